@@ -0,0 +1,68 @@
+/// \file
+/// \brief Compile-time bit patterns of the ArUco DICT_6X6_250 dictionary and a marker blitter
+
+#include "include/aruco-atlas.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int kMaxCells = arucoMarkerCells(kArucoMaxBorderBits);
+
+// Split [0, size) into the runs of pixels that sample each cell. The sampling is the same as
+// cv::resize with INTER_NEAREST, down to the double precision scale, so the result matches
+// generateImageMarker pixel for pixel.
+void cellStarts(int cells, int size, int *starts) {
+	double scale = 1.0 / (static_cast<double>(size) / cells);
+	int pos = 0;
+	for (int cell = 0; cell <= cells; cell++) {
+		while ((pos < size) && (std::min(static_cast<int>(std::floor(pos * scale)), cells - 1) < cell)) {
+			pos++;
+		}
+		starts[cell] = pos;
+	}
+}
+
+} // namespace
+
+auto blitArucoMarker(int id, uint8_t *pixels, int width, int height, size_t stride, int channels,
+		int borderBits) -> bool {
+	const int cells = arucoMarkerCells(borderBits);
+	if ((id < 0) || (id >= kArucoDictionarySize) || (borderBits < 1) ||
+			(borderBits > kArucoMaxBorderBits) || (width < cells) || (height < cells) || (channels < 1)) {
+		return false;
+	}
+
+	int colStart[kMaxCells + 1];
+	int rowStart[kMaxCells + 1];
+	cellStarts(cells, width, colStart);
+	cellStarts(cells, height, rowStart);
+
+	const size_t rowBytes = static_cast<size_t>(width) * channels;
+	for (int row = 0; row < cells; row++) {
+		// Fill the first pixel row of each cell row, then copy it down
+		uint8_t *first = pixels + rowStart[row] * stride;
+		for (int col = 0; col < cells; col++) {
+			std::memset(first + colStart[col] * channels,
+					arucoMarkerCell(id, row, col, borderBits) ? 255 : 0,
+					static_cast<size_t>(colStart[col + 1] - colStart[col]) * channels);
+		}
+		for (int y = rowStart[row] + 1; y < rowStart[row + 1]; y++) {
+			std::memcpy(pixels + y * stride, first, rowBytes);
+		}
+	}
+
+	return true;
+}
+
+auto blitArucoMarker(int id, cv::Mat &target, int borderBits) -> bool {
+	if ((target.dims != 2) || (target.depth() != CV_8U) || (target.channels() > 4)) {
+		return false;
+	}
+	return blitArucoMarker(id, target.data, target.cols, target.rows, target.step[0], target.channels(),
+			borderBits);
+}
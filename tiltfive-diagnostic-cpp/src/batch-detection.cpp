@@ -0,0 +1,265 @@
+/// \file
+/// \brief Headless ArUco detection over directories of captured frames
+
+#include "include/batch-detection.hpp"
+
+#include "include/bounded-queue.hpp"
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/objdetect/aruco_dictionary.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct DecodedImage {
+	size_t index = 0;
+	cv::Mat image;
+};
+
+auto isImageFile(const fs::path &path) -> bool {
+	static const char *const kExtensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".pgm", ".tif", ".tiff" };
+
+	std::string ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return std::find_if(std::begin(kExtensions), std::end(kExtensions),
+				   [&](const char *known) { return ext == known; }) != std::end(kExtensions);
+}
+
+template <typename T>
+void writeRaw(std::ofstream &out, T value) {
+	out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+} // namespace
+
+auto CsvDetectionSink::begin(size_t /* imageCount */) -> bool {
+	mOut.open(mPath, std::ios::trunc);
+	if (!mOut) {
+		std::cerr << "Error creating " << mPath << std::endl;
+		return false;
+	}
+	mOut << "index,path,markers,id,x0,y0,x1,y1,x2,y2,x3,y3\n";
+	return static_cast<bool>(mOut);
+}
+
+auto CsvDetectionSink::write(const ImageDetections &detections) -> bool {
+	char buffer[160];
+	std::string prefix = std::to_string(detections.index) + "," + detections.path + ",";
+
+	if (!detections.decoded || detections.ids.empty()) {
+		mOut << prefix << (detections.decoded ? "0" : "-1") << ",,,,,,,,,\n";
+		return static_cast<bool>(mOut);
+	}
+
+	for (size_t i = 0; i < detections.ids.size(); i++) {
+		const auto &c = detections.corners[i];
+		std::snprintf(buffer, sizeof(buffer), "%zu,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+				detections.ids.size(), detections.ids[i], c[0].x, c[0].y, c[1].x, c[1].y, c[2].x, c[2].y,
+				c[3].x, c[3].y);
+		mOut << prefix << buffer;
+	}
+	return static_cast<bool>(mOut);
+}
+
+auto CsvDetectionSink::finish() -> bool {
+	mOut.close();
+	return !mOut.fail();
+}
+
+auto BinaryDetectionSink::begin(size_t imageCount) -> bool {
+	mOut.open(mPath, std::ios::binary | std::ios::trunc);
+	if (!mOut) {
+		std::cerr << "Error creating " << mPath << std::endl;
+		return false;
+	}
+	mOut.write("T5DR", 4);
+	writeRaw<uint32_t>(mOut, kVersion);
+	writeRaw<uint32_t>(mOut, static_cast<uint32_t>(imageCount));
+	return static_cast<bool>(mOut);
+}
+
+auto BinaryDetectionSink::write(const ImageDetections &detections) -> bool {
+	auto pathLength = static_cast<uint16_t>(std::min<size_t>(detections.path.size(), UINT16_MAX));
+
+	writeRaw<uint32_t>(mOut, static_cast<uint32_t>(detections.index));
+	writeRaw<uint16_t>(mOut, pathLength);
+	mOut.write(detections.path.data(), pathLength);
+	writeRaw<int32_t>(mOut, detections.decoded ? static_cast<int32_t>(detections.ids.size()) : -1);
+
+	for (size_t i = 0; i < detections.ids.size(); i++) {
+		writeRaw<int32_t>(mOut, detections.ids[i]);
+		for (const auto &corner : detections.corners[i]) {
+			writeRaw<float>(mOut, corner.x);
+			writeRaw<float>(mOut, corner.y);
+		}
+	}
+	return static_cast<bool>(mOut);
+}
+
+auto BinaryDetectionSink::finish() -> bool {
+	mOut.close();
+	return !mOut.fail();
+}
+
+auto collectImagePaths(const std::string &path, std::vector<std::string> &paths) -> bool {
+	std::error_code err;
+	fs::path input(path);
+
+	if (fs::is_directory(input, err)) {
+		std::vector<std::string> found;
+		for (const auto &entry : fs::directory_iterator(input, err)) {
+			if (entry.is_regular_file() && isImageFile(entry.path())) {
+				found.push_back(entry.path().string());
+			}
+		}
+		if (err) {
+			std::cerr << "Error reading " << path << " : " << err.message() << std::endl;
+			return false;
+		}
+		std::sort(found.begin(), found.end());
+		paths.insert(paths.end(), found.begin(), found.end());
+		return true;
+	}
+
+	std::string ext = input.extension().string();
+	if ((ext == ".txt") || (ext == ".lst")) {
+		std::ifstream list(path);
+		if (!list) {
+			std::cerr << "Error opening " << path << std::endl;
+			return false;
+		}
+		std::string line;
+		while (std::getline(list, line)) {
+			if (!line.empty() && (line.back() == '\r')) {
+				line.pop_back();
+			}
+			if (line.empty() || (line[0] == '#')) {
+				continue;
+			}
+			fs::path frame(line);
+			paths.push_back(frame.is_absolute() ? line : (input.parent_path() / frame).string());
+		}
+		return true;
+	}
+
+	if (!fs::is_regular_file(input, err)) {
+		std::cerr << "No such file or directory : " << path << std::endl;
+		return false;
+	}
+	paths.push_back(path);
+	return true;
+}
+
+auto runBatchDetection(const std::vector<std::string> &paths, const BatchDetectionOptions &options,
+		DetectionSink &sink, BatchDetectionStats &stats) -> bool {
+	stats = BatchDetectionStats();
+
+	int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	int decodeThreads = std::max(1, options.decodeThreads);
+	int detectThreads = (options.detectThreads > 0) ? options.detectThreads : hardwareThreads;
+
+	if (!sink.begin(paths.size())) {
+		return false;
+	}
+
+	// Parallelism comes from running whole images side by side; OpenCV's own worker pool inside
+	// each detection would only oversubscribe the cores.
+	int previousCvThreads = cv::getNumThreads();
+	if (detectThreads > 1) {
+		cv::setNumThreads(1);
+	}
+
+	BoundedQueue<DecodedImage> decoded(options.prefetch);
+	std::atomic<size_t> nextToDecode{ 0 };
+	std::atomic<bool> failed{ false };
+
+	// Results arrive out of order and are held here until every earlier image has been written
+	std::mutex resultMtx;
+	std::map<size_t, ImageDetections> pending;
+	size_t nextToWrite = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> decoders;
+	std::atomic<int> decodersRunning{ decodeThreads };
+	for (int i = 0; i < decodeThreads; i++) {
+		decoders.emplace_back([&]() {
+			for (;;) {
+				size_t index = nextToDecode.fetch_add(1);
+				if ((index >= paths.size()) || failed) {
+					break;
+				}
+				DecodedImage item;
+				item.index = index;
+				item.image = cv::imread(paths[index], cv::IMREAD_GRAYSCALE);
+				if (!decoded.push(std::move(item))) {
+					break;
+				}
+			}
+			if (decodersRunning.fetch_sub(1) == 1) {
+				decoded.close();
+			}
+		});
+	}
+
+	std::vector<std::thread> detectors;
+	for (int i = 0; i < detectThreads; i++) {
+		detectors.emplace_back([&]() {
+			cv::aruco::ArucoDetector detector(
+					cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250), options.detectorParams);
+
+			DecodedImage item;
+			while (decoded.pop(item)) {
+				ImageDetections result;
+				result.index = item.index;
+				result.path = paths[item.index];
+				result.decoded = !item.image.empty();
+				if (result.decoded) {
+					detector.detectMarkers(item.image, result.corners, result.ids);
+				}
+
+				std::lock_guard<std::mutex> lock(resultMtx);
+				pending.emplace(result.index, std::move(result));
+				for (auto it = pending.begin(); (it != pending.end()) && (it->first == nextToWrite);
+						it = pending.erase(it)) {
+					const auto &ready = it->second;
+					stats.images++;
+					stats.failed += ready.decoded ? 0 : 1;
+					stats.markers += ready.ids.size();
+					if (!failed && !sink.write(ready)) {
+						failed = true;
+						decoded.close();
+					}
+					nextToWrite++;
+				}
+			}
+		});
+	}
+
+	for (auto &thread : decoders) {
+		thread.join();
+	}
+	for (auto &thread : detectors) {
+		thread.join();
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	stats.seconds = elapsed.count();
+
+	cv::setNumThreads(previousCvThreads);
+
+	return sink.finish() && !failed;
+}
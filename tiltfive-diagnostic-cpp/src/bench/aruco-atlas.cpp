@@ -0,0 +1,80 @@
+/// \file
+/// \brief Benchmark of the DICT_6X6_250 atlas blitter against cv::aruco::generateImageMarker
+///
+/// Every marker is first rendered both ways at several sizes and compared pixel for pixel, so the
+/// benchmark doubles as a check that the compile-time table matches OpenCV's dictionary.
+
+#include "../include/aruco-atlas.hpp"
+#include "bench.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect/aruco_dictionary.hpp>
+
+namespace {
+
+constexpr int kSizes[] = { 8, 37, 64, 200, 512 };
+
+auto matches(const cv::aruco::Dictionary &dictionary, int id, int side, int borderBits) -> bool {
+	cv::Mat expected;
+	cv::aruco::generateImageMarker(dictionary, id, side, expected, borderBits);
+
+	// Blit into the middle of a larger image to exercise a strided ROI
+	cv::Mat canvas(side + 16, side + 16, CV_8UC1, cv::Scalar(128));
+	cv::Mat region = canvas(cv::Rect(8, 8, side, side));
+	if (!blitArucoMarker(id, region, borderBits)) {
+		return false;
+	}
+	for (int y = 0; y < side; y++) {
+		if (std::memcmp(region.ptr(y), expected.ptr(y), side) != 0) {
+			return false;
+		}
+	}
+	return (canvas.at<uint8_t>(7, 7) == 128) && (canvas.at<uint8_t>(side + 8, side + 8) == 128);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	size_t iterations = bench::iterationsFromArgs(argc, argv, 2000);
+
+	cv::aruco::Dictionary dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
+	if (dictionary.bytesList.rows != kArucoDictionarySize) {
+		std::fprintf(stderr, "Unexpected dictionary size %d\n", dictionary.bytesList.rows);
+		return EXIT_FAILURE;
+	}
+	for (int borderBits = 1; borderBits <= 2; borderBits++) {
+		for (int side : kSizes) {
+			if (side < arucoMarkerCells(borderBits)) {
+				continue;
+			}
+			for (int id = 0; id < kArucoDictionarySize; id++) {
+				if (!matches(dictionary, id, side, borderBits)) {
+					std::fprintf(stderr, "Mismatch for marker %d at %d px, border %d\n", id, side,
+							borderBits);
+					return EXIT_FAILURE;
+				}
+			}
+		}
+	}
+	std::printf("All %d markers match generateImageMarker\n\n", kArucoDictionarySize);
+
+	for (int side : { 64, 200 }) {
+		char name[64];
+		cv::Mat target(side, side, CV_8UC1);
+
+		std::snprintf(name, sizeof(name), "generateImageMarker %dpx", side);
+		bench::run(name, iterations, [&](size_t i) {
+			cv::aruco::generateImageMarker(dictionary, static_cast<int>(i % kArucoDictionarySize), side,
+					target, 1);
+			bench::doNotOptimize(target.data[0]);
+		});
+
+		std::snprintf(name, sizeof(name), "blitArucoMarker %dpx", side);
+		bench::run(name, iterations, [&](size_t i) {
+			blitArucoMarker(static_cast<int>(i % kArucoDictionarySize), target);
+			bench::doNotOptimize(target.data[0]);
+		});
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+/// \file
+/// \brief Minimal timing helpers shared by the benchmark executables
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace bench {
+
+/// Keep the compiler from discarding a value computed in a timed loop
+template <typename T>
+inline void doNotOptimize(T const &value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile const void *sink;
+	sink = &value;
+#endif
+}
+
+/// Timing for a single benchmark case
+struct Stats {
+	double nsPerOp;
+	size_t iterations;
+};
+
+/// Iteration count for the benchmarks, overridable with `--iterations N`
+inline size_t iterationsFromArgs(int argc, char **argv, size_t defaultIterations) {
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::strcmp(argv[i], "--iterations") == 0) {
+			return std::strtoull(argv[i + 1], nullptr, 10);
+		}
+	}
+	return defaultIterations;
+}
+
+/// Run fn(i) for i in [0, iterations) and report the best of several repeats
+template <typename Fn>
+auto run(const char *name, size_t iterations, Fn &&fn) -> Stats {
+	constexpr int kRepeats = 5;
+
+	// Warm up caches and branch predictors
+	for (size_t i = 0; i < iterations / 10 + 1; i++) {
+		fn(i);
+	}
+
+	double best = 1e300;
+	for (int repeat = 0; repeat < kRepeats; repeat++) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; i++) {
+			fn(i);
+		}
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, elapsed.count() / static_cast<double>(iterations));
+	}
+
+	std::printf("%-48s %10.3f ns/op\n", name, best);
+	return { best, iterations };
+}
+
+} // namespace bench
@@ -0,0 +1,155 @@
+/// \file
+/// \brief Benchmark of the IR preprocessing kernels at each SIMD level against OpenCV
+///
+/// Each level is first checked against the OpenCV equivalent on a camera-sized frame and on an
+/// odd-sized one that exercises the scalar tails: subtraction and downscaling must match exactly,
+/// and the fixed-point contrast stretch must be within one grey level of convertTo. Downscaling drops
+/// an odd last row and column, where INTER_AREA would blend them in, so it is compared against
+/// INTER_AREA on the even-sized top left of the frame.
+
+#include "../include/ir-preprocess.hpp"
+#include "bench.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cmath>
+
+namespace {
+
+constexpr int kCameraWidth = 768;
+constexpr int kCameraHeight = 600;
+
+auto maxDifference(const cv::Mat &a, const uint8_t *b, size_t bStride) -> int {
+	int worst = 0;
+	for (int y = 0; y < a.rows; y++) {
+		const uint8_t *row = a.ptr(y);
+		for (int x = 0; x < a.cols; x++) {
+			worst = std::max(worst, std::abs(row[x] - b[y * bStride + x]));
+		}
+	}
+	return worst;
+}
+
+auto stretchReference(const cv::Mat &src, cv::Mat &dst, uint8_t low, uint8_t high) -> void {
+	double scale = 255.0 / (high - low);
+	src.convertTo(dst, CV_8U, scale, -low * scale);
+}
+
+auto check(int width, int height) -> bool {
+	cv::Mat light(height, width, CV_8UC1);
+	cv::Mat dark(height, width, CV_8UC1);
+	cv::randu(light, 0, 256);
+	cv::randu(dark, 0, 96);
+
+	cv::Mat expectedSubtract, expectedStretch, expectedDownscale;
+	cv::subtract(light, dark, expectedSubtract);
+	uint8_t low = 0;
+	uint8_t high = 0;
+	findStretchRange(light.data, light.step, width, height, 0.01, low, high);
+	stretchReference(light, expectedStretch, low, high);
+	cv::resize(light(cv::Rect(0, 0, width & ~1, height & ~1)), expectedDownscale, cv::Size(width / 2, height / 2), 0,
+			0, cv::INTER_AREA);
+
+	GrayImage out;
+	out.resize(width, height);
+	for (int level = 0; level <= static_cast<int>(detectSimdLevel()); level++) {
+		const char *name = simdLevelName(forceSimdLevel(static_cast<SimdLevel>(level)));
+
+		subtractDarkFrame(light.data, light.step, dark.data, dark.step, out.data(), out.stride(), width,
+				height);
+		if (maxDifference(expectedSubtract, out.data(), out.stride()) != 0) {
+			std::fprintf(stderr, "%s subtractDarkFrame differs from cv::subtract at %dx%d\n", name, width,
+					height);
+			return false;
+		}
+
+		contrastStretch(light.data, light.step, out.data(), out.stride(), width, height, low, high);
+		if (maxDifference(expectedStretch, out.data(), out.stride()) > 1) {
+			std::fprintf(stderr, "%s contrastStretch differs from convertTo at %dx%d\n", name, width,
+					height);
+			return false;
+		}
+
+		downscaleBy2(light.data, light.step, out.data(), width / 2, width, height);
+		if (maxDifference(expectedDownscale, out.data(), width / 2) != 0) {
+			std::fprintf(stderr, "%s downscaleBy2 differs from INTER_AREA at %dx%d\n", name, width,
+					height);
+			return false;
+		}
+	}
+	forceSimdLevel(detectSimdLevel());
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	size_t iterations = bench::iterationsFromArgs(argc, argv, 2000);
+
+	cv::setNumThreads(1);
+	cv::setRNGSeed(7);
+	if (!check(kCameraWidth, kCameraHeight) || !check(kCameraWidth - 1, kCameraHeight + 1) || !check(33, 17)) {
+		return EXIT_FAILURE;
+	}
+	std::printf("All levels match OpenCV; this CPU supports %s\n\n", simdLevelName(detectSimdLevel()));
+
+	cv::Mat light(kCameraHeight, kCameraWidth, CV_8UC1);
+	cv::Mat dark(kCameraHeight, kCameraWidth, CV_8UC1);
+	cv::randu(light, 0, 256);
+	cv::randu(dark, 0, 96);
+	cv::Mat target;
+	uint8_t low = 0;
+	uint8_t high = 0;
+	findStretchRange(light.data, light.step, kCameraWidth, kCameraHeight, 0.01, low, high);
+
+	bench::run("cv::subtract", iterations, [&](size_t) {
+		cv::subtract(light, dark, target);
+		bench::doNotOptimize(target.data[0]);
+	});
+	bench::run("Mat::convertTo stretch", iterations, [&](size_t) {
+		stretchReference(light, target, low, high);
+		bench::doNotOptimize(target.data[0]);
+	});
+	bench::run("cv::resize INTER_AREA 1/2", iterations, [&](size_t) {
+		cv::resize(light, target, cv::Size(kCameraWidth / 2, kCameraHeight / 2), 0, 0, cv::INTER_AREA);
+		bench::doNotOptimize(target.data[0]);
+	});
+
+	GrayImage out;
+	out.resize(kCameraWidth, kCameraHeight);
+	for (int level = 0; level <= static_cast<int>(detectSimdLevel()); level++) {
+		char name[64];
+		const char *levelName = simdLevelName(forceSimdLevel(static_cast<SimdLevel>(level)));
+		std::printf("\n");
+
+		std::snprintf(name, sizeof(name), "subtractDarkFrame %s", levelName);
+		bench::run(name, iterations, [&](size_t) {
+			subtractDarkFrame(light.data, light.step, dark.data, dark.step, out.data(), out.stride(),
+					kCameraWidth, kCameraHeight);
+			bench::doNotOptimize(out.pixels[0]);
+		});
+
+		std::snprintf(name, sizeof(name), "findStretchRange %s", levelName);
+		bench::run(name, iterations, [&](size_t) {
+			findStretchRange(light.data, light.step, kCameraWidth, kCameraHeight, 0.01, low, high);
+			bench::doNotOptimize(high);
+		});
+
+		std::snprintf(name, sizeof(name), "contrastStretch %s", levelName);
+		bench::run(name, iterations, [&](size_t) {
+			contrastStretch(light.data, light.step, out.data(), out.stride(), kCameraWidth, kCameraHeight,
+					low, high);
+			bench::doNotOptimize(out.pixels[0]);
+		});
+
+		std::snprintf(name, sizeof(name), "downscaleBy2 %s", levelName);
+		bench::run(name, iterations, [&](size_t) {
+			downscaleBy2(light.data, light.step, out.data(), kCameraWidth / 2, kCameraWidth, kCameraHeight);
+			bench::doNotOptimize(out.pixels[0]);
+		});
+	}
+	forceSimdLevel(detectSimdLevel());
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,305 @@
+/// \file
+/// \brief Benchmark of PoseFilterBank updates at each SIMD level, and of filtering glasses one by one
+///
+/// Both filter types are first checked for behaviour on synthetic trajectories: smoothing a noisy
+/// constant-velocity walk, extrapolating linear motion up to the prediction horizon, ignoring a
+/// measured quaternion's sign and ignoring stale poses. Then each level is checked against the
+/// scalar one on a noisy synthetic walk for several glasses counts, including ones that leave a
+/// partial vector.
+
+#include "../include/ir-preprocess.hpp"
+#include "../include/pose-filter.hpp"
+#include "bench.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kPeriodNanos = 2000000;
+
+/// Poses of every pair of glasses at each step, glasses moving slowly with measurement noise
+auto makePoses(size_t glassesCount, size_t steps) -> std::vector<T5_GlassesPose> {
+	std::mt19937 random(7);
+	std::normal_distribution<float> noise(0.0f, 0.0005f);
+	std::vector<T5_GlassesPose> poses(glassesCount * steps);
+	for (size_t step = 0; step < steps; step++) {
+		float t = static_cast<float>(step) * 0.002f;
+		for (size_t g = 0; g < glassesCount; g++) {
+			float phase = static_cast<float>(g) * 0.7f;
+			float angle = 0.3f * std::sin(t + phase) + noise(random);
+			T5_GlassesPose &pose = poses[step * glassesCount + g];
+			// Every seventh step of some glasses repeats the previous timestamp, as a stale read would
+			pose.timestampNanos = (step + 1) * kPeriodNanos - ((step % 7 == 0 && g % 3 == 0 && step) ? kPeriodNanos : 0);
+			pose.posGLS_GBD = { 0.2f * std::sin(t + phase) + noise(random), 0.3f + noise(random),
+				0.1f * std::cos(t * 0.5f + phase) + noise(random) };
+			pose.rotToGLS_GBD = { std::cos(angle * 0.5f), 0.0f, std::sin(angle * 0.5f), 0.0f };
+			pose.gameboardType = kT5_GameboardType_LE;
+		}
+	}
+	return poses;
+}
+
+auto filterAll(PoseFilterType type, size_t glassesCount, const std::vector<T5_GlassesPose> &poses)
+		-> std::vector<T5_GlassesPose> {
+	PoseFilterOptions options;
+	options.type = type;
+	PoseFilterBank bank(glassesCount, options);
+	size_t steps = poses.size() / glassesCount;
+	for (size_t step = 0; step < steps; step++) {
+		bank.updateAll(&poses[step * glassesCount]);
+	}
+	std::vector<T5_GlassesPose> predicted(glassesCount);
+	bank.predictAll(steps * kPeriodNanos + kPeriodNanos / 2, predicted.data());
+	return predicted;
+}
+
+auto maxDifference(const std::vector<T5_GlassesPose> &a, const std::vector<T5_GlassesPose> &b) -> float {
+	float worst = 0.0f;
+	for (size_t i = 0; i < a.size(); i++) {
+		const float lhs[] = { a[i].posGLS_GBD.x, a[i].posGLS_GBD.y, a[i].posGLS_GBD.z, a[i].rotToGLS_GBD.w,
+			a[i].rotToGLS_GBD.x, a[i].rotToGLS_GBD.y, a[i].rotToGLS_GBD.z };
+		const float rhs[] = { b[i].posGLS_GBD.x, b[i].posGLS_GBD.y, b[i].posGLS_GBD.z, b[i].rotToGLS_GBD.w,
+			b[i].rotToGLS_GBD.x, b[i].rotToGLS_GBD.y, b[i].rotToGLS_GBD.z };
+		for (int c = 0; c < PoseFilterBank::kChannels; c++) {
+			worst = std::max(worst, std::fabs(lhs[c] - rhs[c]));
+		}
+	}
+	return worst;
+}
+
+auto typeName(PoseFilterType type) -> const char * {
+	return (type == PoseFilterType::kOneEuro) ? "One-Euro" : "Kalman";
+}
+
+/// Glasses walking along x at a constant speed, turning slowly about y, one pose per period
+auto walkPose(size_t step, float speed, float noiseMeters, std::mt19937 &random) -> T5_GlassesPose {
+	std::normal_distribution<float> noise(0.0f, 1.0f);
+	float t = static_cast<float>(step) * kPeriodNanos * 1e-9f;
+	float angle = 0.2f * t;
+	T5_GlassesPose pose{};
+	pose.timestampNanos = (step + 1) * kPeriodNanos;
+	pose.posGLS_GBD = { speed * t + noiseMeters * noise(random), 0.3f + noiseMeters * noise(random),
+		noiseMeters * noise(random) };
+	pose.rotToGLS_GBD = { std::cos(angle * 0.5f), 0.0f, std::sin(angle * 0.5f), 0.0f };
+	pose.gameboardType = kT5_GameboardType_LE;
+	return pose;
+}
+
+auto maxDifference(const T5_GlassesPose &a, const T5_GlassesPose &b) -> float {
+	return maxDifference(std::vector<T5_GlassesPose>{ a }, std::vector<T5_GlassesPose>{ b });
+}
+
+/// RMS position error of the filtered and of the raw poses against the true walk, after a second
+/// for the filter to settle
+auto walkErrors(PoseFilterType type, float speed, float noiseMeters, double &filteredRms, double &rawRms) -> void {
+	PoseFilterOptions options;
+	options.type = type;
+	PoseFilter filter(options);
+	std::mt19937 random(11);
+	std::mt19937 clean(11);
+	constexpr size_t kSettleSteps = 500;
+	constexpr size_t kSteps = 3000;
+	double filteredSum = 0.0;
+	double rawSum = 0.0;
+	for (size_t step = 0; step < kSteps; step++) {
+		T5_GlassesPose measured = walkPose(step, speed, noiseMeters, random);
+		T5_GlassesPose truth = walkPose(step, speed, 0.0f, clean);
+		filter.update(measured);
+		if (step < kSettleSteps) {
+			continue;
+		}
+		T5_GlassesPose filtered = filter.predict(measured.timestampNanos);
+		const float errors[][2] = {
+			{ filtered.posGLS_GBD.x - truth.posGLS_GBD.x, measured.posGLS_GBD.x - truth.posGLS_GBD.x },
+			{ filtered.posGLS_GBD.y - truth.posGLS_GBD.y, measured.posGLS_GBD.y - truth.posGLS_GBD.y },
+			{ filtered.posGLS_GBD.z - truth.posGLS_GBD.z, measured.posGLS_GBD.z - truth.posGLS_GBD.z },
+		};
+		for (const auto &error : errors) {
+			filteredSum += error[0] * error[0];
+			rawSum += error[1] * error[1];
+		}
+	}
+	filteredRms = std::sqrt(filteredSum / (3 * (kSteps - kSettleSteps)));
+	rawRms = std::sqrt(rawSum / (3 * (kSteps - kSettleSteps)));
+}
+
+auto checkBehaviour(PoseFilterType type) -> bool {
+	const char *name = typeName(type);
+	PoseFilterOptions options;
+	options.type = type;
+
+	// Smoothing: below the measurement noise on a slow walk. The One-Euro filter trades smoothing
+	// for lag as speed rises, so only the Kalman filter, which models the velocity, is also held
+	// to it on a fast walk.
+	for (float speed : { 0.002f, 0.5f }) {
+		double filteredRms = 0.0;
+		double rawRms = 0.0;
+		walkErrors(type, speed, 0.0005f, filteredRms, rawRms);
+		bool held = (type == PoseFilterType::kKalman) || (speed < 0.01f);
+		std::printf("%-8s walk at %.3f m/s: %.3f mm RMS error, measurements %.3f mm%s\n", name, speed,
+				filteredRms * 1e3, rawRms * 1e3, held ? "" : " (lag, not checked)");
+		if (held && !(filteredRms < rawRms)) {
+			std::fprintf(stderr, "%s doesn't smooth a %.3f m/s walk\n", name, speed);
+			return false;
+		}
+	}
+
+	// Prediction: extrapolates noiseless linear motion and holds at the horizon
+	constexpr float kSpeed = 0.1f;
+	PoseFilter linear(options);
+	std::mt19937 unused(0);
+	constexpr size_t kLinearSteps = 2000;
+	for (size_t step = 0; step < kLinearSteps; step++) {
+		linear.update(walkPose(step, kSpeed, 0.0f, unused));
+	}
+	uint64_t last = kLinearSteps * kPeriodNanos;
+	auto horizonNanos = static_cast<uint64_t>(options.maxPredictionSeconds * 1e9);
+	T5_GlassesPose now = linear.predict(last);
+	T5_GlassesPose ahead = linear.predict(last + horizonNanos / 2);
+	float expected = kSpeed * static_cast<float>(options.maxPredictionSeconds / 2);
+	float travelled = ahead.posGLS_GBD.x - now.posGLS_GBD.x;
+	if (std::fabs(travelled - expected) > 0.02f * expected) {
+		std::fprintf(stderr, "%s predicts %g m of travel instead of %g m\n", name, travelled, expected);
+		return false;
+	}
+	if ((maxDifference(linear.predict(last + horizonNanos), linear.predict(last + 10 * horizonNanos)) != 0.0f) ||
+			(maxDifference(linear.predict(last - horizonNanos), linear.predict(last - 10 * horizonNanos)) != 0.0f)) {
+		std::fprintf(stderr, "%s prediction isn't held at maxPredictionSeconds\n", name);
+		return false;
+	}
+
+	// Quaternion sign: measuring -q instead of q for every other pose changes nothing
+	PoseFilter plain(options);
+	PoseFilter flipped(options);
+	std::mt19937 plainNoise(3);
+	std::mt19937 flippedNoise(3);
+	float worst = 0.0f;
+	for (size_t step = 0; step < 1000; step++) {
+		T5_GlassesPose pose = walkPose(step, kSpeed, 0.0005f, plainNoise);
+		T5_GlassesPose negated = walkPose(step, kSpeed, 0.0005f, flippedNoise);
+		if (step % 2 == 1) {
+			negated.rotToGLS_GBD = { -negated.rotToGLS_GBD.w, -negated.rotToGLS_GBD.x, -negated.rotToGLS_GBD.y,
+				-negated.rotToGLS_GBD.z };
+		}
+		plain.update(pose);
+		flipped.update(negated);
+		worst = std::max(worst, maxDifference(plain.predict(pose.timestampNanos), flipped.predict(pose.timestampNanos)));
+	}
+	if (worst > 1e-6f) {
+		std::fprintf(stderr, "%s output moves by %g when measured quaternions flip sign\n", name, worst);
+		return false;
+	}
+
+	// Staleness: a pose not newer than the last one is ignored, however far off it is
+	T5_GlassesPose before = plain.predict(last);
+	T5_GlassesPose stale = walkPose(998, kSpeed, 0.0f, unused);
+	stale.posGLS_GBD.x += 1.0f;
+	stale.rotToGLS_GBD = { 0.0f, 1.0f, 0.0f, 0.0f };
+	plain.update(stale);
+	stale.timestampNanos = 1000 * kPeriodNanos;
+	plain.update(stale);
+	if (maxDifference(before, plain.predict(last)) != 0.0f) {
+		std::fprintf(stderr, "%s uses poses with stale timestamps\n", name);
+		return false;
+	}
+	return true;
+}
+
+auto check(size_t glassesCount) -> bool {
+	std::vector<T5_GlassesPose> poses = makePoses(glassesCount, 500);
+	for (PoseFilterType type : { PoseFilterType::kOneEuro, PoseFilterType::kKalman }) {
+		forceSimdLevel(SimdLevel::kScalar);
+		std::vector<T5_GlassesPose> expected = filterAll(type, glassesCount, poses);
+		for (int level = 1; level <= static_cast<int>(detectSimdLevel()); level++) {
+			const char *name = simdLevelName(forceSimdLevel(static_cast<SimdLevel>(level)));
+			float difference = maxDifference(expected, filterAll(type, glassesCount, poses));
+			if (difference > 1e-5f) {
+				std::fprintf(stderr, "%s %s differs from scalar by %g for %zu glasses\n", name, typeName(type),
+						difference, glassesCount);
+				return false;
+			}
+		}
+	}
+	forceSimdLevel(detectSimdLevel());
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	size_t iterations = bench::iterationsFromArgs(argc, argv, 200000);
+
+	for (PoseFilterType type : { PoseFilterType::kOneEuro, PoseFilterType::kKalman }) {
+		if (!checkBehaviour(type)) {
+			return EXIT_FAILURE;
+		}
+	}
+	for (size_t glassesCount : { 1, 3, 8, 13, 64 }) {
+		if (!check(glassesCount)) {
+			return EXIT_FAILURE;
+		}
+	}
+	std::printf("All levels match scalar; this CPU supports %s\n", simdLevelName(detectSimdLevel()));
+
+	constexpr size_t kSteps = 64;
+	for (size_t glassesCount : { 1, 8, 64 }) {
+		std::vector<T5_GlassesPose> poses = makePoses(glassesCount, kSteps);
+		std::vector<T5_GlassesPose> predicted(glassesCount);
+		size_t scaled = iterations / glassesCount + 1;
+		char name[64];
+		std::printf("\n");
+
+		for (PoseFilterType type : { PoseFilterType::kOneEuro, PoseFilterType::kKalman }) {
+			const char *typeName = (type == PoseFilterType::kOneEuro) ? "one-euro" : "kalman";
+			PoseFilterOptions options;
+			options.type = type;
+
+			// Glasses one at a time, as separate PoseFilters would be
+			std::vector<PoseFilter> single(glassesCount, PoseFilter(options));
+			std::snprintf(name, sizeof(name), "%s PoseFilter x%zu", typeName, glassesCount);
+			uint64_t offset = 0;
+			bench::run(name, scaled, [&](size_t i) {
+				size_t step = i % kSteps;
+				offset += (step == 0) ? kSteps * kPeriodNanos : 0;
+				for (size_t g = 0; g < glassesCount; g++) {
+					T5_GlassesPose pose = poses[step * glassesCount + g];
+					pose.timestampNanos += offset;
+					single[g].update(pose);
+				}
+				bench::doNotOptimize(single[0]);
+			});
+
+			for (int level = 0; level <= static_cast<int>(detectSimdLevel()); level++) {
+				const char *levelName = simdLevelName(forceSimdLevel(static_cast<SimdLevel>(level)));
+				if (level == static_cast<int>(SimdLevel::kSse2)) {
+					// The filters have no SSE2 kernels; that level runs the scalar ones
+					continue;
+				}
+				PoseFilterBank bank(glassesCount, options);
+				std::vector<T5_GlassesPose> shifted(poses);
+				std::snprintf(name, sizeof(name), "%s updateAll %s x%zu", typeName, levelName, glassesCount);
+				bench::run(name, scaled, [&](size_t i) {
+					size_t step = i % kSteps;
+					if (step == 0 && i) {
+						for (auto &pose : shifted) {
+							pose.timestampNanos += kSteps * kPeriodNanos;
+						}
+					}
+					bank.updateAll(&shifted[step * glassesCount]);
+					bench::doNotOptimize(bank);
+				});
+
+				std::snprintf(name, sizeof(name), "%s predictAll %s x%zu", typeName, levelName, glassesCount);
+				bench::run(name, scaled, [&](size_t i) {
+					bank.predictAll(i * 1000, predicted.data());
+					bench::doNotOptimize(predicted[0]);
+				});
+			}
+		}
+	}
+	forceSimdLevel(detectSimdLevel());
+
+	return EXIT_SUCCESS;
+}
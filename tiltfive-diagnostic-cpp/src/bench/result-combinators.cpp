@@ -0,0 +1,180 @@
+/// \file
+/// \brief Benchmark of tiltfive::Result combinators against hand-written error checks
+///
+/// The two pipelines below do the same work: three fallible steps, each of which fails for a
+/// fraction of inputs. handWritten() uses the `if (!x) return x.error();` pattern, chained()
+/// uses and_then()/map(). Both are kept out of line so their code can be compared directly:
+///
+///     objdump -d --no-show-raw-insn -C result-combinators | less   # search for handWritten/chained
+
+#include "../include/TiltFiveNative.hpp"
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+namespace {
+
+constexpr size_t kInputCount = 4096;
+std::vector<int> gInputs;
+
+inline auto readSensor(int raw) -> tiltfive::Result<int> {
+	if ((raw & 0x3f) == 0) {
+		return tiltfive::Error::kTryAgain;
+	}
+	return raw * 3;
+}
+
+inline auto scale(int value) -> tiltfive::Result<double> {
+	if (value > 1000000) {
+		return tiltfive::Error::kOverflow;
+	}
+	return value * 0.25;
+}
+
+inline auto offset(double value) -> double {
+	return value + 1.5;
+}
+
+BENCH_NOINLINE auto handWritten(int raw) -> tiltfive::Result<double> {
+	auto sensor = readSensor(raw);
+	if (!sensor) {
+		return sensor.error();
+	}
+	auto scaled = scale(*sensor);
+	if (!scaled) {
+		return scaled.error();
+	}
+	return offset(*scaled);
+}
+
+BENCH_NOINLINE auto chained(int raw) -> tiltfive::Result<double> {
+	return readSensor(raw).and_then(scale).map(offset);
+}
+
+BENCH_NOINLINE auto handWrittenValueOr(int raw) -> double {
+	auto result = handWritten(raw);
+	if (!result) {
+		return -1.0;
+	}
+	return *result;
+}
+
+BENCH_NOINLINE auto chainedValueOr(int raw) -> double {
+	return chained(raw).value_or(-1.0);
+}
+
+// Counts copies and moves made while a std::vector grows
+struct Tracked {
+	static size_t copies;
+	static size_t moves;
+
+	std::string payload;
+
+	explicit Tracked(std::string p) : payload(std::move(p)) {}
+	Tracked(const Tracked &other) : payload(other.payload) { copies++; }
+	Tracked(Tracked &&other) noexcept : payload(std::move(other.payload)) { moves++; }
+	auto operator=(const Tracked &) -> Tracked & = default;
+	auto operator=(Tracked &&) noexcept -> Tracked & = default;
+};
+size_t Tracked::copies = 0;
+size_t Tracked::moves = 0;
+
+static_assert(std::is_nothrow_move_constructible<tiltfive::Result<std::string>>::value,
+		"Result<T> must be nothrow-movable when T is");
+static_assert(std::is_nothrow_move_constructible<tiltfive::Result<Tracked>>::value,
+		"Result<T> must be nothrow-movable when T is");
+static_assert(std::is_nothrow_move_constructible<tiltfive::Result<void>>::value,
+		"Result<void> must be nothrow-movable");
+
+} // namespace
+
+int main(int argc, char **argv) {
+	size_t iterations = bench::iterationsFromArgs(argc, argv, 10000000);
+
+	gInputs.resize(kInputCount);
+	for (size_t i = 0; i < kInputCount; i++) {
+		gInputs[i] = static_cast<int>((i * 2654435761u) & 0xfffff);
+	}
+
+	// Both forms must agree before we bother timing them
+	for (size_t i = 0; i < kInputCount; i++) {
+		auto a = handWritten(gInputs[i]);
+		auto b = chained(gInputs[i]);
+		if (static_cast<bool>(a) != static_cast<bool>(b) || (a && (*a != *b)) ||
+				(!a && (a.error() != b.error()))) {
+			std::fprintf(stderr, "Mismatch for input %d\n", gInputs[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::printf("Result<double> pipeline, %zu iterations\n", iterations);
+	auto hand = bench::run("hand-written checks", iterations, [](size_t i) {
+		bench::doNotOptimize(handWritten(gInputs[i % kInputCount]));
+	});
+	auto chain = bench::run("and_then().map()", iterations, [](size_t i) {
+		bench::doNotOptimize(chained(gInputs[i % kInputCount]));
+	});
+	bench::run("hand-written + fallback", iterations, [](size_t i) {
+		bench::doNotOptimize(handWrittenValueOr(gInputs[i % kInputCount]));
+	});
+	bench::run("and_then().map().value_or()", iterations, [](size_t i) {
+		bench::doNotOptimize(chainedValueOr(gInputs[i % kInputCount]));
+	});
+	std::printf("combinator / hand-written ratio : %.3f\n", chain.nsPerOp / hand.nsPerOp);
+
+	// A single ratio swings by 10-20% either way from run to run on a busy machine, so also time
+	// the two pipelines in short alternating rounds and report the median ratio with its spread
+	constexpr int kRounds = 21;
+	size_t roundIterations = iterations / 10 + 1;
+	auto timePipeline = [&](auto &&pipeline) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < roundIterations; i++) {
+			bench::doNotOptimize(pipeline(gInputs[i % kInputCount]));
+		}
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	};
+	std::vector<double> ratios;
+	for (int round = 0; round < kRounds; round++) {
+		double handSeconds = 0.0;
+		double chainSeconds = 0.0;
+		if (round % 2 == 0) {
+			handSeconds = timePipeline(handWritten);
+			chainSeconds = timePipeline(chained);
+		} else {
+			chainSeconds = timePipeline(chained);
+			handSeconds = timePipeline(handWritten);
+		}
+		ratios.push_back(chainSeconds / handSeconds);
+	}
+	std::sort(ratios.begin(), ratios.end());
+	std::printf("median ratio over %d alternating rounds : %.3f (range %.3f to %.3f)\n\n", kRounds,
+			ratios[kRounds / 2], ratios.front(), ratios.back());
+
+	// std::vector only moves elements on reallocation if the move constructor is noexcept
+	constexpr size_t kVectorElements = 100000;
+	std::vector<tiltfive::Result<Tracked>> results;
+	for (size_t i = 0; i < kVectorElements; i++) {
+		results.emplace_back(Tracked(std::string(32, 'x')));
+	}
+	std::printf("vector<Result<T>> growth to %zu elements : %zu copies, %zu moves\n",
+			kVectorElements, Tracked::copies, Tracked::moves);
+
+	bench::run("vector<Result<std::string>> push_back x1000", iterations / 10000 + 1, [](size_t) {
+		std::vector<tiltfive::Result<std::string>> strings;
+		for (int i = 0; i < 1000; i++) {
+			strings.emplace_back(std::string(48, 'y'));
+		}
+		bench::doNotOptimize(strings.data());
+	});
+
+	return (Tracked::copies == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,157 @@
+/// \file
+/// \brief Benchmark of the compact tiltfive::Result representation against the general one
+///
+/// Each T5 payload is compared with a layout-identical wrapper that opts out of the compact
+/// representation via tiltfive::UseCompactResult, so the only difference is the Result itself.
+
+#include "../include/TiltFiveNative.hpp"
+#include "bench.hpp"
+
+#include <vector>
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+struct WidePose : T5_GlassesPose {};
+struct WideWandReport : T5_WandReport {};
+struct WideDouble {
+	double value;
+};
+
+namespace tiltfive {
+template <>
+struct UseCompactResult<WidePose> : std::false_type {};
+template <>
+struct UseCompactResult<WideWandReport> : std::false_type {};
+template <>
+struct UseCompactResult<WideDouble> : std::false_type {};
+} // namespace tiltfive
+
+static_assert(std::is_trivially_copyable<tiltfive::Result<T5_GlassesPose>>::value,
+		"Compact results must be trivially copyable");
+static_assert(std::is_trivially_copyable<tiltfive::Result<T5_WandReport>>::value,
+		"Compact results must be trivially copyable");
+static_assert(!std::is_trivially_copyable<tiltfive::Result<WidePose>>::value,
+		"Opted-out results use the general representation");
+
+namespace {
+
+constexpr size_t kBatch = 1024;
+
+// Mimics Glasses::getLatestGlassesPose(): one call in 16 reports 'try again'
+template <typename Pose>
+BENCH_NOINLINE auto fetchPose(size_t i) -> tiltfive::Result<Pose> {
+	if ((i & 0xf) == 0) {
+		return tiltfive::Error::kTryAgain;
+	}
+	Pose pose{};
+	pose.timestampNanos = i;
+	pose.posGLS_GBD.x = static_cast<float>(i);
+	pose.rotToGLS_GBD.w = 1.0f;
+	return pose;
+}
+
+template <typename Report>
+BENCH_NOINLINE auto fetchReport(size_t i) -> tiltfive::Result<Report> {
+	if ((i & 0xf) == 0) {
+		return tiltfive::Error::kTargetNotFound;
+	}
+	Report report{};
+	report.timestampNanos = i;
+	report.trigger = 0.5f;
+	return report;
+}
+
+BENCH_NOINLINE auto fetchIpd(size_t i) -> tiltfive::Result<double> {
+	if ((i & 0xf) == 0) {
+		return tiltfive::Error::kSettingUnknown;
+	}
+	return 0.063 + static_cast<double>(i & 0xff) * 1e-6;
+}
+
+BENCH_NOINLINE auto fetchWideIpd(size_t i) -> tiltfive::Result<WideDouble> {
+	if ((i & 0xf) == 0) {
+		return tiltfive::Error::kSettingUnknown;
+	}
+	return WideDouble{ 0.063 + static_cast<double>(i & 0xff) * 1e-6 };
+}
+
+template <typename Pose>
+void benchPose(const char *returnName, const char *copyName, size_t iterations) {
+	bench::run(returnName, iterations, [](size_t i) {
+		auto pose = fetchPose<Pose>(i);
+		bench::doNotOptimize(pose ? pose->posGLS_GBD.x : 0.0f);
+	});
+
+	std::vector<tiltfive::Result<Pose>> source;
+	for (size_t i = 0; i < kBatch; i++) {
+		source.push_back(fetchPose<Pose>(i));
+	}
+	std::vector<tiltfive::Result<Pose>> dest(source);
+	bench::run(copyName, iterations / kBatch + 1, [&](size_t) {
+		std::copy(source.cbegin(), source.cend(), dest.begin());
+		bench::doNotOptimize(dest.data());
+	});
+}
+
+template <typename Report>
+void benchReport(const char *name, size_t iterations) {
+	bench::run(name, iterations, [](size_t i) {
+		auto report = fetchReport<Report>(i);
+		bench::doNotOptimize(report ? report->trigger : 0.0f);
+	});
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	size_t iterations = bench::iterationsFromArgs(argc, argv, 20000000);
+
+	std::printf("%-32s %8s %8s\n", "sizeof", "general", "compact");
+	std::printf("%-32s %8zu %8zu\n", "Result<double>", sizeof(tiltfive::Result<WideDouble>),
+			sizeof(tiltfive::Result<double>));
+	std::printf("%-32s %8zu %8zu\n", "Result<T5_GlassesPose>", sizeof(tiltfive::Result<WidePose>),
+			sizeof(tiltfive::Result<T5_GlassesPose>));
+	std::printf("%-32s %8zu %8zu\n", "Result<T5_WandReport>",
+			sizeof(tiltfive::Result<WideWandReport>), sizeof(tiltfive::Result<T5_WandReport>));
+	std::printf("%-32s %8s %8zu\n", "Result<bool>", "-", sizeof(tiltfive::Result<bool>));
+	std::printf("%-32s %8s %8zu\n", "Result<ConnectionState>", "-",
+			sizeof(tiltfive::Result<tiltfive::ConnectionState>));
+	std::printf("\n");
+
+	// Errors must survive the round trip through the compact form
+	auto compactErr = fetchPose<T5_GlassesPose>(0);
+	auto wideErr = fetchPose<WidePose>(0);
+	tiltfive::Result<double> foreignErr = std::errc::timed_out;
+	if (compactErr.error() != wideErr.error() ||
+			foreignErr.error() != std::make_error_code(std::errc::timed_out)) {
+		std::fprintf(stderr, "Compact error round trip failed\n");
+		return EXIT_FAILURE;
+	}
+
+	benchPose<WidePose>("pose return (general)", "pose batch copy x1024 (general)", iterations);
+	benchPose<T5_GlassesPose>("pose return (compact)", "pose batch copy x1024 (compact)",
+			iterations);
+	benchReport<WideWandReport>("wand report return (general)", iterations);
+	benchReport<T5_WandReport>("wand report return (compact)", iterations);
+
+	bench::run("double return (general)", iterations, [](size_t i) {
+		auto ipd = fetchWideIpd(i);
+		bench::doNotOptimize(ipd ? ipd->value : 0.0);
+	});
+	bench::run("double return (compact)", iterations, [](size_t i) {
+		bench::doNotOptimize(fetchIpd(i).value_or(0.0));
+	});
+
+	bench::run("error() materialization (general)", iterations, [](size_t i) {
+		bench::doNotOptimize(fetchPose<WidePose>(i & ~size_t(0xf)).error().value());
+	});
+	bench::run("error() materialization (compact)", iterations, [](size_t i) {
+		bench::doNotOptimize(fetchPose<T5_GlassesPose>(i & ~size_t(0xf)).error().value());
+	});
+
+	return EXIT_SUCCESS;
+}
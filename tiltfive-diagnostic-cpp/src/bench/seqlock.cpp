@@ -0,0 +1,75 @@
+/// \file
+/// \brief Benchmark of reading the latest pose through a SeqLock against a mutex-guarded copy
+///
+/// PoseStreamHelper publishes its latest pose this way. The writer thread stores at 500 Hz, the
+/// helper's default sample rate; readers are timed alone and while it writes. Alone, the SeqLock is
+/// slightly slower than the uncontended mutex; it only wins once the writer is running.
+
+#include "../include/TiltFiveNative.h"
+#include "../include/seqlock.hpp"
+#include "bench.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+/// Background thread that keeps storing new poses until destroyed
+template <typename StoreFn>
+class Writer {
+public:
+	explicit Writer(StoreFn store) : mStore(std::move(store)) {
+		mThread = std::thread([this]() {
+			T5_GlassesPose pose{};
+			while (mRunning.load(std::memory_order_relaxed)) {
+				pose.timestampNanos += 2000000;
+				pose.posGLS_GBD.x = static_cast<float>(pose.timestampNanos % 1000);
+				mStore(pose);
+				std::this_thread::sleep_for(std::chrono::microseconds(2000));
+			}
+		});
+	}
+
+	~Writer() {
+		mRunning = false;
+		mThread.join();
+	}
+
+private:
+	StoreFn mStore;
+	std::atomic<bool> mRunning{ true };
+	std::thread mThread;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+	size_t iterations = bench::iterationsFromArgs(argc, argv, 10000000);
+
+	SeqLock<T5_GlassesPose> seqLock;
+	std::mutex mtx;
+	T5_GlassesPose guarded{};
+
+	bench::run("seqlock load, no writer", iterations, [&](size_t) { bench::doNotOptimize(seqLock.load()); });
+	bench::run("mutex copy, no writer", iterations, [&](size_t) {
+		std::lock_guard<std::mutex> lock(mtx);
+		bench::doNotOptimize(guarded);
+	});
+
+	{
+		Writer writer([&](const T5_GlassesPose &pose) { seqLock.store(pose); });
+		bench::run("seqlock load, writer at 500 Hz", iterations, [&](size_t) { bench::doNotOptimize(seqLock.load()); });
+	}
+	{
+		Writer writer([&](const T5_GlassesPose &pose) {
+			std::lock_guard<std::mutex> lock(mtx);
+			guarded = pose;
+		});
+		bench::run("mutex copy, writer at 500 Hz", iterations, [&](size_t) {
+			std::lock_guard<std::mutex> lock(mtx);
+			bench::doNotOptimize(guarded);
+		});
+	}
+	return 0;
+}
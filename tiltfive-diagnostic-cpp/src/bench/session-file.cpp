@@ -0,0 +1,139 @@
+/// \file
+/// \brief Benchmark of random frame access in a session file against one PNG per frame
+///
+/// Both stores are filled with the same synthetic frames and every frame is read back from both
+/// and compared before timing, so the benchmark also checks the container round trip.
+
+#include "../include/session-file.hpp"
+#include "bench.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace {
+
+constexpr int kWidth = 768;
+constexpr int kHeight = 600;
+constexpr size_t kFrames = 200;
+constexpr uint64_t kFramePeriodNanos = 16666667;
+
+auto pngPath(const std::filesystem::path &directory, size_t index) -> std::string {
+	return (directory / ("frame-" + std::to_string(index) + ".png")).string();
+}
+
+auto checksum(const cv::Mat &image) -> uint64_t {
+	uint64_t sum = 0;
+	for (int y = 0; y < image.rows; y++) {
+		const uint8_t *row = image.ptr(y);
+		for (int x = 0; x < image.cols; x++) {
+			sum += row[x];
+		}
+	}
+	return sum;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	size_t iterations = bench::iterationsFromArgs(argc, argv, 200);
+
+	auto directory = std::filesystem::temp_directory_path() / "t5-session-bench";
+	std::filesystem::create_directories(directory);
+	std::string sessionPath = (directory / "session.t5s").string();
+
+	cv::setRNGSeed(3);
+	cv::Mat image(kHeight, kWidth, CV_8UC1);
+	{
+		SessionWriter writer;
+		if (!writer.open(sessionPath, kWidth, kHeight)) {
+			return EXIT_FAILURE;
+		}
+		for (size_t i = 0; i < kFrames; i++) {
+			cv::randu(image, 0, 64 + static_cast<int>(i % 192));
+			SessionFrameInfo info{};
+			info.timestampNanos = i * kFramePeriodNanos;
+			info.illuminationMode = 1;
+			if (!writer.append(image.data, image.step, info) || !cv::imwrite(pngPath(directory, i), image)) {
+				std::fprintf(stderr, "Error writing frame %zu\n", i);
+				return EXIT_FAILURE;
+			}
+		}
+		if (!writer.finish()) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	SessionReader reader;
+	if (!reader.open(sessionPath) || (reader.frameCount() != kFrames)) {
+		std::fprintf(stderr, "Error reading %s\n", sessionPath.c_str());
+		return EXIT_FAILURE;
+	}
+	for (size_t i = 0; i < kFrames; i++) {
+		cv::Mat png = cv::imread(pngPath(directory, i), cv::IMREAD_GRAYSCALE);
+		cv::Mat mapped = reader.frame(i);
+		if ((png.size() != mapped.size()) || (cv::norm(png, mapped, cv::NORM_INF) != 0.0) ||
+				(reader.seek(i * kFramePeriodNanos) != i) || (reader.seek(i * kFramePeriodNanos + 1) != i + 1)) {
+			std::fprintf(stderr, "Session frame %zu doesn't match\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+	std::printf("All %zu frames match their PNGs\n", kFrames);
+
+	// A recording cut off mid-frame, as a crash leaves it, still reads back its whole frames
+	{
+		std::string crashedPath = (directory / "crashed.t5s").string();
+		std::filesystem::copy_file(sessionPath, crashedPath, std::filesystem::copy_options::overwrite_existing);
+		SessionHeader header;
+		std::memcpy(&header, reader.frame(0).data - kSessionPageSize, sizeof(header));
+		header.frameCount = 0;
+		header.indexOffset = 0;
+		std::fstream crashed(crashedPath, std::ios::binary | std::ios::in | std::ios::out);
+		crashed.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		crashed.close();
+		size_t kept = kFrames / 2;
+		std::filesystem::resize_file(crashedPath, header.slotsOffset + kept * header.slotBytes + header.slotBytes / 2);
+
+		SessionReader recovered;
+		bool ok = recovered.open(crashedPath) && recovered.recovered() && (recovered.frameCount() == kept);
+		for (size_t i = 0; ok && (i < kept); i++) {
+			ok = (cv::norm(recovered.frame(i), reader.frame(i), cv::NORM_INF) == 0.0) &&
+					(recovered.info(i).timestampNanos == reader.info(i).timestampNanos);
+		}
+		if (!ok) {
+			std::fprintf(stderr, "Recovering a cut-off session failed\n");
+			return EXIT_FAILURE;
+		}
+		std::printf("Recovered %zu whole frames of a cut-off session\n\n", kept);
+	}
+
+	// Visit frames in a scattered order, touching every pixel so mapped pages are really read
+	auto scattered = [](size_t i) { return (i * 7919) % kFrames; };
+
+	bench::run("imread PNG, random frame", iterations, [&](size_t i) {
+		cv::Mat frame = cv::imread(pngPath(directory, scattered(i)), cv::IMREAD_GRAYSCALE);
+		bench::doNotOptimize(checksum(frame));
+	});
+
+	reader.adviseRandom();
+	bench::run("SessionReader, random frame", iterations, [&](size_t i) {
+		bench::doNotOptimize(checksum(reader.frame(scattered(i))));
+	});
+
+	reader.adviseSequential();
+	bench::run("SessionReader, sequential scan", iterations, [&](size_t i) {
+		bench::doNotOptimize(checksum(reader.frame(i % kFrames)));
+	});
+
+	bench::run("SessionReader::seek", iterations * 1000, [&](size_t i) {
+		bench::doNotOptimize(reader.seek(scattered(i) * kFramePeriodNanos));
+	});
+
+	reader.close();
+	std::filesystem::remove_all(directory);
+	return EXIT_SUCCESS;
+}
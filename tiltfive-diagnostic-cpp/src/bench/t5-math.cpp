@@ -0,0 +1,245 @@
+/// \file
+/// \brief Benchmark of the t5math batch functions against plain scalar loops
+///
+/// Three versions of each operation are timed over a batch: a textbook loop (rotation as q v q*,
+/// slerp with acos and sin), the t5math::scalar loop, and the dispatched batch function. The batch
+/// results are first checked against the textbook ones on a batch with a partial last block, and
+/// in place.
+
+#include "../include/t5-math.hpp"
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t kBatch = 1024;
+constexpr float kSlerpT = 0.3f;
+
+auto randomQuats(std::mt19937 &random, size_t count) -> std::vector<T5_Quat> {
+	std::normal_distribution<float> normal;
+	std::vector<T5_Quat> quats(count);
+	for (auto &q : quats) {
+		q = { normal(random), normal(random), normal(random), normal(random) };
+		float norm = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+		q = { q.w / norm, q.x / norm, q.y / norm, q.z / norm };
+	}
+	return quats;
+}
+
+auto randomVecs(std::mt19937 &random, size_t count) -> std::vector<T5_Vec3> {
+	std::uniform_real_distribution<float> uniform(-2.0f, 2.0f);
+	std::vector<T5_Vec3> vecs(count);
+	for (auto &v : vecs) {
+		v = { uniform(random), uniform(random), uniform(random) };
+	}
+	return vecs;
+}
+
+// Textbook versions, written for clarity rather than speed
+
+auto naiveRotate(const T5_Quat &q, const T5_Vec3 &v) -> T5_Vec3 {
+	T5_Quat r = t5math::multiply(t5math::multiply(q, { 0.0f, v.x, v.y, v.z }), t5math::conjugate(q));
+	return { r.x, r.y, r.z };
+}
+
+auto naiveSlerp(const T5_Quat &a, T5_Quat b, float t) -> T5_Quat {
+	double cosTheta = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+	if (cosTheta < 0.0) {
+		b = { -b.w, -b.x, -b.y, -b.z };
+		cosTheta = -cosTheta;
+	}
+	if (cosTheta > 0.9999) {
+		return { a.w + t * (b.w - a.w), a.x + t * (b.x - a.x), a.y + t * (b.y - a.y), a.z + t * (b.z - a.z) };
+	}
+	double theta = std::acos(cosTheta);
+	auto weightA = static_cast<float>(std::sin((1.0 - t) * theta) / std::sin(theta));
+	auto weightB = static_cast<float>(std::sin(t * theta) / std::sin(theta));
+	return { weightA * a.w + weightB * b.w, weightA * a.x + weightB * b.x, weightA * a.y + weightB * b.y,
+		weightA * a.z + weightB * b.z };
+}
+
+auto difference(const T5_Quat &a, const T5_Quat &b) -> float {
+	return std::max({ std::fabs(a.w - b.w), std::fabs(a.x - b.x), std::fabs(a.y - b.y), std::fabs(a.z - b.z) });
+}
+
+auto difference(const T5_Vec3 &a, const T5_Vec3 &b) -> float {
+	return std::max({ std::fabs(a.x - b.x), std::fabs(a.y - b.y), std::fabs(a.z - b.z) });
+}
+
+template <typename T>
+auto maxDifference(const std::vector<T> &a, const std::vector<T> &b) -> float {
+	float worst = 0.0f;
+	for (size_t i = 0; i < a.size(); i++) {
+		worst = std::max(worst, difference(a[i], b[i]));
+	}
+	return worst;
+}
+
+auto report(const char *name, float worst, float tolerance) -> bool {
+	if (worst > tolerance) {
+		std::fprintf(stderr, "%s differs from the textbook version by %g\n", name, worst);
+		return false;
+	}
+	return true;
+}
+
+auto check() -> bool {
+	// Two and a half blocks of 8 plus a few, so every path also runs its scalar tail
+	constexpr size_t kCount = 23;
+	std::mt19937 random(11);
+	std::vector<T5_Quat> a = randomQuats(random, kCount);
+	std::vector<T5_Quat> b = randomQuats(random, kCount);
+	std::vector<T5_Vec3> u = randomVecs(random, kCount);
+	std::vector<T5_Vec3> v = randomVecs(random, kCount);
+
+	std::vector<T5_Quat> expectedQuats(kCount);
+	std::vector<T5_Vec3> expectedVecs(kCount);
+	std::vector<T5_Quat> quats(kCount);
+	std::vector<T5_Vec3> vecs(kCount);
+	bool ok = true;
+
+	for (size_t i = 0; i < kCount; i++) {
+		expectedQuats[i] = t5math::multiply(a[i], b[i]);
+	}
+	t5math::multiply(a.data(), b.data(), quats.data(), kCount);
+	ok &= report("multiply", maxDifference(expectedQuats, quats), 1e-6f);
+
+	for (size_t i = 0; i < kCount; i++) {
+		expectedQuats[i] = t5math::conjugate(a[i]);
+	}
+	t5math::inverse(a.data(), quats.data(), kCount);
+	ok &= report("inverse", maxDifference(expectedQuats, quats), 1e-6f);
+
+	for (size_t i = 0; i < kCount; i++) {
+		expectedVecs[i] = naiveRotate(a[i], v[i]);
+	}
+	t5math::rotate(a.data(), v.data(), vecs.data(), kCount);
+	ok &= report("rotate", maxDifference(expectedVecs, vecs), 1e-5f);
+
+	for (float t : { 0.0f, kSlerpT, 0.5f, 1.0f }) {
+		for (size_t i = 0; i < kCount; i++) {
+			expectedQuats[i] = naiveSlerp(a[i], b[i], t);
+		}
+		t5math::slerp(a.data(), b.data(), t, quats.data(), kCount);
+		ok &= report("slerp", maxDifference(expectedQuats, quats), 2e-6f);
+		t5math::scalar::slerp(a.data(), b.data(), t, quats.data(), kCount);
+		ok &= report("scalar slerp", maxDifference(expectedQuats, quats), 2e-6f);
+	}
+
+	for (size_t i = 0; i < kCount; i++) {
+		T5_Vec3 moved = naiveRotate(a[i], v[i]);
+		expectedQuats[i] = t5math::multiply(a[i], b[i]);
+		expectedVecs[i] = { moved.x + u[i].x, moved.y + u[i].y, moved.z + u[i].z };
+	}
+	// In place, over the second transform
+	quats = b;
+	vecs = v;
+	t5math::compose(a.data(), u.data(), quats.data(), vecs.data(), quats.data(), vecs.data(), kCount);
+	ok &= report("compose rotation", maxDifference(expectedQuats, quats), 1e-6f);
+	ok &= report("compose translation", maxDifference(expectedVecs, vecs), 1e-5f);
+	return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	size_t iterations = bench::iterationsFromArgs(argc, argv, 20000);
+
+	if (!check()) {
+		return EXIT_FAILURE;
+	}
+	std::printf("Batch results match the textbook versions\n\n");
+
+	std::mt19937 random(3);
+	std::vector<T5_Quat> a = randomQuats(random, kBatch);
+	std::vector<T5_Quat> b = randomQuats(random, kBatch);
+	std::vector<T5_Vec3> u = randomVecs(random, kBatch);
+	std::vector<T5_Vec3> v = randomVecs(random, kBatch);
+	std::vector<T5_Quat> quats(kBatch);
+	std::vector<T5_Vec3> vecs(kBatch);
+	std::printf("Per batch of %zu:\n", kBatch);
+
+	bench::run("multiply textbook loop", iterations, [&](size_t) {
+		for (size_t i = 0; i < kBatch; i++) {
+			quats[i] = t5math::multiply(a[i], b[i]);
+		}
+		bench::doNotOptimize(quats[0]);
+	});
+	bench::run("multiply t5math::scalar", iterations, [&](size_t) {
+		t5math::scalar::multiply(a.data(), b.data(), quats.data(), kBatch);
+		bench::doNotOptimize(quats[0]);
+	});
+	bench::run("multiply t5math", iterations, [&](size_t) {
+		t5math::multiply(a.data(), b.data(), quats.data(), kBatch);
+		bench::doNotOptimize(quats[0]);
+	});
+
+	bench::run("inverse textbook loop", iterations, [&](size_t) {
+		for (size_t i = 0; i < kBatch; i++) {
+			float norm = a[i].w * a[i].w + a[i].x * a[i].x + a[i].y * a[i].y + a[i].z * a[i].z;
+			quats[i] = { a[i].w / norm, -a[i].x / norm, -a[i].y / norm, -a[i].z / norm };
+		}
+		bench::doNotOptimize(quats[0]);
+	});
+	bench::run("inverse t5math::scalar", iterations, [&](size_t) {
+		t5math::scalar::inverse(a.data(), quats.data(), kBatch);
+		bench::doNotOptimize(quats[0]);
+	});
+	bench::run("inverse t5math", iterations, [&](size_t) {
+		t5math::inverse(a.data(), quats.data(), kBatch);
+		bench::doNotOptimize(quats[0]);
+	});
+
+	bench::run("rotate textbook loop (q v q*)", iterations, [&](size_t) {
+		for (size_t i = 0; i < kBatch; i++) {
+			vecs[i] = naiveRotate(a[i], v[i]);
+		}
+		bench::doNotOptimize(vecs[0]);
+	});
+	bench::run("rotate t5math::scalar", iterations, [&](size_t) {
+		t5math::scalar::rotate(a.data(), v.data(), vecs.data(), kBatch);
+		bench::doNotOptimize(vecs[0]);
+	});
+	bench::run("rotate t5math", iterations, [&](size_t) {
+		t5math::rotate(a.data(), v.data(), vecs.data(), kBatch);
+		bench::doNotOptimize(vecs[0]);
+	});
+
+	bench::run("slerp textbook loop (acos, sin)", iterations, [&](size_t) {
+		for (size_t i = 0; i < kBatch; i++) {
+			quats[i] = naiveSlerp(a[i], b[i], kSlerpT);
+		}
+		bench::doNotOptimize(quats[0]);
+	});
+	bench::run("slerp t5math::scalar", iterations, [&](size_t) {
+		t5math::scalar::slerp(a.data(), b.data(), kSlerpT, quats.data(), kBatch);
+		bench::doNotOptimize(quats[0]);
+	});
+	bench::run("slerp t5math", iterations, [&](size_t) {
+		t5math::slerp(a.data(), b.data(), kSlerpT, quats.data(), kBatch);
+		bench::doNotOptimize(quats[0]);
+	});
+
+	bench::run("compose textbook loop", iterations, [&](size_t) {
+		for (size_t i = 0; i < kBatch; i++) {
+			T5_Vec3 moved = naiveRotate(a[i], v[i]);
+			quats[i] = t5math::multiply(a[i], b[i]);
+			vecs[i] = { moved.x + u[i].x, moved.y + u[i].y, moved.z + u[i].z };
+		}
+		bench::doNotOptimize(quats[0]);
+	});
+	bench::run("compose t5math::scalar", iterations, [&](size_t) {
+		t5math::scalar::compose(a.data(), u.data(), b.data(), v.data(), quats.data(), vecs.data(), kBatch);
+		bench::doNotOptimize(quats[0]);
+	});
+	bench::run("compose t5math", iterations, [&](size_t) {
+		t5math::compose(a.data(), u.data(), b.data(), v.data(), quats.data(), vecs.data(), kBatch);
+		bench::doNotOptimize(quats[0]);
+	});
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+/// \file
+/// \brief Benchmark of the cost of trace spans, alone and against a camera frame's work
+///
+/// The frame stand-in is only IR preprocessing of a 768x600 frame, a fraction of a real frame
+/// that also runs marker detection, so the overhead it reports is an upper bound. The overhead is
+/// reported two ways: the cost of a span measured inside the frame times the spans per frame, over
+/// the frame time, and the difference between whole frames timed with tracing off and on. The
+/// budget is only called met or missed when the figure's confidence interval is clear of 1%.
+
+#include "../include/ir-preprocess.hpp"
+#include "../include/trace.hpp"
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace {
+
+constexpr int kWidth = 768;
+constexpr int kHeight = 600;
+
+// About as many spans as one pass of the capture loop records, binder calls included
+constexpr int kSpansPerFrame = 16;
+// The frame's own span and process()'s are recorded around the work; the rest run back to back
+constexpr int kTimedSpans = kSpansPerFrame - 2;
+
+struct FrameTiming {
+	double frameNs;
+	double spansNs; ///< The kTimedSpans back-to-back spans alone
+};
+
+auto tracedFrame(IrPreprocessor &preprocessor, const std::vector<uint8_t> &light,
+		const std::vector<uint8_t> &dark) -> FrameTiming {
+	using Clock = std::chrono::steady_clock;
+	auto start = Clock::now();
+	Clock::time_point spansStart;
+	Clock::time_point spansEnd;
+	{
+		T5DIAG_TRACE_SPAN("bench", "frame");
+		// process() records one span itself
+		preprocessor.process(light.data(), kWidth, kWidth, kHeight, dark.data(), kWidth);
+		spansStart = Clock::now();
+		for (int i = 0; i < kTimedSpans; i++) {
+			T5DIAG_TRACE_SPAN("bench", "step");
+			bench::doNotOptimize(preprocessor.frame().data()[i]);
+		}
+		spansEnd = Clock::now();
+	}
+	std::chrono::duration<double, std::nano> frame = Clock::now() - start;
+	std::chrono::duration<double, std::nano> spans = spansEnd - spansStart;
+	return { frame.count(), spans.count() };
+}
+
+/// Keep the calling thread on the CPU it is running on; returns that CPU, or -1 if not pinned
+auto pinToCurrentCpu() -> int {
+#if defined(__linux__)
+	int cpu = sched_getcpu();
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if ((cpu < 0) || (sched_setaffinity(0, sizeof(set), &set) != 0)) {
+		return -1;
+	}
+	return cpu;
+#else
+	return -1;
+#endif
+}
+
+auto median(std::vector<double> values) -> double {
+	std::sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+/// Median of per-round figures, with the order statistics that bracket it at about 95% confidence
+struct Interval {
+	double median;
+	double lower;
+	double upper;
+	double min;
+	double max;
+};
+
+auto medianInterval(std::vector<double> values) -> Interval {
+	std::sort(values.begin(), values.end());
+	size_t count = values.size();
+	double halfWidth = 0.98 * std::sqrt(static_cast<double>(count));
+	auto lower = static_cast<size_t>(std::max(0.0, std::floor(count / 2.0 - halfWidth)));
+	auto upper = std::min(static_cast<size_t>(std::ceil(count / 2.0 + halfWidth)), count - 1);
+	return { values[count / 2], values[lower], values[upper], values.front(), values.back() };
+}
+
+auto verdict(const Interval &overhead, double budget) -> const char * {
+	if ((overhead.lower > -budget) && (overhead.upper < budget)) {
+		return "within budget";
+	}
+	if (overhead.lower > budget) {
+		return "over budget";
+	}
+	return "inconclusive, the interval is not inside the budget";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	size_t iterations = bench::iterationsFromArgs(argc, argv, 100000);
+	Tracer &tracer = Tracer::instance();
+
+	tracer.enable(false);
+	bench::run("span, tracing disabled", iterations, [&](size_t i) {
+		T5DIAG_TRACE_SPAN("bench", "span");
+		bench::doNotOptimize(i);
+	});
+	tracer.enable(true);
+	bench::run("span, tracing enabled", iterations, [&](size_t i) {
+		T5DIAG_TRACE_SPAN("bench", "span");
+		bench::doNotOptimize(i);
+	});
+	tracer.enable(false);
+
+	std::mt19937 rng(5);
+	std::vector<uint8_t> light(kWidth * kHeight);
+	std::vector<uint8_t> dark(kWidth * kHeight);
+	for (size_t i = 0; i < light.size(); i++) {
+		light[i] = static_cast<uint8_t>(rng());
+		dark[i] = static_cast<uint8_t>(rng() % 96);
+	}
+
+	// Each round times about a thousand frames with tracing off and on, in alternating order so
+	// drift in machine load hits both alike, and yields one figure of each kind. Frames are timed
+	// one by one and the median taken, so a preemption costs one sample instead of skewing the
+	// whole half round. The frames run on their own pinned thread, whose trace buffer the enabled
+	// rounds fill to about two thirds.
+	size_t frames = iterations / 100;
+	constexpr int kRounds = 41;
+	constexpr double kBudgetPercent = 1.0;
+	int cpu = -1;
+	std::vector<double> frameNs[2];
+	std::vector<double> spanNs;
+	std::vector<double> fromSpans;
+	std::vector<double> fromFrames;
+	std::thread worker([&] {
+		cpu = pinToCurrentCpu();
+		IrPreprocessor preprocessor;
+		for (size_t i = 0; i < frames; i++) {
+			tracedFrame(preprocessor, light, dark);
+		}
+
+		std::vector<double> frameSamples(frames);
+		std::vector<double> spanSamples(frames);
+		for (int round = 0; round < kRounds; round++) {
+			double roundFrameNs[2] = {};
+			double roundSpansNs[2] = {};
+			for (int step = 0; step < 2; step++) {
+				int enabled = (round % 2 == 0) ? step : 1 - step;
+				tracer.enable(enabled != 0);
+				for (size_t i = 0; i < frames; i++) {
+					FrameTiming timing = tracedFrame(preprocessor, light, dark);
+					frameSamples[i] = timing.frameNs;
+					spanSamples[i] = timing.spansNs;
+				}
+				roundFrameNs[enabled] = median(frameSamples);
+				roundSpansNs[enabled] = median(spanSamples);
+				frameNs[enabled].push_back(roundFrameNs[enabled]);
+			}
+			double perSpanNs = (roundSpansNs[1] - roundSpansNs[0]) / kTimedSpans;
+			spanNs.push_back(perSpanNs);
+			fromSpans.push_back(100.0 * kSpansPerFrame * perSpanNs / roundFrameNs[0]);
+			fromFrames.push_back(100.0 * (roundFrameNs[1] - roundFrameNs[0]) / roundFrameNs[0]);
+		}
+		tracer.enable(false);
+	});
+	worker.join();
+
+	std::printf("%-48s %10.3f ns/op\n", "span within a frame, on minus off (median)", median(spanNs));
+	std::printf("%-48s %10.3f ns/op\n", "frame, tracing disabled (median)", median(frameNs[0]));
+	std::printf("%-48s %10.3f ns/op\n", "frame, tracing enabled (median)", median(frameNs[1]));
+
+	std::printf("\nTracing overhead with %d spans per frame (budget %.0f%%), %d rounds of %zu frames, ", kSpansPerFrame,
+			kBudgetPercent, kRounds, frames);
+	if (cpu >= 0) {
+		std::printf("pinned to CPU %d:\n", cpu);
+	} else {
+		std::printf("not pinned:\n");
+	}
+	Interval spans = medianInterval(fromSpans);
+	Interval whole = medianInterval(fromFrames);
+	std::printf("  span cost x spans  median %.3f%%, 95%% CI [%.3f%%, %.3f%%]: %s\n", spans.median, spans.lower,
+			spans.upper, verdict(spans, kBudgetPercent));
+	std::printf("  whole frames       median %.3f%%, 95%% CI [%.3f%%, %.3f%%], range [%.3f%%, %.3f%%]: %s\n",
+			whole.median, whole.lower, whole.upper, whole.min, whole.max, verdict(whole, kBudgetPercent));
+	return 0;
+}
@@ -0,0 +1,452 @@
+/// \file
+/// \brief Camera capture loop: marker detection, marker poses and frame recording
+
+#include "include/camera-capture.hpp"
+#include "include/capture-control.hpp"
+#include "include/capture-preview.hpp"
+#include "include/frame-demux.hpp"
+#include "include/frame-writer.hpp"
+#include "include/ir-preprocess.hpp"
+#include "include/marker-pose.hpp"
+#include "include/metrics.hpp"
+#include "include/session-file.hpp"
+#include "include/trace.hpp"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/objdetect/aruco_detector.hpp>
+#include <opencv2/objdetect/aruco_dictionary.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// The per-frame status line is redrawn at most this often; writing it every frame costs more than
+// detection on a slow terminal
+constexpr auto kStatusInterval = std::chrono::milliseconds(100);
+
+// Frames without an illumination mode before warning that the service may not report one at all
+constexpr uint64_t kUnknownModeWarnFrames = 30;
+
+// Everything the capture loop publishes, looked up once so updates never take the registry lock
+struct CaptureMetrics {
+	explicit CaptureMetrics(MetricsRegistry &registry)
+		: reads(registry, "t5diag_camera_reads_total", "Camera buffer reads by result", "result"),
+		  frames(registry.counter("t5diag_camera_frames_total", "Camera frames acquired")),
+		  dropped(registry.counter("t5diag_camera_frames_dropped_total",
+				  "Camera frames dropped for an unknown illumination mode")),
+		  detected(registry.counter("t5diag_detection_frames_total", "Frames marker detection ran on")),
+		  detectedFull(registry.counter("t5diag_detection_full_frames_total",
+				  "Frames marker detection also ran on at full resolution")),
+		  detectionSeconds(registry.histogram("t5diag_detection_seconds",
+				  "Marker detection time per frame, including preprocessing", latencyBuckets())),
+		  frameSeconds(registry.histogram("t5diag_camera_frame_seconds",
+				  "Time from a frame arriving until its buffer is resubmitted", latencyBuckets())),
+		  markersPerFrame(registry.histogram("t5diag_markers_per_frame", "Markers detected per frame",
+				  { 0, 1, 2, 4, 8, 16, 32 })),
+		  poseAvailable(registry.counter("t5diag_pose_reads_total", "Glasses pose reads by availability",
+				  { { "result", "available" } })),
+		  poseUnavailable(registry.counter("t5diag_pose_reads_total", "Glasses pose reads by availability",
+				  { { "result", "unavailable" } })),
+		  poseAvailability(registry.gauge("t5diag_pose_availability_ratio",
+				  "Fraction of glasses pose reads that returned a pose")) {}
+
+	MetricCounterFamily reads;
+	MetricCounter &frames;
+	MetricCounter &dropped;
+	MetricCounter &detected;
+	MetricCounter &detectedFull;
+	MetricHistogram &detectionSeconds;
+	MetricHistogram &frameSeconds;
+	MetricHistogram &markersPerFrame;
+	MetricCounter &poseAvailable;
+	MetricCounter &poseUnavailable;
+	MetricGauge &poseAvailability;
+};
+
+auto initCameraImage(std::shared_ptr<tiltfive::Glasses> &glasses, T5_CamImage *imageBuffer, uint8_t cameraIndex,
+		std::vector<uint8_t> &pixels) -> tiltfive::Result<void> {
+	pixels.resize(T5_MIN_CAM_IMAGE_BUFFER_WIDTH * T5_MIN_CAM_IMAGE_BUFFER_HEIGHT);
+	imageBuffer->bufferSize = static_cast<uint32_t>(pixels.size());
+	imageBuffer->cameraIndex = cameraIndex;
+	imageBuffer->pixelData = pixels.data();
+
+	auto result = glasses->submitEmptyCamImageBuffer(imageBuffer);
+
+	std::cout << "\nResult:       " << result << "\n";
+	std::cout << "Buffer: " << imageBuffer << "\n\n";
+
+	return result;
+}
+
+auto roundNum(float num) -> std::string {
+	double value = std::round(num * 1000.0) / 1000.0;
+	std::string num_text = std::to_string(value);
+
+	return num_text.substr(0, num_text.find(".") + 4);
+}
+
+// Use the parameters saved by detector-tuner, if there are any
+auto loadDetectorParams(const std::string &path, cv::aruco::DetectorParameters &params) -> void {
+	if (path.empty() || !std::ifstream(path)) {
+		return;
+	}
+
+	cv::FileStorage storage(path, cv::FileStorage::READ);
+	if (storage.isOpened() && params.readDetectorParameters(storage.root())) {
+		std::cout << "Loaded detector parameters from " << path << std::endl;
+	} else {
+		std::cerr << "Error reading " << path << ", using default detector parameters" << std::endl;
+		params = cv::aruco::DetectorParameters();
+	}
+}
+
+// Use the calibration if there is one, otherwise a rough pinhole guess
+auto createMarkerPoseEstimator(const std::string &path) -> MarkerPoseEstimator {
+	CameraIntrinsics intrinsics =
+			CameraIntrinsics::approximate(T5_MIN_CAM_IMAGE_BUFFER_WIDTH, T5_MIN_CAM_IMAGE_BUFFER_HEIGHT);
+	MarkerPoseEstimator::Options options;
+
+	if (!path.empty() && std::ifstream(path) && loadCameraIntrinsics(path, intrinsics)) {
+		cv::FileStorage storage(path, cv::FileStorage::READ);
+		if (!storage["marker_length"].empty()) {
+			options.markerLength = static_cast<double>(storage["marker_length"]);
+		}
+		std::cout << "Loaded camera intrinsics from " << path << std::endl;
+	} else {
+		std::cout << "No " << path << ", marker poses use approximate intrinsics" << std::endl;
+	}
+	return MarkerPoseEstimator(intrinsics, options);
+}
+
+} // namespace
+
+auto runCameraCapture(std::shared_ptr<tiltfive::Glasses> &glasses, const CameraCaptureOptions &options) -> tiltfive::Result<void> {
+	auto readyResult = glasses->ensureReady();
+	std::cout << "Glasses Status: " << readyResult << "\n";
+	if (!readyResult) {
+		std::cout << "*** GLASSES UNAVAILABLE\n";
+		return readyResult;
+	}
+
+	T5_CameraStreamConfig cameraStreamConfig = T5_CameraStreamConfig();
+	cameraStreamConfig.cameraIndex = options.cameraIndex;
+	cameraStreamConfig.enabled = true;
+	auto configureResult = glasses->configureCameraStream(cameraStreamConfig);
+	if (!configureResult) {
+		std::cerr << "Error configuring camera stream : " << configureResult << std::endl;
+		return configureResult;
+	}
+
+	T5_CamImage camImage = T5_CamImage();
+	T5_CamImage *camImageBuffer = &camImage;
+	std::vector<uint8_t> camPixels;
+	auto submitResult = initCameraImage(glasses, camImageBuffer, options.cameraIndex, camPixels);
+	if (!submitResult) {
+		return submitResult;
+	}
+
+	Tracer::instance().setThreadName("capture");
+	CaptureControl control(options.stdinCommands);
+	std::unique_ptr<PreviewWindow> preview;
+	if (!options.headless) {
+		PreviewOptions previewOptions;
+		previewOptions.fps = options.previewFps;
+		preview.reset(new PreviewWindow(previewOptions, [&control](int key) {
+			// Quit when user presses 'q' key
+			if (key == 'q') {
+				control.requestQuit();
+			}
+		}));
+	}
+	std::cout << "Press q then Enter, or Ctrl+C, to stop early; s then Enter prints a status line" << std::endl;
+
+	MetricsRegistry localMetrics;
+	CaptureMetrics metrics(options.metrics ? *options.metrics : localMetrics);
+	uint64_t demuxDropped = 0;
+
+	int count = 0;
+	int successCount = 0;
+	std::map<std::error_code, int> errorCodeCount;
+	std::map<float, int> xPosDict;
+
+	// Setup Aruco marker detection
+	std::vector<int> markerIds;
+	std::vector<std::vector<cv::Point2f>> markerCorners, rejectedCandidates;
+	cv::aruco::DetectorParameters detectorParams = cv::aruco::DetectorParameters();
+	loadDetectorParams(options.detectorConfig, detectorParams);
+	cv::aruco::Dictionary dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
+	cv::aruco::ArucoDetector detector(dictionary, detectorParams);
+	FrameDemux demux(options.demux);
+	IrPreprocessor preprocessor;
+	MarkerPoseEstimator poseEstimator = createMarkerPoseEstimator(options.intrinsicsPath);
+	CsvMarkerPoseSink poseSink(options.markerPoseOutput);
+	size_t markerPoseCount = 0;
+	size_t previousMarkers = 0;
+
+	// Keep raw frames for post-mortems only when asked: a regular sample, marker loss or failures
+	FrameWriterOptions frameWriterOptions;
+	frameWriterOptions.directory = options.framesDirectory;
+	frameWriterOptions.everyNth = options.framesEveryNth;
+	frameWriterOptions.onMarkerLoss = options.framesOnMarkerLoss;
+	frameWriterOptions.onError = options.framesOnError;
+	std::unique_ptr<AsyncFrameWriter> frameWriter;
+	if ((frameWriterOptions.everyNth > 0) || frameWriterOptions.onMarkerLoss || frameWriterOptions.onError) {
+		frameWriter.reset(new AsyncFrameWriter(frameWriterOptions));
+	}
+
+	SessionWriter session;
+	if (!options.sessionPath.empty() &&
+			session.open(options.sessionPath, T5_MIN_CAM_IMAGE_BUFFER_WIDTH, T5_MIN_CAM_IMAGE_BUFFER_HEIGHT)) {
+		std::cout << "Recording camera frames to " << options.sessionPath << std::endl;
+	}
+	std::cout << "IR preprocessing using " << simdLevelName(activeSimdLevel()) << std::endl;
+
+	// Poses are sampled on the helper's thread so the loop only waits on camera frames
+	auto poseStream = glasses->createPoseStreamHelper();
+
+	// Time from a frame arriving until its buffer is resubmitted: what bounds throughput
+	std::chrono::steady_clock::duration busyTime{ 0 };
+	auto start = std::chrono::steady_clock::now();
+	auto nextStatus = start;
+	do {
+		count++;
+
+		auto pose = poseStream->getLatestPose(kT5_GlassesPoseUsage_GlassesPresentation);
+		auto imageRead = glasses->getFilledCamImageBuffer();
+		errorCodeCount[imageRead.error()]++;
+		metrics.reads.get(imageRead.error().value(), [&]() {
+			return imageRead ? std::string("Success") : imageRead.error().message();
+		}).add();
+		(pose ? metrics.poseAvailable : metrics.poseUnavailable).add();
+		uint64_t poseReads = metrics.poseAvailable.value() + metrics.poseUnavailable.value();
+		metrics.poseAvailability.set(static_cast<double>(metrics.poseAvailable.value()) / poseReads);
+
+		// posCAM_GBD doesn't seem to work. This code is for debugging.
+		auto it = xPosDict.find(camImageBuffer->posCAM_GBD.x);
+		if (it != xPosDict.end()) {
+			xPosDict[camImageBuffer->posCAM_GBD.x]++;
+		} else {
+			xPosDict[camImageBuffer->posCAM_GBD.x] = 1;
+		}
+
+		if (imageRead) {
+			T5DIAG_TRACE_SPAN("capture", "frame");
+			auto frameStart = std::chrono::steady_clock::now();
+			metrics.frames.add();
+			// A frame we failed to record or publish poses for is worth keeping for a post-mortem
+			bool frameError = false;
+			if (session.isOpen()) {
+				auto now = std::chrono::steady_clock::now().time_since_epoch();
+				frameError |= !session.append(*camImageBuffer,
+						std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+			}
+
+			// Dark frames never show markers; keep them to subtract from the next light frame instead
+			RoutedFrame routed = demux.push(*camImageBuffer);
+			metrics.dropped.add(demux.stats().dropped - demuxDropped);
+			demuxDropped = demux.stats().dropped;
+			const FrameDemuxStats &modes = demux.stats();
+			if ((modes.count(IlluminationMode::kUnknown) == kUnknownModeWarnFrames) &&
+					(modes.count(IlluminationMode::kLight) == 0) && (modes.count(IlluminationMode::kDark) == 0)) {
+				std::cerr << "\nWarning: none of the first " << kUnknownModeWarnFrames
+						  << " frames reported an illumination mode; ";
+				if (options.demux.unknownKeepEvery > 0) {
+					std::cerr << "detecting on 1 in " << options.demux.unknownKeepEvery;
+				} else {
+					std::cerr << "dropping all of them";
+				}
+				std::cerr << " (--unknown-frames N)" << std::endl;
+			}
+
+			if (routed.detect) {
+				auto detectStart = std::chrono::steady_clock::now();
+				preprocessor.process(routed.light, routed.lightStride, routed.width, routed.height, routed.dark,
+						routed.darkStride);
+				const GrayImage &frame = preprocessor.frame();
+				const GrayImage &coarse = preprocessor.coarseFrame();
+				cv::Mat img(frame.height, frame.width, CV_8U, const_cast<uint8_t *>(frame.data()));
+				cv::Mat coarseImg(coarse.height, coarse.width, CV_8U, const_cast<uint8_t *>(coarse.data()));
+
+				// Try the half-resolution frame first. Fall back to full resolution when it loses markers
+				// the previous frame had, and periodically in case some are too small to ever show up in it.
+				{
+					T5DIAG_TRACE_SPAN("capture", "detect markers (coarse)");
+					detector.detectMarkers(coarseImg, markerCorners, markerIds, rejectedCandidates);
+				}
+				bool periodicFull = (options.fullDetectEveryNth > 0) &&
+						(demux.stats().detected % static_cast<uint64_t>(options.fullDetectEveryNth) == 0);
+				if (markerIds.empty() || (markerIds.size() < previousMarkers) || periodicFull) {
+					T5DIAG_TRACE_SPAN("capture", "detect markers (full)");
+					detector.detectMarkers(img, markerCorners, markerIds, rejectedCandidates);
+					metrics.detectedFull.add();
+				} else {
+					for (auto &corners : markerCorners) {
+						for (auto &corner : corners) {
+							corner = corner * 2.0f + cv::Point2f(0.5f, 0.5f);
+						}
+					}
+				}
+				previousMarkers = markerIds.size();
+				metrics.detected.add();
+				metrics.detectionSeconds.observe(
+						std::chrono::duration<double>(std::chrono::steady_clock::now() - detectStart).count());
+				metrics.markersPerFrame.observe(static_cast<double>(markerIds.size()));
+
+				// Publish where each marker is in the gameboard frame, to compare against the glasses pose
+				const MarkerPoseFrame &markerPoses = poseEstimator.estimate(markerIds, markerCorners,
+						camImageBuffer->posCAM_GBD, camImageBuffer->rotToCAM_GBD, pose ? pose->timestampNanos : 0);
+				frameError |= !poseSink.write(markerPoses);
+				markerPoseCount += markerPoses.markers.size();
+
+				if (frameWriter) {
+					cv::Mat rawImage(routed.height, routed.width, CV_8U, const_cast<uint8_t *>(routed.light),
+							routed.lightStride);
+					frameWriter->offer(count, rawImage, markerIds.size(), frameError);
+				}
+
+				// Only draw the overlay when someone will look at it
+				bool firstDetection = (demux.stats().detected == 1);
+				bool showPreview = preview && preview->wantsFrame();
+				cv::Mat outputImage;
+				if (firstDetection || showPreview) {
+					T5DIAG_TRACE_SPAN("capture", "draw overlay");
+					outputImage = img.clone();
+					cv::aruco::drawDetectedMarkers(outputImage, markerCorners, markerIds);
+					const CameraIntrinsics &intrinsics = poseEstimator.intrinsics();
+					for (const auto &markerPose : markerPoses.markers) {
+						cv::drawFrameAxes(outputImage, intrinsics.cameraMatrix, intrinsics.distCoeffs, markerPose.rvec,
+								markerPose.tvec, 0.5f * static_cast<float>(poseEstimator.options().markerLength));
+					}
+				}
+
+				if (showPreview) {
+					preview->offer(outputImage);
+				}
+
+				if (firstDetection) {
+					T5DIAG_TRACE_SPAN("capture", "save first detection");
+					// Save the Mat as a PNG image
+					bool success = cv::imwrite("camera-frame.png", outputImage);
+
+					if (success) {
+						std::cout << "\n\nImage saved successfully as 'camera-frame.png'." << std::endl;
+					} else {
+						std::cerr << "\n\nError saving the image.\n\n"
+								  << std::endl;
+					}
+				}
+			}
+			auto now = std::chrono::steady_clock::now();
+			if ((now >= nextStatus) || control.takeStatusRequest()) {
+				T5DIAG_TRACE_SPAN("capture", "status line");
+				nextStatus = now + kStatusInterval;
+				if (!pose) {
+					std::cout << "\rImage Success " << successCount << " times out of " << count << " passes - err, err, err - err, err, err, err" << std::flush;
+				} else {
+					std::cout << "\rImage Success " << successCount << " times out of " << count << " passes - "
+							  << roundNum(pose->posGLS_GBD.x) << ", "
+							  << roundNum(pose->posGLS_GBD.y) << ", "
+							  << roundNum(pose->posGLS_GBD.z) << " - "
+							  << roundNum(pose->rotToGLS_GBD.x) << ", "
+							  << roundNum(pose->rotToGLS_GBD.y) << ", "
+							  << roundNum(pose->rotToGLS_GBD.z) << ", "
+							  << roundNum(pose->rotToGLS_GBD.w) << std::flush;
+				}
+			}
+
+			successCount++;
+
+			// If you need to spend some time processing the image, you can submit an alternate CamImageBuffer, rather than reuse this one.
+			auto resubmitResult = glasses->submitEmptyCamImageBuffer(camImageBuffer);
+			if (!resubmitResult) {
+				std::cout << "\n\n** ERROR ON RESET ***\n\n";
+			}
+			auto frameTime = std::chrono::steady_clock::now() - frameStart;
+			busyTime += frameTime;
+			metrics.frameSeconds.observe(std::chrono::duration<double>(frameTime).count());
+		}
+
+	} while (!control.quitRequested() && ((std::chrono::steady_clock::now() - start) < options.duration));
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	PreviewStats previewStats;
+	if (preview) {
+		preview->close();
+		previewStats = preview->stats();
+	}
+
+	std::cout << "\n\nThroughput:\n";
+	double busySeconds = std::chrono::duration<double>(busyTime).count();
+	std::cout << " * " << successCount << " frames in " << roundNum(static_cast<float>(elapsed.count())) << " s ("
+			  << roundNum(static_cast<float>(successCount / std::max(elapsed.count(), 1e-9))) << " fps), "
+			  << roundNum(static_cast<float>(successCount ? 1000.0 * busySeconds / successCount : 0.0))
+			  << " ms processing per frame (" << roundNum(static_cast<float>(busySeconds > 0 ? successCount / busySeconds : 0.0))
+			  << " fps possible)\n";
+	if (preview) {
+		std::cout << " * Preview at " << roundNum(static_cast<float>(options.previewFps)) << " fps: " << previewStats.shown
+				  << " frames shown of " << previewStats.offered << " offered\n";
+	} else {
+		std::cout << " * Preview disabled (headless)\n";
+	}
+
+	std::cout << "\nX Positions:\n";
+	for (const auto &pair : xPosDict) {
+		std::cout << " * Position: " << pair.first << " returned " << pair.second << " times.\n";
+	}
+
+	const FrameDemuxStats &frameStats = demux.stats();
+	std::cout << "\n\nIllumination Modes:\n";
+	for (int mode = 0; mode < kIlluminationModeCount; mode++) {
+		auto illumination = static_cast<IlluminationMode>(mode);
+		std::cout << " * " << illuminationModeName(illumination) << ": " << frameStats.count(illumination)
+				  << " frames (" << roundNum(static_cast<float>(frameStats.rate(illumination))) << " fps)\n";
+	}
+	std::cout << " * Detected on " << frameStats.detected << " frames ("
+			  << roundNum(static_cast<float>(frameStats.detectRate())) << " fps), " << frameStats.paired
+			  << " with dark frame subtraction, " << frameStats.dropped << " unknown frames dropped\n";
+
+	std::cout << " * " << markerPoseCount << " marker poses written to " << options.markerPoseOutput << "\n";
+
+	if (frameWriter) {
+		frameWriter->close();
+		FrameWriterStats writerStats = frameWriter->stats();
+		std::cout << " * " << writerStats.written << " frames written to " << frameWriterOptions.directory << " ("
+				  << writerStats.bytes / 1024 << " KiB), " << writerStats.dropped << " dropped with the writer busy, "
+				  << writerStats.failed << " failed\n";
+	}
+
+	if (session.isOpen()) {
+		size_t recorded = session.frameCount();
+		if (session.finish()) {
+			std::cout << " * " << recorded << " frames recorded to " << options.sessionPath << "\n";
+		}
+	}
+
+	std::cout << "\n\nError Codes:\n";
+	for (const auto &pair : errorCodeCount) {
+		std::cout << " * Type '" << pair.first << "' returned " << pair.second << " times.\n";
+	}
+
+	// The buffer is still submitted, so take it back before its memory goes away
+	auto cancelResult = glasses->cancelCamImageBuffer(camImageBuffer->pixelData);
+	if (!cancelResult) {
+		std::cerr << "Error cancelling camera buffer : " << cancelResult << std::endl;
+	}
+
+	cameraStreamConfig.enabled = false;
+	auto disableResult = glasses->configureCameraStream(cameraStreamConfig);
+	if (!disableResult) {
+		std::cerr << "Error disabling camera stream : " << disableResult << std::endl;
+	}
+
+	return tiltfive::kSuccess;
+}
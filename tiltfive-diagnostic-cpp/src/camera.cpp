@@ -20,19 +20,15 @@
 /// \privatesection
 
 #include "include/TiltFiveNative.hpp"
+#include "include/camera-capture.hpp"
+#include "include/metrics-server.hpp"
+#include "include/metrics.hpp"
+#include "include/trace.hpp"
 
-#include <opencv2/core.hpp>
-#include <opencv2/highgui.hpp>
-#include <opencv2/imgcodecs.hpp>
-#include <opencv2/objdetect/aruco_detector.hpp>
-#include <opencv2/objdetect/aruco_dictionary.hpp>
-
+#include <algorithm>
 #include <chrono>
-#include <fstream>
+#include <cstdlib>
 #include <iostream>
-#include <map>
-
-using namespace cv;
 
 /// \private
 using Client = std::shared_ptr<tiltfive::Client>;
@@ -46,6 +42,9 @@ constexpr std::chrono::milliseconds operator""_ms(unsigned long long ms) {
 	return std::chrono::milliseconds(ms);
 }
 
+// How readPoses runs the camera, set from the command line
+static CameraCaptureOptions gCaptureOptions;
+
 /// Find the first pair of available glasses
 //
 /// \param[in] client - std::unique_ptr to a ::Client
@@ -54,29 +53,28 @@ constexpr std::chrono::milliseconds operator""_ms(unsigned long long ms) {
 auto waitForGlasses(Client &client) -> tiltfive::Result<Glasses> {
 	std::cout << "Looking for glasses..." << std::flush;
 
+	// The discovery helper polls in the background and wakes us as soon as glasses appear,
+	// rather than on the next fixed sleep.
+	auto discoveryHelper = client->createGlassesDiscoveryHelper();
+
 	// Loop until we find glasses
-	auto glassesList = client->listGlasses();
-	if (!glassesList) {
-		return glassesList.error();
-	}
-	while (glassesList->empty()) {
+	auto glassesId = discoveryHelper->awaitGlasses(1000_ms);
+	while (!glassesId) {
+		if (glassesId.error() != tiltfive::Error::kTimeout) {
+			return glassesId.error();
+		}
 		std::cout << "." << std::flush;
-		std::this_thread::sleep_for(100_ms);
 
-		// Request a list of the available glasses
-		glassesList = client->listGlasses();
-		if (!glassesList) {
-			return glassesList.error();
-		}
+		glassesId = discoveryHelper->awaitGlasses(1000_ms);
 	}
 
 	// Print out the found glasses
-	for (auto &glassesInstance : *glassesList) {
+	for (auto &glassesInstance : discoveryHelper->listKnownGlasses()) {
 		std::cout << "Found : " << glassesInstance << std::endl;
 	}
 
 	// Return the first found glasses
-	return tiltfive::obtainGlasses(glassesList->front(), client);
+	return tiltfive::obtainGlasses(*glassesId, client);
 }
 /// [WaitForGlasses]
 
@@ -117,150 +115,15 @@ auto waitForWand(Glasses &glasses) -> tiltfive::Result<Wand> {
 	}
 }
 
-auto initCameraImage(Glasses &glasses, T5_CamImage *imageBuffer) -> tiltfive::Result<void> {
-	imageBuffer->bufferSize = T5_MIN_CAM_IMAGE_BUFFER_WIDTH * T5_MIN_CAM_IMAGE_BUFFER_HEIGHT;
-	imageBuffer->cameraIndex = 0;
-	imageBuffer->pixelData = new uint8_t[T5_MIN_CAM_IMAGE_BUFFER_WIDTH * T5_MIN_CAM_IMAGE_BUFFER_HEIGHT];
-
-	auto result = glasses->submitEmptyCamImageBuffer(imageBuffer);
-
-	std::cout << "\nResult:       " << result << "\n";
-	std::cout << "Buffer: " << imageBuffer << "\n\n";
-
-	return result;
-}
-
-static std::string roundNum(float num) {
-	double value = std::round(num * 1000.0) / 1000.0;
-	std::string num_text = std::to_string(value);
-
-	return num_text.substr(0, num_text.find(".") + 4);
-}
-
 /// [ExclusiveOps]
 auto readPoses(Glasses &glasses) -> tiltfive::Result<void> {
-	auto readyResult = glasses->ensureReady();
-	std::cout << "Glasses Status: " << readyResult << "\n";
-	if (!readyResult) {
-		std::cout << "*** GLASSES UNAVAILABLE\n";
-		return readyResult;
-	}
-
-	T5_CamImage *camImageBuffer = new T5_CamImage();
-	auto submitResult = initCameraImage(glasses, camImageBuffer);
-
-	cv::namedWindow("Test Window", cv::WINDOW_AUTOSIZE);
-
-	int count = 0;
-	int successCount = 0;
-	std::map<std::error_code, int> errorCodeCount;
-	std::map<float, int> xPosDict;
-
-	// Setup Aruco marker detection
-	std::vector<int> markerIds;
-	std::vector<std::vector<cv::Point2f>> markerCorners, rejectedCandidates;
-	cv::aruco::DetectorParameters detectorParams = cv::aruco::DetectorParameters();
-	cv::aruco::Dictionary dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
-	cv::aruco::ArucoDetector detector(dictionary, detectorParams);
-
-	auto start = std::chrono::steady_clock::now();
-	do {
-		count++;
-
-		auto pose = glasses->getLatestGlassesPose(kT5_GlassesPoseUsage_GlassesPresentation);
-		auto imageRead = glasses->getFilledCamImageBuffer();
-		errorCodeCount[imageRead.error()]++;
-
-		// posCAM_GBD doesn't seem to work. This code is for debugging.
-		auto it = xPosDict.find(camImageBuffer->posCAM_GBD.x);
-		if (it != xPosDict.end()) {
-			xPosDict[camImageBuffer->posCAM_GBD.x]++;
-		} else {
-			xPosDict[camImageBuffer->posCAM_GBD.x] = 1;
-		}
-
-		if (imageRead) {
-			cv::Mat img(T5_MIN_CAM_IMAGE_BUFFER_HEIGHT, T5_MIN_CAM_IMAGE_BUFFER_WIDTH, CV_8U,
-					camImageBuffer->pixelData);
-
-			detector.detectMarkers(img, markerCorners, markerIds, rejectedCandidates);
-
-			cv::Mat outputImage = img.clone();
-			cv::aruco::drawDetectedMarkers(outputImage, markerCorners, markerIds);
-
-			cv::imshow("Test Window", outputImage);
-			int k = cv::waitKey(1);
-
-			if (!pose) {
-				std::cout << "\rImage Success " << successCount << " times out of " << count << " passes - err, err, err - err, err, err, err";
-			} else {
-				std::cout << "\rImage Success " << successCount << " times out of " << count << " passes - "
-						  << roundNum(pose->posGLS_GBD.x) << ", "
-						  << roundNum(pose->posGLS_GBD.y) << ", "
-						  << roundNum(pose->posGLS_GBD.z) << " - "
-						  << roundNum(pose->rotToGLS_GBD.x) << ", "
-						  << roundNum(pose->rotToGLS_GBD.y) << ", "
-						  << roundNum(pose->rotToGLS_GBD.z) << ", "
-						  << roundNum(pose->rotToGLS_GBD.w);
-			}
-
-			successCount++;
-			if (successCount == 1) {
-				// Save the Mat as a PNG image
-				bool success = cv::imwrite("camera-frame.png", outputImage);
-
-				if (success) {
-					std::cout << "\n\nImage saved successfully as 'camera-frame.png'." << std::endl;
-				} else {
-					std::cerr << "\n\nError saving the image.\n\n"
-							  << std::endl;
-				}
-			}
-
-			// If you need to spend some time processing the image, you can submit an alternate CamImageBuffer, rather than reuse this one.
-			auto resubmitResult = glasses->submitEmptyCamImageBuffer(camImageBuffer);
-			if (!resubmitResult) {
-				std::cout << "\n\n** ERROR ON RESET ***\n\n";
-			}
-
-			// Quit when user presses 'q' key
-			const int Q_KEY = 113;
-			if (k == Q_KEY) {
-				break;
-			}
-		}
-
-	} while ((std::chrono::steady_clock::now() - start) < 100000_ms);
-
-	std::cout << "\n\X Positions:\n";
-	for (const auto &pair : xPosDict) {
-		std::cout << " * Position: " << pair.first << " returned " << pair.second << " times.\n";
-	}
-
-	std::cout << "\n\nError Codes:\n";
-	for (const auto &pair : errorCodeCount) {
-		std::cout << " * Type '" << pair.first << "' returned " << pair.second << " times.\n";
-	}
-
-	// TODO: Determine a better way to determine if the image buffer needs to be cleared, successCount seems like a hack
-	if (successCount > 0) {
-		glasses->cancelCamImageBuffer(camImageBuffer->pixelData);
-	}
-
-	return tiltfive::kSuccess;
+	return runCameraCapture(glasses, gCaptureOptions);
 }
 /// [ExclusiveOps]
 
 auto doThingsWithGlasses(Glasses &glasses) -> tiltfive::Result<void> {
 	std::cout << "Doing something with : " << glasses << std::endl;
 
-	// Set Config Parameters
-	T5_CameraStreamConfig cameraStreamConfig = T5_CameraStreamConfig();
-	cameraStreamConfig.cameraIndex = 0;
-	cameraStreamConfig.enabled = true;
-
-	glasses->configureCameraStream(cameraStreamConfig);
-
 	/// [NonExclusiveOps]
 	// Get the friendly name for the glasses
 	// This is the name that's user set in the Tilt Five control panel.
@@ -330,43 +193,30 @@ auto doThingsWithGlasses(Glasses &glasses) -> tiltfive::Result<void> {
 
 /// [SystemWideQuery]
 auto printGameboardDimensions(Client &client) -> tiltfive::Result<void> {
-	auto result = client->getGameboardSize(kT5_GameboardType_LE);
-	if (!result) {
-		return result.error();
-	}
-
-	float width = result->viewableExtentPositiveX + result->viewableExtentNegativeX;
-	float length = result->viewableExtentPositiveY + result->viewableExtentNegativeY;
-	float height = result->viewableExtentPositiveZ;
-
-	std::cout << "LE Gameboard size : " << width << "m x " << length << "m x " << height << "m"
-			  << std::endl;
-
-	return tiltfive::kSuccess;
+	return client->getGameboardSize(kT5_GameboardType_LE).map([](const T5_GameboardSize &size) {
+		float width = size.viewableExtentPositiveX + size.viewableExtentNegativeX;
+		float length = size.viewableExtentPositiveY + size.viewableExtentNegativeY;
+		float height = size.viewableExtentPositiveZ;
+
+		std::cout << "LE Gameboard size : " << width << "m x " << length << "m x " << height << "m"
+				  << std::endl;
+	});
 }
 
 /// [WaitForServiceCallerFn]
 auto printServiceVersion(Client &client) -> tiltfive::Result<void> {
-	auto result = client->getServiceVersion();
-	if (!result) {
-		return result.error();
-	}
-
-	std::cout << "Service version : " << result << std::endl;
-	return tiltfive::kSuccess;
+	return client->getServiceVersion().map([](const std::string &version) {
+		std::cout << "Service version : " << version << std::endl;
+	});
 }
 /// [WaitForServiceCallerFn]
 /// [SystemWideQuery]
 
 auto printUiStatusFlags(Client &client) -> tiltfive::Result<void> {
-	auto result = client->isTiltFiveUiRequestingAttention();
-	if (!result) {
-		return result.error();
-	}
-	std::cout << "Tilt Five UI (Attention Requested) : " << ((*result) ? "TRUE" : "FALSE")
-			  << std::endl;
-
-	return tiltfive::kSuccess;
+	return client->isTiltFiveUiRequestingAttention().map([](bool attentionRequested) {
+		std::cout << "Tilt Five UI (Attention Requested) : " << (attentionRequested ? "TRUE" : "FALSE")
+				  << std::endl;
+	});
 }
 
 /// [WaitForService]
@@ -375,6 +225,9 @@ template <typename T>
 auto waitForService(Client &client, const std::function<tiltfive::Result<T>(Client &client)> &func)
 		-> tiltfive::Result<T> {
 	bool waitingForService = false;
+	// Start with a short retry so an already-running service costs almost nothing, then back
+	// off towards the old fixed 100ms poll.
+	auto retryInterval = 5_ms;
 	for (;;) {
 		auto result = func(client);
 		if (result) {
@@ -385,7 +238,8 @@ auto waitForService(Client &client, const std::function<tiltfive::Result<T>(Clie
 
 		std::cout << (waitingForService ? "." : "Waiting for service...") << std::flush;
 		waitingForService = true;
-		std::this_thread::sleep_for(100_ms);
+		std::this_thread::sleep_for(retryInterval);
+		retryInterval = std::min(retryInterval * 2, 100_ms);
 	}
 }
 /// [WaitForService]
@@ -406,7 +260,61 @@ class MyParamChangeListener : public tiltfive::ParamChangeListener {
 	}
 };
 
-int main(int /* argc */, char ** /* argv */) {
+int main(int argc, char **argv) {
+	int metricsPort = -1;
+	std::string tracePath;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if ((arg == "--record") && (i + 1 < argc)) {
+			gCaptureOptions.sessionPath = argv[++i];
+		} else if (arg == "--headless") {
+			gCaptureOptions.headless = true;
+		} else if ((arg == "--frames-every") && (i + 1 < argc)) {
+			gCaptureOptions.framesEveryNth = std::max(std::atoi(argv[++i]), 0);
+		} else if ((arg == "--full-detect-every") && (i + 1 < argc)) {
+			gCaptureOptions.fullDetectEveryNth = std::max(std::atoi(argv[++i]), 0);
+		} else if ((arg == "--unknown-frames") && (i + 1 < argc)) {
+			gCaptureOptions.demux.unknownKeepEvery = std::max(std::atoi(argv[++i]), 0);
+		} else if (arg == "--frames-on-loss") {
+			gCaptureOptions.framesOnMarkerLoss = true;
+		} else if (arg == "--frames-on-error") {
+			gCaptureOptions.framesOnError = true;
+		} else if ((arg == "--preview-fps") && (i + 1 < argc)) {
+			gCaptureOptions.previewFps = std::max(std::atof(argv[++i]), 0.1);
+		} else if ((arg == "--metrics-port") && (i + 1 < argc)) {
+			metricsPort = std::atoi(argv[++i]);
+		} else if ((arg == "--trace") && (i + 1 < argc)) {
+			tracePath = argv[++i];
+		} else {
+			std::cout << "Usage: " << argv[0] << " [--record SESSION.t5s] [--headless] [--frames-every N] [--frames-on-loss] [--frames-on-error] [--full-detect-every N] [--unknown-frames N] [--preview-fps N] [--metrics-port PORT] [--trace PATH]\n"
+					  << "  --record PATH      Also record every raw camera frame to a session file\n"
+					  << "  --headless         Don't open the preview window\n"
+					  << "  --frames-every N   Write every Nth raw frame to frames/ (default: none)\n"
+					  << "  --frames-on-loss   Write the first raw frame after markers are lost\n"
+					  << "  --frames-on-error  Write raw frames that failed to record or publish poses\n"
+					  << "  --full-detect-every N  Also detect at full resolution every Nth frame (default 10)\n"
+					  << "  --unknown-frames N  Detect on every Nth frame with no illumination mode (default 3)\n"
+					  << "  --preview-fps N    Preview redraw rate (default 10)\n"
+					  << "  --metrics-port N   Serve live metrics for Prometheus at http://127.0.0.1:N/metrics\n"
+					  << "  --trace PATH       Write timing spans of the run to PATH as a Chrome trace\n";
+			return (arg == "--help") ? 0 : 1;
+		}
+	}
+
+	MetricsRegistry metrics;
+	MetricsServer metricsServer(metrics);
+	if ((metricsPort >= 0) && (metricsPort <= 65535)) {
+		if (!metricsServer.start(static_cast<uint16_t>(metricsPort))) {
+			std::exit(EXIT_FAILURE);
+		}
+		gCaptureOptions.metrics = &metrics;
+		std::cout << "Serving metrics at http://127.0.0.1:" << metricsServer.port() << "/metrics" << std::endl;
+	}
+	if (!tracePath.empty()) {
+		Tracer::instance().setThreadName("main");
+		Tracer::instance().enable(true);
+	}
+
 	/// [CreateClient]
 	// Create the client
 	auto client = tiltfive::obtainClient("com.tiltfive.test", "0.1.0", nullptr);
@@ -465,6 +373,15 @@ int main(int /* argc */, char ** /* argv */) {
 	std::cout << "Waiting a little..." << std::endl;
 	std::this_thread::sleep_for(5000_ms);
 
+	if (!tracePath.empty()) {
+		Tracer::instance().enable(false);
+		size_t events = 0;
+		uint64_t dropped = 0;
+		if (Tracer::instance().writeChromeTrace(tracePath, events, dropped)) {
+			std::cout << "Wrote " << events << " spans to " << tracePath << std::endl;
+		}
+	}
+
 	std::cout << "ALL DONE!" << std::endl;
 }
 /// [Main]
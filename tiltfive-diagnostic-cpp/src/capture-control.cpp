@@ -0,0 +1,97 @@
+/// \file
+/// \brief Quit and status requests for long captures, from signals and stdin instead of a window
+
+#include "include/capture-control.hpp"
+
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <conio.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Lock-free, so safe to set from a signal handler
+std::atomic<bool> gSignalled{ false };
+
+extern "C" void onQuitSignal(int) {
+	gSignalled = true;
+}
+
+// How long the stdin thread waits for input before checking whether it should stop
+constexpr auto kStdinPollInterval = std::chrono::milliseconds(100);
+
+} // namespace
+
+CaptureControl::CaptureControl(bool readStdin) {
+	gSignalled = false;
+	mPreviousInt = std::signal(SIGINT, onQuitSignal);
+	mPreviousTerm = std::signal(SIGTERM, onQuitSignal);
+
+	if (readStdin) {
+		mStdinThread = std::thread([this]() { readCommands(); });
+	}
+}
+
+CaptureControl::~CaptureControl() {
+	mStop = true;
+	if (mStdinThread.joinable()) {
+		mStdinThread.join();
+	}
+
+	std::signal(SIGINT, (mPreviousInt != SIG_ERR) ? mPreviousInt : SIG_DFL);
+	std::signal(SIGTERM, (mPreviousTerm != SIG_ERR) ? mPreviousTerm : SIG_DFL);
+}
+
+auto CaptureControl::quitRequested() const -> bool {
+	return mQuit.load(std::memory_order_relaxed) || gSignalled.load(std::memory_order_relaxed);
+}
+
+auto CaptureControl::handleCommand(char command) -> void {
+	switch (std::tolower(static_cast<unsigned char>(command))) {
+		case 'q':
+			mQuit = true;
+			break;
+		case 's':
+			mStatus = true;
+			break;
+		default:
+			break;
+	}
+}
+
+auto CaptureControl::readCommands() -> void {
+#if defined(_WIN32)
+	// Console keys arrive without Enter, like the 'q' key in the preview window
+	while (!mStop) {
+		if (_kbhit()) {
+			handleCommand(static_cast<char>(_getch()));
+		} else {
+			std::this_thread::sleep_for(kStdinPollInterval);
+		}
+	}
+#else
+	// Poll rather than block in read() so the destructor can join the thread
+	char buffer[64];
+	while (!mStop) {
+		pollfd input = { STDIN_FILENO, POLLIN, 0 };
+		int ready = poll(&input, 1, static_cast<int>(kStdinPollInterval.count()));
+		if (ready <= 0) {
+			continue; // Timed out, or interrupted by a signal
+		}
+		ssize_t bytes = read(STDIN_FILENO, buffer, sizeof(buffer));
+		if (bytes <= 0) {
+			return; // End of input; keep capturing
+		}
+		for (ssize_t i = 0; i < bytes; i++) {
+			handleCommand(buffer[i]);
+		}
+	}
+#endif
+}
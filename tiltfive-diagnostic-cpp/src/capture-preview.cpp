@@ -0,0 +1,114 @@
+/// \file
+/// \brief Low-rate preview window driven from its own thread
+
+#include "include/capture-preview.hpp"
+#include "include/trace.hpp"
+
+#include <opencv2/highgui.hpp>
+
+#include <algorithm>
+
+namespace {
+
+auto nowNanos() -> int64_t {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+			.count();
+}
+
+// How often the window's events are pumped while no new frame arrives
+constexpr auto kEventInterval = std::chrono::milliseconds(20);
+
+} // namespace
+
+PreviewWindow::PreviewWindow(PreviewOptions options, std::function<void(int key)> onKey)
+	: mOptions(std::move(options)),
+	  mInterval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			  std::chrono::duration<double>(1.0 / std::max(mOptions.fps, 0.1)))),
+	  mOnKey(std::move(onKey)) {
+	mThread = std::thread([this]() { run(); });
+}
+
+PreviewWindow::~PreviewWindow() {
+	close();
+}
+
+auto PreviewWindow::wantsFrame() const -> bool {
+	return nowNanos() >= mNextDueNanos.load(std::memory_order_relaxed);
+}
+
+auto PreviewWindow::offer(const cv::Mat &image) -> void {
+	auto interval = std::chrono::duration_cast<std::chrono::nanoseconds>(mInterval).count();
+	mNextDueNanos.store(nowNanos() + interval, std::memory_order_relaxed);
+	mOffered++;
+
+	{
+		std::lock_guard<std::mutex> lock(mMtx);
+		if (mClosed) {
+			return;
+		}
+		// Reuses the pending buffer when the size and type match
+		image.copyTo(mPending);
+		mHasPending = true;
+	}
+	mCv.notify_one();
+}
+
+auto PreviewWindow::close() -> void {
+	{
+		std::lock_guard<std::mutex> lock(mMtx);
+		if (mClosed) {
+			return;
+		}
+		mClosed = true;
+	}
+	mCv.notify_one();
+	if (mThread.joinable()) {
+		mThread.join();
+	}
+}
+
+auto PreviewWindow::stats() const -> PreviewStats {
+	PreviewStats stats;
+	stats.offered = mOffered;
+	stats.shown = mShown;
+	return stats;
+}
+
+auto PreviewWindow::run() -> void {
+	Tracer::instance().setThreadName("preview");
+	cv::namedWindow(mOptions.title, cv::WINDOW_AUTOSIZE);
+
+	cv::Mat shown;
+	for (;;) {
+		bool draw = false;
+		{
+			std::unique_lock<std::mutex> lock(mMtx);
+			mCv.wait_for(lock, kEventInterval, [this]() { return mClosed || mHasPending; });
+			if (mClosed) {
+				break;
+			}
+			if (mHasPending) {
+				// Swap so the capture loop writes into the buffer that was last on screen
+				std::swap(shown, mPending);
+				mHasPending = false;
+				draw = true;
+			}
+		}
+
+		if (draw) {
+			T5DIAG_TRACE_SPAN("preview", "imshow");
+			cv::imshow(mOptions.title, shown);
+			mShown++;
+		}
+		int key = -1;
+		{
+			T5DIAG_TRACE_SPAN("preview", "waitKey");
+			key = cv::waitKey(1);
+		}
+		if ((key >= 0) && mOnKey) {
+			mOnKey(key & 0xff);
+		}
+	}
+
+	cv::destroyWindow(mOptions.title);
+}
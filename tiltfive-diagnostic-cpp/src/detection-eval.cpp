@@ -0,0 +1,381 @@
+/// \file
+/// \brief Accuracy and throughput scoring of ArUco detector configurations
+
+#include "include/detection-eval.hpp"
+
+#include "include/aruco-atlas.hpp"
+
+#include <opencv2/core/version.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/objdetect/aruco_dictionary.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// Matches the Tilt Five camera image
+constexpr int kSyntheticWidth = 768;
+constexpr int kSyntheticHeight = 600;
+constexpr int kSyntheticMarkerPx = 120;
+constexpr int kSyntheticPitchPx = 200;
+constexpr int kSyntheticCols = 3;
+constexpr int kSyntheticRows = 2;
+
+auto splitCsv(const std::string &line) -> std::vector<std::string> {
+	std::vector<std::string> fields;
+	std::stringstream stream(line);
+	std::string field;
+	while (std::getline(stream, field, ',')) {
+		fields.push_back(field);
+	}
+	if (!line.empty() && (line.back() == ',')) {
+		fields.emplace_back();
+	}
+	return fields;
+}
+
+// Scale 0-255 into [dark, light], then warp, blur and add noise, in that order
+struct Degradation {
+	const char *group;
+	int dark;
+	int light;
+	bool perspective;
+	double blurSigma;
+	double noiseSigma;
+};
+
+constexpr Degradation kDegradations[] = {
+	{ "synthetic-clean", 0, 255, false, 0.0, 0.0 },
+	{ "synthetic-noise", 0, 255, false, 0.0, 28.0 },
+	{ "synthetic-blur", 0, 255, false, 3.0, 2.0 },
+	{ "synthetic-perspective", 0, 255, true, 0.8, 8.0 },
+	{ "synthetic-low-contrast", 92, 122, false, 1.1, 6.0 }, // Like the IR tangible camera
+};
+
+auto addNoise(cv::Mat &image, double sigma, int seed) -> void {
+	cv::Mat noise(image.size(), CV_16SC1);
+	cv::setRNGSeed(seed);
+	cv::randn(noise, 0.0, sigma);
+
+	cv::Mat wide;
+	image.convertTo(wide, CV_16S);
+	wide += noise;
+	wide.convertTo(image, CV_8U);
+}
+
+} // namespace
+
+auto loadLabelledFrames(const std::string &labelsPath, std::vector<LabelledFrame> &frames) -> bool {
+	std::ifstream labels(labelsPath);
+	if (!labels) {
+		std::cerr << "Error opening " << labelsPath << std::endl;
+		return false;
+	}
+
+	std::filesystem::path baseDir = std::filesystem::path(labelsPath).parent_path();
+	std::string line;
+	std::string currentIndex;
+	int lineNumber = 0;
+
+	while (std::getline(labels, line)) {
+		lineNumber++;
+		if (!line.empty() && (line.back() == '\r')) {
+			line.pop_back();
+		}
+		if (line.empty() || (lineNumber == 1)) {
+			continue;
+		}
+
+		auto fields = splitCsv(line);
+		if (fields.size() != 12) {
+			std::cerr << labelsPath << ":" << lineNumber << " : expected 12 fields" << std::endl;
+			return false;
+		}
+		if (std::atoi(fields[2].c_str()) < 0) {
+			continue;
+		}
+
+		if (frames.empty() || (fields[0] != currentIndex)) {
+			currentIndex = fields[0];
+
+			LabelledFrame frame;
+			frame.name = fields[1];
+			frame.group = "captured";
+			std::filesystem::path imagePath(fields[1]);
+			if (imagePath.is_relative()) {
+				imagePath = baseDir / imagePath;
+			}
+			frame.image = cv::imread(imagePath.string(), cv::IMREAD_GRAYSCALE);
+			if (frame.image.empty()) {
+				std::cerr << "Error reading " << imagePath.string() << std::endl;
+				return false;
+			}
+			frames.push_back(std::move(frame));
+		}
+
+		if (fields[3].empty()) {
+			continue;
+		}
+		auto &frame = frames.back();
+		frame.ids.push_back(std::atoi(fields[3].c_str()));
+		std::vector<cv::Point2f> corners;
+		for (int i = 0; i < 4; i++) {
+			corners.emplace_back(std::stof(fields[4 + 2 * i]), std::stof(fields[5 + 2 * i]));
+		}
+		frame.corners.push_back(std::move(corners));
+	}
+
+	return true;
+}
+
+auto renderSyntheticFrames(const SyntheticCorpusOptions &options, std::vector<LabelledFrame> &frames)
+		-> void {
+	const int originX = (kSyntheticWidth - ((kSyntheticCols - 1) * kSyntheticPitchPx + kSyntheticMarkerPx)) / 2;
+	const int originY = (kSyntheticHeight - ((kSyntheticRows - 1) * kSyntheticPitchPx + kSyntheticMarkerPx)) / 2;
+	int frameNumber = 0;
+
+	for (const auto &degradation : kDegradations) {
+		for (int i = 0; i < options.framesPerVariant; i++, frameNumber++) {
+			LabelledFrame frame;
+			frame.name = std::string(degradation.group) + "-" + std::to_string(i);
+			frame.group = degradation.group;
+
+			cv::Mat page(kSyntheticHeight, kSyntheticWidth, CV_8UC1, cv::Scalar(255));
+			for (int k = 0; k < kSyntheticCols * kSyntheticRows; k++) {
+				int id = (frameNumber * 37 + k * 11) % kArucoDictionarySize;
+				int x = originX + (k % kSyntheticCols) * kSyntheticPitchPx;
+				int y = originY + (k / kSyntheticCols) * kSyntheticPitchPx;
+				cv::Mat cell = page(cv::Rect(x, y, kSyntheticMarkerPx, kSyntheticMarkerPx));
+				blitArucoMarker(id, cell);
+
+				// Centres of the outermost border pixels, as the detector reports them
+				auto left = static_cast<float>(x);
+				auto top = static_cast<float>(y);
+				auto side = static_cast<float>(kSyntheticMarkerPx - 1);
+				frame.ids.push_back(id);
+				frame.corners.push_back({ { left, top }, { left + side, top }, { left + side, top + side },
+						{ left, top + side } });
+			}
+
+			page.convertTo(page, CV_8U, (degradation.light - degradation.dark) / 255.0, degradation.dark);
+
+			if (degradation.perspective) {
+				std::vector<cv::Point2f> from = { { 0.0f, 0.0f }, { kSyntheticWidth, 0.0f },
+					{ kSyntheticWidth, kSyntheticHeight }, { 0.0f, kSyntheticHeight } };
+				std::vector<cv::Point2f> to;
+				for (int k = 0; k < 4; k++) {
+					to.emplace_back(from[k].x + static_cast<float>(90.0 * std::sin(1.3 * i + 2.1 * k)),
+							from[k].y + static_cast<float>(70.0 * std::cos(0.7 * i + 1.7 * k)));
+				}
+				cv::Mat homography = cv::getPerspectiveTransform(from, to);
+				cv::warpPerspective(page, page, homography, page.size(), cv::INTER_LINEAR, cv::BORDER_CONSTANT,
+						cv::Scalar(degradation.light));
+
+				// Keep only the markers that are still wholly in frame
+				std::vector<int> keptIds;
+				std::vector<std::vector<cv::Point2f>> keptCorners;
+				for (size_t m = 0; m < frame.ids.size(); m++) {
+					std::vector<cv::Point2f> warped;
+					cv::perspectiveTransform(frame.corners[m], warped, homography);
+					bool inside = true;
+					for (const auto &p : warped) {
+						inside = inside && (p.x >= 0) && (p.y >= 0) && (p.x < kSyntheticWidth - 1) &&
+								 (p.y < kSyntheticHeight - 1);
+					}
+					if (inside) {
+						keptIds.push_back(frame.ids[m]);
+						keptCorners.push_back(std::move(warped));
+					}
+				}
+				frame.ids = std::move(keptIds);
+				frame.corners = std::move(keptCorners);
+			}
+
+			if (degradation.blurSigma > 0.0) {
+				cv::GaussianBlur(page, page, cv::Size(0, 0), degradation.blurSigma);
+			}
+			if (degradation.noiseSigma > 0.0) {
+				addNoise(page, degradation.noiseSigma, options.seed + frameNumber);
+			}
+
+			frame.image = page;
+			frames.push_back(std::move(frame));
+		}
+	}
+}
+
+auto DetectionScore::precision() const -> double {
+	size_t detected = truePositives + falsePositives;
+	return (detected > 0) ? static_cast<double>(truePositives) / detected : 1.0;
+}
+
+auto DetectionScore::recall() const -> double {
+	size_t labelled = truePositives + falseNegatives;
+	return (labelled > 0) ? static_cast<double>(truePositives) / labelled : 1.0;
+}
+
+auto DetectionScore::cornerRmse() const -> double {
+	return (corners > 0) ? std::sqrt(cornerSquaredError / corners) : 0.0;
+}
+
+auto DetectionScore::framesPerSecond() const -> double {
+	return (detectSeconds > 0.0) ? detectCalls / detectSeconds : 0.0;
+}
+
+auto DetectionScore::operator+=(const DetectionScore &other) -> DetectionScore & {
+	frames += other.frames;
+	truePositives += other.truePositives;
+	falsePositives += other.falsePositives;
+	falseNegatives += other.falseNegatives;
+	cornerSquaredError += other.cornerSquaredError;
+	corners += other.corners;
+	detectSeconds += other.detectSeconds;
+	detectCalls += other.detectCalls;
+	return *this;
+}
+
+auto scoreDetections(const LabelledFrame &frame, const std::vector<int> &ids,
+		const std::vector<std::vector<cv::Point2f>> &corners, DetectionScore &score) -> void {
+	std::vector<bool> matched(frame.ids.size(), false);
+
+	score.frames++;
+	for (size_t d = 0; d < ids.size(); d++) {
+		size_t label = 0;
+		while ((label < frame.ids.size()) && ((frame.ids[label] != ids[d]) || matched[label])) {
+			label++;
+		}
+		if (label == frame.ids.size()) {
+			score.falsePositives++;
+			continue;
+		}
+
+		matched[label] = true;
+		score.truePositives++;
+		for (int c = 0; c < 4; c++) {
+			cv::Point2f delta = corners[d][c] - frame.corners[label][c];
+			score.cornerSquaredError += delta.x * delta.x + delta.y * delta.y;
+			score.corners++;
+		}
+	}
+
+	for (bool found : matched) {
+		score.falseNegatives += found ? 0 : 1;
+	}
+}
+
+auto evaluateDetector(const std::vector<LabelledFrame> &frames,
+		const cv::aruco::DetectorParameters &params, int passes) -> std::map<std::string, DetectionScore> {
+	cv::aruco::ArucoDetector detector(cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250), params);
+	std::map<std::string, DetectionScore> scores;
+	std::vector<int> ids;
+	std::vector<std::vector<cv::Point2f>> corners;
+
+	for (int pass = 0; pass < std::max(1, passes); pass++) {
+		for (const auto &frame : frames) {
+			auto start = std::chrono::steady_clock::now();
+			detector.detectMarkers(frame.image, corners, ids);
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+			DetectionScore frameScore;
+			if (pass == 0) {
+				scoreDetections(frame, ids, corners, frameScore);
+			}
+			frameScore.detectSeconds = elapsed.count();
+			frameScore.detectCalls = 1;
+
+			scores[frame.group] += frameScore;
+			scores["all"] += frameScore;
+		}
+	}
+
+	return scores;
+}
+
+auto loadGoldenMetrics(const std::string &path, std::map<std::string, GoldenMetrics> &golden) -> bool {
+	std::ifstream in(path);
+	if (!in) {
+		std::cerr << "Error opening " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(in, line)) {
+		std::stringstream stream(line.substr(0, line.find('#')));
+		std::string group;
+		std::string metric;
+		double value = 0.0;
+		if (!(stream >> group)) {
+			continue;
+		}
+		if (!(stream >> metric >> value)) {
+			std::cerr << "Malformed golden line '" << line << "'" << std::endl;
+			return false;
+		}
+
+		auto &entry = golden[group];
+		if (metric == "precision") {
+			entry.precision = value;
+		} else if (metric == "recall") {
+			entry.recall = value;
+		} else if (metric == "corner_rmse") {
+			entry.cornerRmse = value;
+		} else if (metric == "fps") {
+			entry.framesPerSecond = value;
+		} else {
+			std::cerr << "Unknown golden metric '" << metric << "'" << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+auto saveGoldenMetrics(const std::string &path, const std::map<std::string, DetectionScore> &scores)
+		-> bool {
+	std::ofstream out(path, std::ios::trunc);
+	if (!out) {
+		std::cerr << "Error creating " << path << std::endl;
+		return false;
+	}
+
+	char buffer[128];
+	out << "# detection-regression --write-golden, OpenCV " CV_VERSION "\n";
+	out << "# group metric value\n";
+	for (const auto &entry : scores) {
+		const char *group = entry.first.c_str();
+		const auto &score = entry.second;
+		std::snprintf(buffer, sizeof(buffer), "%s precision %.4f\n%s recall %.4f\n%s corner_rmse %.4f\n%s fps %.1f\n",
+				group, score.precision(), group, score.recall(), group, score.cornerRmse(), group,
+				score.framesPerSecond());
+		out << buffer;
+	}
+
+	return static_cast<bool>(out);
+}
+
+auto loadDetectorParameters(const std::string &path, cv::aruco::DetectorParameters &params) -> bool {
+	cv::FileStorage storage(path, cv::FileStorage::READ);
+	if (!storage.isOpened()) {
+		std::cerr << "Error opening " << path << std::endl;
+		return false;
+	}
+	return params.readDetectorParameters(storage.root());
+}
+
+auto saveDetectorParameters(const std::string &path, cv::aruco::DetectorParameters params) -> bool {
+	cv::FileStorage storage(path, cv::FileStorage::WRITE);
+	if (!storage.isOpened()) {
+		std::cerr << "Error creating " << path << std::endl;
+		return false;
+	}
+	return params.writeDetectorParameters(storage);
+}
@@ -0,0 +1,180 @@
+/// \file
+/// \brief Checks an ArUco detector configuration against golden accuracy and throughput results
+
+#include "include/detection-eval.hpp"
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+
+/// How far each metric may move in the bad direction before a group fails
+struct Tolerances {
+	double precision = 0.01; ///< Absolute drop
+	double recall = 0.01; ///< Absolute drop
+	double cornerRmse = 0.05; ///< Absolute rise, in pixels
+	double fps = 0.5; ///< Fractional drop; negative disables the check
+};
+
+static void printScores(const std::map<std::string, DetectionScore> &scores) {
+	std::printf("%-24s %6s %6s %6s %6s %10s %10s %10s\n", "group", "frames", "TP", "FP", "FN", "precision",
+			"recall", "rmse px");
+	for (const auto &entry : scores) {
+		const auto &s = entry.second;
+		std::printf("%-24s %6zu %6zu %6zu %6zu %10.4f %10.4f %10.4f\n", entry.first.c_str(), s.frames,
+				s.truePositives, s.falsePositives, s.falseNegatives, s.precision(), s.recall(), s.cornerRmse());
+	}
+	std::printf("\nThroughput : %.1f frames/sec\n\n", scores.at("all").framesPerSecond());
+}
+
+static auto compareToGolden(const std::map<std::string, DetectionScore> &scores,
+		const std::map<std::string, GoldenMetrics> &golden, const Tolerances &tolerances) -> bool {
+	bool pass = true;
+	auto check = [&](const std::string &group, const char *metric, bool ok, double value, double expected) {
+		if (!ok) {
+			std::printf("REGRESSION %s %s : %.4f vs golden %.4f\n", group.c_str(), metric, value, expected);
+			pass = false;
+		}
+	};
+
+	for (const auto &entry : golden) {
+		auto it = scores.find(entry.first);
+		if (it == scores.end()) {
+			std::printf("REGRESSION %s : group missing from corpus\n", entry.first.c_str());
+			pass = false;
+			continue;
+		}
+
+		const auto &want = entry.second;
+		const auto &got = it->second;
+		check(entry.first, "precision", got.precision() >= want.precision - tolerances.precision,
+				got.precision(), want.precision);
+		check(entry.first, "recall", got.recall() >= want.recall - tolerances.recall, got.recall(),
+				want.recall);
+		check(entry.first, "corner_rmse", got.cornerRmse() <= want.cornerRmse + tolerances.cornerRmse,
+				got.cornerRmse(), want.cornerRmse);
+		if ((tolerances.fps >= 0.0) && (entry.first == "all")) {
+			check(entry.first, "fps", got.framesPerSecond() >= want.framesPerSecond * (1.0 - tolerances.fps),
+					got.framesPerSecond(), want.framesPerSecond);
+		}
+	}
+
+	return pass;
+}
+
+static void printUsage(const char *argv0) {
+	std::cout << "Usage: " << argv0 << " [options]\n"
+			  << "Scores DICT_6X6_250 detection on labelled captures and synthetic renders.\n\n"
+			  << "  --labels FILE        Labelled captures (default regression/labels.csv)\n"
+			  << "  --synthetic N        Synthetic frames per degradation (default 6, 0 for none)\n"
+			  << "  --params FILE        DetectorParameters to test (default: OpenCV defaults)\n"
+			  << "  --golden FILE        Results to compare against (default regression/golden-default.txt)\n"
+			  << "  --write-golden FILE  Save this run as the new golden results and skip the comparison\n"
+			  << "  --passes N           Timed passes over the corpus (default 5)\n"
+			  << "  --threads N          OpenCV worker threads during detection (default: OpenCV's choice)\n"
+			  << "  --tol-precision X    Allowed absolute precision drop (default 0.01)\n"
+			  << "  --tol-recall X       Allowed absolute recall drop (default 0.01)\n"
+			  << "  --tol-rmse X         Allowed corner RMSE rise in pixels (default 0.05)\n"
+			  << "  --tol-fps X          Allowed fractional frame rate drop, negative to ignore (default 0.5)\n"
+			  << "  --dump DIR           Write the synthetic frames to DIR as PNGs\n";
+}
+
+int main(int argc, char **argv) {
+	std::string labelsPath = "regression/labels.csv";
+	std::string goldenPath = "regression/golden-default.txt";
+	std::string writeGoldenPath;
+	std::string paramsPath;
+	std::string dumpDir;
+	SyntheticCorpusOptions synthetic;
+	Tolerances tolerances;
+	int passes = 5;
+	int threads = -1;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool haveValue = (i + 1 < argc);
+
+		if ((arg == "--labels") && haveValue) {
+			labelsPath = argv[++i];
+		} else if ((arg == "--synthetic") && haveValue) {
+			synthetic.framesPerVariant = std::atoi(argv[++i]);
+		} else if ((arg == "--params") && haveValue) {
+			paramsPath = argv[++i];
+		} else if ((arg == "--golden") && haveValue) {
+			goldenPath = argv[++i];
+		} else if ((arg == "--write-golden") && haveValue) {
+			writeGoldenPath = argv[++i];
+		} else if ((arg == "--passes") && haveValue) {
+			passes = std::atoi(argv[++i]);
+		} else if ((arg == "--threads") && haveValue) {
+			threads = std::atoi(argv[++i]);
+		} else if ((arg == "--tol-precision") && haveValue) {
+			tolerances.precision = std::atof(argv[++i]);
+		} else if ((arg == "--tol-recall") && haveValue) {
+			tolerances.recall = std::atof(argv[++i]);
+		} else if ((arg == "--tol-rmse") && haveValue) {
+			tolerances.cornerRmse = std::atof(argv[++i]);
+		} else if ((arg == "--tol-fps") && haveValue) {
+			tolerances.fps = std::atof(argv[++i]);
+		} else if ((arg == "--dump") && haveValue) {
+			dumpDir = argv[++i];
+		} else {
+			printUsage(argv[0]);
+			return (arg == "--help") ? 0 : 1;
+		}
+	}
+
+	cv::aruco::DetectorParameters params;
+	if (!paramsPath.empty() && !loadDetectorParameters(paramsPath, params)) {
+		return 1;
+	}
+
+	std::vector<LabelledFrame> frames;
+	if (!labelsPath.empty() && !loadLabelledFrames(labelsPath, frames)) {
+		return 1;
+	}
+	renderSyntheticFrames(synthetic, frames);
+	if (frames.empty()) {
+		std::cerr << "Empty corpus" << std::endl;
+		return 1;
+	}
+
+	if (!dumpDir.empty()) {
+		std::filesystem::create_directories(dumpDir);
+		for (const auto &frame : frames) {
+			if (frame.group != "captured") {
+				cv::imwrite((std::filesystem::path(dumpDir) / (frame.name + ".png")).string(), frame.image);
+			}
+		}
+	}
+
+	if (threads >= 0) {
+		cv::setNumThreads(threads);
+	}
+
+	auto scores = evaluateDetector(frames, params, passes);
+	printScores(scores);
+
+	if (!writeGoldenPath.empty()) {
+		if (!saveGoldenMetrics(writeGoldenPath, scores)) {
+			return 1;
+		}
+		std::cout << "Golden results written to " << writeGoldenPath << std::endl;
+		return 0;
+	}
+
+	std::map<std::string, GoldenMetrics> golden;
+	if (!loadGoldenMetrics(goldenPath, golden)) {
+		return 1;
+	}
+	if (!compareToGolden(scores, golden, tolerances)) {
+		std::cout << "FAILED against " << goldenPath << std::endl;
+		return 1;
+	}
+
+	std::cout << "PASSED against " << goldenPath << std::endl;
+	return 0;
+}
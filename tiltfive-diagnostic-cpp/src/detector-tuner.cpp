@@ -0,0 +1,260 @@
+/// \file
+/// \brief Offline search for ArUco DetectorParameters on the detection time / recall frontier
+///
+/// Candidates are sampled from a grid over the parameters that matter most for low-contrast IR
+/// frames, scored with the same corpus and metrics as detection-regression. Candidates below the
+/// minimum precision are discarded, and the rest reduced to the set that no other candidate beats
+/// on both time per frame and recall.
+
+#include "include/detection-eval.hpp"
+
+#include <opencv2/core/utility.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+
+namespace {
+
+struct Candidate {
+	cv::aruco::DetectorParameters params;
+	std::string description;
+	DetectionScore score;
+
+	[[nodiscard]] auto msPerFrame() const -> double {
+		double fps = score.framesPerSecond();
+		return (fps > 0.0) ? 1000.0 / fps : 0.0;
+	}
+};
+
+template <typename T, size_t N>
+auto pick(std::mt19937 &rng, const T (&choices)[N]) -> T {
+	return choices[std::uniform_int_distribution<size_t>(0, N - 1)(rng)];
+}
+
+auto describe(const cv::aruco::DetectorParameters &p) -> std::string {
+	static const char *const kRefinement[] = { "none", "subpix", "contour", "apriltag" };
+
+	std::ostringstream out;
+	out << "win=" << p.adaptiveThreshWinSizeMin << ":" << p.adaptiveThreshWinSizeMax << ":"
+		<< p.adaptiveThreshWinSizeStep << " c=" << p.adaptiveThreshConstant
+		<< " perim=" << p.minMarkerPerimeterRate << ":" << p.maxMarkerPerimeterRate
+		<< " poly=" << p.polygonalApproxAccuracyRate << " ppc=" << p.perspectiveRemovePixelPerCell
+		<< " refine=" << kRefinement[p.cornerRefinementMethod & 3]
+		<< (p.useAruco3Detection ? " aruco3" : "");
+	return out.str();
+}
+
+auto sampleParameters(std::mt19937 &rng) -> cv::aruco::DetectorParameters {
+	static const int kWinMin[] = { 3, 5, 7 };
+	static const int kWinMax[] = { 7, 15, 23, 31, 41 };
+	static const int kWinStep[] = { 4, 6, 10, 16 };
+	static const double kThreshConstant[] = { 3, 5, 7, 9 };
+	static const double kMinPerimeter[] = { 0.01, 0.02, 0.03, 0.05 };
+	static const double kMaxPerimeter[] = { 1.0, 2.0, 4.0 };
+	static const double kPolyAccuracy[] = { 0.03, 0.05, 0.08 };
+	static const int kPixelPerCell[] = { 4, 8 };
+	static const int kRefinement[] = { cv::aruco::CORNER_REFINE_NONE, cv::aruco::CORNER_REFINE_SUBPIX,
+		cv::aruco::CORNER_REFINE_CONTOUR };
+	static const bool kAruco3[] = { false, true };
+
+	cv::aruco::DetectorParameters p;
+	p.adaptiveThreshWinSizeMin = pick(rng, kWinMin);
+	p.adaptiveThreshWinSizeMax = std::max(p.adaptiveThreshWinSizeMin, pick(rng, kWinMax));
+	p.adaptiveThreshWinSizeStep = pick(rng, kWinStep);
+	p.adaptiveThreshConstant = pick(rng, kThreshConstant);
+	p.minMarkerPerimeterRate = pick(rng, kMinPerimeter);
+	p.maxMarkerPerimeterRate = pick(rng, kMaxPerimeter);
+	p.polygonalApproxAccuracyRate = pick(rng, kPolyAccuracy);
+	p.perspectiveRemovePixelPerCell = pick(rng, kPixelPerCell);
+	p.cornerRefinementMethod = pick(rng, kRefinement);
+	p.useAruco3Detection = pick(rng, kAruco3);
+	return p;
+}
+
+// Fastest first; each member has strictly better recall than every faster member. Only candidates
+// reaching minPrecision take part, so a fast configuration full of false positives can't push
+// precise ones of the same recall off the frontier.
+auto paretoFrontier(const std::vector<Candidate> &candidates, double minPrecision)
+		-> std::vector<const Candidate *> {
+	std::vector<const Candidate *> sorted;
+	for (const auto &candidate : candidates) {
+		if (candidate.score.precision() >= minPrecision) {
+			sorted.push_back(&candidate);
+		}
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const Candidate *a, const Candidate *b) {
+		if (a->msPerFrame() != b->msPerFrame()) {
+			return a->msPerFrame() < b->msPerFrame();
+		}
+		return a->score.recall() > b->score.recall();
+	});
+
+	std::vector<const Candidate *> frontier;
+	double bestRecall = -1.0;
+	for (const auto *candidate : sorted) {
+		if (candidate->score.recall() > bestRecall) {
+			frontier.push_back(candidate);
+			bestRecall = candidate->score.recall();
+		}
+	}
+	return frontier;
+}
+
+void printUsage(const char *argv0) {
+	std::cout << "Usage: " << argv0 << " [options]\n"
+			  << "Searches DetectorParameters for the detection time / recall frontier.\n\n"
+			  << "  --labels FILE        Labelled captures (default regression/labels.csv)\n"
+			  << "  --synthetic N        Synthetic frames per degradation (default 6, 0 for none)\n"
+			  << "  --candidates N       Configurations to try besides the defaults (default 100)\n"
+			  << "  --seed N             Sampling seed (default 1)\n"
+			  << "  --passes N           Timed passes per candidate (default 2)\n"
+			  << "  --threads N          OpenCV worker threads during detection (default 1)\n"
+			  << "  --min-recall X       Recall the chosen set must reach (default: best on the frontier)\n"
+			  << "  --min-precision X    Precision every frontier member must reach (default 0.99)\n"
+			  << "  --frontier FILE      Also write the frontier as CSV\n"
+			  << "  --out FILE           Chosen parameters (default detector-params.yml)\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	std::string labelsPath = "regression/labels.csv";
+	std::string outPath = "detector-params.yml";
+	std::string frontierPath;
+	SyntheticCorpusOptions synthetic;
+	int candidateCount = 100;
+	unsigned seed = 1;
+	int passes = 2;
+	int threads = 1;
+	double minRecall = -1.0;
+	double minPrecision = 0.99;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool haveValue = (i + 1 < argc);
+
+		if ((arg == "--labels") && haveValue) {
+			labelsPath = argv[++i];
+		} else if ((arg == "--synthetic") && haveValue) {
+			synthetic.framesPerVariant = std::atoi(argv[++i]);
+		} else if ((arg == "--candidates") && haveValue) {
+			candidateCount = std::atoi(argv[++i]);
+		} else if ((arg == "--seed") && haveValue) {
+			seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		} else if ((arg == "--passes") && haveValue) {
+			passes = std::atoi(argv[++i]);
+		} else if ((arg == "--threads") && haveValue) {
+			threads = std::atoi(argv[++i]);
+		} else if ((arg == "--min-recall") && haveValue) {
+			minRecall = std::atof(argv[++i]);
+		} else if ((arg == "--min-precision") && haveValue) {
+			minPrecision = std::atof(argv[++i]);
+		} else if ((arg == "--frontier") && haveValue) {
+			frontierPath = argv[++i];
+		} else if ((arg == "--out") && haveValue) {
+			outPath = argv[++i];
+		} else {
+			printUsage(argv[0]);
+			return (arg == "--help") ? 0 : 1;
+		}
+	}
+
+	std::vector<LabelledFrame> frames;
+	if (!labelsPath.empty() && !loadLabelledFrames(labelsPath, frames)) {
+		return 1;
+	}
+	renderSyntheticFrames(synthetic, frames);
+	if (frames.empty()) {
+		std::cerr << "Empty corpus" << std::endl;
+		return 1;
+	}
+
+	// Time one detection at a time so candidates compare fairly
+	cv::setNumThreads(threads);
+
+	std::vector<Candidate> candidates;
+	std::set<std::string> seen;
+	std::mt19937 rng(seed);
+
+	candidates.push_back({ cv::aruco::DetectorParameters(), "", {} });
+	candidates.back().description = "defaults";
+	seen.insert(describe(candidates.back().params));
+
+	for (int attempt = 0; (static_cast<int>(candidates.size()) <= candidateCount) && (attempt < candidateCount * 20);
+			attempt++) {
+		auto params = sampleParameters(rng);
+		auto description = describe(params);
+		if (seen.insert(description).second) {
+			candidates.push_back({ params, description, {} });
+		}
+	}
+
+	std::cout << "Scoring " << candidates.size() << " configurations on " << frames.size() << " frames"
+			  << std::endl;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		candidates[i].score = evaluateDetector(frames, candidates[i].params, passes).at("all");
+		std::cout << "\r" << (i + 1) << " / " << candidates.size() << std::flush;
+	}
+	std::cout << "\n\n";
+
+	auto frontier = paretoFrontier(candidates, minPrecision);
+	if (frontier.empty()) {
+		std::cerr << "No configuration reaches precision " << minPrecision << std::endl;
+		return 1;
+	}
+
+	std::printf("%10s %8s %9s %8s  %s\n", "ms/frame", "recall", "precision", "rmse px", "parameters");
+	for (const auto *candidate : frontier) {
+		std::printf("%10.2f %8.4f %9.4f %8.4f  %s\n", candidate->msPerFrame(), candidate->score.recall(),
+				candidate->score.precision(), candidate->score.cornerRmse(), candidate->description.c_str());
+	}
+	const auto &defaults = candidates.front();
+	std::printf("\nDefaults: %.2f ms/frame, recall %.4f, precision %.4f, rmse %.4f px\n\n",
+			defaults.msPerFrame(), defaults.score.recall(), defaults.score.precision(),
+			defaults.score.cornerRmse());
+
+	if (!frontierPath.empty()) {
+		std::ofstream out(frontierPath, std::ios::trunc);
+		out << "ms_per_frame,recall,precision,corner_rmse,parameters\n";
+		for (const auto *candidate : frontier) {
+			out << candidate->msPerFrame() << "," << candidate->score.recall() << ","
+				<< candidate->score.precision() << "," << candidate->score.cornerRmse() << ","
+				<< candidate->description << "\n";
+		}
+		if (!out) {
+			std::cerr << "Error writing " << frontierPath << std::endl;
+			return 1;
+		}
+	}
+
+	// The fastest frontier member that is accurate enough
+	if (minRecall < 0.0) {
+		minRecall = frontier.back()->score.recall();
+	}
+	const Candidate *chosen = nullptr;
+	for (const auto *candidate : frontier) {
+		if (candidate->score.recall() >= minRecall) {
+			chosen = candidate;
+			break;
+		}
+	}
+	if (!chosen) {
+		std::cerr << "No configuration with precision " << minPrecision << " reaches recall " << minRecall
+				  << std::endl;
+		return 1;
+	}
+
+	if (!saveDetectorParameters(outPath, chosen->params)) {
+		return 1;
+	}
+	std::cout << "Chose " << chosen->description << "\nSaved to " << outPath
+			  << " (use with detection-regression --params, or next to camera)" << std::endl;
+
+	return 0;
+}
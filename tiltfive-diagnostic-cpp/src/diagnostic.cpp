@@ -20,6 +20,7 @@
 /// \privatesection
 
 #include "include/TiltFiveNative.hpp"
+#include "include/pose-analyzer.hpp"
 
 #include <chrono>
 #include <iostream>
@@ -44,29 +45,28 @@ constexpr std::chrono::milliseconds operator""_ms(unsigned long long ms) {
 auto waitForGlasses(Client &client) -> tiltfive::Result<Glasses> {
 	std::cout << "Looking for glasses..." << std::flush;
 
+	// The discovery helper polls in the background and wakes us as soon as glasses appear,
+	// rather than on the next fixed sleep.
+	auto discoveryHelper = client->createGlassesDiscoveryHelper();
+
 	// Loop until we find glasses
-	auto glassesList = client->listGlasses();
-	if (!glassesList) {
-		return glassesList.error();
-	}
-	while (glassesList->empty()) {
+	auto glassesId = discoveryHelper->awaitGlasses(1000_ms);
+	while (!glassesId) {
+		if (glassesId.error() != tiltfive::Error::kTimeout) {
+			return glassesId.error();
+		}
 		std::cout << "." << std::flush;
-		std::this_thread::sleep_for(100_ms);
 
-		// Request a list of the available glasses
-		glassesList = client->listGlasses();
-		if (!glassesList) {
-			return glassesList.error();
-		}
+		glassesId = discoveryHelper->awaitGlasses(1000_ms);
 	}
 
 	// Print out the found glasses
-	for (auto &glassesInstance : *glassesList) {
+	for (auto &glassesInstance : discoveryHelper->listKnownGlasses()) {
 		std::cout << "Found : " << glassesInstance << std::endl;
 	}
 
 	// Return the first found glasses
-	return tiltfive::obtainGlasses(glassesList->front(), client);
+	return tiltfive::obtainGlasses(*glassesId, client);
 }
 /// [WaitForGlasses]
 
@@ -109,20 +109,40 @@ auto waitForWand(Glasses &glasses) -> tiltfive::Result<Wand> {
 
 /// [ExclusiveOps]
 auto readPoses(Glasses &glasses) -> tiltfive::Result<void> {
+	// Sampled on the helper's thread, so this loop never waits on the service
+	auto poseStream = glasses->createPoseStreamHelper();
+	PoseAnalyzer analyzer;
+	uint64_t analyzedSamples = 0;
 	auto start = std::chrono::steady_clock::now();
 	do {
-		auto pose = glasses->getLatestGlassesPose(kT5_GlassesPoseUsage_GlassesPresentation);
+		// Only analyze each of the helper's samples once, however fast this loop spins
+		uint64_t samples = poseStream->sampleCount(kT5_GlassesPoseUsage_GlassesPresentation);
+		bool fresh = (samples != analyzedSamples);
+		analyzedSamples = samples;
+
+		auto pose = poseStream->getLatestPose(kT5_GlassesPoseUsage_GlassesPresentation);
 		if (!pose) {
 			if (pose.error() == tiltfive::Error::kTryAgain) {
+				if (fresh) {
+					analyzer.addDropout();
+				}
 				std::cout << "\rPose unavailable - Is gameboard visible?                         ";
+			} else if (pose.error() == tiltfive::Error::kUnavailable) {
+				// Nothing sampled yet
+				continue;
 			} else {
 				return pose.error();
 			}
 		} else {
+			if (fresh) {
+				analyzer.addPose(*pose);
+			}
 			std::cout << "\r" << pose;
 		}
 	} while ((std::chrono::steady_clock::now() - start) < 10000_ms);
 
+	std::cout << std::endl;
+	analyzer.report(std::cout);
 	return tiltfive::kSuccess;
 }
 /// [ExclusiveOps]
@@ -212,43 +232,30 @@ auto doThingsWithGlasses(Glasses &glasses) -> tiltfive::Result<void> {
 
 /// [SystemWideQuery]
 auto printGameboardDimensions(Client &client) -> tiltfive::Result<void> {
-	auto result = client->getGameboardSize(kT5_GameboardType_LE);
-	if (!result) {
-		return result.error();
-	}
-
-	float width = result->viewableExtentPositiveX + result->viewableExtentNegativeX;
-	float length = result->viewableExtentPositiveY + result->viewableExtentNegativeY;
-	float height = result->viewableExtentPositiveZ;
-
-	std::cout << "LE Gameboard size : " << width << "m x " << length << "m x " << height << "m"
-			  << std::endl;
-
-	return tiltfive::kSuccess;
+	return client->getGameboardSize(kT5_GameboardType_LE).map([](const T5_GameboardSize &size) {
+		float width = size.viewableExtentPositiveX + size.viewableExtentNegativeX;
+		float length = size.viewableExtentPositiveY + size.viewableExtentNegativeY;
+		float height = size.viewableExtentPositiveZ;
+
+		std::cout << "LE Gameboard size : " << width << "m x " << length << "m x " << height << "m"
+				  << std::endl;
+	});
 }
 
 /// [WaitForServiceCallerFn]
 auto printServiceVersion(Client &client) -> tiltfive::Result<void> {
-	auto result = client->getServiceVersion();
-	if (!result) {
-		return result.error();
-	}
-
-	std::cout << "Service version : " << result << std::endl;
-	return tiltfive::kSuccess;
+	return client->getServiceVersion().map([](const std::string &version) {
+		std::cout << "Service version : " << version << std::endl;
+	});
 }
 /// [WaitForServiceCallerFn]
 /// [SystemWideQuery]
 
 auto printUiStatusFlags(Client &client) -> tiltfive::Result<void> {
-	auto result = client->isTiltFiveUiRequestingAttention();
-	if (!result) {
-		return result.error();
-	}
-	std::cout << "Tilt Five UI (Attention Requested) : " << ((*result) ? "TRUE" : "FALSE")
-			  << std::endl;
-
-	return tiltfive::kSuccess;
+	return client->isTiltFiveUiRequestingAttention().map([](bool attentionRequested) {
+		std::cout << "Tilt Five UI (Attention Requested) : " << (attentionRequested ? "TRUE" : "FALSE")
+				  << std::endl;
+	});
 }
 
 /// [WaitForService]
@@ -257,6 +264,9 @@ template <typename T>
 auto waitForService(Client &client, const std::function<tiltfive::Result<T>(Client &client)> &func)
 		-> tiltfive::Result<T> {
 	bool waitingForService = false;
+	// Start with a short retry so an already-running service costs almost nothing, then back
+	// off towards the old fixed 100ms poll.
+	auto retryInterval = 5_ms;
 	for (;;) {
 		auto result = func(client);
 		if (result) {
@@ -267,7 +277,8 @@ auto waitForService(Client &client, const std::function<tiltfive::Result<T>(Clie
 
 		std::cout << (waitingForService ? "." : "Waiting for service...") << std::flush;
 		waitingForService = true;
-		std::this_thread::sleep_for(100_ms);
+		std::this_thread::sleep_for(retryInterval);
+		retryInterval = std::min(retryInterval * 2, 100_ms);
 	}
 }
 /// [WaitForService]
@@ -0,0 +1,89 @@
+/// \file
+/// \brief Routing of camera frames by illumination mode ahead of marker detection
+
+#include "include/frame-demux.hpp"
+
+#include <cstring>
+
+auto illuminationModeName(IlluminationMode mode) -> const char * {
+	switch (mode) {
+		case IlluminationMode::kLight:
+			return "light";
+		case IlluminationMode::kDark:
+			return "dark";
+		default:
+			return "unknown";
+	}
+}
+
+auto FrameDemuxStats::rate(IlluminationMode mode) const -> double {
+	return (seconds > 0.0) ? static_cast<double>(count(mode)) / seconds : 0.0;
+}
+
+auto FrameDemuxStats::detectRate() const -> double {
+	return (seconds > 0.0) ? static_cast<double>(detected) / seconds : 0.0;
+}
+
+auto FrameDemux::push(const T5_CamImage &image) -> RoutedFrame {
+	auto now = std::chrono::steady_clock::now();
+	if (mSequence == 0) {
+		mFirstFrame = now;
+	}
+	mSequence++;
+	mStats.seconds = std::chrono::duration<double>(now - mFirstFrame).count();
+
+	// Empty buffers leave the geometry at zero; treat those as full-size, tightly packed frames
+	RoutedFrame routed;
+	routed.width = image.imageWidth ? image.imageWidth : T5_MIN_CAM_IMAGE_BUFFER_WIDTH;
+	routed.height = image.imageHeight ? image.imageHeight : T5_MIN_CAM_IMAGE_BUFFER_HEIGHT;
+	routed.light = image.pixelData;
+	routed.lightStride = image.imageStride ? image.imageStride : static_cast<size_t>(routed.width);
+
+	routed.mode = (image.illuminationMode < kIlluminationModeCount)
+			? static_cast<IlluminationMode>(image.illuminationMode)
+			: IlluminationMode::kUnknown;
+	mStats.frames[static_cast<int>(routed.mode)]++;
+
+	switch (routed.mode) {
+		case IlluminationMode::kDark:
+			if (mOptions.maxDarkAge > 0) {
+				mDark.resize(routed.width, routed.height);
+				for (int y = 0; y < routed.height; y++) {
+					std::memcpy(mDark.data() + y * mDark.stride(), routed.light + y * routed.lightStride,
+							routed.width);
+				}
+				mDarkCamera = image.cameraIndex;
+				mDarkSequence = mSequence;
+				mHaveDark = true;
+			}
+			return routed;
+
+		case IlluminationMode::kLight:
+			if (mHaveDark && (mDarkCamera == image.cameraIndex) && (mDark.width == routed.width) &&
+					(mDark.height == routed.height) &&
+					(mSequence - mDarkSequence <= static_cast<uint64_t>(mOptions.maxDarkAge))) {
+				routed.dark = mDark.data();
+				routed.darkStride = mDark.stride();
+				mStats.paired++;
+			}
+			break;
+
+		default:
+			if ((mOptions.unknownKeepEvery <= 0) || (mUnknownSeen++ % mOptions.unknownKeepEvery != 0)) {
+				mStats.dropped++;
+				return routed;
+			}
+			break;
+	}
+
+	routed.detect = true;
+	mStats.detected++;
+	return routed;
+}
+
+auto FrameDemux::reset() -> void {
+	mStats = FrameDemuxStats();
+	mSequence = 0;
+	mHaveDark = false;
+	mUnknownSeen = 0;
+}
@@ -0,0 +1,274 @@
+/// \file
+/// \brief Frame submission on a fixed schedule with dummy textures
+
+#include "include/frame-pacer.hpp"
+#include "include/metrics.hpp"
+#include "include/t5-math.hpp"
+#include "include/trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The status line is redrawn at most this often, after a frame is sent so it only eats slack
+constexpr auto kStatusInterval = std::chrono::milliseconds(100);
+
+// Sends to a local service take microseconds, below the first of the usual latency buckets
+auto submitBuckets() -> std::vector<double> {
+	std::vector<double> bounds = { 0.000001, 0.0000025, 0.000005, 0.00001, 0.000025, 0.00005 };
+	std::vector<double> latency = latencyBuckets();
+	bounds.insert(bounds.end(), latency.begin(), latency.end());
+	return bounds;
+}
+
+// Everything the pacing loop publishes, looked up once so updates never take the registry lock
+struct FrameMetrics {
+	explicit FrameMetrics(MetricsRegistry &registry)
+		: sent(registry.counter("t5diag_frames_sent_total", "Frames sent to the glasses")),
+		  sendFailures(registry.counter("t5diag_frame_send_failures_total", "Frames the service refused")),
+		  missedDeadlines(registry.counter("t5diag_frame_missed_deadlines_total",
+				  "Frames sent after the next frame slot had begun")),
+		  skippedSlots(registry.counter("t5diag_frame_skipped_slots_total",
+				  "Frame slots that passed while an earlier frame was being prepared")),
+		  submitSeconds(registry.histogram("t5diag_frame_submit_seconds", "Duration of each send call",
+				  submitBuckets())),
+		  frameSeconds(registry.histogram("t5diag_frame_seconds",
+				  "Time from a frame slot starting until its frame was sent", latencyBuckets())),
+		  poseAgeSeconds(registry.histogram("t5diag_frame_pose_age_seconds",
+				  "Age of each frame's pose when it was sent", latencyBuckets())),
+		  sentRate(registry.gauge("t5diag_frames_sent_rate_hz", "Frames sent over the last second")) {}
+
+	MetricCounter &sent;
+	MetricCounter &sendFailures;
+	MetricCounter &missedDeadlines;
+	MetricCounter &skippedSlots;
+	MetricHistogram &submitSeconds;
+	MetricHistogram &frameSeconds;
+	MetricHistogram &poseAgeSeconds;
+	MetricGauge &sentRate;
+};
+
+auto nanosSince(Clock::time_point start, Clock::time_point now) -> int64_t {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+}
+
+auto seconds(Clock::duration duration) -> double {
+	return std::chrono::duration<double>(duration).count();
+}
+
+// Sleep to within the spin window of the slot, then spin to it
+auto waitFor(Clock::time_point slot, std::chrono::microseconds spinWindow) -> void {
+	T5DIAG_TRACE_SPAN("frames", "wait");
+	if (Clock::now() < slot - spinWindow) {
+		std::this_thread::sleep_until(slot - spinWindow);
+	}
+	while (Clock::now() < slot) {
+		std::this_thread::yield();
+	}
+}
+
+// Stands in for the CPU and GPU work of drawing both eyes
+auto simulateRender(std::chrono::microseconds renderTime) -> void {
+	if (renderTime.count() == 0) {
+		return;
+	}
+	T5DIAG_TRACE_SPAN("frames", "render");
+	auto end = Clock::now() + renderTime;
+	while (Clock::now() < end) {
+	}
+}
+
+auto printStats(const char *name, const RunningStats &stats) -> void {
+	std::cout << " * " << name << ": mean " << stats.mean() * 1e3 << " ms, stddev " << stats.stddev() * 1e3
+			  << " ms, max " << stats.max() * 1e3 << " ms\n";
+}
+
+auto printSummary(const FramePacerOptions &options, const FramePacerStats &stats) -> void {
+	std::cout << "\n\nFrame pacing at " << options.fps << " fps:\n";
+	std::cout << " * " << stats.sent << " frames sent in " << stats.elapsed << " s (" << stats.sentPerSecond()
+			  << " fps) over " << stats.slots + stats.skippedSlots << " slots\n";
+	std::cout << " * " << stats.missedDeadlines << " missed deadlines, " << stats.skippedSlots << " skipped slots, "
+			  << stats.sendFailures << " send failures\n";
+	std::cout << " * " << stats.staleFrames << " frames reused an earlier pose, " << stats.noPoseSlots
+			  << " slots had no pose yet\n";
+	printStats("Wake lateness", stats.wakeLateness);
+	printStats("Submit latency", stats.submitLatency);
+	printStats("Slot to sent", stats.frameTime);
+	printStats("Pose age at submit", stats.poseAge);
+	std::cout << std::flush;
+}
+
+} // namespace
+
+auto fillFrameEyePoses(const T5_GlassesPose &pose, double ipd, T5_FrameInfo &frameInfo) -> void {
+	t5math::RigidTransform glasses = t5math::gameboardFromGlasses(pose);
+	auto halfIpd = static_cast<float>(ipd * 0.5);
+	T5_Vec3 left = t5math::compose(glasses, { { 1.0f, 0.0f, 0.0f, 0.0f }, { -halfIpd, 0.0f, 0.0f } }).translation;
+	T5_Vec3 right = t5math::compose(glasses, { { 1.0f, 0.0f, 0.0f, 0.0f }, { halfIpd, 0.0f, 0.0f } }).translation;
+
+	frameInfo.rotToLVC_GBD = pose.rotToGLS_GBD;
+	frameInfo.posLVC_GBD = left;
+	frameInfo.rotToRVC_GBD = pose.rotToGLS_GBD;
+	frameInfo.posRVC_GBD = right;
+}
+
+auto runFramePacer(std::shared_ptr<tiltfive::Glasses> &glasses, const FramePacerOptions &options,
+		FramePacerStats &stats) -> tiltfive::Result<void> {
+	stats = FramePacerStats();
+
+	// Already initialized is fine: the context outlives a previous run on the same connection
+	auto graphicsResult = glasses->initGraphicsContext(kT5_GraphicsApi_None, nullptr);
+	if (!graphicsResult && (graphicsResult.error() != tiltfive::Error::kInvalidState)) {
+		std::cerr << "Error initializing graphics : " << graphicsResult << std::endl;
+		return graphicsResult;
+	}
+
+	auto projection = glasses->getProjection(kT5_CartesianCoordinateHandedness_Right, kT5_DepthRange_MinusOneToOne,
+			kT5_MatrixOrder_ColumnMajor, 0.1, 100.0, 1.0);
+	if (!projection) {
+		std::cerr << "Error reading projection : " << projection << std::endl;
+		return projection.error();
+	}
+	auto ipd = glasses->getIpd();
+	if (!ipd) {
+		std::cerr << "Error reading IPD : " << ipd << std::endl;
+		return ipd.error();
+	}
+
+	// Nothing reads through the handles with no graphics API; they only need to be distinct and set
+	static int leftTexture = 0;
+	static int rightTexture = 0;
+	T5_FrameInfo frameInfo = T5_FrameInfo();
+	frameInfo.leftTexHandle = &leftTexture;
+	frameInfo.rightTexHandle = &rightTexture;
+	frameInfo.texWidth_PIX = projection->framebufferWidth;
+	frameInfo.texHeight_PIX = projection->framebufferHeight;
+	frameInfo.isUpsideDown = false;
+	const double kPi = 3.14159265358979323846;
+	auto halfHeight = static_cast<float>(std::tan(0.5 * projection->fieldOfView * kPi / 180.0));
+	auto halfWidth = halfHeight * static_cast<float>(projection->aspectRatio);
+	frameInfo.vci.startX_VCI = -halfWidth;
+	frameInfo.vci.startY_VCI = -halfHeight;
+	frameInfo.vci.width_VCI = 2.0f * halfWidth;
+	frameInfo.vci.height_VCI = 2.0f * halfHeight;
+
+	auto problems = glasses->validateFrameInfo(&frameInfo);
+	if (!problems) {
+		std::cerr << "Error validating frame info : " << problems << std::endl;
+		return problems.error();
+	} else if (!problems->empty()) {
+		std::cerr << "Frame info rejected :\n" << *problems << std::endl;
+		return tiltfive::Error::kInvalidArgument;
+	}
+	std::cout << "Sending " << frameInfo.texWidth_PIX << "x" << frameInfo.texHeight_PIX << " frames at "
+			  << options.fps << " fps, IPD " << *ipd << "m" << std::endl;
+
+	MetricsRegistry localMetrics;
+	FrameMetrics metrics(options.metrics ? *options.metrics : localMetrics);
+	Tracer::instance().setThreadName("frames");
+
+	// Pose timestamps come from the service's clock. The smallest gap seen between reading a pose
+	// and its timestamp is taken as the offset between the clocks, so ages are measured from the
+	// freshest pose seen and exclude whatever latency the service always has.
+	auto start = Clock::now();
+	int64_t clockOffset = std::numeric_limits<int64_t>::max();
+	T5_GlassesPose pose = T5_GlassesPose();
+	bool havePose = false;
+	uint64_t lastTimestamp = 0;
+
+	auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.fps));
+	auto slot = start;
+	auto nextStatus = start;
+	auto rateStart = start;
+	uint64_t rateSent = 0;
+	while (slot - start < options.duration) {
+		waitFor(slot, options.spinWindow);
+		auto woke = Clock::now();
+		stats.slots++;
+		stats.wakeLateness.add(seconds(woke - slot));
+
+		{
+			T5DIAG_TRACE_SPAN("frames", "frame");
+			auto latest = glasses->getLatestGlassesPose(kT5_GlassesPoseUsage_GlassesPresentation);
+			if (latest) {
+				clockOffset = std::min(clockOffset,
+						nanosSince(start, Clock::now()) - static_cast<int64_t>(latest->timestampNanos));
+				pose = *latest;
+				havePose = true;
+			} else if (latest.error() != tiltfive::Error::kTryAgain) {
+				std::cerr << "\nError reading pose : " << latest << std::endl;
+				return latest.error();
+			}
+
+			if (havePose) {
+				if (pose.timestampNanos == lastTimestamp) {
+					stats.staleFrames++;
+				}
+				lastTimestamp = pose.timestampNanos;
+				fillFrameEyePoses(pose, *ipd, frameInfo);
+				simulateRender(options.renderTime);
+
+				auto submitStart = Clock::now();
+				auto sendResult = glasses->sendFrame(&frameInfo);
+				auto sent = Clock::now();
+				if (sendResult) {
+					stats.sent++;
+					metrics.sent.add();
+				} else {
+					stats.sendFailures++;
+					metrics.sendFailures.add();
+				}
+				double submitSeconds = seconds(sent - submitStart);
+				double frameSeconds = seconds(sent - slot);
+				double poseAge = static_cast<double>(nanosSince(start, sent) - clockOffset -
+										 static_cast<int64_t>(pose.timestampNanos)) *
+								 1e-9;
+				stats.submitLatency.add(submitSeconds);
+				stats.frameTime.add(frameSeconds);
+				stats.poseAge.add(poseAge);
+				metrics.submitSeconds.observe(submitSeconds);
+				metrics.frameSeconds.observe(frameSeconds);
+				metrics.poseAgeSeconds.observe(poseAge);
+			} else {
+				stats.noPoseSlots++;
+			}
+		}
+
+		// A frame is late once the next slot has begun; every slot already begun is skipped
+		auto now = Clock::now();
+		auto next = slot + period;
+		if (now > next) {
+			stats.missedDeadlines++;
+			metrics.missedDeadlines.add();
+			while (next <= now) {
+				next += period;
+				stats.skippedSlots++;
+				metrics.skippedSlots.add();
+			}
+		}
+		slot = next;
+
+		if (now - rateStart >= std::chrono::seconds(1)) {
+			metrics.sentRate.set(static_cast<double>(stats.sent - rateSent) / seconds(now - rateStart));
+			rateStart = now;
+			rateSent = stats.sent;
+		}
+		if (now >= nextStatus) {
+			nextStatus += kStatusInterval;
+			std::cout << "\rSent " << stats.sent << ", missed " << stats.missedDeadlines << ", submit mean "
+					  << stats.submitLatency.mean() * 1e6 << " us, pose age mean " << stats.poseAge.mean() * 1e3
+					  << " ms    " << std::flush;
+		}
+	}
+	// Up to the end of the last slot, so a whole run of on-time frames reads as exactly options.fps
+	stats.elapsed = seconds(std::max(Clock::now(), slot) - start);
+
+	printSummary(options, stats);
+	return tiltfive::kSuccess;
+}
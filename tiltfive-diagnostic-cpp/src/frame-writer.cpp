@@ -0,0 +1,173 @@
+/// \file
+/// \brief Background writing of sampled camera frames for post-mortem analysis
+
+#include "include/frame-writer.hpp"
+#include "include/trace.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+auto frameWriteReasonName(FrameWriteReason reason) -> const char * {
+	switch (reason) {
+		case FrameWriteReason::kMarkerLoss:
+			return "loss";
+		case FrameWriteReason::kError:
+			return "error";
+		default:
+			return "sample";
+	}
+}
+
+AsyncFrameWriter::AsyncFrameWriter(FrameWriterOptions options)
+	: mOptions(std::move(options)), mQueue(mOptions.queueCapacity) {
+	std::error_code error;
+	std::filesystem::create_directories(mOptions.directory, error);
+	if (error) {
+		std::cerr << "Error creating " << mOptions.directory << ": " << error.message() << std::endl;
+	}
+
+	int workers = std::max(1, mOptions.workers);
+	for (int i = 0; i < workers; i++) {
+		mWorkers.emplace_back([this]() { work(); });
+	}
+}
+
+AsyncFrameWriter::~AsyncFrameWriter() {
+	close();
+}
+
+auto AsyncFrameWriter::offer(uint64_t frameIndex, const cv::Mat &image, size_t markerCount, bool error) -> bool {
+	bool lost = (markerCount == 0) && (mPreviousMarkers > 0);
+	mPreviousMarkers = markerCount;
+	mOffered++;
+
+	if (error && mOptions.onError) {
+		return enqueue(frameIndex, image, FrameWriteReason::kError);
+	}
+	if (lost && mOptions.onMarkerLoss) {
+		return enqueue(frameIndex, image, FrameWriteReason::kMarkerLoss);
+	}
+	if ((mOptions.everyNth > 0) && ((mOffered - 1) % mOptions.everyNth == 0)) {
+		return enqueue(frameIndex, image, FrameWriteReason::kSampled);
+	}
+	return false;
+}
+
+auto AsyncFrameWriter::enqueue(uint64_t frameIndex, const cv::Mat &image, FrameWriteReason reason) -> bool {
+	if (mClosed || image.empty()) {
+		return false;
+	}
+	T5DIAG_TRACE_SPAN("frame writer", "queue frame");
+	mSubmitted++;
+
+	Job job;
+	job.frameIndex = frameIndex;
+	job.reason = reason;
+	{
+		std::lock_guard<std::mutex> lock(mFreeMtx);
+		if (!mFree.empty()) {
+			job.image = std::move(mFree.back());
+			mFree.pop_back();
+		}
+	}
+	// Reuses the recycled buffer when the size and type match
+	image.copyTo(job.image);
+
+	if (!mQueue.tryPush(job)) {
+		mDropped++;
+		std::lock_guard<std::mutex> lock(mFreeMtx);
+		mFree.push_back(std::move(job.image));
+		return false;
+	}
+	return true;
+}
+
+auto AsyncFrameWriter::work() -> void {
+	Tracer::instance().setThreadName("frame writer");
+	Job job;
+	std::vector<uint8_t> encoded;
+	while (mQueue.pop(job)) {
+		T5DIAG_TRACE_SPAN("frame writer", "write frame");
+		if (write(job, encoded)) {
+			mWritten++;
+		} else {
+			mFailed++;
+		}
+
+		std::lock_guard<std::mutex> lock(mFreeMtx);
+		if (mFree.size() < mQueue.capacity()) {
+			mFree.push_back(std::move(job.image));
+		}
+	}
+}
+
+auto AsyncFrameWriter::write(const Job &job, std::vector<uint8_t> &encoded) -> bool {
+	const char *extension = (mOptions.format == FrameFormat::kPgm) ? "pgm" : "png";
+	char name[64];
+	std::snprintf(name, sizeof(name), "frame-%08llu-%s.%s", static_cast<unsigned long long>(job.frameIndex),
+			frameWriteReasonName(job.reason), extension);
+	std::string path = (std::filesystem::path(mOptions.directory) / name).string();
+
+	if (mOptions.format == FrameFormat::kPgm) {
+		if (job.image.type() != CV_8UC1) {
+			std::cerr << "PGM output needs 8-bit grayscale frames" << std::endl;
+			return false;
+		}
+		// Only the header goes through the buffer; the rows are written straight from the image
+		std::string header = "P5\n" + std::to_string(job.image.cols) + " " + std::to_string(job.image.rows) + "\n255\n";
+		encoded.assign(header.begin(), header.end());
+	} else if (!cv::imencode(".png", job.image, encoded, { cv::IMWRITE_PNG_COMPRESSION, mOptions.pngCompression })) {
+		std::cerr << "Error encoding " << path << std::endl;
+		return false;
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cerr << "Error creating " << path << std::endl;
+		return false;
+	}
+	out.write(reinterpret_cast<const char *>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+	size_t bytes = encoded.size();
+	if (mOptions.format == FrameFormat::kPgm) {
+		size_t rowBytes = job.image.cols * job.image.elemSize();
+		for (int y = 0; y < job.image.rows; y++) {
+			out.write(reinterpret_cast<const char *>(job.image.ptr(y)), static_cast<std::streamsize>(rowBytes));
+		}
+		bytes += rowBytes * job.image.rows;
+	}
+
+	out.close();
+	if (out.fail()) {
+		std::cerr << "Error writing " << path << std::endl;
+		return false;
+	}
+	mBytes += bytes;
+	return true;
+}
+
+auto AsyncFrameWriter::close() -> void {
+	if (mClosed) {
+		return;
+	}
+	mClosed = true;
+	mQueue.close();
+	for (auto &worker : mWorkers) {
+		worker.join();
+	}
+	mWorkers.clear();
+}
+
+auto AsyncFrameWriter::stats() const -> FrameWriterStats {
+	FrameWriterStats stats;
+	stats.submitted = mSubmitted;
+	stats.written = mWritten;
+	stats.dropped = mDropped;
+	stats.failed = mFailed;
+	stats.bytes = mBytes;
+	return stats;
+}
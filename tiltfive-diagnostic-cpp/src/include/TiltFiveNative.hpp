@@ -22,10 +22,16 @@
 #include "TiltFiveNative.h"
 #include "errors.hpp"
 #include "result.hpp"
+#include "seqlock.hpp"
+#include "trace.hpp"
 
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <functional>
 #include <iomanip>
 #include <iostream>
@@ -35,6 +41,7 @@
 #include <set>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -56,9 +63,12 @@ class Client;
 class Glasses;
 class Wand;
 class WandStreamHelper;
+class PoseStreamHelper;
 class GlassesConnectionHelper;
 class ParamChangeHelper;
 class ParamChangeListener;
+class GlassesDiscoveryHelper;
+class GlassesDiscoveryListener;
 
 /// \cond DO_NOT_DOCUMENT
 /// Internal utility functions - Do not call directly
@@ -68,6 +78,9 @@ inline auto obtainWandStreamHelper(
     std::shared_ptr<Glasses> glasses,
     std::chrono::milliseconds pollTimeout = std::chrono::milliseconds(100))
     -> std::shared_ptr<WandStreamHelper>;
+inline auto obtainPoseStreamHelper(std::shared_ptr<Glasses> glasses,
+                                   std::chrono::microseconds samplePeriod,
+                                   size_t historyLength) -> std::unique_ptr<PoseStreamHelper>;
 inline auto obtainGlassesConnectionHelper(std::shared_ptr<Glasses> glasses,
                                           const std::string& displayName,
                                           std::chrono::milliseconds connectionPollInterval)
@@ -76,6 +89,10 @@ inline auto obtainParamChangeHelper(std::shared_ptr<Client> client,
                                     std::weak_ptr<ParamChangeListener> listener,
                                     std::chrono::milliseconds pollInterval)
     -> std::unique_ptr<ParamChangeHelper>;
+inline auto obtainGlassesDiscoveryHelper(std::shared_ptr<Client> client,
+                                         std::chrono::milliseconds minPollInterval,
+                                         std::chrono::milliseconds maxPollInterval)
+    -> std::unique_ptr<GlassesDiscoveryHelper>;
 /// \endcond
 
 /// \brief Client for communicating with the Tilt Five™ API
@@ -135,6 +152,7 @@ protected:
             std::shared_ptr<Client>(new Client(applicationId, applicationVersion, sdkType));
 
         // Start up the service connection
+        T5DIAG_TRACE_SPAN("t5", "t5CreateContext");
         auto err = t5CreateContext(&client->mContext, &client->mClientInfo, platformContext);
         if (err) {
             return static_cast<Error>(err);
@@ -147,6 +165,7 @@ public:
     /// \cond DO_NOT_DOCUMENT
     virtual ~Client() {
         // Release context and library
+        T5DIAG_TRACE_SPAN("t5", "t5DestroyContext");
         t5DestroyContext(&mContext);
         mContext = nullptr;
     }
@@ -172,6 +191,7 @@ public:
         // and try again.
         for (;;) {
             bufferSize    = buffer.size();
+            T5DIAG_TRACE_SPAN("t5", "t5ListGlasses");
             T5_Result err = t5ListGlasses(mContext, buffer.data(), &bufferSize);
             if (!err) {
                 break;
@@ -208,6 +228,7 @@ public:
     auto getServiceVersion() -> Result<std::string> {
         std::unique_ptr<char[]> value(new char[T5_MAX_STRING_PARAM_LEN]);
         size_t size = T5_MAX_STRING_PARAM_LEN;
+        T5DIAG_TRACE_SPAN("t5", "t5GetSystemUtf8Param");
         T5_Result err =
             t5GetSystemUtf8Param(mContext, kT5_ParamSys_UTF8_Service_Version, value.get(), &size);
         if (!err) {
@@ -229,6 +250,7 @@ public:
         std::vector<T5_ParamSys> changedParamsBuffer(changedParamsCount);
 
         changedParamsBuffer.resize(changedParamsCount);
+        T5DIAG_TRACE_SPAN("t5", "t5GetChangedSystemParams");
         T5_Result err =
             t5GetChangedSystemParams(mContext, changedParamsBuffer.data(), &changedParamsCount);
 
@@ -261,6 +283,7 @@ public:
     auto isTiltFiveUiRequestingAttention() -> Result<bool> {
         int64_t value = 0;
 
+        T5DIAG_TRACE_SPAN("t5", "t5GetSystemIntegerParam");
         T5_Result err =
             t5GetSystemIntegerParam(mContext, kT5_ParamSys_Integer_CPL_AttRequired, &value);
         if (!err) {
@@ -279,6 +302,7 @@ public:
     auto getGameboardSize(T5_GameboardType type) -> Result<T5_GameboardSize> {
         T5_GameboardSize size;
 
+        T5DIAG_TRACE_SPAN("t5", "t5GetGameboardSize");
         T5_Result err = t5GetGameboardSize(mContext, type, &size);
         if (!err) {
             return size;
@@ -301,6 +325,22 @@ public:
 
         return obtainParamChangeHelper(shared_from_this(), std::move(listener), pollInterval);
     }
+
+    /// \brief Create a GlassesDiscoveryHelper
+    ///
+    /// The helper watches listGlasses() on a background thread, backing off while nothing changes
+    /// and polling at \p minPollInterval while a caller is blocked waiting for glasses.
+    ///
+    /// \param[in]  minPollInterval - Polling interval used while waiting or after a change
+    /// \param[in]  maxPollInterval - Upper bound for the backed-off polling interval
+    /// \return A std::unique_ptr to a GlassesDiscoveryHelper
+    [[nodiscard]] auto createGlassesDiscoveryHelper(
+        std::chrono::milliseconds minPollInterval = std::chrono::milliseconds(5),
+        std::chrono::milliseconds maxPollInterval = std::chrono::milliseconds(500))
+        -> std::unique_ptr<GlassesDiscoveryHelper> {
+
+        return obtainGlassesDiscoveryHelper(shared_from_this(), minPollInterval, maxPollInterval);
+    }
 };
 
 /// Represents the exclusivity connection state of glasses
@@ -330,6 +370,61 @@ protected:
     std::weak_ptr<WandStreamHelper> mWandStreamHelper{};
     T5_Glasses mGlasses{};
 
+    /// Arguments of a t5GetProjection() call, identifying a cached result
+    struct ProjectionKey {
+        T5_CartesianCoordinateHandedness handedness;
+        T5_DepthRange depthRange;
+        T5_MatrixOrder matrixOrder;
+        double nearPlane;
+        double farPlane;
+        double worldScale;
+
+        auto operator==(const ProjectionKey& other) const -> bool {
+            return (handedness == other.handedness) && (depthRange == other.depthRange) &&
+                   (matrixOrder == other.matrixOrder) && (nearPlane == other.nearPlane) &&
+                   (farPlane == other.farPlane) && (worldScale == other.worldScale);
+        }
+    };
+
+    struct ProjectionKeyHash {
+        auto operator()(const ProjectionKey& key) const -> size_t {
+            size_t hash = 0;
+            auto combine = [&hash](size_t value) {
+                hash ^= value + static_cast<size_t>(0x9e3779b97f4a7c15ULL) + (hash << 6) + (hash >> 2);
+            };
+            combine(std::hash<int>{}(key.handedness));
+            combine(std::hash<int>{}(key.depthRange));
+            combine(std::hash<int>{}(key.matrixOrder));
+            // The bits of the planes mix well enough and cost far less than std::hash<double>
+            for (double value : {key.nearPlane, key.farPlane, key.worldScale}) {
+                uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                combine(static_cast<size_t>(bits ^ (bits >> 32)));
+            }
+            return hash;
+        }
+    };
+
+    // Renderers use a handful of projections; anything beyond this is most likely a varying
+    // clip plane, and starting over keeps the cache from growing without bound
+    static constexpr size_t kMaxCachedProjections = 16;
+
+    std::mutex mProjectionCacheMtx;
+    std::unordered_map<ProjectionKey, T5_ProjectionInfo, ProjectionKeyHash> mProjectionCache;
+    uint64_t mProjectionGeneration{0};
+
+    /// Number of ParamChangeHelpers tracking these glasses; nothing is cached without one
+    std::atomic<int> mProjectionWatchers{0};
+
+    auto addProjectionWatcher() -> void {
+        mProjectionWatchers.fetch_add(1);
+    }
+
+    auto removeProjectionWatcher() -> void {
+        mProjectionWatchers.fetch_sub(1);
+        invalidateProjectionCache();
+    }
+
     friend std::ostream& operator<<(std::ostream& os, std::shared_ptr<Glasses> const& instance) {
         os << *instance;
         return os;
@@ -354,6 +449,7 @@ protected:
         }
 
         T5_Glasses handle;
+        T5DIAG_TRACE_SPAN("t5", "t5CreateGlasses");
         T5_Result err = t5CreateGlasses(client->mContext, identifier.c_str(), &handle);
 
         if (err) {
@@ -396,6 +492,7 @@ public:
     /// \return ConnectionState representing the current connection state.
     auto getConnectionState() -> Result<ConnectionState> {
         T5_ConnectionState connectionState;
+        T5DIAG_TRACE_SPAN("t5", "t5GetGlassesConnectionState");
         T5_Result err = t5GetGlassesConnectionState(mGlasses, &connectionState);
         if (err != T5_SUCCESS) {
             return static_cast<Error>(err);
@@ -431,6 +528,7 @@ public:
         std::vector<T5_ParamGlasses> changedParamsBuffer(changedParamsCount);
 
         changedParamsBuffer.resize(changedParamsCount);
+        T5DIAG_TRACE_SPAN("t5", "t5GetChangedGlassesParams");
         T5_Result err =
             t5GetChangedGlassesParams(mGlasses, changedParamsBuffer.data(), &changedParamsCount);
 
@@ -458,6 +556,7 @@ public:
     /// \return Current IPD in meters.
     auto getIpd() -> Result<double> {
         double value  = 0;
+        T5DIAG_TRACE_SPAN("t5", "t5GetGlassesFloatParam");
         T5_Result err = t5GetGlassesFloatParam(mGlasses, 0, kT5_ParamGlasses_Float_IPD, &value);
         if (!err) {
             return value;
@@ -466,6 +565,73 @@ public:
         }
     }
 
+    /// \brief Get the projection for rendering to these glasses
+    ///
+    /// The projection only changes with the IPD, so while these glasses are registered with a
+    /// ParamChangeHelper, which drops the cached projections when the IPD changes, each distinct set
+    /// of arguments reaches the service once and later calls are a hash map lookup. Unregistered
+    /// glasses ask the service every time, as nothing would notice the IPD changing.
+    ///
+    /// The helper only sees an IPD change when it next polls, so for up to one poll interval after
+    /// the change this can still return the projection for the old IPD.
+    ///
+    /// \param[in] handedness  - ::T5_CartesianCoordinateHandedness of the view space.
+    /// \param[in] depthRange  - ::T5_DepthRange of the clip space Z.
+    /// \param[in] matrixOrder - ::T5_MatrixOrder of the returned matrix.
+    /// \param[in] nearPlane   - The near clipping plane in view space.
+    /// \param[in] farPlane    - The far clipping plane in view space.
+    /// \param[in] worldScale  - Conversion factor between world space and real-world units.
+    ///
+    /// \return ::T5_ProjectionInfo for the given arguments.
+    auto getProjection(T5_CartesianCoordinateHandedness handedness,
+                       T5_DepthRange depthRange,
+                       T5_MatrixOrder matrixOrder,
+                       double nearPlane,
+                       double farPlane,
+                       double worldScale) -> Result<T5_ProjectionInfo> {
+
+        const ProjectionKey key{handedness, depthRange, matrixOrder, nearPlane, farPlane, worldScale};
+        const bool cacheable = mProjectionWatchers.load() > 0;
+        uint64_t generation  = 0;
+        if (cacheable) {
+            std::lock_guard<std::mutex> lock(mProjectionCacheMtx);
+            auto cached = mProjectionCache.find(key);
+            if (cached != mProjectionCache.end()) {
+                return cached->second;
+            }
+            generation = mProjectionGeneration;
+        }
+
+        T5_ProjectionInfo info;
+        T5DIAG_TRACE_SPAN("t5", "t5GetProjection");
+        T5_Result err = t5GetProjection(
+            mGlasses, handedness, depthRange, matrixOrder, nearPlane, farPlane, worldScale, &info);
+        if (err) {
+            return static_cast<Error>(err);
+        }
+
+        if (cacheable) {
+            std::lock_guard<std::mutex> lock(mProjectionCacheMtx);
+            // Don't cache a result the IPD may have changed under while the service was asked
+            if (generation == mProjectionGeneration) {
+                if (mProjectionCache.size() >= kMaxCachedProjections) {
+                    mProjectionCache.clear();
+                }
+                mProjectionCache.emplace(key, info);
+            }
+        }
+        return info;
+    }
+
+    /// \brief Drop every projection cached by getProjection()
+    ///
+    /// ParamChangeHelper calls this when the IPD changes.
+    auto invalidateProjectionCache() -> void {
+        std::lock_guard<std::mutex> lock(mProjectionCacheMtx);
+        mProjectionCache.clear();
+        mProjectionGeneration++;
+    }
+
     /// \brief Get the user-facing name of the glasses
     ///
     /// The value of the friendly name is user specified in the Tilt Five™ UI.
@@ -477,6 +643,7 @@ public:
     auto getFriendlyName() -> Result<std::string> {
         std::unique_ptr<char[]> value(new char[T5_MAX_STRING_PARAM_LEN]);
         size_t size   = T5_MAX_STRING_PARAM_LEN;
+        T5DIAG_TRACE_SPAN("t5", "t5GetGlassesUtf8Param");
         T5_Result err = t5GetGlassesUtf8Param(
             mGlasses, 0, kT5_ParamGlasses_UTF8_FriendlyName, value.get(), &size);
         if (!err) {
@@ -507,6 +674,7 @@ public:
     /// \param[in] displayName - string to display for this program in control panel (localized),
     ///                          e.g. "Awesome Game (Player 1)"
     auto reserve(const std::string& displayName) -> Result<void> {
+        T5DIAG_TRACE_SPAN("t5", "t5ReserveGlasses");
         T5_Result err = t5ReserveGlasses(mGlasses, displayName.c_str());
         if (!err) {
             return kSuccess;
@@ -530,6 +698,7 @@ public:
     ///
     /// \return Result indicating success or error.
     auto ensureReady() -> Result<void> {
+        T5DIAG_TRACE_SPAN("t5", "t5EnsureGlassesReady");
         T5_Result err = t5EnsureGlassesReady(mGlasses);
         if (!err) {
             return kSuccess;
@@ -546,6 +715,7 @@ public:
     ///
     /// \return Result indicating success or error.
     auto release() -> Result<void> {
+        T5DIAG_TRACE_SPAN("t5", "t5ReleaseGlasses");
         T5_Result err = t5ReleaseGlasses(mGlasses);
         if (!err) {
             return kSuccess;
@@ -561,6 +731,7 @@ public:
     /// \return ::T5_GlassesPose representing the most recent pose.
     auto getLatestGlassesPose(T5_GlassesPoseUsage usage) -> Result<T5_GlassesPose> {
         T5_GlassesPose pose;
+        T5DIAG_TRACE_SPAN("t5", "t5GetGlassesPose");
         T5_Result err = t5GetGlassesPose(mGlasses, usage, &pose);
 
         if (!err) {
@@ -575,6 +746,7 @@ public:
     /// \param[in] graphicsApi     - ::T5_GraphicsApi specifying the graphics API for the glasses.
     /// \param[in] graphicsContext - Meaning depends on the graphics API in use.
     auto initGraphicsContext(T5_GraphicsApi graphicsApi, void* graphicsContext) -> Result<void> {
+        T5DIAG_TRACE_SPAN("t5", "t5InitGlassesGraphicsContext");
         T5_Result err = t5InitGlassesGraphicsContext(mGlasses, graphicsApi, graphicsContext);
         if (!err) {
             return kSuccess;
@@ -586,6 +758,7 @@ public:
     ///
     /// \param[in]  config  - ::T5_CameraStreamConfig filled by client to detail configuration
     auto configureCameraStream(T5_CameraStreamConfig config) -> Result<void> {
+        T5DIAG_TRACE_SPAN("t5", "t5ConfigureCameraStreamForGlasses");
         T5_Result err = t5ConfigureCameraStreamForGlasses(mGlasses, config);
         if (!err) {
             return kSuccess;
@@ -599,9 +772,10 @@ public:
     /// \return ::T5_CamImage representing the most recent tt image.
     auto getFilledCamImageBuffer() -> Result<T5_CamImage> {
         T5_CamImage img;
+        T5DIAG_TRACE_SPAN("t5", "t5GetFilledCamImageBuffer");
         T5_Result err = t5GetFilledCamImageBuffer(mGlasses, &img);
         if (!err) {
-            return std::move(img);
+            return img;
         } else {
             return static_cast<Error>(err);
         }
@@ -611,6 +785,7 @@ public:
     //
     /// \param[in] imgBuffer - ::T5_CamImage representing the buffer to be filled.
     auto submitEmptyCamImageBuffer(T5_CamImage* imgBuffer) -> Result<void> {
+        T5DIAG_TRACE_SPAN("t5", "t5SubmitEmptyCamImageBuffer");
         T5_Result err = t5SubmitEmptyCamImageBuffer(mGlasses, imgBuffer);
         if (!err) {
             return kSuccess;
@@ -624,6 +799,7 @@ public:
     /// \param[in] buffer - A pointer to the buffer to be canceled and released from use by the
     /// service.
     auto cancelCamImageBuffer(uint8_t* buffer) -> Result<void> {
+        T5DIAG_TRACE_SPAN("t5", "t5CancelCamImageBuffer");
         T5_Result err = t5CancelCamImageBuffer(mGlasses, buffer);
         if (!err) {
             return kSuccess;
@@ -636,6 +812,7 @@ public:
     ///
     /// \param[in] frameInfo - ::T5_FrameInfo detailing the frame to display.
     auto sendFrame(const T5_FrameInfo* const frameInfo) -> Result<void> {
+        T5DIAG_TRACE_SPAN("t5", "t5SendFrameToGlasses");
         T5_Result err = t5SendFrameToGlasses(mGlasses, frameInfo);
         if (!err) {
             return kSuccess;
@@ -644,12 +821,40 @@ public:
         }
     }
 
+    /// \brief Check a frame for problems the service would reject it for, without sending it
+    ///
+    /// Not needed every frame; the parameters checked rarely change between frames.
+    ///
+    /// \param[in] frameInfo - ::T5_FrameInfo detailing the frame that would be sent.
+    ///
+    /// \return An empty string if the frame is likely valid, else a description of its problems.
+    auto validateFrameInfo(const T5_FrameInfo* const frameInfo) -> Result<std::string> {
+        std::vector<char> detail(T5_MAX_STRING_PARAM_LEN);
+        for (;;) {
+            size_t size   = detail.size();
+            T5DIAG_TRACE_SPAN("t5", "t5ValidateFrameInfo");
+            T5_Result err = t5ValidateFrameInfo(mGlasses, frameInfo, detail.data(), &size);
+            if (err == T5_ERROR_OVERFLOW) {
+                detail.resize(std::max(size, detail.size() * 2));
+                continue;
+            }
+            detail.back() = '\0';
+
+            // Problems with the frame come back as an error alongside their description
+            if (!err || detail.front()) {
+                return std::string(detail.data());
+            }
+            return static_cast<Error>(err);
+        }
+    }
+
     /// \brief Send a Haptic Impulse to a wand
     ///
     /// \param[in]  handle - A handle for the desired wand to receive an impulse.
     /// \param[in]  amplitude - The amplitude of the impulse, between [0.0 and 1.0].
     /// \param[in]  duration - The duration of the impulse, between 0 and 320ms.
     auto sendImpulse(T5_WandHandle handle, float amplitude, uint16_t duration) -> Result<void> {
+        T5DIAG_TRACE_SPAN("t5", "t5SendImpulse");
         T5_Result err = t5SendImpulse(mGlasses, handle, amplitude, duration);
         if (!err) {
             return kSuccess;
@@ -667,6 +872,7 @@ public:
 
         for (;;) {
             wandBuffer.resize(wandCount);
+            T5DIAG_TRACE_SPAN("t5", "t5ListWandsForGlasses");
             T5_Result err = t5ListWandsForGlasses(mGlasses, wandBuffer.data(), &wandCount);
 
             if (!err) {
@@ -693,6 +899,7 @@ public:
     ///
     /// \param[in]  config  - ::T5_WandStreamConfig filled by client to detail configuration
     auto configureWandStream(const T5_WandStreamConfig* const config) -> Result<void> {
+        T5DIAG_TRACE_SPAN("t5", "t5ConfigureWandStreamForGlasses");
         T5_Result err = t5ConfigureWandStreamForGlasses(mGlasses, config);
         if (!err) {
             return kSuccess;
@@ -719,6 +926,7 @@ public:
         -> Result<T5_WandStreamEvent> {
         T5_WandStreamEvent event;
 
+        T5DIAG_TRACE_SPAN("t5", "t5ReadWandStreamForGlasses");
         T5_Result err = t5ReadWandStreamForGlasses(mGlasses, &event, timeout.count());
         if (!err) {
             return event;
@@ -741,6 +949,21 @@ public:
         return wandStreamHelper;
     }
 
+    /// \brief Create a PoseStreamHelper
+    ///
+    /// The glasses must already be exclusively connected; the helper takes over calling
+    /// getLatestGlassesPose() for both ::T5_GlassesPoseUsage values.
+    ///
+    /// \param[in]  samplePeriod  - Period between pose samples.
+    /// \param[in]  historyLength - Distinct poses kept per usage for interpolation.
+    /// \return A std::unique_ptr to a PoseStreamHelper
+    auto createPoseStreamHelper(
+        std::chrono::microseconds samplePeriod = std::chrono::microseconds(2000),
+        size_t historyLength                   = 64) -> std::unique_ptr<PoseStreamHelper> {
+
+        return obtainPoseStreamHelper(shared_from_this(), samplePeriod, historyLength);
+    }
+
     /// \brief Create a GlassesConnectionHelper
     ///
     /// \ref UsingGlassesConnectionHelper
@@ -766,6 +989,7 @@ public:
         }
 
         if (mGlasses) {
+            T5DIAG_TRACE_SPAN("t5", "t5DestroyGlasses");
             t5DestroyGlasses(&mGlasses);
             mGlasses = nullptr;
         }
@@ -795,6 +1019,8 @@ private:
     }
 
     void threadMain() {
+        Tracer::instance().setThreadName("GlassesConnectionHelper");
+
         while (mRunning) {
             auto connectionState = mGlasses->getConnectionState();
             if (!connectionState) {
@@ -967,6 +1193,7 @@ private:
                 return result.error();
             }
 
+            T5DIAG_TRACE_SPAN("helper", "wand event");
             std::lock_guard<std::mutex> lock{mLastWandReportsMtx};
 
             // Process the event
@@ -1022,6 +1249,8 @@ private:
     }
 
     void threadMain() {
+        Tracer::instance().setThreadName("WandStreamHelper");
+
         T5_WandStreamConfig streamConfig{true};
         bool configured = false;
 
@@ -1155,6 +1384,210 @@ public:
     /// \endcond
 };
 
+/// \brief Utility class to sample glasses poses in the background
+///
+/// Polls the pose for both ::kT5_GlassesPoseUsage_GlassesPresentation and
+/// ::kT5_GlassesPoseUsage_SpectatorPresentation from its own thread at a fixed period, so that
+/// render loops read the latest pose from memory instead of waiting on the service. The latest
+/// pose is published through a SeqLock, so reads from any thread never wait on the sampling
+/// thread's writes; they cost about as much as an uncontended mutex either way. A short
+/// history of distinct poses is kept for interpolating to a given timestamp.
+class PoseStreamHelper {
+private:
+    static constexpr size_t kUsageCount = 2;
+
+    struct LatestPose {
+        T5_GlassesPose pose;
+        T5_Result result;  // of the last sample; pose holds the last successful one
+        uint32_t sampled;  // 0 until the first sample
+    };
+
+    const std::shared_ptr<Glasses> mGlasses;
+    const std::chrono::microseconds mSamplePeriod;
+    const size_t mHistoryLength;
+
+    SeqLock<LatestPose> mLatest[kUsageCount];
+
+    std::mutex mHistoryMtx;  // guards access to mHistory
+    std::deque<T5_GlassesPose> mHistory[kUsageCount];
+
+    std::atomic<bool> mRunning{true};
+    std::thread mThread;
+
+    static auto usageIndex(T5_GlassesPoseUsage usage) -> size_t {
+        return (usage == kT5_GlassesPoseUsage_SpectatorPresentation) ? 1 : 0;
+    }
+
+    static auto usageOf(size_t index) -> T5_GlassesPoseUsage {
+        return (index == 1) ? kT5_GlassesPoseUsage_SpectatorPresentation
+                            : kT5_GlassesPoseUsage_GlassesPresentation;
+    }
+
+    auto sample(size_t index) -> void {
+        auto pose = mGlasses->getLatestGlassesPose(usageOf(index));
+
+        LatestPose latest = mLatest[index].load();
+        latest.sampled    = 1;
+        if (!pose) {
+            latest.result = static_cast<T5_Result>(pose.error().value());
+            mLatest[index].store(latest);
+            return;
+        }
+        latest.pose   = *pose;
+        latest.result = T5_SUCCESS;
+        mLatest[index].store(latest);
+
+        // Sampling faster than the service updates returns the same pose again; keep it once
+        std::lock_guard<std::mutex> lock{mHistoryMtx};
+        auto& history = mHistory[index];
+        if (history.empty() || (pose->timestampNanos > history.back().timestampNanos)) {
+            history.push_back(*pose);
+            while (history.size() > mHistoryLength) {
+                history.pop_front();
+            }
+        }
+    }
+
+    void threadMain() {
+        Tracer::instance().setThreadName("PoseStreamHelper");
+
+        auto next = std::chrono::steady_clock::now();
+        while (mRunning) {
+            {
+                T5DIAG_TRACE_SPAN("helper", "pose sample");
+                for (size_t index = 0; index < kUsageCount; index++) {
+                    sample(index);
+                }
+            }
+
+            // After falling behind, carry on from now rather than sampling in a burst
+            next += mSamplePeriod;
+            auto now = std::chrono::steady_clock::now();
+            if (next < now) {
+                next = now;
+            }
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    static auto interpolate(const T5_GlassesPose& a, const T5_GlassesPose& b, uint64_t timestampNanos)
+        -> T5_GlassesPose {
+        float t = static_cast<float>(static_cast<double>(timestampNanos - a.timestampNanos) /
+                                     static_cast<double>(b.timestampNanos - a.timestampNanos));
+
+        T5_GlassesPose pose;
+        pose.timestampNanos = timestampNanos;
+        pose.gameboardType  = (t < 0.5f) ? a.gameboardType : b.gameboardType;
+        pose.posGLS_GBD.x   = a.posGLS_GBD.x + (b.posGLS_GBD.x - a.posGLS_GBD.x) * t;
+        pose.posGLS_GBD.y   = a.posGLS_GBD.y + (b.posGLS_GBD.y - a.posGLS_GBD.y) * t;
+        pose.posGLS_GBD.z   = a.posGLS_GBD.z + (b.posGLS_GBD.z - a.posGLS_GBD.z) * t;
+
+        // Normalized lerp along the shorter arc; poses this close together make slerp unnecessary
+        const T5_Quat& qa = a.rotToGLS_GBD;
+        T5_Quat qb        = b.rotToGLS_GBD;
+        if ((qa.w * qb.w + qa.x * qb.x + qa.y * qb.y + qa.z * qb.z) < 0.0f) {
+            qb = {-qb.w, -qb.x, -qb.y, -qb.z};
+        }
+        T5_Quat q = {qa.w + (qb.w - qa.w) * t,
+                     qa.x + (qb.x - qa.x) * t,
+                     qa.y + (qb.y - qa.y) * t,
+                     qa.z + (qb.z - qa.z) * t};
+        float norm = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+        if (norm > 0.0f) {
+            q = {q.w / norm, q.x / norm, q.y / norm, q.z / norm};
+        }
+        pose.rotToGLS_GBD = q;
+        return pose;
+    }
+
+    friend inline auto obtainPoseStreamHelper(std::shared_ptr<Glasses> glasses,
+                                              std::chrono::microseconds samplePeriod,
+                                              size_t historyLength)
+        -> std::unique_ptr<PoseStreamHelper>;
+
+    PoseStreamHelper(std::shared_ptr<Glasses> glasses,
+                     std::chrono::microseconds samplePeriod,
+                     size_t historyLength)
+        : mGlasses(std::move(glasses))
+        , mSamplePeriod(samplePeriod)
+        , mHistoryLength(std::max<size_t>(historyLength, 2)) {
+
+        mThread = std::thread(&PoseStreamHelper::threadMain, this);
+    }
+
+public:
+    /// \brief Get the most recently sampled pose
+    ///
+    /// Lock-free and safe from any thread.
+    ///
+    /// \param[in] usage ::T5_GlassesPoseUsage indicating the intended use for the glasses pose.
+    ///
+    /// \return The pose, the error of the last sample (e.g. Error::kTryAgain while the gameboard
+    /// isn't visible), or Error::kUnavailable before the first sample.
+    auto getLatestPose(T5_GlassesPoseUsage usage) const -> Result<T5_GlassesPose> {
+        LatestPose latest = mLatest[usageIndex(usage)].load();
+        if (!latest.sampled) {
+            return Error::kUnavailable;
+        }
+        if (latest.result != T5_SUCCESS) {
+            return static_cast<Error>(latest.result);
+        }
+        return latest.pose;
+    }
+
+    /// \brief Get the pose at a timestamp, interpolated between the two samples around it
+    ///
+    /// Position is interpolated linearly and rotation by normalized lerp. Timestamps after the
+    /// newest sample return the newest pose unchanged; nothing is extrapolated.
+    ///
+    /// \param[in] usage          ::T5_GlassesPoseUsage indicating the intended use for the pose.
+    /// \param[in] timestampNanos Time in the same clock as ::T5_GlassesPose::timestampNanos.
+    ///
+    /// \return The pose, Error::kUnavailable if no pose was sampled yet, or
+    /// Error::kTargetNotFound if the timestamp is older than the history.
+    auto getPoseAt(T5_GlassesPoseUsage usage, uint64_t timestampNanos) -> Result<T5_GlassesPose> {
+        std::lock_guard<std::mutex> lock{mHistoryMtx};
+        const auto& history = mHistory[usageIndex(usage)];
+        if (history.empty()) {
+            return Error::kUnavailable;
+        }
+        if (timestampNanos >= history.back().timestampNanos) {
+            return history.back();
+        }
+        if (timestampNanos < history.front().timestampNanos) {
+            return Error::kTargetNotFound;
+        }
+
+        auto after = std::upper_bound(
+            history.begin(),
+            history.end(),
+            timestampNanos,
+            [](uint64_t t, const T5_GlassesPose& pose) { return t < pose.timestampNanos; });
+        return interpolate(*(after - 1), *after, timestampNanos);
+    }
+
+    /// \brief Get the distinct poses sampled recently, oldest first
+    auto getPoseHistory(T5_GlassesPoseUsage usage) -> std::vector<T5_GlassesPose> {
+        std::lock_guard<std::mutex> lock{mHistoryMtx};
+        const auto& history = mHistory[usageIndex(usage)];
+        return {history.begin(), history.end()};
+    }
+
+    /// \brief Number of samples taken so far for a usage, including failed ones
+    [[nodiscard]] auto sampleCount(T5_GlassesPoseUsage usage) const -> uint64_t {
+        return mLatest[usageIndex(usage)].version();
+    }
+
+    /// \cond DO_NOT_DOCUMENT
+    virtual ~PoseStreamHelper() {
+        mRunning = false;
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+    /// \endcond
+};
+
 /// \brief Virtual base class for use with tiltfive::ParamChangeHelper
 class ParamChangeListener {
 public:
@@ -1183,6 +1616,7 @@ private:
 
     std::mutex mRegisteredGlassesMtx;
     std::set<std::shared_ptr<Glasses>> mRegisteredGlasses;
+    bool mWatchingProjections = true;  // registered glasses cache projections while polling runs
 
     std::vector<T5_ParamSys> mChangedSysParams;
     std::vector<T5_ParamGlasses> mChangedGlassesParams;
@@ -1229,12 +1663,21 @@ private:
         mChangedGlassesParams.resize(kDefaultSettingBufferSize);
         for (;;) {
             changeCount   = mChangedGlassesParams.size();
+            T5DIAG_TRACE_SPAN("t5", "t5GetChangedGlassesParams");
             T5_Result err = t5GetChangedGlassesParams(
                 glasses->mGlasses, mChangedGlassesParams.data(), &changeCount);
 
             if (!err) {
                 if (changeCount > 0) {
                     mChangedGlassesParams.resize(changeCount);
+
+                    // Before the listener runs, so it sees the new projection if it asks
+                    if (std::find(mChangedGlassesParams.begin(),
+                                  mChangedGlassesParams.end(),
+                                  kT5_ParamGlasses_Float_IPD) != mChangedGlassesParams.end()) {
+                        glasses->invalidateProjectionCache();
+                    }
+
                     listener->onGlassesParamChanged(glasses, mChangedGlassesParams);
                 }
                 break;
@@ -1242,7 +1685,7 @@ private:
 
             // Error - increase buffer if we overflowed, or record the error and exit
             if (err == T5_ERROR_OVERFLOW) {
-                mChangedSysParams.resize(mChangedSysParams.size() * 2);
+                mChangedGlassesParams.resize(mChangedGlassesParams.size() * 2);
                 continue;
             }
 
@@ -1257,6 +1700,7 @@ private:
         mChangedSysParams.resize(kDefaultSettingBufferSize);
         for (;;) {
             changeCount = mChangedSysParams.size();
+            T5DIAG_TRACE_SPAN("t5", "t5GetChangedSystemParams");
             T5_Result err =
                 t5GetChangedSystemParams(mClient->mContext, mChangedSysParams.data(), &changeCount);
 
@@ -1280,6 +1724,8 @@ private:
     }
 
     auto threadMain() -> void {
+        Tracer::instance().setThreadName("ParamChangeHelper");
+
         while (mRunning) {
             // Listener weak_ptr -> shared_ptr or exit
             {
@@ -1295,6 +1741,13 @@ private:
 
             std::this_thread::sleep_for(mPollInterval);
         }
+
+        // Nothing will notice the IPD changing from here on, so the glasses must stop caching
+        std::lock_guard<std::mutex> lock(mRegisteredGlassesMtx);
+        for (const auto& glasses : mRegisteredGlasses) {
+            glasses->removeProjectionWatcher();
+        }
+        mWatchingProjections = false;
     }
 
 public:
@@ -1320,15 +1773,314 @@ public:
     }
 
     /// \brief Register glasses for parameter change tracking
+    ///
+    /// This also lets Glasses::getProjection() cache projections for the glasses until the helper
+    /// stops polling, when it is destroyed or its listener is.
     auto registerGlasses(const std::shared_ptr<Glasses>& glasses) -> void {
         std::lock_guard<std::mutex> lock(mRegisteredGlassesMtx);
-        mRegisteredGlasses.insert(glasses);
+        if (mRegisteredGlasses.insert(glasses).second && mWatchingProjections) {
+            glasses->addProjectionWatcher();
+        }
     }
 
     /// \brief De-register glasses for parameter change tracking
     auto deregisterGlasses(const std::shared_ptr<Glasses>& glasses) -> void {
         std::lock_guard<std::mutex> lock(mRegisteredGlassesMtx);
-        mRegisteredGlasses.erase(glasses);
+        if (mRegisteredGlasses.erase(glasses) && mWatchingProjections) {
+            glasses->removeProjectionWatcher();
+        }
+    }
+};
+
+/// \brief Virtual base class for use with tiltfive::GlassesDiscoveryHelper
+class GlassesDiscoveryListener {
+public:
+    /// \brief Called by a tiltfive::GlassesDiscoveryHelper when glasses appear in listGlasses()
+    virtual auto onGlassesAdded(const std::string& identifier) -> void = 0;
+
+    /// \brief Called by a tiltfive::GlassesDiscoveryHelper when glasses disappear from
+    /// listGlasses()
+    virtual auto onGlassesRemoved(const std::string& identifier) -> void = 0;
+
+    /// \cond DO_NOT_DOCUMENT
+    virtual ~GlassesDiscoveryListener() = default;
+    /// \endcond
+};
+
+/// \brief Utility class to track glasses appearing and disappearing
+///
+/// Polls Client::listGlasses() on a background thread. While the list is stable the polling
+/// interval doubles up to the configured maximum; it drops back to the minimum whenever the list
+/// changes or a caller blocks in awaitGlasses(), so waiting callers are woken as soon as the
+/// service reports the glasses rather than on the next fixed sleep.
+class GlassesDiscoveryHelper {
+private:
+    const std::shared_ptr<Client> mClient;
+    const std::chrono::milliseconds mMinPollInterval;
+    const std::chrono::milliseconds mMaxPollInterval;
+
+    std::mutex mStateMtx;  // guards the state below, mPollCv and mChangedCv
+    std::condition_variable mPollCv;
+    std::condition_variable mChangedCv;
+    std::vector<std::string> mKnownGlasses;
+    std::error_code mLastPollError{};
+    int mWaiterCount{0};
+    bool mWakeRequested{false};
+    bool mRunning{true};
+
+    std::mutex mListenersMtx;  // guards access to mListeners
+    std::vector<std::weak_ptr<GlassesDiscoveryListener>> mListeners;
+
+    // Held while a change to the known glasses is worked out and delivered, and while a new
+    // listener is registered and sent the glasses already known, so each listener sees every
+    // change exactly once and in order. Recursive so listeners can subscribe from a callback.
+    std::recursive_mutex mNotifyMtx;
+
+    std::thread mThread;
+
+    std::mutex mLastAsyncErrorMtx;
+    std::atomic<std::error_code> mLastAsyncError{};
+
+    void setLastAsyncError(std::error_code err) {
+        std::lock_guard<std::mutex> lock(mLastAsyncErrorMtx);
+        mLastAsyncError = err;
+    }
+
+    // Lock all live listeners, dropping any that have expired.
+    auto lockListeners() -> std::vector<std::shared_ptr<GlassesDiscoveryListener>> {
+        std::lock_guard<std::mutex> lock(mListenersMtx);
+
+        std::vector<std::shared_ptr<GlassesDiscoveryListener>> listeners;
+        auto it = mListeners.begin();
+        while (it != mListeners.end()) {
+            auto listener = it->lock();
+            if (listener) {
+                listeners.push_back(std::move(listener));
+                ++it;
+            } else {
+                it = mListeners.erase(it);
+            }
+        }
+        return listeners;
+    }
+
+    // Replace the known glasses list, returning true if it changed. Listeners are notified
+    // without the state lock held so they're free to call back into the helper.
+    auto updateKnownGlasses(std::vector<std::string> glassesList) -> bool {
+        std::lock_guard<std::recursive_mutex> notifyLock(mNotifyMtx);
+        std::vector<std::string> added;
+        std::vector<std::string> removed;
+        {
+            std::lock_guard<std::mutex> lock(mStateMtx);
+
+            for (const auto& id : glassesList) {
+                if (std::find(mKnownGlasses.cbegin(), mKnownGlasses.cend(), id) ==
+                    mKnownGlasses.cend()) {
+                    added.push_back(id);
+                }
+            }
+            for (const auto& id : mKnownGlasses) {
+                if (std::find(glassesList.cbegin(), glassesList.cend(), id) ==
+                    glassesList.cend()) {
+                    removed.push_back(id);
+                }
+            }
+
+            mKnownGlasses = std::move(glassesList);
+            mLastPollError = {};
+        }
+
+        if (added.empty() && removed.empty()) {
+            return false;
+        }
+        mChangedCv.notify_all();
+
+        for (const auto& listener : lockListeners()) {
+            for (const auto& id : removed) {
+                listener->onGlassesRemoved(id);
+            }
+            for (const auto& id : added) {
+                listener->onGlassesAdded(id);
+            }
+        }
+        return true;
+    }
+
+    void threadMain() {
+        Tracer::instance().setThreadName("GlassesDiscoveryHelper");
+
+        auto pollInterval = mMinPollInterval;
+
+        for (;;) {
+            bool changed = false;
+
+            auto glassesList = mClient->listGlasses();
+            if (glassesList) {
+                changed = updateKnownGlasses(std::move(*glassesList));
+            } else {
+                // 'No service' just means we keep waiting; anything else is reported to
+                // waiting callers as well as recorded.
+                if (glassesList.error() != Error::kNoService) {
+                    setLastAsyncError(glassesList.error());
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mStateMtx);
+                    mLastPollError = glassesList.error();
+                }
+                mChangedCv.notify_all();
+            }
+
+            std::unique_lock<std::mutex> lock(mStateMtx);
+
+            // Adaptive backoff - poll quickly while someone is waiting or the list is changing,
+            // otherwise double the interval up to the maximum.
+            if (changed || (mWaiterCount > 0)) {
+                pollInterval = mMinPollInterval;
+            } else {
+                pollInterval = std::min(pollInterval * 2, mMaxPollInterval);
+            }
+
+            mPollCv.wait_for(lock, pollInterval, [this] { return !mRunning || mWakeRequested; });
+            mWakeRequested = false;
+            if (!mRunning) {
+                break;
+            }
+        }
+    }
+
+    // Block until pred() holds, the poll reports a hard error or the deadline passes.
+    //
+    // PRECONDITIONS: State mutex must be held by lock.
+    template <typename Predicate>
+    auto awaitState(std::unique_lock<std::mutex>& lock,
+                    std::chrono::steady_clock::time_point deadline,
+                    Predicate pred) -> Result<void> {
+        ++mWaiterCount;
+        mWakeRequested = true;
+        mPollCv.notify_one();
+
+        auto hardError = [this] {
+            return mLastPollError && (mLastPollError != Error::kNoService);
+        };
+        bool done = mChangedCv.wait_until(
+            lock, deadline, [&] { return !mRunning || pred() || hardError(); });
+        --mWaiterCount;
+
+        if (!done) {
+            return Error::kTimeout;
+        } else if (pred()) {
+            return kSuccess;
+        } else if (hardError()) {
+            return mLastPollError;
+        }
+        return Error::kUnavailable;
+    }
+
+    friend inline auto obtainGlassesDiscoveryHelper(std::shared_ptr<Client> client,
+                                                    std::chrono::milliseconds minPollInterval,
+                                                    std::chrono::milliseconds maxPollInterval)
+        -> std::unique_ptr<GlassesDiscoveryHelper>;
+
+    GlassesDiscoveryHelper(std::shared_ptr<Client> client,
+                           std::chrono::milliseconds minPollInterval,
+                           std::chrono::milliseconds maxPollInterval)
+        : mClient(std::move(client))
+        , mMinPollInterval(minPollInterval)
+        , mMaxPollInterval(std::max(minPollInterval, maxPollInterval)) {
+
+        mThread = std::thread(&GlassesDiscoveryHelper::threadMain, this);
+    }
+
+public:
+    /// \cond DO_NOT_DOCUMENT
+    virtual ~GlassesDiscoveryHelper() {
+        {
+            std::lock_guard<std::mutex> lock(mStateMtx);
+            mRunning = false;
+        }
+        mPollCv.notify_all();
+        mChangedCv.notify_all();
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+    /// \endcond
+
+    /// \brief Subscribe to glasses added/removed events
+    ///
+    /// Events are delivered on the helper thread. Glasses that are already known are reported
+    /// to the new listener via onGlassesAdded() before this returns, and no change the helper
+    /// notices meanwhile is reported twice or ahead of them. Callbacks must not wait on the helper,
+    /// e.g. with awaitGlasses(), as it can't poll while they run.
+    auto subscribe(const std::shared_ptr<GlassesDiscoveryListener>& listener) -> void {
+        std::lock_guard<std::recursive_mutex> notifyLock(mNotifyMtx);
+        {
+            std::lock_guard<std::mutex> lock(mListenersMtx);
+            mListeners.emplace_back(listener);
+        }
+        for (const auto& id : listKnownGlasses()) {
+            listener->onGlassesAdded(id);
+        }
+    }
+
+    /// \brief Unsubscribe a previously subscribed listener
+    auto unsubscribe(const std::shared_ptr<GlassesDiscoveryListener>& listener) -> void {
+        std::lock_guard<std::mutex> lock(mListenersMtx);
+        mListeners.erase(std::remove_if(mListeners.begin(),
+                                        mListeners.end(),
+                                        [&](const std::weak_ptr<GlassesDiscoveryListener>& l) {
+                                            auto locked = l.lock();
+                                            return !locked || (locked == listener);
+                                        }),
+                         mListeners.end());
+    }
+
+    /// \brief Obtain the glasses identifiers seen by the most recent successful poll
+    auto listKnownGlasses() -> std::vector<std::string> {
+        std::lock_guard<std::mutex> lock(mStateMtx);
+        return mKnownGlasses;
+    }
+
+    /// \brief Block until any glasses are available or timed out
+    ///
+    /// \param[in]  timeout - Time to wait for glasses before timeout
+    /// \return The identifier of the first glasses reported by the service
+    auto awaitGlasses(const std::chrono::milliseconds timeout) -> Result<std::string> {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        std::unique_lock<std::mutex> lock(mStateMtx);
+        auto result = awaitState(lock, deadline, [this] { return !mKnownGlasses.empty(); });
+        if (!result) {
+            return result.error();
+        }
+        return mKnownGlasses.front();
+    }
+
+    /// \brief Block until specific glasses are available or timed out
+    ///
+    /// \param[in]  identifier - Identifier of the glasses, as returned by listGlasses()
+    /// \param[in]  timeout    - Time to wait for the glasses before timeout
+    auto awaitGlasses(const std::string& identifier, const std::chrono::milliseconds timeout)
+        -> Result<void> {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        std::unique_lock<std::mutex> lock(mStateMtx);
+        return awaitState(lock, deadline, [&] {
+            return std::find(mKnownGlasses.cbegin(), mKnownGlasses.cend(), identifier) !=
+                   mKnownGlasses.cend();
+        });
+    }
+
+    /// \brief Obtain and consume the last asynchronous error
+    ///
+    /// The discovery process may produce errors asynchronously which can
+    /// be detected by calling this.
+    ///
+    /// \return The last known error or a default std::error_code if no error
+    /// was present
+    auto consumeLastAsyncError() -> std::error_code {
+        std::lock_guard<std::mutex> lock(mLastAsyncErrorMtx);
+        return mLastAsyncError.exchange({});
     }
 };
 
@@ -1411,6 +2163,14 @@ inline auto obtainWandStreamHelper(std::shared_ptr<Glasses> glasses,
     return std::shared_ptr<WandStreamHelper>(new WandStreamHelper(std::move(glasses), pollTimeout));
 }
 
+/// Internal utility function - Do not call directly
+inline auto obtainPoseStreamHelper(std::shared_ptr<Glasses> glasses,
+                                   std::chrono::microseconds samplePeriod,
+                                   size_t historyLength) -> std::unique_ptr<PoseStreamHelper> {
+    return std::unique_ptr<PoseStreamHelper>(
+        new PoseStreamHelper(std::move(glasses), samplePeriod, historyLength));
+}
+
 /// Internal utility function - Do not call directly
 inline auto obtainWand(T5_WandHandle handle, std::shared_ptr<WandStreamHelper> wandStreamHelper)
     -> std::shared_ptr<Wand> {
@@ -1436,6 +2196,16 @@ inline auto obtainParamChangeHelper(std::shared_ptr<Client> client,
     return std::unique_ptr<ParamChangeHelper>(
         new ParamChangeHelper(std::move(client), std::move(listener), pollInterval));
 }
+
+/// Internal utility function - Do not call directly
+inline auto obtainGlassesDiscoveryHelper(std::shared_ptr<Client> client,
+                                         std::chrono::milliseconds minPollInterval,
+                                         std::chrono::milliseconds maxPollInterval)
+    -> std::unique_ptr<GlassesDiscoveryHelper> {
+
+    return std::unique_ptr<GlassesDiscoveryHelper>(
+        new GlassesDiscoveryHelper(std::move(client), minPollInterval, maxPollInterval));
+}
 /// \endcond
 
 /// \}
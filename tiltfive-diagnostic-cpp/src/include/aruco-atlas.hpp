@@ -0,0 +1,119 @@
+#pragma once
+
+/// \file
+/// \brief Compile-time bit patterns of the ArUco DICT_6X6_250 dictionary and a marker blitter
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cv {
+class Mat;
+}
+
+/// Data bits along each side of a marker, excluding the border
+constexpr int kArucoMarkerBits = 6;
+constexpr int kArucoDictionarySize = 250;
+constexpr int kArucoMaxBorderBits = 4;
+
+/// Data bits of every DICT_6X6_250 marker, as produced by cv::aruco::generateImageMarker.
+///
+/// Each entry holds 36 bits in row-major order, top-left bit in bit 35. A set bit is a white cell.
+constexpr uint64_t kArucoDict6x6_250[kArucoDictionarySize] = {
+	0x1E3DD82A6ull, 0x0EFBA3891ull, 0x15907EACDull, 0xC91B3069Eull,
+	0xD607D6E15ull, 0xD8E8E0E68ull, 0x4268B41F5ull, 0x88A50F29Aull,
+	0x307D524FDull, 0x3C2F34B3Cull, 0x45DFC74E3ull, 0x48D85B257ull,
+	0x710558FC6ull, 0x86DCFAD07ull, 0x8D72A93F6ull, 0xA2B89DCDEull,
+	0x09FD1E9C4ull, 0x154DBD18Full, 0x300A310E2ull, 0x4807EFAFDull,
+	0x56DF11DB6ull, 0x66883274Cull, 0x76E8CB781ull, 0x9A53D9CF3ull,
+	0xA9CB84024ull, 0xC67549490ull, 0xC1D288941ull, 0xE7480852Bull,
+	0xEA2FCA848ull, 0xE963B77B1ull, 0xFA36652AFull, 0x065BFF7BDull,
+	0x0541D72D6ull, 0x0CF7246A2ull, 0x1338A39EBull, 0x15A893E74ull,
+	0x3A417EE9Eull, 0x4F11E26C0ull, 0x530DB6D20ull, 0x589BFAE34ull,
+	0x6409E8A0Bull, 0x60537A891ull, 0x6159069BAull, 0x6BFF78D7Bull,
+	0x70AD96A4Full, 0x75846F71Aull, 0x7A95192FCull, 0x8609760AAull,
+	0x8A2D44C3Full, 0x93EB78B14ull, 0x988DA84D4ull, 0x9EDE2B3C8ull,
+	0xA529E07B8ull, 0xB593B855Full, 0xB7F8E426Full, 0xBC205225Eull,
+	0xC04487765ull, 0xC4C324259ull, 0xC5A91BD8Dull, 0xCE73E6B2Cull,
+	0xCD0CA6272ull, 0xC9435D44Dull, 0xCFBE80F34ull, 0xE57D15877ull,
+	0xEFC6858E9ull, 0xF77EF3772ull, 0x2CE43F254ull, 0x2BDCFF4B3ull,
+	0x37C7DDBDAull, 0xA1A254E0Full, 0xA982C1BB5ull, 0xD81B49B08ull,
+	0x035829F86ull, 0x07C4095FCull, 0x0FE26617Bull, 0x144836441ull,
+	0x10AD5FFB7ull, 0x12829553Full, 0x16E13184Cull, 0x187A496B0ull,
+	0x1AE886112ull, 0x1913AE0A1ull, 0x1B67B5A17ull, 0x25DC95F0Bull,
+	0x288961F76ull, 0x3354146AAull, 0x31C16C1F7ull, 0x33CB18C66ull,
+	0x3ECFE490Full, 0x464518A3Full, 0x44BA70B67ull, 0x419C623E8ull,
+	0x48D1914A1ull, 0x54F499F6Dull, 0x575A9C813ull, 0x558355B2Cull,
+	0x57B77610Full, 0x5C3436FE4ull, 0x5C48FC77Eull, 0x5E6EEF402ull,
+	0x5F233B6FFull, 0x5B742A632ull, 0x650FA33AEull, 0x65D3175CCull,
+	0x6A9C245AEull, 0x69C5F3042ull, 0x69D2484EAull, 0x7479E2DE6ull,
+	0x72CF23EABull, 0x77B1DC414ull, 0x7E0C07217ull, 0x7A6970647ull,
+	0x78B2D8707ull, 0x79C585794ull, 0x866F59FC6ull, 0x82F6727F5ull,
+	0x854E2F414ull, 0x9A1185934ull, 0x9C7160C97ull, 0x9DD194FD8ull,
+	0xA21E12E38ull, 0xAE701C82Cull, 0xAD01219C1ull, 0xB0351F9EEull,
+	0xB64AD80D4ull, 0xB537314B4ull, 0xBEAAC7E3Bull, 0xBB683DBCFull,
+	0xC672F72C1ull, 0xC1E74DBABull, 0xCB55EE59Dull, 0xCBA053724ull,
+	0xD0090FCF1ull, 0xD06C3AD54ull, 0xD3F120574ull, 0xE6E33B1A7ull,
+	0xE3533EA4Aull, 0xE8068EB14ull, 0xEC07C0597ull, 0xEAF3803DAull,
+	0xF63B27D88ull, 0xF30798379ull, 0xFE4BBA9B9ull, 0xABA57D86Bull,
+	0xC0D1625ABull, 0x13CE7BAE7ull, 0x4E81FD617ull, 0x56E076320ull,
+	0x6A708A540ull, 0x72A898A18ull, 0x815D42F80ull, 0xCF4CC3D5Full,
+	0xD6BB65864ull, 0xECD313A31ull, 0xF521F5207ull, 0xF91FA5DF7ull,
+	0x0024F47A7ull, 0x00084D882ull, 0x043CC2F29ull, 0x047B50211ull,
+	0x067AE4C1Dull, 0x00AA968A3ull, 0x04D138E94ull, 0x0510A80DAull,
+	0x0140B0007ull, 0x019D9CEE1ull, 0x081057E3Bull, 0x086B97B66ull,
+	0x0EE8B860Aull, 0x0B6C76B9Bull, 0x0FDCB98CBull, 0x0FCACF3A0ull,
+	0x14249FD98ull, 0x1407201FDull, 0x150910D57ull, 0x135CD7307ull,
+	0x11479ABB6ull, 0x1CB9A9238ull, 0x1CDD07766ull, 0x1F2E7C24Bull,
+	0x196642477ull, 0x1957D4C84ull, 0x1FA8F4F04ull, 0x1B8246ED8ull,
+	0x1BAEE10FEull, 0x22A4B63CAull, 0x22BF9012Full, 0x232C15B40ull,
+	0x255AA966Cull, 0x27A5AFA97ull, 0x25F40E425ull, 0x286655CDEull,
+	0x2C427E0E0ull, 0x2AB97CBD0ull, 0x2946E1D23ull, 0x2DA628410ull,
+	0x2BFB209A6ull, 0x368CD66BCull, 0x3487777C7ull, 0x34DDEB840ull,
+	0x3791F76F1ull, 0x3A228E175ull, 0x3E13BD408ull, 0x3C9843CA2ull,
+	0x39589D179ull, 0x3974DAEEBull, 0x3F6DBC731ull, 0x3D6BC050Cull,
+	0x39AB27497ull, 0x46024E25Eull, 0x4682BA0BCull, 0x42E9CD5AEull,
+	0x44C9B7B3Full, 0x40C7D41E9ull, 0x46D2B4CCEull, 0x43195356Bull,
+	0x4122E6DD9ull, 0x4753A59ABull, 0x4E1EF1E08ull, 0x4E4AC0960ull,
+	0x4E5FAA06Full, 0x4A8D32943ull, 0x491594B39ull, 0x4D4DDB621ull,
+	0x4BA761E81ull, 0x49D483D8Eull, 0x56290EF6Cull, 0x537ED5FFCull,
+	0x55F5A7AFAull, 0x55D5EA64Full, 0x581BAB1DAull, 0x5EBE926DDull,
+	0x5F10F99B5ull, 0x5D1EDFA5Cull, 0x5F718DF02ull, 0x5DE11E468ull,
+	0x6033BB247ull, 0x64581AFE1ull, 0x63C8DDA76ull, 0x61DA3D8FDull,
+	0x6E3A22AFAull, 0x6E6105B71ull, 0x6A89A9E8Cull, 0x6A97224F5ull,
+	0x6B12C3801ull, 0x6B684B22Aull, 0x6F94C1579ull, 0x6DA6FEA0Dull,
+	0x6FEACA457ull, 0x703D38A60ull,
+};
+
+/// Cells along each side of a marker with the given border width
+constexpr auto arucoMarkerCells(int borderBits) -> int {
+	return kArucoMarkerBits + 2 * borderBits;
+}
+
+/// Whether a cell of a marker is white. Row and column count from the top-left border cell.
+constexpr auto arucoMarkerCell(int id, int row, int col, int borderBits = 1) -> bool {
+	row -= borderBits;
+	col -= borderBits;
+	if ((row < 0) || (col < 0) || (row >= kArucoMarkerBits) || (col >= kArucoMarkerBits)) {
+		return false;
+	}
+	int bit = (kArucoMarkerBits * kArucoMarkerBits - 1) - (row * kArucoMarkerBits + col);
+	return ((kArucoDict6x6_250[id] >> bit) & 1) != 0;
+}
+
+/// Draw a marker scaled with nearest-neighbour sampling to fill an 8-bit image
+///
+/// The output is identical to cv::aruco::generateImageMarker at the same size, without building
+/// the dictionary or allocating.
+///
+/// \param[in]  id         - Marker id, below kArucoDictionarySize
+/// \param[out] pixels     - Top-left pixel of the destination
+/// \param[in]  stride     - Bytes between the start of consecutive rows
+/// \param[in]  channels   - Bytes per pixel; every channel of a pixel gets the same value
+/// \param[in]  borderBits - Border width in cells, 1 to kArucoMaxBorderBits
+///
+/// \return false if the id or border is out of range, or the image has fewer pixels than cells
+auto blitArucoMarker(int id, uint8_t *pixels, int width, int height, size_t stride, int channels,
+		int borderBits = 1) -> bool;
+
+/// Draw a marker to fill target, typically an ROI of a larger CV_8U image of 1 to 4 channels
+auto blitArucoMarker(int id, cv::Mat &target, int borderBits = 1) -> bool;
@@ -0,0 +1,100 @@
+#pragma once
+
+/// \file
+/// \brief Headless ArUco detection over directories of captured frames
+
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect/aruco_detector.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// Markers found in one image
+struct ImageDetections {
+	size_t index = 0; ///< Position of the image in the input list
+	std::string path;
+	bool decoded = false; ///< False if the image couldn't be read
+	std::vector<int> ids;
+	std::vector<std::vector<cv::Point2f>> corners; ///< Four per marker, clockwise from top-left
+};
+
+/// Receives detections in input order
+class DetectionSink {
+public:
+	virtual ~DetectionSink() = default;
+
+	virtual auto begin(size_t imageCount) -> bool = 0;
+	virtual auto write(const ImageDetections &detections) -> bool = 0;
+	virtual auto finish() -> bool = 0;
+};
+
+/// Writes one CSV row per marker: `index,path,markers,id,x0,y0,x1,y1,x2,y2,x3,y3`.
+///
+/// Images without markers get a single row with markers = 0 and empty marker fields, and images
+/// that couldn't be decoded get markers = -1.
+class CsvDetectionSink : public DetectionSink {
+public:
+	explicit CsvDetectionSink(std::string path) : mPath(std::move(path)) {}
+
+	auto begin(size_t imageCount) -> bool override;
+	auto write(const ImageDetections &detections) -> bool override;
+	auto finish() -> bool override;
+
+private:
+	const std::string mPath;
+	std::ofstream mOut;
+};
+
+/// Writes a compact little-endian binary file.
+///
+/// Header: "T5DR", uint32 version, uint32 image count. Then per image: uint32 index, uint16 path
+/// length, path bytes, int32 marker count (-1 if not decoded), and per marker an int32 id followed
+/// by eight float32 corner coordinates.
+class BinaryDetectionSink : public DetectionSink {
+public:
+	static constexpr uint32_t kVersion = 1;
+
+	explicit BinaryDetectionSink(std::string path) : mPath(std::move(path)) {}
+
+	auto begin(size_t imageCount) -> bool override;
+	auto write(const ImageDetections &detections) -> bool override;
+	auto finish() -> bool override;
+
+private:
+	const std::string mPath;
+	std::ofstream mOut;
+};
+
+struct BatchDetectionOptions {
+	int decodeThreads = 2;
+	int detectThreads = 0; ///< 0 uses one per hardware thread
+	size_t prefetch = 16; ///< Decoded images allowed to wait for a detector
+	cv::aruco::DetectorParameters detectorParams;
+};
+
+struct BatchDetectionStats {
+	size_t images = 0;
+	size_t failed = 0; ///< Images that couldn't be decoded
+	size_t markers = 0;
+	double seconds = 0.0;
+
+	[[nodiscard]] auto imagesPerSecond() const -> double {
+		return (seconds > 0.0) ? images / seconds : 0.0;
+	}
+};
+
+/// Expand an input path into the images to process
+///
+/// A directory yields its image files sorted by name. A `.txt` or `.lst` file is read as a
+/// recorded session: one image path per line, relative to the list's directory, in capture
+/// order. Anything else is treated as a single image.
+auto collectImagePaths(const std::string &path, std::vector<std::string> &paths) -> bool;
+
+/// Detect DICT_6X6_250 markers in every image and pass the results to sink in input order
+///
+/// Images are decoded to grayscale on a pool of prefetch threads and handed through a bounded
+/// queue to a pool of detectors, so neither disk nor decode stalls the detectors.
+auto runBatchDetection(const std::vector<std::string> &paths, const BatchDetectionOptions &options,
+		DetectionSink &sink, BatchDetectionStats &stats) -> bool;
@@ -0,0 +1,90 @@
+#pragma once
+
+/// \file
+/// \brief Blocking fixed-capacity queue for handing work between threads
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/// Multi-producer, multi-consumer FIFO with a fixed capacity.
+///
+/// Producers block while the queue is full and consumers block while it's empty. Once closed,
+/// pushes fail and pops drain the remaining items before failing.
+template <typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(size_t capacity) : mCapacity(capacity > 0 ? capacity : 1) {}
+
+	BoundedQueue(const BoundedQueue &) = delete;
+	auto operator=(const BoundedQueue &) -> BoundedQueue & = delete;
+
+	/// Wait for space and append item. Returns false if the queue was closed.
+	auto push(T item) -> bool {
+		std::unique_lock<std::mutex> lock(mMtx);
+		mNotFull.wait(lock, [&]() { return mClosed || (mItems.size() < mCapacity); });
+		if (mClosed) {
+			return false;
+		}
+		mItems.push_back(std::move(item));
+		lock.unlock();
+		mNotEmpty.notify_one();
+		return true;
+	}
+
+	/// Move item in only if there's space right now. Returns false, leaving item untouched, if the
+	/// queue is full or closed.
+	auto tryPush(T &item) -> bool {
+		std::unique_lock<std::mutex> lock(mMtx);
+		if (mClosed || (mItems.size() >= mCapacity)) {
+			return false;
+		}
+		mItems.push_back(std::move(item));
+		lock.unlock();
+		mNotEmpty.notify_one();
+		return true;
+	}
+
+	/// Wait for an item. Returns false once the queue is closed and empty.
+	auto pop(T &item) -> bool {
+		std::unique_lock<std::mutex> lock(mMtx);
+		mNotEmpty.wait(lock, [&]() { return mClosed || !mItems.empty(); });
+		if (mItems.empty()) {
+			return false;
+		}
+		item = std::move(mItems.front());
+		mItems.pop_front();
+		lock.unlock();
+		mNotFull.notify_one();
+		return true;
+	}
+
+	/// Wake all waiters; no further items are accepted
+	auto close() -> void {
+		{
+			std::lock_guard<std::mutex> lock(mMtx);
+			mClosed = true;
+		}
+		mNotEmpty.notify_all();
+		mNotFull.notify_all();
+	}
+
+	[[nodiscard]] auto size() const -> size_t {
+		std::lock_guard<std::mutex> lock(mMtx);
+		return mItems.size();
+	}
+
+	[[nodiscard]] auto capacity() const -> size_t {
+		return mCapacity;
+	}
+
+private:
+	const size_t mCapacity;
+	mutable std::mutex mMtx;
+	std::condition_variable mNotEmpty;
+	std::condition_variable mNotFull;
+	std::deque<T> mItems;
+	bool mClosed = false;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+/// \file
+/// \brief Camera capture loop: marker detection, marker poses and frame recording
+
+#include "TiltFiveNative.hpp"
+#include "frame-demux.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class MetricsRegistry;
+
+struct CameraCaptureOptions {
+	std::chrono::milliseconds duration{ 100000 };
+	uint8_t cameraIndex = 0;
+
+	std::string detectorConfig = "detector-params.yml"; ///< Used if present, as saved by detector-tuner
+	std::string intrinsicsPath = "camera-intrinsics.yml"; ///< Used if present, else approximate intrinsics
+	std::string markerPoseOutput = "marker-poses.csv";
+	std::string framesDirectory = "frames"; ///< Where sampled raw frames are written
+
+	// Raw frame sampling for post-mortems; off unless one of these is set, as frames add up quickly
+	int framesEveryNth = 0; ///< Write every Nth frame; 0 disables
+	bool framesOnMarkerLoss = false; ///< Write the first frame without markers after frames with some
+	bool framesOnError = false; ///< Write frames whose recording or marker pose output failed
+	std::string sessionPath; ///< Record every raw frame to this session file if set
+
+	/// Detection runs on the half resolution frame first and repeats at full resolution when that
+	/// finds fewer markers than the previous frame, and on every Nth detected frame regardless, so
+	/// markers too small to find at half resolution are still picked up; 0 disables the periodic pass
+	int fullDetectEveryNth = 10;
+	FrameDemux::Options demux; ///< How frames are routed by illumination mode
+
+	bool headless = false; ///< Don't open the preview window
+	double previewFps = 10.0; ///< Preview redraw rate; capture runs at full rate regardless
+	bool stdinCommands = true; ///< Read q (quit) and s (status) commands from stdin
+
+	MetricsRegistry *metrics = nullptr; ///< Publish live counters here for scraping if set
+};
+
+/// Stream camera frames from exclusively connected glasses until the duration passes or the user
+/// quits, detecting markers on every lit frame, then print a summary including frame throughput
+///
+/// The capture loop never touches HighGUI. Quitting comes from SIGINT, SIGTERM, a `q` on stdin or
+/// the `q` key in the preview window, which runs on its own thread unless headless.
+auto runCameraCapture(std::shared_ptr<tiltfive::Glasses> &glasses, const CameraCaptureOptions &options) -> tiltfive::Result<void>;
@@ -0,0 +1,48 @@
+#pragma once
+
+/// \file
+/// \brief Quit and status requests for long captures, from signals and stdin instead of a window
+
+#include <atomic>
+#include <thread>
+
+/// Collects requests to stop or report on a running capture
+///
+/// While alive, SIGINT and SIGTERM request a quit instead of killing the process, so the capture
+/// can still release its camera buffer and write its summary. Optionally a thread reads commands
+/// from stdin: `q` quits and `s` asks for a status line. Reaching the end of stdin stops the
+/// thread without quitting, so captures started with stdin closed run to their duration.
+///
+/// Only one CaptureControl should be alive at a time; it owns the signal handlers.
+class CaptureControl {
+public:
+	explicit CaptureControl(bool readStdin);
+	~CaptureControl();
+
+	CaptureControl(const CaptureControl &) = delete;
+	auto operator=(const CaptureControl &) -> CaptureControl & = delete;
+
+	/// Cheap enough to check on every frame
+	[[nodiscard]] auto quitRequested() const -> bool;
+
+	auto requestQuit() -> void {
+		mQuit = true;
+	}
+
+	/// True once per `s` command
+	auto takeStatusRequest() -> bool {
+		return mStatus.exchange(false, std::memory_order_relaxed);
+	}
+
+private:
+	auto readCommands() -> void;
+	auto handleCommand(char command) -> void;
+
+	std::atomic<bool> mQuit{ false };
+	std::atomic<bool> mStatus{ false };
+	std::atomic<bool> mStop{ false };
+	std::thread mStdinThread;
+
+	void (*mPreviousInt)(int) = nullptr;
+	void (*mPreviousTerm)(int) = nullptr;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+/// \file
+/// \brief Low-rate preview window driven from its own thread
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct PreviewOptions {
+	std::string title = "Test Window";
+	double fps = 10.0; ///< Redraw rate; the capture loop never waits for the window
+};
+
+struct PreviewStats {
+	uint64_t offered = 0; ///< Frames handed over by the capture loop
+	uint64_t shown = 0;
+};
+
+/// Shows a subsampled stream of frames without putting HighGUI in the capture loop
+///
+/// The window is created, drawn and polled for keys on its own thread. The capture loop asks
+/// wantsFrame() before spending time drawing an overlay, and offer() only copies into a single
+/// pending slot, replacing a frame the window hasn't picked up yet.
+class PreviewWindow {
+public:
+	/// \param onKey - Called on the preview thread with each key pressed in the window
+	PreviewWindow(PreviewOptions options, std::function<void(int key)> onKey);
+	~PreviewWindow();
+
+	PreviewWindow(const PreviewWindow &) = delete;
+	auto operator=(const PreviewWindow &) -> PreviewWindow & = delete;
+
+	/// True when the next redraw is due, so the caller should render and offer a frame
+	[[nodiscard]] auto wantsFrame() const -> bool;
+
+	auto offer(const cv::Mat &image) -> void;
+
+	/// Close the window and stop its thread
+	auto close() -> void;
+
+	[[nodiscard]] auto stats() const -> PreviewStats;
+
+private:
+	auto run() -> void;
+
+	const PreviewOptions mOptions;
+	const std::chrono::steady_clock::duration mInterval;
+	const std::function<void(int key)> mOnKey;
+
+	std::mutex mMtx;
+	std::condition_variable mCv;
+	cv::Mat mPending;
+	bool mHasPending = false;
+	bool mClosed = false;
+	std::thread mThread;
+
+	std::atomic<int64_t> mNextDueNanos{ 0 }; ///< steady_clock time of the next wanted frame
+	std::atomic<uint64_t> mOffered{ 0 };
+	std::atomic<uint64_t> mShown{ 0 };
+};
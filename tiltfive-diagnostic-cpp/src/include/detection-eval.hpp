@@ -0,0 +1,92 @@
+#pragma once
+
+/// \file
+/// \brief Accuracy and throughput scoring of ArUco detector configurations
+
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect/aruco_detector.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/// A frame with the markers known to be in it
+struct LabelledFrame {
+	std::string name;
+	std::string group; ///< Scores are reported per group as well as overall
+	cv::Mat image; ///< CV_8UC1
+	std::vector<int> ids;
+	std::vector<std::vector<cv::Point2f>> corners; ///< Clockwise from top-left, pixel-centre coordinates
+};
+
+/// Load frames labelled in the CSV format written by CsvDetectionSink
+///
+/// Image paths are relative to the label file. Labels use the corners the detector reports without
+/// refinement: the centres of the outermost border pixels, so a marker covering pixels [x, x+s) has
+/// its corners at x and x + s - 1. Subpixel refinement moves corners out to the geometric edge,
+/// about 0.7 px from these. Frames are put in the "captured" group.
+auto loadLabelledFrames(const std::string &labelsPath, std::vector<LabelledFrame> &frames) -> bool;
+
+struct SyntheticCorpusOptions {
+	int framesPerVariant = 6;
+	int seed = 5;
+};
+
+/// Render camera-sized frames of known markers in the groups "synthetic-clean", "synthetic-noise",
+/// "synthetic-blur", "synthetic-perspective" and "synthetic-low-contrast".
+///
+/// Rendering is deterministic for a given seed and OpenCV version. Markers pushed out of frame by
+/// the perspective warp are left unlabelled.
+auto renderSyntheticFrames(const SyntheticCorpusOptions &options, std::vector<LabelledFrame> &frames)
+		-> void;
+
+/// Detection counts and timing accumulated over a set of frames
+struct DetectionScore {
+	size_t frames = 0;
+	size_t truePositives = 0;
+	size_t falsePositives = 0;
+	size_t falseNegatives = 0;
+	double cornerSquaredError = 0.0; ///< Sum over the corners of true positives
+	size_t corners = 0;
+	double detectSeconds = 0.0;
+	size_t detectCalls = 0;
+
+	[[nodiscard]] auto precision() const -> double;
+	[[nodiscard]] auto recall() const -> double;
+	/// Root mean square corner distance in pixels
+	[[nodiscard]] auto cornerRmse() const -> double;
+	[[nodiscard]] auto framesPerSecond() const -> double;
+
+	auto operator+=(const DetectionScore &other) -> DetectionScore &;
+};
+
+/// Compare a detection result against the frame's labels by marker id
+auto scoreDetections(const LabelledFrame &frame, const std::vector<int> &ids,
+		const std::vector<std::vector<cv::Point2f>> &corners, DetectionScore &score) -> void;
+
+/// Run DICT_6X6_250 detection over frames on the calling thread
+///
+/// Accuracy is scored on the first pass; every pass is timed.
+///
+/// \return Scores by group, plus the key "all" for the whole corpus
+auto evaluateDetector(const std::vector<LabelledFrame> &frames,
+		const cv::aruco::DetectorParameters &params, int passes) -> std::map<std::string, DetectionScore>;
+
+/// Reference metrics for one group, as stored in a golden file
+struct GoldenMetrics {
+	double precision = 0.0;
+	double recall = 0.0;
+	double cornerRmse = 0.0;
+	double framesPerSecond = 0.0;
+};
+
+/// Read a golden file of `group metric value` lines; `#` starts a comment
+auto loadGoldenMetrics(const std::string &path, std::map<std::string, GoldenMetrics> &golden) -> bool;
+/// Write a golden file, headed by the OpenCV version the scores came from
+auto saveGoldenMetrics(const std::string &path, const std::map<std::string, DetectionScore> &scores)
+		-> bool;
+
+/// Read or write DetectorParameters as an OpenCV FileStorage file (.yml, .json or .xml)
+auto loadDetectorParameters(const std::string &path, cv::aruco::DetectorParameters &params) -> bool;
+auto saveDetectorParameters(const std::string &path, cv::aruco::DetectorParameters params) -> bool;
@@ -0,0 +1,94 @@
+#pragma once
+
+/// \file
+/// \brief Routing of camera frames by illumination mode ahead of marker detection
+
+#include "ir-preprocess.hpp"
+#include "types.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/// Values of T5_CamImage::illuminationMode
+enum class IlluminationMode : uint8_t {
+	kUnknown = 0,
+	kLight = 1,
+	kDark = 2,
+};
+
+constexpr int kIlluminationModeCount = 3;
+
+auto illuminationModeName(IlluminationMode mode) -> const char *;
+
+/// A frame the demux wants detection to run on
+struct RoutedFrame {
+	bool detect = false; ///< False when the frame was dropped or only kept as a dark reference
+	IlluminationMode mode = IlluminationMode::kUnknown;
+	int width = 0;
+	int height = 0;
+	const uint8_t *light = nullptr; ///< The camera's own buffer, valid until it is resubmitted
+	size_t lightStride = 0;
+	const uint8_t *dark = nullptr; ///< Paired unlit frame to subtract, or null
+	size_t darkStride = 0;
+};
+
+/// Frame counts by illumination mode and what was done with them
+struct FrameDemuxStats {
+	uint64_t frames[kIlluminationModeCount] = {};
+	uint64_t detected = 0;
+	uint64_t paired = 0; ///< Detected frames that had a dark frame to subtract
+	uint64_t dropped = 0; ///< Unknown frames skipped by downsampling
+	double seconds = 0.0; ///< Time from the first frame to the last
+
+	[[nodiscard]] auto count(IlluminationMode mode) const -> uint64_t {
+		return frames[static_cast<int>(mode)];
+	}
+	/// Frames per second seen in the given mode
+	[[nodiscard]] auto rate(IlluminationMode mode) const -> double;
+	[[nodiscard]] auto detectRate() const -> double;
+};
+
+/// Sends light frames to detection, keeps dark frames to subtract from their neighbours, and
+/// downsamples frames of unknown illumination
+///
+/// Services that don't report an illumination mode send every frame as unknown, so those are
+/// detected on rather than dropped; downsampling only bounds the cost of the unlit ones among them.
+///
+/// Dark frames are copied, so the camera buffer can be resubmitted straight after push(). A light
+/// frame is paired with the most recent dark frame from the same camera if it arrived within
+/// Options::maxDarkAge frames and has the same size.
+class FrameDemux {
+public:
+	struct Options {
+		/// Detect on every Nth unknown frame; 0 drops them all. Odd, so that frames alternating
+		/// between lit and unlit are not always sampled on the same phase.
+		int unknownKeepEvery = 3;
+		int maxDarkAge = 2; ///< Frames a dark frame stays usable for pairing; 0 disables pairing
+	};
+
+	FrameDemux() = default;
+	explicit FrameDemux(Options options) : mOptions(options) {}
+
+	/// Route a filled camera frame
+	auto push(const T5_CamImage &image) -> RoutedFrame;
+
+	[[nodiscard]] auto stats() const -> const FrameDemuxStats & {
+		return mStats;
+	}
+
+	/// Forget the stored dark frame and counts
+	auto reset() -> void;
+
+private:
+	Options mOptions;
+	FrameDemuxStats mStats;
+	uint64_t mSequence = 0;
+	std::chrono::steady_clock::time_point mFirstFrame;
+
+	GrayImage mDark;
+	uint8_t mDarkCamera = 0;
+	uint64_t mDarkSequence = 0;
+	bool mHaveDark = false;
+	uint64_t mUnknownSeen = 0;
+};
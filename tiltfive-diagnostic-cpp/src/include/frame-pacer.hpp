@@ -0,0 +1,64 @@
+#pragma once
+
+/// \file
+/// \brief Frame submission on a fixed schedule, measuring whether a render loop keeps up
+///
+/// The pacer stands in for an application's render loop. At each frame slot it reads the latest
+/// glasses pose, derives the left and right eye poses from it and the IPD, optionally burns a
+/// simulated render time, and sends a T5_FrameInfo with dummy texture handles, so it needs no GPU
+/// and runs against the stand-in service as well as real glasses with ::kT5_GraphicsApi_None.
+///
+/// Slots are waited for by sleeping until shortly before them and spinning the rest, since sleeps
+/// alone overshoot by up to a scheduler tick. A frame misses its deadline when it is sent after
+/// the next slot has begun; slots that have passed by the time a frame is sent are skipped rather
+/// than sent late in a burst.
+
+#include "TiltFiveNative.hpp"
+#include "pose-analyzer.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+class MetricsRegistry;
+
+struct FramePacerOptions {
+	std::chrono::milliseconds duration{ 10000 };
+	double fps = 60.0; ///< Frame slots per second
+	std::chrono::microseconds spinWindow{ 1000 }; ///< Spin instead of sleeping this close to a slot
+	std::chrono::microseconds renderTime{ 0 }; ///< Busy time per frame between reading the pose and sending
+
+	MetricsRegistry *metrics = nullptr; ///< Publish live counters here for scraping if set
+};
+
+/// What a pacing run measured; times are in seconds
+struct FramePacerStats {
+	uint64_t slots = 0; ///< Frame slots woken for, sent or not; skipped ones are counted separately
+	uint64_t sent = 0;
+	uint64_t sendFailures = 0;
+	uint64_t missedDeadlines = 0; ///< Frames sent after the next slot had begun
+	uint64_t skippedSlots = 0; ///< Slots that passed while an earlier frame was still being prepared
+	uint64_t staleFrames = 0; ///< Frames sent with an earlier pose because no new one was available
+	uint64_t noPoseSlots = 0; ///< Slots skipped because no pose had been read yet
+	double elapsed = 0.0;
+
+	RunningStats wakeLateness; ///< From the slot starting until the pacer woke for it
+	RunningStats submitLatency; ///< Duration of the send call alone
+	RunningStats frameTime; ///< From the slot starting until its frame was sent
+	RunningStats poseAge; ///< Age of the frame's pose when it was sent
+
+	[[nodiscard]] auto sentPerSecond() const -> double {
+		return (elapsed > 0.0) ? static_cast<double>(sent) / elapsed : 0.0;
+	}
+};
+
+/// Eye poses for rendering a frame from a glasses pose
+///
+/// Both eyes share the glasses' orientation and sit IPD/2 either side of the glasses origin along
+/// the glasses' X axis.
+auto fillFrameEyePoses(const T5_GlassesPose &pose, double ipd, T5_FrameInfo &frameInfo) -> void;
+
+/// Initialize graphics on exclusively connected glasses and send frames at options.fps until the
+/// duration passes, then print a summary
+auto runFramePacer(std::shared_ptr<tiltfive::Glasses> &glasses, const FramePacerOptions &options,
+		FramePacerStats &stats) -> tiltfive::Result<void>;
@@ -0,0 +1,105 @@
+#pragma once
+
+/// \file
+/// \brief Background writing of sampled camera frames for post-mortem analysis
+
+#include "bounded-queue.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Why a frame was written; also used as the file name suffix
+enum class FrameWriteReason {
+	kSampled,
+	kMarkerLoss,
+	kError,
+};
+
+auto frameWriteReasonName(FrameWriteReason reason) -> const char *;
+
+enum class FrameFormat {
+	kPng, ///< Lossless; about 25 ms of a worker per camera frame for half the size of raw
+	kPgm, ///< Raw binary PGM, lossless with almost no CPU cost
+};
+
+struct FrameWriterOptions {
+	std::string directory = "frames";
+	FrameFormat format = FrameFormat::kPng;
+	int pngCompression = 1; ///< zlib level 0-9; higher levels barely shrink noisy IR frames
+	int workers = 2;
+	size_t queueCapacity = 32; ///< Frames allowed to wait for a worker before new ones are dropped
+
+	// Nothing is written unless at least one of these is set
+	int everyNth = 0; ///< Write every Nth frame regardless of content; 0 disables
+	bool onMarkerLoss = false; ///< Write the first frame without markers after frames with some
+	bool onError = false; ///< Write frames the caller flags as erroneous
+};
+
+struct FrameWriterStats {
+	uint64_t submitted = 0; ///< Frames the sampling chose to write
+	uint64_t written = 0;
+	uint64_t dropped = 0; ///< Frames discarded because the queue was full
+	uint64_t failed = 0; ///< Frames that couldn't be encoded or written
+	uint64_t bytes = 0;
+};
+
+/// Writes sampled frames from the capture thread without blocking it
+///
+/// offer() decides whether a frame is wanted, copies it into a recycled buffer and hands it to a
+/// pool of workers that encode and write it. When the workers fall behind, frames are dropped and
+/// counted instead of stalling capture.
+class AsyncFrameWriter {
+public:
+	explicit AsyncFrameWriter(FrameWriterOptions options);
+	~AsyncFrameWriter();
+
+	AsyncFrameWriter(const AsyncFrameWriter &) = delete;
+	auto operator=(const AsyncFrameWriter &) -> AsyncFrameWriter & = delete;
+
+	/// Consider one captured frame for writing
+	///
+	/// \param frameIndex Used in the file name
+	/// \param markerCount Markers detected in the frame, for loss sampling
+	/// \param error The caller saw something wrong with this frame
+	/// \return True if the frame was queued
+	auto offer(uint64_t frameIndex, const cv::Mat &image, size_t markerCount, bool error = false) -> bool;
+
+	/// Write everything still queued and stop the workers
+	auto close() -> void;
+
+	[[nodiscard]] auto stats() const -> FrameWriterStats;
+
+private:
+	struct Job {
+		uint64_t frameIndex = 0;
+		FrameWriteReason reason = FrameWriteReason::kSampled;
+		cv::Mat image;
+	};
+
+	auto enqueue(uint64_t frameIndex, const cv::Mat &image, FrameWriteReason reason) -> bool;
+	auto work() -> void;
+	auto write(const Job &job, std::vector<uint8_t> &encoded) -> bool;
+
+	const FrameWriterOptions mOptions;
+	BoundedQueue<Job> mQueue;
+	std::vector<std::thread> mWorkers;
+	bool mClosed = false;
+
+	size_t mPreviousMarkers = 0;
+	uint64_t mOffered = 0;
+
+	std::mutex mFreeMtx;
+	std::vector<cv::Mat> mFree; ///< Buffers returned by the workers for reuse
+
+	std::atomic<uint64_t> mSubmitted{ 0 };
+	std::atomic<uint64_t> mWritten{ 0 };
+	std::atomic<uint64_t> mDropped{ 0 };
+	std::atomic<uint64_t> mFailed{ 0 };
+	std::atomic<uint64_t> mBytes{ 0 };
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+/// \file
+/// \brief Vectorized preprocessing of 8-bit IR camera frames ahead of marker detection
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Instruction sets the kernels can use, in increasing order of preference
+enum class SimdLevel {
+	kScalar,
+	kSse2,
+	kAvx2,
+};
+
+auto simdLevelName(SimdLevel level) -> const char *;
+
+/// Best level supported by this CPU
+auto detectSimdLevel() -> SimdLevel;
+
+/// Level the kernels currently dispatch to; detectSimdLevel() until overridden
+auto activeSimdLevel() -> SimdLevel;
+
+/// Restrict the kernels to at most the given level, e.g. to benchmark the fallbacks
+///
+/// \return The level actually used, which is capped at detectSimdLevel()
+auto forceSimdLevel(SimdLevel level) -> SimdLevel;
+
+/// dst = max(light - dark, 0), removing ambient IR seen in the unlit frame
+auto subtractDarkFrame(const uint8_t *light, size_t lightStride, const uint8_t *dark, size_t darkStride,
+		uint8_t *dst, size_t dstStride, int width, int height) -> void;
+
+/// Pick the intensity range to stretch, ignoring clipFraction of the pixels at each end
+auto findStretchRange(const uint8_t *src, size_t stride, int width, int height, double clipFraction,
+		uint8_t &low, uint8_t &high) -> void;
+
+/// Map [low, high] linearly onto [0, 255], saturating outside it. src and dst may be the same.
+auto contrastStretch(const uint8_t *src, size_t srcStride, uint8_t *dst, size_t dstStride, int width,
+		int height, uint8_t low, uint8_t high) -> void;
+
+/// Average each 2x2 block into a (width / 2) x (height / 2) image, rounding to nearest
+auto downscaleBy2(const uint8_t *src, size_t srcStride, uint8_t *dst, size_t dstStride, int width,
+		int height) -> void;
+
+/// A tightly packed 8-bit image
+struct GrayImage {
+	std::vector<uint8_t> pixels;
+	int width = 0;
+	int height = 0;
+
+	auto resize(int newWidth, int newHeight) -> void {
+		width = newWidth;
+		height = newHeight;
+		pixels.resize(static_cast<size_t>(width) * height);
+	}
+
+	[[nodiscard]] auto data() -> uint8_t * {
+		return pixels.data();
+	}
+	[[nodiscard]] auto data() const -> const uint8_t * {
+		return pixels.data();
+	}
+	[[nodiscard]] auto stride() const -> size_t {
+		return static_cast<size_t>(width);
+	}
+};
+
+/// Runs the kernels on each camera frame, reusing its buffers between frames
+class IrPreprocessor {
+public:
+	struct Options {
+		bool stretch = true;
+		double clipFraction = 0.01; ///< Fraction of pixels allowed to saturate at each end
+		bool coarse = true; ///< Also produce a half resolution frame
+	};
+
+	IrPreprocessor() = default;
+	explicit IrPreprocessor(Options options) : mOptions(options) {}
+
+	/// Preprocess a lit frame, subtracting the matching unlit frame if there is one
+	auto process(const uint8_t *light, size_t lightStride, int width, int height,
+			const uint8_t *dark = nullptr, size_t darkStride = 0) -> void;
+
+	/// Full resolution result of the last process()
+	[[nodiscard]] auto frame() const -> const GrayImage & {
+		return mFrame;
+	}
+
+	/// Half resolution result of the last process(); empty unless Options::coarse is set
+	[[nodiscard]] auto coarseFrame() const -> const GrayImage & {
+		return mCoarse;
+	}
+
+private:
+	Options mOptions;
+	GrayImage mFrame;
+	GrayImage mCoarse;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+/// \file
+/// \brief 6DoF poses of detected ArUco markers in the gameboard frame
+
+#include "types.h"
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/// Pinhole model of the tracking camera, as written by cv::calibrateCamera tools
+struct CameraIntrinsics {
+	cv::Matx33d cameraMatrix;
+	std::vector<double> distCoeffs; ///< Empty or all zero for an undistorted camera
+
+	/// A distortion-free guess for a width x height camera with the given horizontal field of view.
+	/// Good enough to watch relative drift, not for absolute accuracy.
+	static auto approximate(int width, int height, double horizontalFovDegrees = 90.0) -> CameraIntrinsics;
+};
+
+/// Read `camera_matrix` and optionally `distortion_coefficients` from an OpenCV FileStorage file
+auto loadCameraIntrinsics(const std::string &path, CameraIntrinsics &intrinsics) -> bool;
+
+/// Pose of one marker for one frame
+struct MarkerPose {
+	int id = 0;
+	cv::Vec3d rvec; ///< Marker to OpenCV camera frame (x right, y down, z forward)
+	cv::Vec3d tvec;
+	T5_Vec3 posMKR_GBD{}; ///< Marker centre in the gameboard frame
+	T5_Quat rotToMKR_GBD{}; ///< Rotates GBD frame orientation to the marker's (z out of its face)
+	double reprojectionError = 0.0; ///< RMS over the four corners, in pixels
+	bool fromGuess = false; ///< The previous frame's solution chose between ambiguous solutions
+};
+
+/// All marker poses from one camera frame
+struct MarkerPoseFrame {
+	uint64_t frame = 0;
+	uint64_t timestampNanos = 0;
+	T5_Vec3 posCAM_GBD{};
+	T5_Quat rotToCAM_GBD{};
+	std::vector<MarkerPose> markers;
+};
+
+/// Receives marker poses frame by frame
+class MarkerPoseSink {
+public:
+	virtual ~MarkerPoseSink() = default;
+
+	virtual auto write(const MarkerPoseFrame &poses) -> bool = 0;
+};
+
+/// Writes one CSV row per marker per frame:
+/// `frame,timestamp_ns,id,x,y,z,qw,qx,qy,qz,reprojection_px,guess`, positions in the GBD frame
+class CsvMarkerPoseSink : public MarkerPoseSink {
+public:
+	explicit CsvMarkerPoseSink(std::string path) : mPath(std::move(path)) {}
+
+	auto write(const MarkerPoseFrame &poses) -> bool override;
+
+private:
+	const std::string mPath;
+	std::ofstream mOut;
+};
+
+/// Solves PnP for every marker of a frame and expresses the results in the gameboard frame
+///
+/// Each marker is solved with the analytic SOLVEPNP_IPPE_SQUARE, which is several times faster
+/// than iterating from a guess. A square seen nearly face-on has two solutions with similar
+/// reprojection error, though, so while a marker stays in view its previous solution is used to
+/// pick the one it is closest to rather than letting the pose flip between them.
+///
+/// The tracking camera's pose from T5_CamImage is taken to follow the NDK's usual axes (x right,
+/// y up, z backward), so OpenCV's camera frame is flipped about x before applying it.
+class MarkerPoseEstimator {
+public:
+	struct Options {
+		double markerLength = 200 / 300.0 * 0.0254; ///< Side of the black square in metres; opencv-aruco's default sheet
+		bool useGuess = true; ///< Let the last solution decide between ambiguous solutions
+		int maxGuessAge = 3; ///< Frames a marker can go unseen before its last solution is forgotten
+		double ambiguityRatio = 3.0; ///< Solutions whose errors are within this factor are ambiguous
+	};
+
+	MarkerPoseEstimator(CameraIntrinsics intrinsics, Options options);
+
+	/// Estimate poses for markers detected in one frame; corners are clockwise from top-left
+	auto estimate(const std::vector<int> &ids, const std::vector<std::vector<cv::Point2f>> &corners,
+			const T5_Vec3 &posCAM_GBD, const T5_Quat &rotToCAM_GBD, uint64_t timestampNanos)
+			-> const MarkerPoseFrame &;
+
+	[[nodiscard]] auto poses() const -> const MarkerPoseFrame & {
+		return mPoses;
+	}
+	[[nodiscard]] auto intrinsics() const -> const CameraIntrinsics & {
+		return mIntrinsics;
+	}
+	[[nodiscard]] auto options() const -> const Options & {
+		return mOptions;
+	}
+
+private:
+	struct Guess {
+		cv::Matx33d rotation;
+		uint64_t frame = 0;
+	};
+
+	CameraIntrinsics mIntrinsics;
+	Options mOptions;
+	bool mDistorted = false;
+	std::vector<cv::Point3f> mObjectPoints;
+	std::vector<cv::Point2f> mImagePoints;
+	std::vector<cv::Vec3d> mRvecs;
+	std::vector<cv::Vec3d> mTvecs;
+	std::vector<double> mErrors;
+	std::map<int, Guess> mGuesses;
+	MarkerPoseFrame mPoses;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+/// \file
+/// \brief Headless batch rendering of ArUco marker sheets
+
+#include "pdf-writer.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <string>
+#include <vector>
+
+/// Geometry of a page of markers, in pixels
+struct MarkerSheetLayout {
+	int rows = 6;
+	int cols = 5;
+	int markerSidePx = 200; ///< Marker side, including the black border
+	int cellSidePx = 220; ///< Pitch between neighbouring markers
+	int marginPx = 20; ///< Page margin around the grid
+	int borderBits = 1; ///< 1 to kArucoMaxBorderBits
+	double dpi = 300.0; ///< Only used to size PDF pages
+	int pageWidthPx = 0; ///< 0 sizes the page to fit the grid
+	int pageHeightPx = 0; ///< 0 sizes the page to fit the grid
+
+	[[nodiscard]] auto markersPerPage() const -> int {
+		return rows * cols;
+	}
+
+	[[nodiscard]] auto pageSize() const -> cv::Size;
+
+	/// Check the grid fits on the page; describes the problem in err if not
+	[[nodiscard]] auto validate(std::string &err) const -> bool;
+
+	/// Size the grid to fill a page of the given pixel dimensions, keeping the current rows,
+	/// columns and margin. Markers are rounded down to a whole number of pixels per bit.
+	auto fitToPage(cv::Size pagePx, int bitsPerSide) -> void;
+};
+
+/// Parse a marker id list such as "0-29,40,50-60"
+///
+/// \param[in]  spec           - Comma separated ids and inclusive ranges
+/// \param[in]  dictionarySize - Ids must be below this
+/// \param[out] ids            - Parsed ids, in the order given
+auto parseMarkerIds(const std::string &spec, int dictionarySize, std::vector<int> &ids) -> bool;
+
+/// Renders pages of DICT_6X6_250 markers into an 8-bit canvas
+class MarkerSheetRenderer {
+public:
+	explicit MarkerSheetRenderer(MarkerSheetLayout layout) : mLayout(layout) {}
+
+	[[nodiscard]] auto layout() const -> const MarkerSheetLayout & {
+		return mLayout;
+	}
+
+	/// Render up to markersPerPage() ids into page, with cells rendered in parallel
+	///
+	/// \param[in,out] page - Reallocated as a CV_8UC1 page if its size or type is wrong
+	auto renderPage(const int *ids, size_t count, cv::Mat &page) const -> void;
+
+private:
+	const MarkerSheetLayout mLayout;
+};
+
+/// Receives rendered pages, in order
+class MarkerSheetSink {
+public:
+	virtual ~MarkerSheetSink() = default;
+
+	virtual auto begin(size_t pageCount) -> bool = 0;
+	virtual auto writePage(const cv::Mat &page, size_t pageIndex) -> bool = 0;
+	virtual auto finish() -> bool = 0;
+};
+
+/// Writes each page to its own PNG: `<prefix>.png` for a single page, else `<prefix>-NNN.png`
+class PngSheetSink : public MarkerSheetSink {
+public:
+	explicit PngSheetSink(std::string prefix) : mPrefix(std::move(prefix)) {}
+
+	auto begin(size_t pageCount) -> bool override;
+	auto writePage(const cv::Mat &page, size_t pageIndex) -> bool override;
+	auto finish() -> bool override {
+		return true;
+	}
+
+private:
+	const std::string mPrefix;
+	size_t mPageCount = 0;
+};
+
+/// Streams all pages into a single PDF
+class PdfSheetSink : public MarkerSheetSink {
+public:
+	PdfSheetSink(std::string path, double dpi) : mPath(std::move(path)), mDpi(dpi) {}
+
+	auto begin(size_t pageCount) -> bool override;
+	auto writePage(const cv::Mat &page, size_t pageIndex) -> bool override;
+	auto finish() -> bool override;
+
+private:
+	const std::string mPath;
+	const double mDpi;
+	PdfWriter mWriter;
+};
+
+/// Render ids onto as many pages as needed and pass them to sink
+///
+/// Encoding of each page overlaps rendering of the next, and only two page buffers are live at
+/// any time, so memory use is independent of the page count.
+auto generateMarkerSheets(const MarkerSheetRenderer &renderer, const std::vector<int> &ids,
+		MarkerSheetSink &sink) -> bool;
@@ -0,0 +1,47 @@
+#pragma once
+
+/// \file
+/// \brief Minimal HTTP endpoint serving a MetricsRegistry for Prometheus to scrape
+
+#include "metrics.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+/// Serves `GET /metrics` on a loopback TCP port from a background thread
+///
+/// Requests are handled one at a time on the server's own thread; rendering only takes the
+/// registry's registration lock, never anything the capture loop waits on.
+class MetricsServer {
+public:
+	explicit MetricsServer(const MetricsRegistry &registry) : mRegistry(registry) {}
+	~MetricsServer();
+
+	MetricsServer(const MetricsServer &) = delete;
+	auto operator=(const MetricsServer &) -> MetricsServer & = delete;
+
+	/// Listen on address:port and start serving
+	///
+	/// \param[in] port    - 0 picks a free port; see port()
+	/// \param[in] address - IPv4 address to bind; the default only accepts local scrapes
+	auto start(uint16_t port, const std::string &address = "127.0.0.1") -> bool;
+
+	auto stop() -> void;
+
+	/// The port actually listened on
+	[[nodiscard]] auto port() const -> uint16_t {
+		return mPort;
+	}
+
+private:
+	auto serve() -> void;
+	auto handle(intptr_t client) -> void;
+
+	const MetricsRegistry &mRegistry;
+	intptr_t mListener = -1; ///< Socket handle; SOCKET on Windows, a file descriptor elsewhere
+	uint16_t mPort = 0;
+	std::atomic<bool> mStop{ false };
+	std::thread mThread;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+/// \file
+/// \brief Counters, gauges and histograms for long-running diagnostics, in Prometheus text format
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Label name and value pairs, e.g. `{ { "error", "Try Again" } }`
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+/// Monotonic count; add() is a single relaxed atomic increment
+class MetricCounter {
+public:
+	auto add(uint64_t value = 1) -> void {
+		mValue.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] auto value() const -> uint64_t {
+		return mValue.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<uint64_t> mValue{ 0 };
+};
+
+/// Value that can go up and down
+class MetricGauge {
+public:
+	auto set(double value) -> void {
+		mValue.store(value, std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] auto value() const -> double {
+		return mValue.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<double> mValue{ 0.0 };
+};
+
+/// Distribution over fixed buckets; observe() touches three atomics and never locks
+class MetricHistogram {
+public:
+	/// \param bounds - Upper bucket bounds in increasing order; +Inf is implied
+	explicit MetricHistogram(std::vector<double> bounds);
+
+	auto observe(double value) -> void;
+
+	[[nodiscard]] auto bounds() const -> const std::vector<double> & {
+		return mBounds;
+	}
+
+	/// Observations at or below each bound, then the total count for +Inf
+	[[nodiscard]] auto cumulativeCounts() const -> std::vector<uint64_t>;
+
+	[[nodiscard]] auto sum() const -> double {
+		return mSum.load(std::memory_order_relaxed);
+	}
+
+private:
+	const std::vector<double> mBounds;
+	std::unique_ptr<std::atomic<uint64_t>[]> mBuckets; ///< One per bound plus +Inf, not cumulative
+	std::atomic<double> mSum{ 0.0 };
+};
+
+/// Owns all metrics of a run and renders them for scraping
+///
+/// Registering takes a lock and returns a reference that stays valid for the registry's lifetime,
+/// so hot loops look their metrics up once and then update them without locking. Registering the
+/// same name and labels again returns the existing metric.
+class MetricsRegistry {
+public:
+	auto counter(const std::string &name, const std::string &help, const MetricLabels &labels = {})
+			-> MetricCounter &;
+	auto gauge(const std::string &name, const std::string &help, const MetricLabels &labels = {}) -> MetricGauge &;
+	auto histogram(const std::string &name, const std::string &help, std::vector<double> bounds,
+			const MetricLabels &labels = {}) -> MetricHistogram &;
+
+	/// Everything registered so far, in Prometheus text exposition format 0.0.4
+	[[nodiscard]] auto render() const -> std::string;
+
+private:
+	enum class Type {
+		kCounter,
+		kGauge,
+		kHistogram,
+	};
+
+	struct Entry {
+		std::string name;
+		std::string help;
+		Type type;
+		MetricLabels labels;
+		std::unique_ptr<MetricCounter> counter;
+		std::unique_ptr<MetricGauge> gauge;
+		std::unique_ptr<MetricHistogram> histogram;
+	};
+
+	auto find(const std::string &name, Type type, const MetricLabels &labels) -> Entry *;
+
+	mutable std::mutex mMtx;
+	std::deque<Entry> mEntries; ///< In registration order; metrics of one name render together
+};
+
+/// Counters of one name split by a single label, for one thread's hot loop
+///
+/// Keeps its own map from a small integer key, such as an error code value, to the registered
+/// counter, so only the first occurrence of each key takes the registry's lock or builds the label.
+/// Not thread-safe; give each thread its own family.
+class MetricCounterFamily {
+public:
+	MetricCounterFamily(MetricsRegistry &registry, std::string name, std::string help, std::string labelName)
+		: mRegistry(registry), mName(std::move(name)), mHelp(std::move(help)), mLabelName(std::move(labelName)) {}
+
+	/// \param labelValue - Called the first time key is seen, to make its label value
+	template <typename LabelFn>
+	auto get(int key, LabelFn &&labelValue) -> MetricCounter & {
+		auto it = mCounters.find(key);
+		if (it == mCounters.end()) {
+			MetricCounter &counter = mRegistry.counter(mName, mHelp, { { mLabelName, labelValue() } });
+			it = mCounters.emplace(key, &counter).first;
+		}
+		return *it->second;
+	}
+
+private:
+	MetricsRegistry &mRegistry;
+	const std::string mName;
+	const std::string mHelp;
+	const std::string mLabelName;
+	std::map<int, MetricCounter *> mCounters;
+};
+
+/// Bucket bounds for latencies in seconds, from 100 us to 1 s
+auto latencyBuckets() -> std::vector<double>;
@@ -0,0 +1,54 @@
+#pragma once
+
+/// \file
+/// \brief Streaming writer for multi-page PDFs of 8-bit grayscale images
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// Writes one full-page grayscale image per PDF page.
+///
+/// Each page is encoded and written as soon as it's added, so memory use doesn't grow with the
+/// page count. Images are stored with the PDF RunLengthDecode filter, which suits the large flat
+/// areas of marker sheets and needs no external compression library.
+class PdfWriter {
+public:
+	PdfWriter() = default;
+	PdfWriter(const PdfWriter &) = delete;
+	auto operator=(const PdfWriter &) -> PdfWriter & = delete;
+	~PdfWriter();
+
+	/// Create the file and write the PDF header
+	auto open(const std::string &path) -> bool;
+
+	/// Append a page showing the image at the given resolution
+	///
+	/// \param[in] pixels - Top-left first, one byte per pixel
+	/// \param[in] stride - Bytes between the start of consecutive rows
+	/// \param[in] dpi    - Pixels per inch, used to size the page
+	auto addGrayPage(const uint8_t *pixels, int width, int height, size_t stride, double dpi) -> bool;
+
+	/// Write the page tree, cross-reference table and trailer
+	auto close() -> bool;
+
+	[[nodiscard]] auto pageCount() const -> size_t {
+		return mPageObjects.size();
+	}
+
+private:
+	auto beginObject(int objectNumber) -> void;
+	auto allocateObject() -> int;
+	auto write(const std::string &text) -> void;
+	auto write(const uint8_t *data, size_t size) -> void;
+
+	static constexpr int kCatalogObject = 1;
+	static constexpr int kPagesObject = 2;
+
+	std::ofstream mOut;
+	uint64_t mOffset = 0;
+	std::vector<uint64_t> mObjectOffsets; // indexed by object number, 0 unused
+	std::vector<int> mPageObjects;
+	std::vector<uint8_t> mEncodeBuffer;
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+/// \file
+/// \brief Online jitter, drift and dropout statistics over a stream of glasses poses
+///
+/// Everything is kept as running moments, so memory stays constant however long a session runs
+/// and adding a pose never allocates.
+
+#include "types.h"
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+/// Running mean and variance by Welford's method, plus extremes
+class RunningStats {
+public:
+	auto add(double value) -> void {
+		mCount++;
+		double delta = value - mMean;
+		mMean += delta / static_cast<double>(mCount);
+		mM2 += delta * (value - mMean);
+		mMin = (value < mMin) ? value : mMin;
+		mMax = (value > mMax) ? value : mMax;
+	}
+
+	auto reset() -> void {
+		*this = RunningStats();
+	}
+
+	[[nodiscard]] auto count() const -> uint64_t {
+		return mCount;
+	}
+
+	[[nodiscard]] auto mean() const -> double {
+		return mMean;
+	}
+
+	/// Sample variance; 0 below two values
+	[[nodiscard]] auto variance() const -> double {
+		return (mCount > 1) ? mM2 / static_cast<double>(mCount - 1) : 0.0;
+	}
+
+	[[nodiscard]] auto stddev() const -> double;
+
+	/// 0 before the first value
+	[[nodiscard]] auto min() const -> double {
+		return mCount ? mMin : 0.0;
+	}
+
+	[[nodiscard]] auto max() const -> double {
+		return mCount ? mMax : 0.0;
+	}
+
+private:
+	uint64_t mCount = 0;
+	double mMean = 0.0;
+	double mM2 = 0.0;
+	double mMin = std::numeric_limits<double>::infinity();
+	double mMax = -std::numeric_limits<double>::infinity();
+};
+
+/// Least-squares slope of a value over time, from running co-moments
+class RunningTrend {
+public:
+	auto add(double time, double value) -> void {
+		mCount++;
+		double dt = time - mMeanTime;
+		mMeanTime += dt / static_cast<double>(mCount);
+		mMeanValue += (value - mMeanValue) / static_cast<double>(mCount);
+		mCovariance += dt * (value - mMeanValue);
+		mTimeM2 += dt * (time - mMeanTime);
+	}
+
+	auto reset() -> void {
+		*this = RunningTrend();
+	}
+
+	/// Change in value per unit of time; 0 until the times differ
+	[[nodiscard]] auto slope() const -> double {
+		return (mTimeM2 > 0.0) ? mCovariance / mTimeM2 : 0.0;
+	}
+
+private:
+	uint64_t mCount = 0;
+	double mMeanTime = 0.0;
+	double mMeanValue = 0.0;
+	double mCovariance = 0.0;
+	double mTimeM2 = 0.0;
+};
+
+/// Tracking quality of one pose stream
+///
+/// Jitter is the spread of the change between consecutive poses, so steady motion doesn't count
+/// as jitter but noise does. Drift is the least-squares trend of position, and of the angle away
+/// from the first pose, over the pose timestamps; both are only meaningful while the glasses are
+/// held still. Poses repeating the previous timestamp are counted and otherwise ignored.
+class PoseAnalyzer {
+public:
+	/// Feed a pose read successfully
+	auto addPose(const T5_GlassesPose &pose) -> void;
+
+	/// Feed an expected pose that wasn't available (Error::kTryAgain), once per missed sample
+	/// period rather than per read; consecutive ones form a dropout streak
+	auto addDropout() -> void;
+
+	/// Forget everything, e.g. to start the next reporting window
+	auto reset() -> void;
+
+	[[nodiscard]] auto poses() const -> uint64_t {
+		return mPoses;
+	}
+
+	[[nodiscard]] auto repeats() const -> uint64_t {
+		return mRepeats;
+	}
+
+	/// Where the glasses were, per axis (0 = x, 1 = y, 2 = z), in meters
+	[[nodiscard]] auto position(int axis) const -> const RunningStats & {
+		return mPosition[axis];
+	}
+
+	/// Change between consecutive poses, per axis, in meters
+	[[nodiscard]] auto positionJitter(int axis) const -> const RunningStats & {
+		return mPositionStep[axis];
+	}
+
+	/// Meters per second
+	[[nodiscard]] auto positionDrift(int axis) const -> double {
+		return mPositionTrend[axis].slope();
+	}
+
+	/// Rotation between consecutive poses, in radians
+	[[nodiscard]] auto angularJitter() const -> const RunningStats & {
+		return mAngleStep;
+	}
+
+	/// Radians per second away from the first pose's orientation
+	[[nodiscard]] auto angularDrift() const -> double {
+		return mAngleTrend.slope();
+	}
+
+	/// Time between consecutive distinct poses, in seconds
+	[[nodiscard]] auto interval() const -> const RunningStats & {
+		return mInterval;
+	}
+
+	/// Lengths of finished dropout streaks, in missed samples
+	[[nodiscard]] auto dropoutStreaks() const -> const RunningStats & {
+		return mStreaks;
+	}
+
+	[[nodiscard]] auto dropouts() const -> uint64_t {
+		return mDropouts;
+	}
+
+	/// Longest streak so far, including one still running
+	[[nodiscard]] auto longestDropout() const -> uint64_t;
+
+	/// A few lines in millimeters, degrees and milliseconds
+	auto report(std::ostream &out) const -> void;
+
+private:
+	bool mHavePrevious = false;
+	T5_GlassesPose mPrevious{};
+	T5_Quat mFirstRotation{};
+	uint64_t mFirstTimestamp = 0;
+	uint64_t mPoses = 0;
+	uint64_t mRepeats = 0;
+
+	RunningStats mPosition[3];
+	RunningStats mPositionStep[3];
+	RunningTrend mPositionTrend[3];
+	RunningStats mAngleStep;
+	RunningTrend mAngleTrend;
+	RunningStats mInterval;
+
+	uint64_t mDropouts = 0;
+	uint64_t mStreak = 0;
+	RunningStats mStreaks;
+};
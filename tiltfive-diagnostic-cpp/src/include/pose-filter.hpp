@@ -0,0 +1,130 @@
+#pragma once
+
+/// \file
+/// \brief One-Euro and constant-velocity Kalman smoothing of glasses poses, with prediction
+///
+/// A pose is filtered as seven independent channels: the three position coordinates and the four
+/// rotation quaternion components. Each measured quaternion is first flipped onto the same
+/// hemisphere as the filtered one, so q and -q never pull against each other, and the rotation is
+/// renormalized on the way out. The filters keep a rate of change per channel, so a pose can be
+/// predicted at any timestamp, e.g. when a spectator view renders, without asking the service.
+///
+/// PoseFilterBank keeps the state of many glasses structure-of-arrays, channel by channel, so one
+/// update runs the same arithmetic across every pair of glasses with AVX2 where available.
+/// Nothing allocates after construction.
+
+#include "types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class PoseFilterType {
+	kOneEuro, ///< Adaptive low-pass: smooth when still, responsive when moving
+	kKalman, ///< Constant-velocity Kalman filter per channel
+};
+
+/// One-Euro filter parameters (Casiez et al., CHI 2012)
+struct OneEuroParams {
+	float minCutoff; ///< Hz; lower smooths more while still
+	float beta; ///< Cutoff increase per unit/s of speed; higher lags less while moving
+	float derivativeCutoff; ///< Hz, for the speed estimate
+};
+
+/// Constant-velocity Kalman filter parameters
+struct KalmanParams {
+	float processNoise; ///< Spectral density of the unmodelled acceleration, units^2/s^3
+	float measurementNoise; ///< Variance of one measurement, units^2
+};
+
+struct PoseFilterOptions {
+	PoseFilterType type = PoseFilterType::kOneEuro;
+
+	// Starting points for a seated spectator view; position is in meters, rotation in quaternion
+	// components (about 0.5 per radian for small angles). With these the One-Euro filter lags a
+	// 0.5 m/s walk by about 4 mm.
+	OneEuroParams positionOneEuro{ 1.5f, 40.0f, 1.0f };
+	OneEuroParams rotationOneEuro{ 1.5f, 40.0f, 1.0f };
+	KalmanParams positionKalman{ 5.0f, 2.5e-7f };
+	KalmanParams rotationKalman{ 10.0f, 1e-7f };
+
+	/// Predictions further than this from the last measurement are held at this horizon
+	double maxPredictionSeconds = 0.1;
+};
+
+/// Smoothing and prediction state of several glasses
+class PoseFilterBank {
+public:
+	static constexpr int kChannels = 7; ///< Position x, y, z then rotation w, x, y, z
+
+	PoseFilterBank(size_t glassesCount, PoseFilterOptions options = {});
+
+	[[nodiscard]] auto size() const -> size_t {
+		return mCount;
+	}
+
+	/// Feed a measurement for one pair of glasses
+	///
+	/// Poses not newer than the last one fed for those glasses are ignored.
+	auto update(size_t glasses, const T5_GlassesPose &pose) -> void;
+
+	/// Feed one measurement per pair of glasses, poses[i] for glasses i, in one vectorized pass
+	auto updateAll(const T5_GlassesPose *poses) -> void;
+
+	/// The filtered pose extrapolated to a timestamp, in the clock of T5_GlassesPose::timestampNanos
+	///
+	/// Before the first measurement this is a zero pose with an identity rotation.
+	[[nodiscard]] auto predict(size_t glasses, uint64_t timestampNanos) const -> T5_GlassesPose;
+
+	/// predict() for every pair of glasses into out[0, size())
+	auto predictAll(uint64_t timestampNanos, T5_GlassesPose *out) const -> void;
+
+	/// Forget one pair of glasses, e.g. after tracking was lost
+	auto reset(size_t glasses) -> void;
+
+private:
+	auto stage(size_t glasses, const T5_GlassesPose &pose) -> void;
+	auto run(size_t begin, size_t end) -> void;
+	auto lane(int channel, size_t glasses) const -> size_t {
+		return static_cast<size_t>(channel) * mStride + glasses;
+	}
+
+	const size_t mCount;
+	const size_t mStride; ///< mCount rounded up to a whole number of vectors
+	const PoseFilterOptions mOptions;
+
+	// Per glasses
+	std::vector<uint64_t> mTimestamp; ///< Of the last measurement used, 0 before the first
+	std::vector<T5_GameboardType> mGameboard;
+	std::vector<float> mDt; ///< Seconds since the previous measurement, 0 to leave unchanged
+
+	// Per lane, channel-major
+	std::vector<float> mMeasured;
+	std::vector<float> mPrevious; ///< The measurement before, for the One-Euro speed estimate
+	std::vector<float> mValue;
+	std::vector<float> mRate; ///< Units per second
+	std::vector<float> mP00; ///< Kalman covariance of value, value-rate and rate
+	std::vector<float> mP01;
+	std::vector<float> mP11;
+};
+
+/// PoseFilterBank for a single pair of glasses
+class PoseFilter {
+public:
+	explicit PoseFilter(PoseFilterOptions options = {}) : mBank(1, options) {}
+
+	auto update(const T5_GlassesPose &pose) -> void {
+		mBank.update(0, pose);
+	}
+
+	[[nodiscard]] auto predict(uint64_t timestampNanos) const -> T5_GlassesPose {
+		return mBank.predict(0, timestampNanos);
+	}
+
+	auto reset() -> void {
+		mBank.reset(0);
+	}
+
+private:
+	PoseFilterBank mBank;
+};
@@ -19,8 +19,14 @@
 /// \file
 /// \brief C++ Templated common return type for the Tilt Five™ API
 
+#include "errors.hpp"
+
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 namespace tiltfive {
 
@@ -32,19 +38,46 @@ public:
     ~BadResultAccess() noexcept override = default;
 };
 
-/// Templated return type with support for error conditions
+template <typename T, typename Enable = void>
+class Result;
+
+/// \private
+template <typename T>
+struct IsResult : std::false_type {};
+
+/// \private
+template <typename T, typename Enable>
+struct IsResult<Result<T, Enable>> : std::true_type {};
+
+/// \brief Selects the compact tiltfive::Result representation for a payload type
+///
+/// Trivially copyable payloads (::T5_GlassesPose, ::T5_WandReport, scalars...) default to the
+/// compact representation. It is chosen for trivial copyability rather than size: poses and wand
+/// reports come out the same size either way, but only the compact result copies with a memcpy.
+/// Specialize to std::false_type to opt a type out.
 template <typename T>
+struct UseCompactResult
+    : std::integral_constant<bool,
+                             std::is_trivially_copyable<T>::value &&
+                                 std::is_trivially_destructible<T>::value &&
+                                 std::is_copy_constructible<T>::value> {};
+
+/// Templated return type with support for error conditions
+template <typename T, typename Enable>
 class [[nodiscard]] Result {
 public:
     using Value = T;
 
-    Result(Value&& value) noexcept : mValue(std::move(value)), mErrFlags(kErrFlagsNone) {}
+    Result(Value&& value) noexcept(std::is_nothrow_move_constructible<Value>::value)
+        : mValue(std::move(value)), mErrFlags(kErrFlagsNone) {}
 
-    Result(const Value& value) : mValue(value), mErrFlags(kErrFlagsNone) {}
+    Result(const Value& value) noexcept(std::is_nothrow_copy_constructible<Value>::value)
+        : mValue(value), mErrFlags(kErrFlagsNone) {}
 
     Result(std::error_code err) noexcept : mErr(err), mErrFlags(kErrFlagHaveErr) {}
 
-    Result(Result&& other) : mErrFlags(other.mErrFlags) {
+    Result(Result&& other) noexcept(std::is_nothrow_move_constructible<Value>::value)
+        : mErrFlags(other.mErrFlags) {
         if (mErrFlags == kErrFlagsNone) {
             new (&mValue) Value(std::move(other.mValue));
         } else {
@@ -52,7 +85,8 @@ public:
         }
     }
 
-    Result(const Result& other) noexcept : mErrFlags(other.mErrFlags) {
+    Result(const Result& other) noexcept(std::is_nothrow_copy_constructible<Value>::value)
+        : mErrFlags(other.mErrFlags) {
         if (mErrFlags == kErrFlagsNone) {
             new (&mValue) Value(other.mValue);
         } else {
@@ -76,7 +110,9 @@ public:
         }
     }
 
-    auto operator=(Result&& other) noexcept -> Result& {
+    auto operator=(Result&& other) noexcept(std::is_nothrow_move_constructible<Value>::value &&
+                                            std::is_nothrow_move_assignable<Value>::value)
+        -> Result& {
         if (mErrFlags == kErrFlagsNone) {
             if (other.mErrFlags == kErrFlagsNone) {
                 mValue = std::move(other.mValue);
@@ -97,7 +133,9 @@ public:
         return *this;
     }
 
-    auto operator=(const Result& other) -> Result& {
+    auto operator=(const Result& other) noexcept(
+        std::is_nothrow_copy_constructible<Value>::value &&
+        std::is_nothrow_copy_assignable<Value>::value) -> Result& {
         if (mErrFlags == kErrFlagsNone) {
             if (other.mErrFlags == kErrFlagsNone) {
                 mValue = other.mValue;
@@ -165,6 +203,103 @@ public:
         return (mErrFlags & kErrFlagSkipped) != 0;
     }
 
+    /// \brief Obtain the contained value, or \p defaultValue if this holds an error
+    template <typename U>
+    auto value_or(U&& defaultValue) const& -> Value {
+        if (mErrFlags != kErrFlagsNone) {
+            return static_cast<Value>(std::forward<U>(defaultValue));
+        }
+        return mValue;
+    }
+
+    /// \brief Obtain the contained value, or \p defaultValue if this holds an error
+    template <typename U>
+    auto value_or(U&& defaultValue) && -> Value {
+        if (mErrFlags != kErrFlagsNone) {
+            return static_cast<Value>(std::forward<U>(defaultValue));
+        }
+        return std::move(mValue);
+    }
+
+    /// \brief Transform the contained value, passing any error through unchanged
+    ///
+    /// \param[in] f - Callable taking the value. Its return type U gives a Result<U>; a callable
+    ///                returning void gives a Result<void>.
+    template <typename F>
+    auto map(F&& f) const& -> Result<std::invoke_result_t<F, const Value&>> {
+        using U = std::invoke_result_t<F, const Value&>;
+        if (mErrFlags != kErrFlagsNone) {
+            return mErr;
+        }
+        if constexpr (std::is_void<U>::value) {
+            std::forward<F>(f)(mValue);
+            return Result<U>{};
+        } else {
+            return std::forward<F>(f)(mValue);
+        }
+    }
+
+    /// \brief Transform the contained value, passing any error through unchanged
+    template <typename F>
+    auto map(F&& f) && -> Result<std::invoke_result_t<F, Value&&>> {
+        using U = std::invoke_result_t<F, Value&&>;
+        if (mErrFlags != kErrFlagsNone) {
+            return mErr;
+        }
+        if constexpr (std::is_void<U>::value) {
+            std::forward<F>(f)(std::move(mValue));
+            return Result<U>{};
+        } else {
+            return std::forward<F>(f)(std::move(mValue));
+        }
+    }
+
+    /// \brief Chain a fallible operation on the contained value
+    ///
+    /// \param[in] f - Callable taking the value and returning a tiltfive::Result. Not called if
+    ///                this holds an error, in which case the error is passed through.
+    template <typename F>
+    auto and_then(F&& f) const& -> std::invoke_result_t<F, const Value&> {
+        using R = std::invoke_result_t<F, const Value&>;
+        static_assert(IsResult<R>::value, "and_then() callable must return a tiltfive::Result");
+        if (mErrFlags != kErrFlagsNone) {
+            return R(mErr);
+        }
+        return std::forward<F>(f)(mValue);
+    }
+
+    /// \brief Chain a fallible operation on the contained value
+    template <typename F>
+    auto and_then(F&& f) && -> std::invoke_result_t<F, Value&&> {
+        using R = std::invoke_result_t<F, Value&&>;
+        static_assert(IsResult<R>::value, "and_then() callable must return a tiltfive::Result");
+        if (mErrFlags != kErrFlagsNone) {
+            return R(mErr);
+        }
+        return std::forward<F>(f)(std::move(mValue));
+    }
+
+    /// \brief Handle an error, passing any value through unchanged
+    ///
+    /// \param[in] f - Callable taking the std::error_code and returning a Result convertible to
+    ///                this type (a recovered value or another error).
+    template <typename F>
+    auto or_else(F&& f) const& -> Result {
+        if (mErrFlags != kErrFlagsNone) {
+            return std::forward<F>(f)(mErr);
+        }
+        return *this;
+    }
+
+    /// \brief Handle an error, passing any value through unchanged
+    template <typename F>
+    auto or_else(F&& f) && -> Result {
+        if (mErrFlags != kErrFlagsNone) {
+            return std::forward<F>(f)(mErr);
+        }
+        return std::move(*this);
+    }
+
 private:
     [[noreturn]] void throwBadResultAccess() const {
 #if (__has_feature__cxx_exceptions)
@@ -204,7 +339,7 @@ public:
 
     Result(std::error_code err) noexcept : mErr(err), mErrFlags(kErrFlagHaveErr) {}
 
-    Result(Result&& other) : mErrFlags(other.mErrFlags) {
+    Result(Result&& other) noexcept : mErrFlags(other.mErrFlags) {
         if (mErrFlags != kErrFlagsNone) {
             new (&mErr) std::error_code(other.mErr);
         }
@@ -232,7 +367,7 @@ public:
         }
     }
 
-    auto operator=(Result&& other) -> Result& {
+    auto operator=(Result&& other) noexcept -> Result& {
         if (mErrFlags == kErrFlagsNone) {
             if (other.mErrFlags != kErrFlagsNone) {
                 new (&mErr) std::error_code(other.mErr);
@@ -249,7 +384,7 @@ public:
         return *this;
     }
 
-    auto operator=(const Result& other) -> Result& {
+    auto operator=(const Result& other) noexcept -> Result& {
         if (mErrFlags == kErrFlagsNone) {
             if (other.mErrFlags != kErrFlagsNone) {
                 new (&mErr) std::error_code(other.mErr);
@@ -266,7 +401,7 @@ public:
         return *this;
     }
 
-    auto operator=(success_t) -> Result& {
+    auto operator=(success_t) noexcept -> Result& {
         if (mErrFlags != kErrFlagsNone) {
             using std::error_code;
             mErr.~error_code();
@@ -298,6 +433,48 @@ public:
         return (mErrFlags & kErrFlagSkipped) != 0;
     }
 
+    /// \brief Run a function on success, passing any error through unchanged
+    ///
+    /// \param[in] f - Callable taking no arguments. Its return type U gives a Result<U>.
+    template <typename F>
+    auto map(F&& f) const -> Result<std::invoke_result_t<F>> {
+        using U = std::invoke_result_t<F>;
+        if (mErrFlags != kErrFlagsNone) {
+            return mErr;
+        }
+        if constexpr (std::is_void<U>::value) {
+            std::forward<F>(f)();
+            return Result{};
+        } else {
+            return std::forward<F>(f)();
+        }
+    }
+
+    /// \brief Chain a fallible operation on success
+    ///
+    /// \param[in] f - Callable taking no arguments and returning a tiltfive::Result. Not called
+    ///                if this holds an error, in which case the error is passed through.
+    template <typename F>
+    auto and_then(F&& f) const -> std::invoke_result_t<F> {
+        using R = std::invoke_result_t<F>;
+        static_assert(IsResult<R>::value, "and_then() callable must return a tiltfive::Result");
+        if (mErrFlags != kErrFlagsNone) {
+            return R(mErr);
+        }
+        return std::forward<F>(f)();
+    }
+
+    /// \brief Handle an error, passing success through unchanged
+    ///
+    /// \param[in] f - Callable taking the std::error_code and returning a Result<void>.
+    template <typename F>
+    auto or_else(F&& f) const -> Result {
+        if (mErrFlags != kErrFlagsNone) {
+            return std::forward<F>(f)(mErr);
+        }
+        return *this;
+    }
+
 private:
     [[noreturn]] static void throwBadResultAccess() {
 #if (__has_feature__cxx_exceptions)
@@ -323,6 +500,241 @@ private:
 /// Indicates 'success' for a Result<void> function
 static constexpr success_t kSuccess{success_t::Construct::kToken};
 
+namespace details {
+
+// Error categories seen by compact results, so the category can be stored as a 4 bit index.
+// Index 0 is always the Tilt Five category. Work around the lack of inline variable support.
+template <typename Dummy>
+struct CompactErrorCategories {
+    static constexpr uint8_t kCapacity = 16;
+
+    static std::atomic<const std::error_category*> kSlots[kCapacity];
+
+    // Returns kCapacity if the registry is full
+    static auto indexOf(const std::error_category& category) noexcept -> uint8_t {
+        if (&category == &ErrorCategory<void>::kSingleton) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < kCapacity; i++) {
+            const std::error_category* slot = kSlots[i].load(std::memory_order_acquire);
+            if (slot == nullptr) {
+                if (kSlots[i].compare_exchange_strong(slot, &category)) {
+                    return i;
+                }
+            }
+            if (slot == &category) {
+                return i;
+            }
+        }
+        return kCapacity;
+    }
+
+    static auto at(uint8_t index) noexcept -> const std::error_category& {
+        if (index == 0) {
+            return ErrorCategory<void>::kSingleton;
+        }
+        return *kSlots[index].load(std::memory_order_acquire);
+    }
+};
+
+template <typename Dummy>
+std::atomic<const std::error_category*>
+    CompactErrorCategories<Dummy>::kSlots[CompactErrorCategories<Dummy>::kCapacity]{};
+
+}  // namespace details
+
+/// \brief Compact tiltfive::Result for trivially copyable payloads
+///
+/// Holds the error as a tiltfive::Error value in the same storage as the payload, with the error
+/// category packed into the flags byte as a small index. The std::error_code is only built when
+/// error() is called. Being trivially copyable itself, the result is copied with a plain memcpy
+/// and small results are returned in registers.
+///
+/// Errors from categories other than tiltfive::ErrorCategory are supported, up to a total of 15
+/// distinct categories per process; beyond that they're reported as Error::kInternalError.
+template <typename T>
+class [[nodiscard]] Result<T, typename std::enable_if<UseCompactResult<T>::value>::type> {
+public:
+    using Value = T;
+
+    Result(const Value& value) noexcept : mValue(value), mErrFlags(kErrFlagsNone) {}
+
+    Result(Error err) noexcept
+        : mErrValue(static_cast<int>(err)), mErrFlags(kErrFlagHaveErr) {}
+
+    Result(std::error_code err) noexcept : mErrValue(err.value()), mErrFlags(kErrFlagHaveErr) {
+        auto index = details::CompactErrorCategories<void>::indexOf(err.category());
+        if (index >= details::CompactErrorCategories<void>::kCapacity) {
+            mErrValue = static_cast<int>(Error::kInternalError);
+            index     = 0;
+        }
+        mErrFlags |= static_cast<uint8_t>(index << kErrCategoryShift);
+    }
+
+    template <
+        typename ErrorCodeEnum,
+        typename = typename std::enable_if<std::is_error_code_enum<ErrorCodeEnum>::value>::type>
+    Result(ErrorCodeEnum err) noexcept : Result(std::error_code(err)) {}
+
+    Result(std::errc err) noexcept : Result(std::make_error_code(err)) {}
+
+    Result(Result&& other) noexcept      = default;
+    Result(const Result& other) noexcept = default;
+    ~Result()                            = default;
+
+    auto operator=(Result&& other) noexcept -> Result&      = default;
+    auto operator=(const Result& other) noexcept -> Result& = default;
+
+    explicit operator bool() const noexcept {
+        return mErrFlags == kErrFlagsNone;
+    }
+
+    auto operator*() -> Value& {
+        if (mErrFlags != kErrFlagsNone) {
+            throwBadResultAccess();
+        }
+        return mValue;
+    }
+
+    auto operator*() const -> const Value& {
+        if (mErrFlags != kErrFlagsNone) {
+            throwBadResultAccess();
+        }
+        return mValue;
+    }
+
+    auto operator->() -> Value* {
+        if (mErrFlags != kErrFlagsNone) {
+            throwBadResultAccess();
+        }
+        return &mValue;
+    }
+
+    auto operator->() const -> const Value* {
+        if (mErrFlags != kErrFlagsNone) {
+            throwBadResultAccess();
+        }
+        return &mValue;
+    }
+
+    [[nodiscard]] auto error() const noexcept -> std::error_code {
+        if (mErrFlags != kErrFlagsNone) {
+            return {mErrValue,
+                    details::CompactErrorCategories<void>::at(mErrFlags >> kErrCategoryShift)};
+        }
+        return {};
+    }
+
+    [[nodiscard]] auto logged() const noexcept -> bool {
+        return (mErrFlags & kErrFlagLogged) != 0;
+    }
+
+    [[nodiscard]] auto skipped() const noexcept -> bool {
+        return (mErrFlags & kErrFlagSkipped) != 0;
+    }
+
+    /// \brief Obtain the contained value, or \p defaultValue if this holds an error
+    template <typename U>
+    auto value_or(U&& defaultValue) const -> Value {
+        if (mErrFlags != kErrFlagsNone) {
+            return static_cast<Value>(std::forward<U>(defaultValue));
+        }
+        return mValue;
+    }
+
+    /// \brief Transform the contained value, passing any error through unchanged
+    ///
+    /// \param[in] f - Callable taking the value. Its return type U gives a Result<U>; a callable
+    ///                returning void gives a Result<void>.
+    template <typename F>
+    auto map(F&& f) const& -> Result<std::invoke_result_t<F, const Value&>> {
+        using U = std::invoke_result_t<F, const Value&>;
+        if (mErrFlags != kErrFlagsNone) {
+            return error();
+        }
+        if constexpr (std::is_void<U>::value) {
+            std::forward<F>(f)(mValue);
+            return Result<U>{};
+        } else {
+            return std::forward<F>(f)(mValue);
+        }
+    }
+
+    /// \brief Transform the contained value, passing any error through unchanged
+    template <typename F>
+    auto map(F&& f) && -> Result<std::invoke_result_t<F, Value&&>> {
+        using U = std::invoke_result_t<F, Value&&>;
+        if (mErrFlags != kErrFlagsNone) {
+            return error();
+        }
+        if constexpr (std::is_void<U>::value) {
+            std::forward<F>(f)(std::move(mValue));
+            return Result<U>{};
+        } else {
+            return std::forward<F>(f)(std::move(mValue));
+        }
+    }
+
+    /// \brief Chain a fallible operation on the contained value
+    ///
+    /// \param[in] f - Callable taking the value and returning a tiltfive::Result. Not called if
+    ///                this holds an error, in which case the error is passed through.
+    template <typename F>
+    auto and_then(F&& f) const& -> std::invoke_result_t<F, const Value&> {
+        using R = std::invoke_result_t<F, const Value&>;
+        static_assert(IsResult<R>::value, "and_then() callable must return a tiltfive::Result");
+        if (mErrFlags != kErrFlagsNone) {
+            return R(error());
+        }
+        return std::forward<F>(f)(mValue);
+    }
+
+    /// \brief Chain a fallible operation on the contained value
+    template <typename F>
+    auto and_then(F&& f) && -> std::invoke_result_t<F, Value&&> {
+        using R = std::invoke_result_t<F, Value&&>;
+        static_assert(IsResult<R>::value, "and_then() callable must return a tiltfive::Result");
+        if (mErrFlags != kErrFlagsNone) {
+            return R(error());
+        }
+        return std::forward<F>(f)(std::move(mValue));
+    }
+
+    /// \brief Handle an error, passing any value through unchanged
+    ///
+    /// \param[in] f - Callable taking the std::error_code and returning a Result convertible to
+    ///                this type (a recovered value or another error).
+    template <typename F>
+    auto or_else(F&& f) const -> Result {
+        if (mErrFlags != kErrFlagsNone) {
+            return std::forward<F>(f)(error());
+        }
+        return *this;
+    }
+
+private:
+    [[noreturn]] void throwBadResultAccess() const {
+#if (__has_feature__cxx_exceptions)
+        throw BadResultAccess{};
+#else
+        std::terminate();
+#endif
+    }
+
+    union {
+        Value mValue;
+        int mErrValue;  // tiltfive::Error, or the raw value for other categories
+    };
+
+    static constexpr uint8_t kErrFlagsNone     = 0x00;
+    static constexpr uint8_t kErrFlagHaveErr   = 0x01;  // Do we have an error?
+    static constexpr uint8_t kErrFlagLogged    = 0x02;  // Is the error already logged?
+    static constexpr uint8_t kErrFlagSkipped   = 0x04;  // Was logging skipped?
+    static constexpr uint8_t kErrCategoryShift = 4;     // Category index in the top 4 bits
+
+    uint8_t mErrFlags;
+};
+
 // Support struct to determine if a type supports std::ostream& operator<<
 template <typename T, typename Enable = std::ostream&>
 struct supports_ostream : std::false_type {};
@@ -0,0 +1,84 @@
+#pragma once
+
+/// \file
+/// \brief Single-writer sequence lock for publishing small values to many readers
+///
+/// Header-only so the binder can use it. The value is stored as relaxed atomic words, so a reader
+/// that races the writer copies a torn value, sees the sequence change and retries, without any
+/// data race in the C++ sense.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+/// Latest value of T, written by one thread and read without locking by any number of others
+///
+/// A read is a handful of loads and never blocks the writer; it only retries while a write is in
+/// progress. Uncontended it is no faster than an uncontended mutex (slightly slower in
+/// bench-seqlock); it pays off when a writer is storing concurrently, which is the point for
+/// values up to a few cache lines that change at sensor rate, such as the latest pose.
+template <typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable_v<T>, "SeqLock values are copied word by word");
+
+public:
+	/// Starts out holding all-zero bytes
+	SeqLock() {
+		for (auto &word : mWords) {
+			word.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	SeqLock(const SeqLock &) = delete;
+	auto operator=(const SeqLock &) -> SeqLock & = delete;
+
+	/// Only one thread may store
+	auto store(const T &value) -> void {
+		uint64_t words[kWords] = {};
+		std::memcpy(words, &value, sizeof(T));
+
+		uint64_t sequence = mSequence.load(std::memory_order_relaxed);
+		mSequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i = 0; i < kWords; i++) {
+			mWords[i].store(words[i], std::memory_order_relaxed);
+		}
+		mSequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	/// Safe from any thread
+	[[nodiscard]] auto load() const -> T {
+		uint64_t words[kWords];
+		for (;;) {
+			uint64_t before = mSequence.load(std::memory_order_acquire);
+			if (before & 1) {
+				// The writer may have been preempted mid-store; let it finish
+				std::this_thread::yield();
+				continue;
+			}
+			for (size_t i = 0; i < kWords; i++) {
+				words[i] = mWords[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (mSequence.load(std::memory_order_relaxed) == before) {
+				break;
+			}
+		}
+		T value;
+		std::memcpy(&value, words, sizeof(T));
+		return value;
+	}
+
+	/// Number of stores so far
+	[[nodiscard]] auto version() const -> uint64_t {
+		return mSequence.load(std::memory_order_acquire) / 2;
+	}
+
+private:
+	static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<uint64_t> mSequence{ 0 };
+	std::atomic<uint64_t> mWords[kWords];
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+/// \file
+/// \brief Recorded camera sessions in a memory-mappable container
+///
+/// A session file starts with a SessionHeader padded to kSessionPageSize, followed by one fixed-size
+/// slot per frame holding its tightly packed 8-bit pixels, and ends with a SessionFrameInfo per
+/// frame. Slots are padded to a whole number of pages so every frame starts page-aligned. All
+/// fields are little-endian.
+///
+/// Since version 2 the last bytes of each slot also hold a copy of the frame's SessionFrameInfo,
+/// so a recording that never reached SessionWriter::finish(), e.g. because the process crashed,
+/// can still be read: its header has no index offset yet, or an index that runs past the end of
+/// the file, and SessionReader rebuilds the index from the complete slots.
+
+#include "types.h"
+
+#include <opencv2/core.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+constexpr uint32_t kSessionVersion = 2;
+constexpr size_t kSessionPageSize = 4096;
+
+struct SessionHeader {
+	char magic[4]; ///< "T5SS"
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint64_t slotBytes; ///< Bytes from one frame to the next
+	uint64_t frameCount;
+	uint64_t slotsOffset;
+	uint64_t indexOffset; ///< 0 until the recording is finished
+	uint32_t flags; ///< SessionHeader::kSorted if timestamps never decrease
+	uint32_t reserved[3];
+
+	static constexpr uint32_t kSorted = 1;
+};
+static_assert(sizeof(SessionHeader) == 64, "SessionHeader is part of the file format");
+
+/// Per-frame metadata, stored in the index at the end of the file
+struct SessionFrameInfo {
+	uint64_t timestampNanos;
+	T5_Vec3 posCAM_GBD;
+	T5_Quat rotToCAM_GBD;
+	uint8_t illuminationMode;
+	uint8_t cameraIndex;
+	uint16_t reserved0;
+	uint32_t reserved[2];
+};
+static_assert(sizeof(SessionFrameInfo) == 48, "SessionFrameInfo is part of the file format");
+
+/// Appends frames to a new session file; the index is written by finish()
+///
+/// The header is written when the file is opened, with no frames, and rewritten by finish() ahead
+/// of the index. Until then, readers recover the frames from their slots.
+class SessionWriter {
+public:
+	SessionWriter() = default;
+	~SessionWriter();
+
+	SessionWriter(const SessionWriter &) = delete;
+	auto operator=(const SessionWriter &) -> SessionWriter & = delete;
+
+	auto open(const std::string &path, int width, int height) -> bool;
+
+	/// Append one frame of width x height 8-bit pixels
+	auto append(const uint8_t *pixels, size_t stride, const SessionFrameInfo &info) -> bool;
+
+	/// Append a filled camera buffer, e.g. straight from getFilledCamImageBuffer()
+	auto append(const T5_CamImage &image, uint64_t timestampNanos) -> bool;
+
+	/// Write the index and final header. Called by the destructor if needed.
+	auto finish() -> bool;
+
+	[[nodiscard]] auto isOpen() const -> bool {
+		return mOut.is_open();
+	}
+	[[nodiscard]] auto frameCount() const -> size_t {
+		return mIndex.size();
+	}
+
+private:
+	std::string mPath;
+	std::ofstream mOut;
+	SessionHeader mHeader{};
+	std::vector<SessionFrameInfo> mIndex;
+	std::vector<char> mPadding;
+};
+
+/// Read-only random access to a session file through a memory mapping
+///
+/// Frames are returned as cv::Mat views straight into the mapping, so nothing is copied or decoded
+/// until the pixels are touched, and the OS pages frames in and out as needed. The views are only
+/// valid while the reader stays open and must not be written to.
+class SessionReader {
+public:
+	SessionReader() = default;
+	~SessionReader();
+
+	SessionReader(const SessionReader &) = delete;
+	auto operator=(const SessionReader &) -> SessionReader & = delete;
+
+	auto open(const std::string &path) -> bool;
+	auto close() -> void;
+
+	[[nodiscard]] auto isOpen() const -> bool {
+		return mBase != nullptr;
+	}
+	[[nodiscard]] auto frameCount() const -> size_t {
+		return static_cast<size_t>(mHeader.frameCount);
+	}
+	[[nodiscard]] auto width() const -> int {
+		return static_cast<int>(mHeader.width);
+	}
+	[[nodiscard]] auto height() const -> int {
+		return static_cast<int>(mHeader.height);
+	}
+	/// True if the file was not finished and its index was rebuilt from the slots
+	[[nodiscard]] auto recovered() const -> bool {
+		return mRecovered;
+	}
+
+	/// Zero-copy CV_8UC1 view of a frame; empty if index is not below frameCount()
+	[[nodiscard]] auto frame(size_t index) const -> cv::Mat;
+	/// index must be below frameCount()
+	[[nodiscard]] auto info(size_t index) const -> const SessionFrameInfo & {
+		assert(index < frameCount());
+		return mIndex[index];
+	}
+
+	/// Index of the first frame at or after the timestamp, or frameCount() if there is none.
+	/// Binary search for sessions recorded with increasing timestamps, a linear scan otherwise.
+	[[nodiscard]] auto seek(uint64_t timestampNanos) const -> size_t;
+
+	/// Tell the OS frames will be read in order, so it reads ahead and drops pages behind
+	auto adviseSequential() -> void;
+	/// Tell the OS not to read ahead, for seeking around
+	auto adviseRandom() -> void;
+	/// Start paging in a range of frames ahead of use
+	auto prefetch(size_t first, size_t count) -> void;
+
+private:
+	auto recover(uint64_t maxFrames) -> void;
+	auto advise(size_t offset, size_t length, int advice) -> void;
+
+	const uint8_t *mBase = nullptr;
+	size_t mSize = 0;
+	SessionHeader mHeader{}; ///< Copy of the file's, with the frame count of a recovered file
+	const SessionFrameInfo *mIndex = nullptr;
+	std::vector<SessionFrameInfo> mRecoveredIndex;
+	bool mRecovered = false;
+#if defined(_WIN32)
+	void *mFile = nullptr;
+	void *mMapping = nullptr;
+#else
+	int mFd = -1;
+#endif
+};
@@ -0,0 +1,608 @@
+#pragma once
+
+/// \file
+/// \brief Quaternion and rigid transform math on T5_Quat and T5_Vec3, one at a time or in batches
+///
+/// Quaternions are Hamilton quaternions stored w first, as T5_Quat is, and rotate vectors as
+/// q v q^-1, so rotate(pose.rotToGLS_GBD, v) takes a GBD direction to GLS. A RigidTransform maps
+/// p to rotate(rotation, p) + translation, and compose(a, b) applies b first, then a.
+///
+/// The batch functions take the T5 types as they are laid out in memory. Each block of 8 (AVX2) or
+/// 4 (NEON) elements is transposed into structure-of-arrays registers on load and back on store,
+/// so callers never repack. The output may be the same array as an input but must not otherwise
+/// overlap one. AVX2 is chosen at run time on x86 and NEON at compile time on AArch64; elsewhere,
+/// and for the last few elements of a batch, the scalar loops in t5math::scalar run instead.
+///
+/// Header-only, so the binder and the tools can use it without linking anything.
+
+#include "types.h"
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define T5MATH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define T5MATH_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions marked for it; MSVC always can
+#if defined(T5MATH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define T5MATH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define T5MATH_TARGET_AVX2
+#endif
+
+namespace t5math {
+
+static_assert(sizeof(T5_Quat) == 4 * sizeof(float), "T5_Quat is loaded as four packed floats");
+static_assert(sizeof(T5_Vec3) == 3 * sizeof(float), "T5_Vec3 is loaded as three packed floats");
+
+/// Pose of one frame in another: maps p to rotate(rotation, p) + translation
+struct RigidTransform {
+	T5_Quat rotation;
+	T5_Vec3 translation;
+};
+
+namespace detail {
+
+// Slerp weights sin(t theta) / sin(theta) as a polynomial in x - 1, x = cos(theta), after D. Eberly,
+// "A Fast and Accurate Algorithm for Computing SLERP" (2011): the series is nested as
+// 1 + b0 (1 + b1 (1 + ...)) with b[i] = (t^2 - (i + 1)^2) / ((i + 1) (2i + 3)) (x - 1). Truncated
+// at twelve terms, with the last scaled by kSlerpMu to make up for the rest, it is within 1e-6 of
+// the exact weights over the whole range the short-way interpolation uses, theta in [0, pi/2].
+constexpr int kSlerpTerms = 12;
+constexpr float kSlerpMu = 1.89372f;
+
+/// The b[i] / (x - 1) for a weight t, shared by every element of a batch
+struct SlerpCoefficients {
+	float weight;
+	float terms[kSlerpTerms];
+
+	explicit SlerpCoefficients(float t) : weight(t) {
+		for (int i = 0; i < kSlerpTerms; i++) {
+			float n = static_cast<float>(i + 1);
+			terms[i] = (t * t - n * n) / (n * (2.0f * n + 1.0f));
+		}
+		terms[kSlerpTerms - 1] *= kSlerpMu;
+	}
+};
+
+/// sin(t theta) / sin(theta) for cosTheta - 1 in [-1, 0]
+inline auto slerpWeight(const SlerpCoefficients &k, float cosThetaMinusOne) -> float {
+	float series = 1.0f;
+	for (int i = kSlerpTerms - 1; i >= 0; i--) {
+		series = 1.0f + k.terms[i] * cosThetaMinusOne * series;
+	}
+	return k.weight * series;
+}
+
+} // namespace detail
+
+/// Hamilton product: rotating by the result rotates by b, then by a
+inline auto multiply(const T5_Quat &a, const T5_Quat &b) -> T5_Quat {
+	return {
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+	};
+}
+
+/// The inverse of a unit quaternion
+inline auto conjugate(const T5_Quat &q) -> T5_Quat {
+	return { q.w, -q.x, -q.y, -q.z };
+}
+
+/// The inverse of any nonzero quaternion
+inline auto inverse(const T5_Quat &q) -> T5_Quat {
+	float scale = 1.0f / (q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+	return { q.w * scale, -q.x * scale, -q.y * scale, -q.z * scale };
+}
+
+/// q v q^-1 for a unit quaternion q
+inline auto rotate(const T5_Quat &q, const T5_Vec3 &v) -> T5_Vec3 {
+	// t = 2 (q.xyz x v), then v + w t + q.xyz x t
+	float tx = 2.0f * (q.y * v.z - q.z * v.y);
+	float ty = 2.0f * (q.z * v.x - q.x * v.z);
+	float tz = 2.0f * (q.x * v.y - q.y * v.x);
+	return {
+		v.x + q.w * tx + (q.y * tz - q.z * ty),
+		v.y + q.w * ty + (q.z * tx - q.x * tz),
+		v.z + q.w * tz + (q.x * ty - q.y * tx),
+	};
+}
+
+namespace detail {
+
+inline auto slerp(const T5_Quat &a, const T5_Quat &b, const SlerpCoefficients &kA, const SlerpCoefficients &kB)
+		-> T5_Quat {
+	float cosTheta = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+	float sign = (cosTheta < 0.0f) ? -1.0f : 1.0f;
+	float xm1 = sign * cosTheta - 1.0f;
+	float weightA = slerpWeight(kA, xm1);
+	float weightB = sign * slerpWeight(kB, xm1);
+	return { weightA * a.w + weightB * b.w, weightA * a.x + weightB * b.x, weightA * a.y + weightB * b.y,
+		weightA * a.z + weightB * b.z };
+}
+
+} // namespace detail
+
+/// Spherical interpolation between unit quaternions, from a at t = 0 to b at t = 1, the short way
+///
+/// Within about 1e-6 of the exact result for t in [0, 1], without trigonometric functions.
+inline auto slerp(const T5_Quat &a, const T5_Quat &b, float t) -> T5_Quat {
+	return detail::slerp(a, b, detail::SlerpCoefficients(1.0f - t), detail::SlerpCoefficients(t));
+}
+
+/// The transform applying b, then a
+inline auto compose(const RigidTransform &a, const RigidTransform &b) -> RigidTransform {
+	T5_Vec3 moved = rotate(a.rotation, b.translation);
+	return { multiply(a.rotation, b.rotation),
+		{ moved.x + a.translation.x, moved.y + a.translation.y, moved.z + a.translation.z } };
+}
+
+/// The transform undoing t, for a unit rotation
+inline auto inverse(const RigidTransform &t) -> RigidTransform {
+	T5_Quat rotation = conjugate(t.rotation);
+	T5_Vec3 moved = rotate(rotation, t.translation);
+	return { rotation, { -moved.x, -moved.y, -moved.z } };
+}
+
+/// Where the glasses are in the gameboard frame: maps GLS points to GBD
+inline auto gameboardFromGlasses(const T5_GlassesPose &pose) -> RigidTransform {
+	return { conjugate(pose.rotToGLS_GBD), pose.posGLS_GBD };
+}
+
+/// Scalar batch loops; the reference for the vector paths and the fallback without them
+namespace scalar {
+
+inline auto multiply(const T5_Quat *a, const T5_Quat *b, T5_Quat *out, size_t count) -> void {
+	for (size_t i = 0; i < count; i++) {
+		out[i] = t5math::multiply(a[i], b[i]);
+	}
+}
+
+inline auto inverse(const T5_Quat *q, T5_Quat *out, size_t count) -> void {
+	for (size_t i = 0; i < count; i++) {
+		out[i] = t5math::inverse(q[i]);
+	}
+}
+
+inline auto rotate(const T5_Quat *q, const T5_Vec3 *v, T5_Vec3 *out, size_t count) -> void {
+	for (size_t i = 0; i < count; i++) {
+		out[i] = t5math::rotate(q[i], v[i]);
+	}
+}
+
+inline auto slerp(const T5_Quat *a, const T5_Quat *b, float t, T5_Quat *out, size_t count) -> void {
+	const detail::SlerpCoefficients kA(1.0f - t);
+	const detail::SlerpCoefficients kB(t);
+	for (size_t i = 0; i < count; i++) {
+		out[i] = detail::slerp(a[i], b[i], kA, kB);
+	}
+}
+
+inline auto compose(const T5_Quat *rotationA, const T5_Vec3 *translationA, const T5_Quat *rotationB,
+		const T5_Vec3 *translationB, T5_Quat *rotationOut, T5_Vec3 *translationOut, size_t count) -> void {
+	for (size_t i = 0; i < count; i++) {
+		RigidTransform c = t5math::compose({ rotationA[i], translationA[i] }, { rotationB[i], translationB[i] });
+		rotationOut[i] = c.rotation;
+		translationOut[i] = c.translation;
+	}
+}
+
+} // namespace scalar
+
+namespace detail {
+
+#if defined(T5MATH_X86)
+
+inline auto avx2Supported() -> bool {
+	static const bool supported = []() {
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool osSavesYmm = ((info[2] & (1 << 27)) != 0) && ((_xgetbv(0) & 6) == 6);
+		if (!osSavesYmm || (maxLeaf < 7)) {
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}();
+	return supported;
+}
+
+struct QuatX8 {
+	__m256 w, x, y, z;
+};
+
+struct Vec3X8 {
+	__m256 x, y, z;
+};
+
+// Transposes four rows within each 128-bit half: AoS quaternions to SoA components and back
+T5MATH_TARGET_AVX2 inline auto transpose4x4(__m256 &r0, __m256 &r1, __m256 &r2, __m256 &r3) -> void {
+	__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+	__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+	__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+	__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+	r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+T5MATH_TARGET_AVX2 inline auto loadHalves(const float *low, const float *high) -> __m256 {
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+}
+
+T5MATH_TARGET_AVX2 inline auto storeHalves(float *low, float *high, __m256 v) -> void {
+	_mm_storeu_ps(low, _mm256_castps256_ps128(v));
+	_mm_storeu_ps(high, _mm256_extractf128_ps(v, 1));
+}
+
+// Lane j of each component is element j of the block
+T5MATH_TARGET_AVX2 inline auto loadQuats(const T5_Quat *q) -> QuatX8 {
+	const float *p = reinterpret_cast<const float *>(q);
+	QuatX8 r{ loadHalves(p, p + 16), loadHalves(p + 4, p + 20), loadHalves(p + 8, p + 24),
+		loadHalves(p + 12, p + 28) };
+	transpose4x4(r.w, r.x, r.y, r.z);
+	return r;
+}
+
+T5MATH_TARGET_AVX2 inline auto storeQuats(T5_Quat *q, QuatX8 r) -> void {
+	float *p = reinterpret_cast<float *>(q);
+	transpose4x4(r.w, r.x, r.y, r.z);
+	storeHalves(p, p + 16, r.w);
+	storeHalves(p + 4, p + 20, r.x);
+	storeHalves(p + 8, p + 24, r.y);
+	storeHalves(p + 12, p + 28, r.z);
+}
+
+// Eight packed xyz triples, as in Intel's "3D Vector Normalization Using 256-Bit Intel AVX"
+T5MATH_TARGET_AVX2 inline auto loadVecs(const T5_Vec3 *v) -> Vec3X8 {
+	const float *p = reinterpret_cast<const float *>(v);
+	__m256 m03 = loadHalves(p, p + 12); // x0 y0 z0 x1 | x4 y4 z4 x5
+	__m256 m14 = loadHalves(p + 4, p + 16); // y1 z1 x2 y2 | y5 z5 x6 y6
+	__m256 m25 = loadHalves(p + 8, p + 20); // z2 x3 y3 z3 | z6 x7 y7 z7
+	__m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+	__m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+	return { _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0)), _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0)),
+		_mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1)) };
+}
+
+T5MATH_TARGET_AVX2 inline auto storeVecs(T5_Vec3 *v, const Vec3X8 &r) -> void {
+	float *p = reinterpret_cast<float *>(v);
+	__m256 xy = _mm256_shuffle_ps(r.x, r.y, _MM_SHUFFLE(2, 0, 2, 0));
+	__m256 yz = _mm256_shuffle_ps(r.y, r.z, _MM_SHUFFLE(3, 1, 3, 1));
+	__m256 zx = _mm256_shuffle_ps(r.z, r.x, _MM_SHUFFLE(3, 1, 2, 0));
+	storeHalves(p, p + 12, _mm256_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0)));
+	storeHalves(p + 4, p + 16, _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0)));
+	storeHalves(p + 8, p + 20, _mm256_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+T5MATH_TARGET_AVX2 inline auto multiplyX8(const QuatX8 &a, const QuatX8 &b) -> QuatX8 {
+	return {
+		_mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(a.w, b.w), _mm256_mul_ps(a.x, b.x)),
+				_mm256_add_ps(_mm256_mul_ps(a.y, b.y), _mm256_mul_ps(a.z, b.z))),
+		_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a.w, b.x), _mm256_mul_ps(a.x, b.w)),
+				_mm256_sub_ps(_mm256_mul_ps(a.y, b.z), _mm256_mul_ps(a.z, b.y))),
+		_mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(a.w, b.y), _mm256_mul_ps(a.x, b.z)),
+				_mm256_add_ps(_mm256_mul_ps(a.y, b.w), _mm256_mul_ps(a.z, b.x))),
+		_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a.w, b.z), _mm256_mul_ps(a.x, b.y)),
+				_mm256_sub_ps(_mm256_mul_ps(a.z, b.w), _mm256_mul_ps(a.y, b.x))),
+	};
+}
+
+T5MATH_TARGET_AVX2 inline auto crossX8(__m256 ax, __m256 ay, __m256 az, const Vec3X8 &b) -> Vec3X8 {
+	return { _mm256_sub_ps(_mm256_mul_ps(ay, b.z), _mm256_mul_ps(az, b.y)),
+		_mm256_sub_ps(_mm256_mul_ps(az, b.x), _mm256_mul_ps(ax, b.z)),
+		_mm256_sub_ps(_mm256_mul_ps(ax, b.y), _mm256_mul_ps(ay, b.x)) };
+}
+
+T5MATH_TARGET_AVX2 inline auto rotateX8(const QuatX8 &q, const Vec3X8 &v) -> Vec3X8 {
+	Vec3X8 t = crossX8(q.x, q.y, q.z, v);
+	t = { _mm256_add_ps(t.x, t.x), _mm256_add_ps(t.y, t.y), _mm256_add_ps(t.z, t.z) };
+	Vec3X8 c = crossX8(q.x, q.y, q.z, t);
+	return { _mm256_add_ps(_mm256_add_ps(v.x, _mm256_mul_ps(q.w, t.x)), c.x),
+		_mm256_add_ps(_mm256_add_ps(v.y, _mm256_mul_ps(q.w, t.y)), c.y),
+		_mm256_add_ps(_mm256_add_ps(v.z, _mm256_mul_ps(q.w, t.z)), c.z) };
+}
+
+T5MATH_TARGET_AVX2 inline auto slerpWeightX8(const SlerpCoefficients &k, __m256 cosThetaMinusOne) -> __m256 {
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 series = one;
+	for (int i = kSlerpTerms - 1; i >= 0; i--) {
+		series = _mm256_add_ps(one, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(k.terms[i]), cosThetaMinusOne), series));
+	}
+	return _mm256_mul_ps(_mm256_set1_ps(k.weight), series);
+}
+
+// Each kernel handles whole blocks and returns how many elements it did
+
+T5MATH_TARGET_AVX2 inline auto multiplyAvx2(const T5_Quat *a, const T5_Quat *b, T5_Quat *out, size_t count)
+		-> size_t {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		storeQuats(out + i, multiplyX8(loadQuats(a + i), loadQuats(b + i)));
+	}
+	return i;
+}
+
+T5MATH_TARGET_AVX2 inline auto inverseAvx2(const T5_Quat *q, T5_Quat *out, size_t count) -> size_t {
+	const __m256 negativeZero = _mm256_set1_ps(-0.0f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		QuatX8 r = loadQuats(q + i);
+		__m256 norm = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r.w, r.w), _mm256_mul_ps(r.x, r.x)),
+				_mm256_add_ps(_mm256_mul_ps(r.y, r.y), _mm256_mul_ps(r.z, r.z)));
+		__m256 scale = _mm256_div_ps(_mm256_set1_ps(1.0f), norm);
+		__m256 negativeScale = _mm256_xor_ps(scale, negativeZero);
+		storeQuats(out + i, { _mm256_mul_ps(r.w, scale), _mm256_mul_ps(r.x, negativeScale),
+						_mm256_mul_ps(r.y, negativeScale), _mm256_mul_ps(r.z, negativeScale) });
+	}
+	return i;
+}
+
+T5MATH_TARGET_AVX2 inline auto rotateAvx2(const T5_Quat *q, const T5_Vec3 *v, T5_Vec3 *out, size_t count)
+		-> size_t {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		storeVecs(out + i, rotateX8(loadQuats(q + i), loadVecs(v + i)));
+	}
+	return i;
+}
+
+T5MATH_TARGET_AVX2 inline auto slerpAvx2(const T5_Quat *a, const T5_Quat *b, float t, T5_Quat *out,
+		size_t count) -> size_t {
+	const SlerpCoefficients kA(1.0f - t);
+	const SlerpCoefficients kB(t);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 negativeZero = _mm256_set1_ps(-0.0f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		QuatX8 qa = loadQuats(a + i);
+		QuatX8 qb = loadQuats(b + i);
+		__m256 cosTheta = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(qa.w, qb.w), _mm256_mul_ps(qa.x, qb.x)),
+				_mm256_add_ps(_mm256_mul_ps(qa.y, qb.y), _mm256_mul_ps(qa.z, qb.z)));
+		// Take the short way round by flipping b's weight where the quaternions point apart
+		__m256 sign = _mm256_and_ps(cosTheta, negativeZero);
+		__m256 xm1 = _mm256_sub_ps(_mm256_xor_ps(cosTheta, sign), one);
+		__m256 weightA = slerpWeightX8(kA, xm1);
+		__m256 weightB = _mm256_xor_ps(slerpWeightX8(kB, xm1), sign);
+		storeQuats(out + i, { _mm256_add_ps(_mm256_mul_ps(weightA, qa.w), _mm256_mul_ps(weightB, qb.w)),
+						_mm256_add_ps(_mm256_mul_ps(weightA, qa.x), _mm256_mul_ps(weightB, qb.x)),
+						_mm256_add_ps(_mm256_mul_ps(weightA, qa.y), _mm256_mul_ps(weightB, qb.y)),
+						_mm256_add_ps(_mm256_mul_ps(weightA, qa.z), _mm256_mul_ps(weightB, qb.z)) });
+	}
+	return i;
+}
+
+T5MATH_TARGET_AVX2 inline auto composeAvx2(const T5_Quat *rotationA, const T5_Vec3 *translationA,
+		const T5_Quat *rotationB, const T5_Vec3 *translationB, T5_Quat *rotationOut, T5_Vec3 *translationOut,
+		size_t count) -> size_t {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		QuatX8 ra = loadQuats(rotationA + i);
+		Vec3X8 ta = loadVecs(translationA + i);
+		Vec3X8 moved = rotateX8(ra, loadVecs(translationB + i));
+		QuatX8 rotation = multiplyX8(ra, loadQuats(rotationB + i));
+		storeQuats(rotationOut + i, rotation);
+		storeVecs(translationOut + i,
+				{ _mm256_add_ps(moved.x, ta.x), _mm256_add_ps(moved.y, ta.y), _mm256_add_ps(moved.z, ta.z) });
+	}
+	return i;
+}
+
+#elif defined(T5MATH_NEON)
+
+// vld4q_f32 and vld3q_f32 deinterleave four T5_Quats or T5_Vec3s straight into components
+
+inline auto multiplyX4(const float32x4x4_t &a, const float32x4x4_t &b) -> float32x4x4_t {
+	float32x4x4_t r;
+	r.val[0] = vsubq_f32(vsubq_f32(vmulq_f32(a.val[0], b.val[0]), vmulq_f32(a.val[1], b.val[1])),
+			vaddq_f32(vmulq_f32(a.val[2], b.val[2]), vmulq_f32(a.val[3], b.val[3])));
+	r.val[1] = vaddq_f32(vaddq_f32(vmulq_f32(a.val[0], b.val[1]), vmulq_f32(a.val[1], b.val[0])),
+			vsubq_f32(vmulq_f32(a.val[2], b.val[3]), vmulq_f32(a.val[3], b.val[2])));
+	r.val[2] = vaddq_f32(vsubq_f32(vmulq_f32(a.val[0], b.val[2]), vmulq_f32(a.val[1], b.val[3])),
+			vaddq_f32(vmulq_f32(a.val[2], b.val[0]), vmulq_f32(a.val[3], b.val[1])));
+	r.val[3] = vaddq_f32(vaddq_f32(vmulq_f32(a.val[0], b.val[3]), vmulq_f32(a.val[1], b.val[2])),
+			vsubq_f32(vmulq_f32(a.val[3], b.val[0]), vmulq_f32(a.val[2], b.val[1])));
+	return r;
+}
+
+// a.xyz x b, with a taken from a quaternion's vector part
+inline auto crossX4(const float32x4x4_t &a, const float32x4x3_t &b) -> float32x4x3_t {
+	float32x4x3_t r;
+	r.val[0] = vsubq_f32(vmulq_f32(a.val[2], b.val[2]), vmulq_f32(a.val[3], b.val[1]));
+	r.val[1] = vsubq_f32(vmulq_f32(a.val[3], b.val[0]), vmulq_f32(a.val[1], b.val[2]));
+	r.val[2] = vsubq_f32(vmulq_f32(a.val[1], b.val[1]), vmulq_f32(a.val[2], b.val[0]));
+	return r;
+}
+
+inline auto rotateX4(const float32x4x4_t &q, const float32x4x3_t &v) -> float32x4x3_t {
+	float32x4x3_t t = crossX4(q, v);
+	for (int c = 0; c < 3; c++) {
+		t.val[c] = vaddq_f32(t.val[c], t.val[c]);
+	}
+	float32x4x3_t cross = crossX4(q, t);
+	float32x4x3_t r;
+	for (int c = 0; c < 3; c++) {
+		r.val[c] = vaddq_f32(vaddq_f32(v.val[c], vmulq_f32(q.val[0], t.val[c])), cross.val[c]);
+	}
+	return r;
+}
+
+inline auto slerpWeightX4(const SlerpCoefficients &k, float32x4_t cosThetaMinusOne) -> float32x4_t {
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	float32x4_t series = one;
+	for (int i = kSlerpTerms - 1; i >= 0; i--) {
+		series = vaddq_f32(one, vmulq_f32(vmulq_n_f32(cosThetaMinusOne, k.terms[i]), series));
+	}
+	return vmulq_n_f32(series, k.weight);
+}
+
+inline auto multiplyNeon(const T5_Quat *a, const T5_Quat *b, T5_Quat *out, size_t count) -> size_t {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		vst4q_f32(reinterpret_cast<float *>(out + i), multiplyX4(vld4q_f32(reinterpret_cast<const float *>(a + i)),
+				vld4q_f32(reinterpret_cast<const float *>(b + i))));
+	}
+	return i;
+}
+
+inline auto inverseNeon(const T5_Quat *q, T5_Quat *out, size_t count) -> size_t {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4x4_t r = vld4q_f32(reinterpret_cast<const float *>(q + i));
+		float32x4_t norm = vaddq_f32(vaddq_f32(vmulq_f32(r.val[0], r.val[0]), vmulq_f32(r.val[1], r.val[1])),
+				vaddq_f32(vmulq_f32(r.val[2], r.val[2]), vmulq_f32(r.val[3], r.val[3])));
+		float32x4_t scale = vdivq_f32(vdupq_n_f32(1.0f), norm);
+		r.val[0] = vmulq_f32(r.val[0], scale);
+		for (int c = 1; c < 4; c++) {
+			r.val[c] = vnegq_f32(vmulq_f32(r.val[c], scale));
+		}
+		vst4q_f32(reinterpret_cast<float *>(out + i), r);
+	}
+	return i;
+}
+
+inline auto rotateNeon(const T5_Quat *q, const T5_Vec3 *v, T5_Vec3 *out, size_t count) -> size_t {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		vst3q_f32(reinterpret_cast<float *>(out + i), rotateX4(vld4q_f32(reinterpret_cast<const float *>(q + i)),
+				vld3q_f32(reinterpret_cast<const float *>(v + i))));
+	}
+	return i;
+}
+
+inline auto slerpNeon(const T5_Quat *a, const T5_Quat *b, float t, T5_Quat *out, size_t count) -> size_t {
+	const SlerpCoefficients kA(1.0f - t);
+	const SlerpCoefficients kB(t);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4x4_t qa = vld4q_f32(reinterpret_cast<const float *>(a + i));
+		float32x4x4_t qb = vld4q_f32(reinterpret_cast<const float *>(b + i));
+		float32x4_t cosTheta = vaddq_f32(vaddq_f32(vmulq_f32(qa.val[0], qb.val[0]), vmulq_f32(qa.val[1], qb.val[1])),
+				vaddq_f32(vmulq_f32(qa.val[2], qb.val[2]), vmulq_f32(qa.val[3], qb.val[3])));
+		// Take the short way round by flipping b's weight where the quaternions point apart
+		uint32x4_t apart = vcltq_f32(cosTheta, vdupq_n_f32(0.0f));
+		float32x4_t xm1 = vsubq_f32(vabsq_f32(cosTheta), one);
+		float32x4_t weightA = slerpWeightX4(kA, xm1);
+		float32x4_t weightB = slerpWeightX4(kB, xm1);
+		weightB = vbslq_f32(apart, vnegq_f32(weightB), weightB);
+		float32x4x4_t r;
+		for (int c = 0; c < 4; c++) {
+			r.val[c] = vaddq_f32(vmulq_f32(weightA, qa.val[c]), vmulq_f32(weightB, qb.val[c]));
+		}
+		vst4q_f32(reinterpret_cast<float *>(out + i), r);
+	}
+	return i;
+}
+
+inline auto composeNeon(const T5_Quat *rotationA, const T5_Vec3 *translationA, const T5_Quat *rotationB,
+		const T5_Vec3 *translationB, T5_Quat *rotationOut, T5_Vec3 *translationOut, size_t count) -> size_t {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4x4_t ra = vld4q_f32(reinterpret_cast<const float *>(rotationA + i));
+		float32x4x3_t ta = vld3q_f32(reinterpret_cast<const float *>(translationA + i));
+		float32x4x3_t moved = rotateX4(ra, vld3q_f32(reinterpret_cast<const float *>(translationB + i)));
+		float32x4x4_t rotation = multiplyX4(ra, vld4q_f32(reinterpret_cast<const float *>(rotationB + i)));
+		for (int c = 0; c < 3; c++) {
+			moved.val[c] = vaddq_f32(moved.val[c], ta.val[c]);
+		}
+		vst4q_f32(reinterpret_cast<float *>(rotationOut + i), rotation);
+		vst3q_f32(reinterpret_cast<float *>(translationOut + i), moved);
+	}
+	return i;
+}
+
+#endif
+
+} // namespace detail
+
+/// out[i] = multiply(a[i], b[i])
+inline auto multiply(const T5_Quat *a, const T5_Quat *b, T5_Quat *out, size_t count) -> void {
+	size_t done = 0;
+#if defined(T5MATH_X86)
+	if (detail::avx2Supported()) {
+		done = detail::multiplyAvx2(a, b, out, count);
+	}
+#elif defined(T5MATH_NEON)
+	done = detail::multiplyNeon(a, b, out, count);
+#endif
+	scalar::multiply(a + done, b + done, out + done, count - done);
+}
+
+/// out[i] = inverse(q[i])
+inline auto inverse(const T5_Quat *q, T5_Quat *out, size_t count) -> void {
+	size_t done = 0;
+#if defined(T5MATH_X86)
+	if (detail::avx2Supported()) {
+		done = detail::inverseAvx2(q, out, count);
+	}
+#elif defined(T5MATH_NEON)
+	done = detail::inverseNeon(q, out, count);
+#endif
+	scalar::inverse(q + done, out + done, count - done);
+}
+
+/// out[i] = rotate(q[i], v[i])
+inline auto rotate(const T5_Quat *q, const T5_Vec3 *v, T5_Vec3 *out, size_t count) -> void {
+	size_t done = 0;
+#if defined(T5MATH_X86)
+	if (detail::avx2Supported()) {
+		done = detail::rotateAvx2(q, v, out, count);
+	}
+#elif defined(T5MATH_NEON)
+	done = detail::rotateNeon(q, v, out, count);
+#endif
+	scalar::rotate(q + done, v + done, out + done, count - done);
+}
+
+/// out[i] = slerp(a[i], b[i], t)
+inline auto slerp(const T5_Quat *a, const T5_Quat *b, float t, T5_Quat *out, size_t count) -> void {
+	size_t done = 0;
+#if defined(T5MATH_X86)
+	if (detail::avx2Supported()) {
+		done = detail::slerpAvx2(a, b, t, out, count);
+	}
+#elif defined(T5MATH_NEON)
+	done = detail::slerpNeon(a, b, t, out, count);
+#endif
+	scalar::slerp(a + done, b + done, t, out + done, count - done);
+}
+
+/// compose() over transforms stored as separate rotation and translation arrays, as poses hold them
+inline auto compose(const T5_Quat *rotationA, const T5_Vec3 *translationA, const T5_Quat *rotationB,
+		const T5_Vec3 *translationB, T5_Quat *rotationOut, T5_Vec3 *translationOut, size_t count) -> void {
+	size_t done = 0;
+#if defined(T5MATH_X86)
+	if (detail::avx2Supported()) {
+		done = detail::composeAvx2(rotationA, translationA, rotationB, translationB, rotationOut, translationOut,
+				count);
+	}
+#elif defined(T5MATH_NEON)
+	done = detail::composeNeon(rotationA, translationA, rotationB, translationB, rotationOut, translationOut,
+			count);
+#endif
+	scalar::compose(rotationA + done, translationA + done, rotationB + done, translationB + done,
+			rotationOut + done, translationOut + done, count - done);
+}
+
+} // namespace t5math
@@ -0,0 +1,79 @@
+#pragma once
+
+/// \file
+/// \brief Shared-memory layout written by the t5profiler interposer and read by t5top
+///
+/// The interposer creates one segment per profiled process, named by t5ProfileShmName(), and
+/// counts every call through the T5 C interface into it. Each thread gets its own row of per
+/// function stats, so the hot path only ever touches the calling thread's cache lines; threads
+/// beyond kT5ProfileMaxThreads - 1 share the last row. The reader copies the counters without
+/// locking, so a snapshot may be a call or two out of step between columns.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+constexpr uint32_t kT5ProfileMagic = 0x46503554; ///< "T5PF"
+constexpr uint32_t kT5ProfileVersion = 2;
+
+constexpr size_t kT5ProfileMaxFunctions = 48;
+constexpr size_t kT5ProfileNameLength = 48;
+constexpr size_t kT5ProfileMaxThreads = 64;
+
+/// Latency bucket i counts calls of [2^i, 2^(i+1)) ns; bucket 0 also takes 0 ns and the last
+/// bucket everything from about 2 s up
+constexpr size_t kT5ProfileBuckets = 32;
+
+/// Distinct result codes kept per function and thread; later codes are only counted as other
+constexpr size_t kT5ProfileResultSlots = 8;
+
+struct T5ProfileResultCount {
+	std::atomic<uint32_t> codePlusOne; ///< 0 while the slot is unused
+	std::atomic<uint64_t> count;
+};
+
+/// Calls of one function from one thread
+struct T5ProfileStats {
+	std::atomic<uint64_t> calls;
+	std::atomic<uint64_t> totalNanos;
+	std::atomic<uint64_t> maxNanos;
+	std::atomic<uint64_t> buckets[kT5ProfileBuckets];
+	T5ProfileResultCount results[kT5ProfileResultSlots];
+	std::atomic<uint64_t> otherResults;
+};
+
+struct T5ProfileThread {
+	std::atomic<uint32_t> tid; ///< Kernel thread id, 0 for the shared overflow row
+};
+
+/// Whole segment; zero-filled on creation, which is a valid empty state for every counter
+struct T5ProfileShared {
+	std::atomic<uint32_t> magic; ///< Stored last, once the names below are written
+	uint32_t version;
+	uint32_t pid;
+	uint32_t functionCount;
+	uint64_t startNanos; ///< CLOCK_MONOTONIC when the segment was created
+	std::atomic<uint64_t> exitNanos; ///< CLOCK_MONOTONIC when the process exited normally, else 0
+	char functions[kT5ProfileMaxFunctions][kT5ProfileNameLength];
+
+	std::atomic<uint32_t> threadCount; ///< Rows claimed so far, may run past kT5ProfileMaxThreads
+	T5ProfileThread threads[kT5ProfileMaxThreads];
+	T5ProfileStats stats[kT5ProfileMaxThreads][kT5ProfileMaxFunctions];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared counters must be lock-free");
+
+/// Name of the segment for a process, for shm_open()
+inline auto t5ProfileShmName(uint32_t pid) -> std::string {
+	char name[32];
+	std::snprintf(name, sizeof(name), "/t5profile-%u", pid);
+	return name;
+}
+
+/// Bucket index for a call's duration
+inline auto t5ProfileBucket(uint64_t nanos) -> size_t {
+	auto bucket = static_cast<size_t>(63 - __builtin_clzll(nanos | 1));
+	return (bucket < kT5ProfileBuckets) ? bucket : kT5ProfileBuckets - 1;
+}
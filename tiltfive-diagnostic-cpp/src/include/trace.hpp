@@ -0,0 +1,193 @@
+#pragma once
+
+/// \file
+/// \brief Scoped timing spans recorded per thread and exported as a Chrome trace
+///
+/// Recording is header-only so the binder can use it without adding a link dependency; only
+/// writeChromeTrace() lives in trace.cpp. The JSON opens in chrome://tracing and ui.perfetto.dev.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TraceEvent {
+	const char *name; ///< Must outlive the tracer; string literals in practice
+	const char *category;
+	int64_t startNanos; ///< Since the tracer was created
+	int64_t durationNanos;
+};
+
+/// Events of one thread, written only by that thread
+///
+/// Storage grows in fixed chunks that are never moved, so an exporter on another thread can read
+/// everything published so far without locking. Once full, further events are counted and dropped.
+class TraceBuffer {
+public:
+	static constexpr size_t kChunkEvents = 4096;
+	static constexpr size_t kMaxChunks = 256; ///< About a million events per thread
+
+	TraceBuffer(uint32_t threadId) : mThreadId(threadId) {
+		for (auto &chunk : mChunks) {
+			chunk.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	~TraceBuffer() {
+		for (auto &chunk : mChunks) {
+			delete[] chunk.load(std::memory_order_relaxed);
+		}
+	}
+
+	TraceBuffer(const TraceBuffer &) = delete;
+	auto operator=(const TraceBuffer &) -> TraceBuffer & = delete;
+
+	/// Only called from the owning thread
+	auto append(const TraceEvent &event) -> void {
+		size_t count = mCount.load(std::memory_order_relaxed);
+		size_t chunkIndex = count / kChunkEvents;
+		if (chunkIndex >= kMaxChunks) {
+			mDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		TraceEvent *chunk = mChunks[chunkIndex].load(std::memory_order_relaxed);
+		if (!chunk) {
+			chunk = new TraceEvent[kChunkEvents];
+			mChunks[chunkIndex].store(chunk, std::memory_order_release);
+		}
+		chunk[count % kChunkEvents] = event;
+		mCount.store(count + 1, std::memory_order_release);
+	}
+
+	/// Events published so far; safe from any thread
+	[[nodiscard]] auto size() const -> size_t {
+		return mCount.load(std::memory_order_acquire);
+	}
+
+	/// Only valid for index < size()
+	[[nodiscard]] auto at(size_t index) const -> const TraceEvent & {
+		return mChunks[index / kChunkEvents].load(std::memory_order_acquire)[index % kChunkEvents];
+	}
+
+	[[nodiscard]] auto dropped() const -> uint64_t {
+		return mDropped.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] auto threadId() const -> uint32_t {
+		return mThreadId;
+	}
+
+	[[nodiscard]] auto threadName() const -> std::string {
+		std::lock_guard<std::mutex> lock(mNameMtx);
+		return mThreadName;
+	}
+
+	auto setThreadName(std::string name) -> void {
+		std::lock_guard<std::mutex> lock(mNameMtx);
+		mThreadName = std::move(name);
+	}
+
+private:
+	const uint32_t mThreadId;
+	std::atomic<TraceEvent *> mChunks[kMaxChunks];
+	std::atomic<size_t> mCount{ 0 };
+	std::atomic<uint64_t> mDropped{ 0 };
+
+	mutable std::mutex mNameMtx;
+	std::string mThreadName;
+};
+
+/// Process-wide switch and owner of every thread's buffer
+///
+/// Disabled by default; a disabled span costs one relaxed load. Each thread's buffer is created
+/// and registered, under a lock, on its first span and kept after the thread exits so the whole
+/// run can be exported at the end.
+class Tracer {
+public:
+	static auto instance() -> Tracer & {
+		static Tracer tracer;
+		return tracer;
+	}
+
+	auto enable(bool enabled) -> void {
+		mEnabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] auto enabled() const -> bool {
+		return mEnabled.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] auto now() const -> int64_t {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mEpoch)
+				.count();
+	}
+
+	/// The calling thread's buffer
+	auto threadBuffer() -> TraceBuffer & {
+		thread_local TraceBuffer *buffer = nullptr;
+		if (!buffer) {
+			std::lock_guard<std::mutex> lock(mBuffersMtx);
+			mBuffers.emplace_back(new TraceBuffer(static_cast<uint32_t>(mBuffers.size() + 1)));
+			buffer = mBuffers.back().get();
+		}
+		return *buffer;
+	}
+
+	/// Label the calling thread in the exported trace
+	auto setThreadName(std::string name) -> void {
+		threadBuffer().setThreadName(std::move(name));
+	}
+
+	/// Write every thread's events recorded so far as Chrome trace JSON
+	///
+	/// \param[out] events  - Number of events written
+	/// \param[out] dropped - Events lost to full buffers
+	auto writeChromeTrace(const std::string &path, size_t &events, uint64_t &dropped) const -> bool;
+
+private:
+	Tracer() : mEpoch(std::chrono::steady_clock::now()) {}
+
+	const std::chrono::steady_clock::time_point mEpoch;
+	std::atomic<bool> mEnabled{ false };
+
+	mutable std::mutex mBuffersMtx;
+	std::vector<std::unique_ptr<TraceBuffer>> mBuffers;
+};
+
+/// Records the time from construction to destruction as one event, if tracing is enabled
+class TraceSpan {
+public:
+	explicit TraceSpan(const char *category, const char *name) : mName(name), mCategory(category) {
+		Tracer &tracer = Tracer::instance();
+		mStart = tracer.enabled() ? tracer.now() : -1;
+	}
+
+	~TraceSpan() {
+		if (mStart >= 0) {
+			Tracer &tracer = Tracer::instance();
+			tracer.threadBuffer().append({ mName, mCategory, mStart, tracer.now() - mStart });
+		}
+	}
+
+	TraceSpan(const TraceSpan &) = delete;
+	auto operator=(const TraceSpan &) -> TraceSpan & = delete;
+
+private:
+	const char *mName;
+	const char *mCategory;
+	int64_t mStart;
+};
+
+#define T5DIAG_TRACE_CONCAT_INNER(a, b) a##b
+#define T5DIAG_TRACE_CONCAT(a, b) T5DIAG_TRACE_CONCAT_INNER(a, b)
+
+/// Time the rest of the enclosing scope; compiled out with T5DIAG_NO_TRACING
+#if defined(T5DIAG_NO_TRACING)
+#define T5DIAG_TRACE_SPAN(category, name)
+#else
+#define T5DIAG_TRACE_SPAN(category, name) TraceSpan T5DIAG_TRACE_CONCAT(traceSpan, __LINE__)(category, name)
+#endif
@@ -0,0 +1,366 @@
+/// \file
+/// \brief Vectorized preprocessing of 8-bit IR camera frames ahead of marker detection
+
+#include "include/ir-preprocess.hpp"
+#include "include/trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define IR_PREPROCESS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions marked for it; MSVC always can
+#if defined(IR_PREPROCESS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define IR_TARGET_AVX2 __attribute__((target("avx2")))
+#define IR_TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define IR_TARGET_AVX2
+#define IR_TARGET_SSE2
+#endif
+
+namespace {
+
+std::atomic<int> gSimdLevel{ -1 };
+
+// Contrast stretch in 16-bit fixed point: out = ((x << 8) * scale) >> 16 with x clamped to the
+// range, which keeps every intermediate within uint16 lanes and the result within [0, 255].
+struct StretchCoefficients {
+	uint8_t low;
+	uint8_t range;
+	uint16_t scale;
+};
+
+auto stretchCoefficients(uint8_t low, uint8_t high) -> StretchCoefficients {
+	int range = std::max(1, high - low);
+	return { low, static_cast<uint8_t>(range), static_cast<uint16_t>((65280 + range / 2) / range) };
+}
+
+// Scalar kernels; these also finish the tail of each row for the vector versions
+
+void subtractRowScalar(const uint8_t *light, const uint8_t *dark, uint8_t *dst, int begin, int end) {
+	for (int x = begin; x < end; x++) {
+		dst[x] = (light[x] > dark[x]) ? static_cast<uint8_t>(light[x] - dark[x]) : 0;
+	}
+}
+
+void stretchRowScalar(const uint8_t *src, uint8_t *dst, int begin, int end, const StretchCoefficients &k) {
+	for (int x = begin; x < end; x++) {
+		unsigned value = std::min<unsigned>((src[x] > k.low) ? src[x] - k.low : 0, k.range);
+		dst[x] = static_cast<uint8_t>(((value << 8) * k.scale) >> 16);
+	}
+}
+
+void downscaleRowScalar(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int begin, int end) {
+	for (int x = begin; x < end; x++) {
+		size_t i = 2 * static_cast<size_t>(x);
+		dst[x] = static_cast<uint8_t>((row0[i] + row0[i + 1] + row1[i] + row1[i + 1] + 2) >> 2);
+	}
+}
+
+#if defined(IR_PREPROCESS_X86)
+
+IR_TARGET_SSE2 void subtractRowSse2(const uint8_t *light, const uint8_t *dark, uint8_t *dst, int width) {
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(light + x));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dark + x));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_subs_epu8(a, b));
+	}
+	subtractRowScalar(light, dark, dst, x, width);
+}
+
+IR_TARGET_AVX2 void subtractRowAvx2(const uint8_t *light, const uint8_t *dark, uint8_t *dst, int width) {
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(light + x));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dark + x));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_subs_epu8(a, b));
+	}
+	subtractRowScalar(light, dark, dst, x, width);
+}
+
+IR_TARGET_SSE2 void stretchRowSse2(const uint8_t *src, uint8_t *dst, int width, const StretchCoefficients &k) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i low = _mm_set1_epi8(static_cast<char>(k.low));
+	const __m128i range = _mm_set1_epi8(static_cast<char>(k.range));
+	const __m128i scale = _mm_set1_epi16(static_cast<short>(k.scale));
+
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+		value = _mm_min_epu8(_mm_subs_epu8(value, low), range);
+		// Interleaving with zero below each byte gives value << 8 in each 16-bit lane
+		__m128i lo = _mm_mulhi_epu16(_mm_unpacklo_epi8(zero, value), scale);
+		__m128i hi = _mm_mulhi_epu16(_mm_unpackhi_epi8(zero, value), scale);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(lo, hi));
+	}
+	stretchRowScalar(src, dst, x, width, k);
+}
+
+IR_TARGET_AVX2 void stretchRowAvx2(const uint8_t *src, uint8_t *dst, int width, const StretchCoefficients &k) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i low = _mm256_set1_epi8(static_cast<char>(k.low));
+	const __m256i range = _mm256_set1_epi8(static_cast<char>(k.range));
+	const __m256i scale = _mm256_set1_epi16(static_cast<short>(k.scale));
+
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		__m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x));
+		value = _mm256_min_epu8(_mm256_subs_epu8(value, low), range);
+		// Unpack and pack both work within 128-bit lanes, so the byte order comes back unchanged
+		__m256i lo = _mm256_mulhi_epu16(_mm256_unpacklo_epi8(zero, value), scale);
+		__m256i hi = _mm256_mulhi_epu16(_mm256_unpackhi_epi8(zero, value), scale);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_packus_epi16(lo, hi));
+	}
+	stretchRowScalar(src, dst, x, width, k);
+}
+
+// Sums of horizontally adjacent byte pairs, one per 16-bit lane
+IR_TARGET_SSE2 inline __m128i pairSumsSse2(const uint8_t *p) {
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+	return _mm_add_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00ff)), _mm_srli_epi16(v, 8));
+}
+
+IR_TARGET_AVX2 inline __m256i pairSumsAvx2(const uint8_t *p) {
+	__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+	return _mm256_add_epi16(_mm256_and_si256(v, _mm256_set1_epi16(0x00ff)), _mm256_srli_epi16(v, 8));
+}
+
+IR_TARGET_SSE2 void downscaleRowSse2(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int dstWidth) {
+	const __m128i two = _mm_set1_epi16(2);
+
+	int x = 0;
+	for (; x + 16 <= dstWidth; x += 16) {
+		__m128i a = _mm_add_epi16(pairSumsSse2(row0 + 2 * x), pairSumsSse2(row1 + 2 * x));
+		__m128i b = _mm_add_epi16(pairSumsSse2(row0 + 2 * x + 16), pairSumsSse2(row1 + 2 * x + 16));
+		a = _mm_srli_epi16(_mm_add_epi16(a, two), 2);
+		b = _mm_srli_epi16(_mm_add_epi16(b, two), 2);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(a, b));
+	}
+	downscaleRowScalar(row0, row1, dst, x, dstWidth);
+}
+
+IR_TARGET_AVX2 void downscaleRowAvx2(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int dstWidth) {
+	const __m256i two = _mm256_set1_epi16(2);
+
+	int x = 0;
+	for (; x + 32 <= dstWidth; x += 32) {
+		__m256i a = _mm256_add_epi16(pairSumsAvx2(row0 + 2 * x), pairSumsAvx2(row1 + 2 * x));
+		__m256i b = _mm256_add_epi16(pairSumsAvx2(row0 + 2 * x + 32), pairSumsAvx2(row1 + 2 * x + 32));
+		a = _mm256_srli_epi16(_mm256_add_epi16(a, two), 2);
+		b = _mm256_srli_epi16(_mm256_add_epi16(b, two), 2);
+		// Packing interleaves the 128-bit lanes of a and b; put the quarters back in order
+		__m256i packed = _mm256_packus_epi16(a, b);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x),
+				_mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+	downscaleRowScalar(row0, row1, dst, x, dstWidth);
+}
+
+#endif
+
+} // namespace
+
+auto simdLevelName(SimdLevel level) -> const char * {
+	switch (level) {
+	case SimdLevel::kAvx2:
+		return "avx2";
+	case SimdLevel::kSse2:
+		return "sse2";
+	default:
+		return "scalar";
+	}
+}
+
+auto detectSimdLevel() -> SimdLevel {
+#if defined(IR_PREPROCESS_X86) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return SimdLevel::kAvx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return SimdLevel::kSse2;
+	}
+#elif defined(IR_PREPROCESS_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osSavesYmm = ((info[2] & (1 << 27)) != 0) && ((_xgetbv(0) & 6) == 6);
+	bool avx2 = false;
+	if (osSavesYmm && (maxLeaf >= 7)) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+	if (avx2) {
+		return SimdLevel::kAvx2;
+	}
+	if (sse2) {
+		return SimdLevel::kSse2;
+	}
+#endif
+	return SimdLevel::kScalar;
+}
+
+auto activeSimdLevel() -> SimdLevel {
+	int level = gSimdLevel.load(std::memory_order_relaxed);
+	if (level < 0) {
+		level = static_cast<int>(detectSimdLevel());
+		gSimdLevel.store(level, std::memory_order_relaxed);
+	}
+	return static_cast<SimdLevel>(level);
+}
+
+auto forceSimdLevel(SimdLevel level) -> SimdLevel {
+	auto supported = detectSimdLevel();
+	auto used = (static_cast<int>(level) < static_cast<int>(supported)) ? level : supported;
+	gSimdLevel.store(static_cast<int>(used), std::memory_order_relaxed);
+	return used;
+}
+
+auto subtractDarkFrame(const uint8_t *light, size_t lightStride, const uint8_t *dark, size_t darkStride,
+		uint8_t *dst, size_t dstStride, int width, int height) -> void {
+	auto level = activeSimdLevel();
+	for (int y = 0; y < height; y++) {
+		const uint8_t *a = light + y * lightStride;
+		const uint8_t *b = dark + y * darkStride;
+		uint8_t *out = dst + y * dstStride;
+#if defined(IR_PREPROCESS_X86)
+		if (level == SimdLevel::kAvx2) {
+			subtractRowAvx2(a, b, out, width);
+			continue;
+		}
+		if (level == SimdLevel::kSse2) {
+			subtractRowSse2(a, b, out, width);
+			continue;
+		}
+#endif
+		(void)level;
+		subtractRowScalar(a, b, out, 0, width);
+	}
+}
+
+auto findStretchRange(const uint8_t *src, size_t stride, int width, int height, double clipFraction,
+		uint8_t &low, uint8_t &high) -> void {
+	// Four interleaved histograms avoid stalls when neighbouring pixels share a bin
+	uint32_t histograms[4][256] = {};
+	for (int y = 0; y < height; y++) {
+		const uint8_t *row = src + y * stride;
+		int x = 0;
+		for (; x + 4 <= width; x += 4) {
+			histograms[0][row[x]]++;
+			histograms[1][row[x + 1]]++;
+			histograms[2][row[x + 2]]++;
+			histograms[3][row[x + 3]]++;
+		}
+		for (; x < width; x++) {
+			histograms[0][row[x]]++;
+		}
+	}
+
+	uint64_t histogram[256];
+	for (int i = 0; i < 256; i++) {
+		histogram[i] = static_cast<uint64_t>(histograms[0][i]) + histograms[1][i] + histograms[2][i] + histograms[3][i];
+	}
+
+	auto clipCount = static_cast<uint64_t>(clipFraction * width * height);
+	uint64_t count = 0;
+	int lowBin = 0;
+	while ((lowBin < 255) && ((count += histogram[lowBin]) <= clipCount)) {
+		lowBin++;
+	}
+	count = 0;
+	int highBin = 255;
+	while ((highBin > lowBin) && ((count += histogram[highBin]) <= clipCount)) {
+		highBin--;
+	}
+
+	low = static_cast<uint8_t>(lowBin);
+	high = static_cast<uint8_t>(highBin);
+}
+
+auto contrastStretch(const uint8_t *src, size_t srcStride, uint8_t *dst, size_t dstStride, int width,
+		int height, uint8_t low, uint8_t high) -> void {
+	auto k = stretchCoefficients(low, high);
+	auto level = activeSimdLevel();
+	for (int y = 0; y < height; y++) {
+		const uint8_t *in = src + y * srcStride;
+		uint8_t *out = dst + y * dstStride;
+#if defined(IR_PREPROCESS_X86)
+		if (level == SimdLevel::kAvx2) {
+			stretchRowAvx2(in, out, width, k);
+			continue;
+		}
+		if (level == SimdLevel::kSse2) {
+			stretchRowSse2(in, out, width, k);
+			continue;
+		}
+#endif
+		(void)level;
+		stretchRowScalar(in, out, 0, width, k);
+	}
+}
+
+auto downscaleBy2(const uint8_t *src, size_t srcStride, uint8_t *dst, size_t dstStride, int width,
+		int height) -> void {
+	int dstWidth = width / 2;
+	int dstHeight = height / 2;
+	auto level = activeSimdLevel();
+	for (int y = 0; y < dstHeight; y++) {
+		const uint8_t *row0 = src + (2 * y) * srcStride;
+		const uint8_t *row1 = row0 + srcStride;
+		uint8_t *out = dst + y * dstStride;
+#if defined(IR_PREPROCESS_X86)
+		if (level == SimdLevel::kAvx2) {
+			downscaleRowAvx2(row0, row1, out, dstWidth);
+			continue;
+		}
+		if (level == SimdLevel::kSse2) {
+			downscaleRowSse2(row0, row1, out, dstWidth);
+			continue;
+		}
+#endif
+		(void)level;
+		downscaleRowScalar(row0, row1, out, 0, dstWidth);
+	}
+}
+
+auto IrPreprocessor::process(const uint8_t *light, size_t lightStride, int width, int height,
+		const uint8_t *dark, size_t darkStride) -> void {
+	T5DIAG_TRACE_SPAN("capture", "preprocess");
+	mFrame.resize(width, height);
+
+	const uint8_t *src = light;
+	size_t srcStride = lightStride;
+	if (dark) {
+		subtractDarkFrame(light, lightStride, dark, darkStride, mFrame.data(), mFrame.stride(), width, height);
+		src = mFrame.data();
+		srcStride = mFrame.stride();
+	}
+
+	if (mOptions.stretch) {
+		uint8_t low = 0;
+		uint8_t high = 255;
+		findStretchRange(src, srcStride, width, height, mOptions.clipFraction, low, high);
+		contrastStretch(src, srcStride, mFrame.data(), mFrame.stride(), width, height, low, high);
+	} else if (src == light) {
+		for (int y = 0; y < height; y++) {
+			std::memcpy(mFrame.data() + y * mFrame.stride(), light + y * lightStride, width);
+		}
+	}
+
+	if (mOptions.coarse) {
+		mCoarse.resize(width / 2, height / 2);
+		downscaleBy2(mFrame.data(), mFrame.stride(), mCoarse.data(), mCoarse.stride(), width, height);
+	} else {
+		mCoarse.resize(0, 0);
+	}
+}
@@ -0,0 +1,236 @@
+/// \file
+/// \brief 6DoF poses of detected ArUco markers in the gameboard frame
+
+#include "include/marker-pose.hpp"
+#include "include/trace.hpp"
+
+#include <opencv2/calib3d.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+
+// Rotation taking GBD vectors into the frame the quaternion rotates to
+auto quatToMatrix(const T5_Quat &q) -> cv::Matx33d {
+	double w = q.w, x = q.x, y = q.y, z = q.z;
+	double n = w * w + x * x + y * y + z * z;
+	double s = (n > 0.0) ? 2.0 / n : 0.0;
+
+	cv::Matx33d r;
+	r(0, 0) = 1.0 - s * (y * y + z * z);
+	r(0, 1) = s * (x * y - w * z);
+	r(0, 2) = s * (x * z + w * y);
+	r(1, 0) = s * (x * y + w * z);
+	r(1, 1) = 1.0 - s * (x * x + z * z);
+	r(1, 2) = s * (y * z - w * x);
+	r(2, 0) = s * (x * z - w * y);
+	r(2, 1) = s * (y * z + w * x);
+	r(2, 2) = 1.0 - s * (x * x + y * y);
+	return r;
+}
+
+auto matrixToQuat(const cv::Matx33d &r) -> T5_Quat {
+	double w, x, y, z;
+	double trace = r(0, 0) + r(1, 1) + r(2, 2);
+	if (trace > 0.0) {
+		double s = 2.0 * std::sqrt(trace + 1.0);
+		w = 0.25 * s;
+		x = (r(2, 1) - r(1, 2)) / s;
+		y = (r(0, 2) - r(2, 0)) / s;
+		z = (r(1, 0) - r(0, 1)) / s;
+	} else if ((r(0, 0) > r(1, 1)) && (r(0, 0) > r(2, 2))) {
+		double s = 2.0 * std::sqrt(1.0 + r(0, 0) - r(1, 1) - r(2, 2));
+		w = (r(2, 1) - r(1, 2)) / s;
+		x = 0.25 * s;
+		y = (r(0, 1) + r(1, 0)) / s;
+		z = (r(0, 2) + r(2, 0)) / s;
+	} else if (r(1, 1) > r(2, 2)) {
+		double s = 2.0 * std::sqrt(1.0 + r(1, 1) - r(0, 0) - r(2, 2));
+		w = (r(0, 2) - r(2, 0)) / s;
+		x = (r(0, 1) + r(1, 0)) / s;
+		y = 0.25 * s;
+		z = (r(1, 2) + r(2, 1)) / s;
+	} else {
+		double s = 2.0 * std::sqrt(1.0 + r(2, 2) - r(0, 0) - r(1, 1));
+		w = (r(1, 0) - r(0, 1)) / s;
+		x = (r(0, 2) + r(2, 0)) / s;
+		y = (r(1, 2) + r(2, 1)) / s;
+		z = 0.25 * s;
+	}
+	// Keep w non-negative so consecutive frames don't flip sign
+	double sign = (w < 0.0) ? -1.0 : 1.0;
+	return { static_cast<float>(sign * w), static_cast<float>(sign * x), static_cast<float>(sign * y),
+		static_cast<float>(sign * z) };
+}
+
+// Larger for rotations closer to each other; the trace of the relative rotation is 1 + 2 cos(angle)
+auto rotationSimilarity(const cv::Matx33d &a, const cv::Matx33d &b) -> double {
+	double trace = 0.0;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			trace += a(r, c) * b(r, c);
+		}
+	}
+	return trace;
+}
+
+} // namespace
+
+auto CameraIntrinsics::approximate(int width, int height, double horizontalFovDegrees) -> CameraIntrinsics {
+	const double kPi = 3.14159265358979323846;
+	double focal = 0.5 * width / std::tan(0.5 * horizontalFovDegrees * kPi / 180.0);
+
+	CameraIntrinsics intrinsics;
+	intrinsics.cameraMatrix = cv::Matx33d(focal, 0.0, 0.5 * (width - 1), 0.0, focal, 0.5 * (height - 1), 0.0,
+			0.0, 1.0);
+	return intrinsics;
+}
+
+auto loadCameraIntrinsics(const std::string &path, CameraIntrinsics &intrinsics) -> bool {
+	cv::FileStorage storage(path, cv::FileStorage::READ);
+	if (!storage.isOpened()) {
+		std::cerr << "Error opening " << path << std::endl;
+		return false;
+	}
+
+	cv::Mat cameraMatrix, distCoeffs;
+	storage["camera_matrix"] >> cameraMatrix;
+	storage["distortion_coefficients"] >> distCoeffs;
+	if ((cameraMatrix.rows != 3) || (cameraMatrix.cols != 3)) {
+		std::cerr << "No 3x3 camera_matrix in " << path << std::endl;
+		return false;
+	}
+
+	cameraMatrix.convertTo(cameraMatrix, CV_64F);
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			intrinsics.cameraMatrix(r, c) = cameraMatrix.at<double>(r, c);
+		}
+	}
+	intrinsics.distCoeffs.clear();
+	if (!distCoeffs.empty()) {
+		distCoeffs.convertTo(distCoeffs, CV_64F);
+		distCoeffs = distCoeffs.reshape(1, 1);
+		intrinsics.distCoeffs.assign(distCoeffs.ptr<double>(), distCoeffs.ptr<double>() + distCoeffs.cols);
+	}
+	return true;
+}
+
+auto CsvMarkerPoseSink::write(const MarkerPoseFrame &poses) -> bool {
+	T5DIAG_TRACE_SPAN("capture", "write marker poses");
+	if (!mOut.is_open()) {
+		mOut.open(mPath, std::ios::trunc);
+		if (!mOut) {
+			std::cerr << "Error creating " << mPath << std::endl;
+			return false;
+		}
+		mOut << "frame,timestamp_ns,id,x,y,z,qw,qx,qy,qz,reprojection_px,guess\n";
+	}
+
+	char buffer[200];
+	for (const auto &marker : poses.markers) {
+		const auto &p = marker.posMKR_GBD;
+		const auto &q = marker.rotToMKR_GBD;
+		std::snprintf(buffer, sizeof(buffer), "%llu,%llu,%d,%.5f,%.5f,%.5f,%.6f,%.6f,%.6f,%.6f,%.3f,%d\n",
+				static_cast<unsigned long long>(poses.frame), static_cast<unsigned long long>(poses.timestampNanos),
+				marker.id, p.x, p.y, p.z, q.w, q.x, q.y, q.z, marker.reprojectionError, marker.fromGuess ? 1 : 0);
+		mOut << buffer;
+	}
+	return static_cast<bool>(mOut);
+}
+
+MarkerPoseEstimator::MarkerPoseEstimator(CameraIntrinsics intrinsics, Options options)
+	: mIntrinsics(std::move(intrinsics)), mOptions(options) {
+	for (double coefficient : mIntrinsics.distCoeffs) {
+		mDistorted = mDistorted || (coefficient != 0.0);
+	}
+
+	// The corner order SOLVEPNP_IPPE_SQUARE requires, matching the detector's
+	auto half = static_cast<float>(0.5 * mOptions.markerLength);
+	mObjectPoints = { { -half, half, 0.0f }, { half, half, 0.0f }, { half, -half, 0.0f }, { -half, -half, 0.0f } };
+}
+
+auto MarkerPoseEstimator::estimate(const std::vector<int> &ids, const std::vector<std::vector<cv::Point2f>> &corners,
+		const T5_Vec3 &posCAM_GBD, const T5_Quat &rotToCAM_GBD, uint64_t timestampNanos) -> const MarkerPoseFrame & {
+	T5DIAG_TRACE_SPAN("capture", "estimate marker poses");
+	mPoses.frame++;
+	mPoses.timestampNanos = timestampNanos;
+	mPoses.posCAM_GBD = posCAM_GBD;
+	mPoses.rotToCAM_GBD = rotToCAM_GBD;
+	mPoses.markers.clear();
+
+	// Undistort every corner of the frame in one call, then solve each marker distortion-free
+	mImagePoints.clear();
+	for (const auto &markerCorners : corners) {
+		mImagePoints.insert(mImagePoints.end(), markerCorners.begin(), markerCorners.end());
+	}
+	if (mDistorted && !mImagePoints.empty()) {
+		std::vector<cv::Point2f> distorted;
+		distorted.swap(mImagePoints);
+		cv::undistortPoints(distorted, mImagePoints, mIntrinsics.cameraMatrix, mIntrinsics.distCoeffs, cv::noArray(),
+				mIntrinsics.cameraMatrix);
+	}
+
+	// OpenCV camera axes (y down, z forward) to the NDK's (y up, z backward), then into GBD
+	const cv::Matx33d flip(1.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0, 0.0, -1.0);
+	const cv::Matx33d cameraToGameboard = quatToMatrix(rotToCAM_GBD).t() * flip;
+	const cv::Vec3d cameraOrigin(posCAM_GBD.x, posCAM_GBD.y, posCAM_GBD.z);
+
+	for (size_t i = 0; i < ids.size(); i++) {
+		if (corners[i].size() != 4) {
+			continue;
+		}
+		const cv::Point2f *imagePoints = &mImagePoints[i * 4];
+		std::vector<cv::Point2f> markerPoints(imagePoints, imagePoints + 4);
+
+		MarkerPose pose;
+		pose.id = ids[i];
+
+		int solutions = cv::solvePnPGeneric(mObjectPoints, markerPoints, mIntrinsics.cameraMatrix, cv::noArray(),
+				mRvecs, mTvecs, false, cv::SOLVEPNP_IPPE_SQUARE, cv::noArray(), cv::noArray(), mErrors);
+		if (solutions < 1) {
+			continue;
+		}
+
+		// Solutions come sorted by reprojection error
+		int chosen = 0;
+		cv::Matx33d markerToCamera;
+		cv::Rodrigues(mRvecs[0], markerToCamera);
+
+		auto guess = mGuesses.find(pose.id);
+		if (mOptions.useGuess && (solutions > 1) && (guess != mGuesses.end()) &&
+				(mErrors[1] <= mOptions.ambiguityRatio * mErrors[0])) {
+			cv::Matx33d alternative;
+			cv::Rodrigues(mRvecs[1], alternative);
+			const cv::Matx33d &previous = guess->second.rotation;
+			if (rotationSimilarity(previous, alternative) > rotationSimilarity(previous, markerToCamera)) {
+				chosen = 1;
+				markerToCamera = alternative;
+			}
+			pose.fromGuess = true;
+		}
+		pose.rvec = mRvecs[chosen];
+		pose.tvec = mTvecs[chosen];
+		pose.reprojectionError = mErrors[chosen];
+		mGuesses[pose.id] = { markerToCamera, mPoses.frame };
+
+		cv::Vec3d position = cameraOrigin + cameraToGameboard * pose.tvec;
+		pose.posMKR_GBD = { static_cast<float>(position[0]), static_cast<float>(position[1]),
+			static_cast<float>(position[2]) };
+		pose.rotToMKR_GBD = matrixToQuat((cameraToGameboard * markerToCamera).t());
+
+		mPoses.markers.push_back(pose);
+	}
+
+	for (auto it = mGuesses.begin(); it != mGuesses.end();) {
+		if (mPoses.frame - it->second.frame > static_cast<uint64_t>(mOptions.maxGuessAge)) {
+			it = mGuesses.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	return mPoses;
+}
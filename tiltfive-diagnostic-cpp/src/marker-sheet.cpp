@@ -0,0 +1,182 @@
+/// \file
+/// \brief Headless batch rendering of ArUco marker sheets
+
+#include "include/marker-sheet.hpp"
+
+#include "include/aruco-atlas.hpp"
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <sstream>
+
+auto MarkerSheetLayout::pageSize() const -> cv::Size {
+	int width = (pageWidthPx > 0) ? pageWidthPx : cols * cellSidePx + 2 * marginPx;
+	int height = (pageHeightPx > 0) ? pageHeightPx : rows * cellSidePx + 2 * marginPx;
+	return { width, height };
+}
+
+auto MarkerSheetLayout::validate(std::string &err) const -> bool {
+	if ((rows <= 0) || (cols <= 0)) {
+		err = "rows and columns must be positive";
+		return false;
+	}
+	if ((borderBits < 1) || (borderBits > kArucoMaxBorderBits)) {
+		err = "border must be 1 to " + std::to_string(kArucoMaxBorderBits) + " bits";
+		return false;
+	}
+	if ((markerSidePx < arucoMarkerCells(borderBits)) || (cellSidePx < markerSidePx)) {
+		err = "marker side must be at least one pixel per bit and no larger than the cell pitch";
+		return false;
+	}
+	auto size = pageSize();
+	if ((marginPx + (cols - 1) * cellSidePx + markerSidePx > size.width) ||
+			(marginPx + (rows - 1) * cellSidePx + markerSidePx > size.height)) {
+		err = "marker grid doesn't fit on the page";
+		return false;
+	}
+	return true;
+}
+
+auto MarkerSheetLayout::fitToPage(cv::Size pagePx, int bitsPerSide) -> void {
+	pageWidthPx = pagePx.width;
+	pageHeightPx = pagePx.height;
+
+	cellSidePx = std::min((pagePx.width - 2 * marginPx) / cols, (pagePx.height - 2 * marginPx) / rows);
+
+	// Keep the original 200:220 marker to pitch ratio, snapped to whole pixels per bit
+	int marker = cellSidePx * 10 / 11;
+	markerSidePx = std::max(bitsPerSide, marker / bitsPerSide * bitsPerSide);
+}
+
+auto parseMarkerIds(const std::string &spec, int dictionarySize, std::vector<int> &ids) -> bool {
+	std::stringstream stream(spec);
+	std::string item;
+
+	while (std::getline(stream, item, ',')) {
+		if (item.empty()) {
+			continue;
+		}
+
+		int first = 0;
+		int last = 0;
+		char dash = 0;
+		std::stringstream itemStream(item);
+		itemStream >> first;
+		if (!itemStream) {
+			return false;
+		}
+		if (itemStream >> dash) {
+			if ((dash != '-') || !(itemStream >> last)) {
+				return false;
+			}
+		} else {
+			last = first;
+		}
+
+		if ((first < 0) || (last < first) || (last >= dictionarySize)) {
+			return false;
+		}
+		for (int id = first; id <= last; id++) {
+			ids.push_back(id);
+		}
+	}
+
+	return !ids.empty();
+}
+
+auto MarkerSheetRenderer::renderPage(const int *ids, size_t count, cv::Mat &page) const -> void {
+	page.create(mLayout.pageSize(), CV_8UC1);
+	page.setTo(cv::Scalar(255));
+
+	count = std::min(count, static_cast<size_t>(mLayout.markersPerPage()));
+
+	// Each cell renders straight into its own region of the page, so workers never overlap
+	cv::parallel_for_(cv::Range(0, static_cast<int>(count)), [&](const cv::Range &range) {
+		for (int i = range.start; i < range.end; i++) {
+			int row = i / mLayout.cols;
+			int col = i % mLayout.cols;
+			cv::Mat cell = page(cv::Rect(col * mLayout.cellSidePx + mLayout.marginPx,
+					row * mLayout.cellSidePx + mLayout.marginPx,
+					mLayout.markerSidePx,
+					mLayout.markerSidePx));
+			blitArucoMarker(ids[i], cell, mLayout.borderBits);
+		}
+	});
+}
+
+auto PngSheetSink::begin(size_t pageCount) -> bool {
+	mPageCount = pageCount;
+	return true;
+}
+
+auto PngSheetSink::writePage(const cv::Mat &page, size_t pageIndex) -> bool {
+	std::string fileName = mPrefix + ".png";
+	if (mPageCount > 1) {
+		char suffix[16];
+		std::snprintf(suffix, sizeof(suffix), "-%03zu.png", pageIndex + 1);
+		fileName = mPrefix + suffix;
+	}
+
+	if (!cv::imwrite(fileName, page)) {
+		std::cerr << "Error writing " << fileName << std::endl;
+		return false;
+	}
+	return true;
+}
+
+auto PdfSheetSink::begin(size_t /* pageCount */) -> bool {
+	if (!mWriter.open(mPath)) {
+		std::cerr << "Error creating " << mPath << std::endl;
+		return false;
+	}
+	return true;
+}
+
+auto PdfSheetSink::writePage(const cv::Mat &page, size_t /* pageIndex */) -> bool {
+	return mWriter.addGrayPage(page.data, page.cols, page.rows, page.step[0], mDpi);
+}
+
+auto PdfSheetSink::finish() -> bool {
+	return mWriter.close();
+}
+
+auto generateMarkerSheets(const MarkerSheetRenderer &renderer, const std::vector<int> &ids,
+		MarkerSheetSink &sink) -> bool {
+	size_t perPage = renderer.layout().markersPerPage();
+	size_t pageCount = (ids.size() + perPage - 1) / perPage;
+
+	if (!sink.begin(pageCount)) {
+		return false;
+	}
+
+	cv::Mat pages[2];
+	std::future<bool> pendingWrite;
+	bool ok = true;
+
+	for (size_t pageIndex = 0; pageIndex < pageCount; pageIndex++) {
+		cv::Mat &page = pages[pageIndex % 2];
+
+		size_t first = pageIndex * perPage;
+		renderer.renderPage(ids.data() + first, std::min(perPage, ids.size() - first), page);
+
+		// The previous page must be written before this one, and before its buffer is reused
+		if (pendingWrite.valid() && !pendingWrite.get()) {
+			ok = false;
+			break;
+		}
+		pendingWrite = std::async(std::launch::async, [&sink, &page, pageIndex]() {
+			return sink.writePage(page, pageIndex);
+		});
+	}
+
+	if (pendingWrite.valid() && !pendingWrite.get()) {
+		ok = false;
+	}
+
+	return sink.finish() && ok;
+}
@@ -0,0 +1,211 @@
+/// \file
+/// \brief Minimal HTTP endpoint serving a MetricsRegistry for Prometheus to scrape
+
+#include "include/metrics-server.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(_WIN32)
+using Socket = SOCKET;
+const Socket kNoSocket = INVALID_SOCKET;
+
+auto closeSocket(Socket socket) -> void {
+	closesocket(socket);
+}
+
+auto waitReadable(Socket socket, int timeoutMs) -> bool {
+	WSAPOLLFD entry = { socket, POLLRDNORM, 0 };
+	return WSAPoll(&entry, 1, timeoutMs) > 0;
+}
+
+// Winsock has no SIGPIPE
+constexpr int kSendFlags = 0;
+
+auto disableSigpipe(Socket) -> void {}
+#else
+using Socket = int;
+const Socket kNoSocket = -1;
+
+auto closeSocket(Socket socket) -> void {
+	close(socket);
+}
+
+auto waitReadable(Socket socket, int timeoutMs) -> bool {
+	pollfd entry = { socket, POLLIN, 0 };
+	return poll(&entry, 1, timeoutMs) > 0;
+}
+
+// A scraper hanging up mid-response must fail the send, not raise SIGPIPE and end the process.
+// Linux takes a flag on each send; macOS and the BSDs take a socket option instead.
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+auto disableSigpipe(Socket socket) -> void {
+#if defined(SO_NOSIGPIPE)
+	int on = 1;
+	setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+	(void)socket;
+#endif
+}
+#endif
+
+// How often the accept loop checks whether it should stop
+constexpr int kAcceptPollMs = 100;
+// A scraper that doesn't send its request within this long is dropped
+constexpr int kRequestTimeoutMs = 1000;
+
+auto sendAll(Socket socket, const std::string &data) -> bool {
+	size_t sent = 0;
+	while (sent < data.size()) {
+		auto bytes = send(socket, data.data() + sent, static_cast<int>(data.size() - sent), kSendFlags);
+		if (bytes <= 0) {
+			return false;
+		}
+		sent += static_cast<size_t>(bytes);
+	}
+	return true;
+}
+
+auto response(const char *status, const char *contentType, const std::string &body) -> std::string {
+	return std::string("HTTP/1.1 ") + status + "\r\nContent-Type: " + contentType +
+			"\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+}
+
+} // namespace
+
+MetricsServer::~MetricsServer() {
+	stop();
+}
+
+auto MetricsServer::start(uint16_t port, const std::string &address) -> bool {
+	if (mListener != -1) {
+		return true;
+	}
+
+#if defined(_WIN32)
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		std::cerr << "Error initializing Winsock" << std::endl;
+		return false;
+	}
+#endif
+
+	Socket listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener == kNoSocket) {
+		std::cerr << "Error creating metrics socket" << std::endl;
+		return false;
+	}
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+
+	sockaddr_in bindAddress = {};
+	bindAddress.sin_family = AF_INET;
+	bindAddress.sin_port = htons(port);
+	if (inet_pton(AF_INET, address.c_str(), &bindAddress.sin_addr) != 1) {
+		std::cerr << "Invalid metrics address " << address << std::endl;
+		closeSocket(listener);
+		return false;
+	}
+	if ((bind(listener, reinterpret_cast<sockaddr *>(&bindAddress), sizeof(bindAddress)) != 0) ||
+			(listen(listener, 4) != 0)) {
+		std::cerr << "Error listening for metrics scrapes on " << address << ":" << port << std::endl;
+		closeSocket(listener);
+		return false;
+	}
+
+	sockaddr_in boundAddress = {};
+	socklen_t boundSize = sizeof(boundAddress);
+	getsockname(listener, reinterpret_cast<sockaddr *>(&boundAddress), &boundSize);
+	mPort = ntohs(boundAddress.sin_port);
+
+	mListener = static_cast<intptr_t>(listener);
+	mStop = false;
+	mThread = std::thread([this]() { serve(); });
+	return true;
+}
+
+auto MetricsServer::stop() -> void {
+	if (mListener == -1) {
+		return;
+	}
+	mStop = true;
+	if (mThread.joinable()) {
+		mThread.join();
+	}
+	closeSocket(static_cast<Socket>(mListener));
+	mListener = -1;
+#if defined(_WIN32)
+	WSACleanup();
+#endif
+}
+
+auto MetricsServer::serve() -> void {
+	auto listener = static_cast<Socket>(mListener);
+	while (!mStop) {
+		if (!waitReadable(listener, kAcceptPollMs)) {
+			continue;
+		}
+		Socket client = accept(listener, nullptr, nullptr);
+		if (client == kNoSocket) {
+			continue;
+		}
+		disableSigpipe(client);
+		handle(static_cast<intptr_t>(client));
+		closeSocket(client);
+	}
+}
+
+auto MetricsServer::handle(intptr_t clientHandle) -> void {
+	auto client = static_cast<Socket>(clientHandle);
+
+	// Only the request line matters; read until it's complete or the headers end
+	std::string request;
+	char buffer[1024];
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kRequestTimeoutMs);
+	while ((request.find("\r\n") == std::string::npos) && (request.size() < 8192)) {
+		auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		if ((remaining.count() <= 0) || !waitReadable(client, static_cast<int>(remaining.count()))) {
+			return;
+		}
+		auto bytes = recv(client, buffer, sizeof(buffer), 0);
+		if (bytes <= 0) {
+			return;
+		}
+		request.append(buffer, static_cast<size_t>(bytes));
+	}
+
+	std::string requestLine = request.substr(0, request.find("\r\n"));
+	if ((requestLine.compare(0, 13, "GET /metrics ") == 0) || (requestLine.compare(0, 6, "GET / ") == 0)) {
+		sendAll(client, response("200 OK", "text/plain; version=0.0.4; charset=utf-8", mRegistry.render()));
+	} else if (requestLine.compare(0, 4, "GET ") == 0) {
+		sendAll(client, response("404 Not Found", "text/plain; charset=utf-8", "Metrics are at /metrics\n"));
+	} else {
+		sendAll(client, response("405 Method Not Allowed", "text/plain; charset=utf-8", "Only GET is supported\n"));
+	}
+}
@@ -0,0 +1,203 @@
+/// \file
+/// \brief Counters, gauges and histograms for long-running diagnostics, in Prometheus text format
+
+#include "include/metrics.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+
+namespace {
+
+auto formatValue(double value) -> std::string {
+	if (std::isnan(value)) {
+		return "NaN";
+	}
+	if (std::isinf(value)) {
+		return (value > 0) ? "+Inf" : "-Inf";
+	}
+	// Shortest of the two that reads back exactly, so bucket bounds print as written
+	char text[32];
+	std::snprintf(text, sizeof(text), "%.15g", value);
+	if (std::strtod(text, nullptr) != value) {
+		std::snprintf(text, sizeof(text), "%.17g", value);
+	}
+	return text;
+}
+
+auto escapeLabelValue(const std::string &value) -> std::string {
+	std::string escaped;
+	escaped.reserve(value.size());
+	for (char c : value) {
+		if (c == '\\') {
+			escaped += "\\\\";
+		} else if (c == '"') {
+			escaped += "\\\"";
+		} else if (c == '\n') {
+			escaped += "\\n";
+		} else {
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+auto escapeHelp(const std::string &help) -> std::string {
+	std::string escaped;
+	escaped.reserve(help.size());
+	for (char c : help) {
+		if (c == '\\') {
+			escaped += "\\\\";
+		} else if (c == '\n') {
+			escaped += "\\n";
+		} else {
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+// `{a="1",b="2"}`, with an extra label appended if given, or nothing for no labels
+auto formatLabels(const MetricLabels &labels, const char *extraName = nullptr, const std::string &extraValue = {})
+		-> std::string {
+	if (labels.empty() && !extraName) {
+		return {};
+	}
+	std::string text = "{";
+	for (const auto &label : labels) {
+		if (text.size() > 1) {
+			text += ",";
+		}
+		text += label.first + "=\"" + escapeLabelValue(label.second) + "\"";
+	}
+	if (extraName) {
+		if (text.size() > 1) {
+			text += ",";
+		}
+		text += std::string(extraName) + "=\"" + extraValue + "\"";
+	}
+	return text + "}";
+}
+
+} // namespace
+
+MetricHistogram::MetricHistogram(std::vector<double> bounds)
+	: mBounds(std::move(bounds)), mBuckets(new std::atomic<uint64_t>[mBounds.size() + 1]) {
+	for (size_t i = 0; i <= mBounds.size(); i++) {
+		mBuckets[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+auto MetricHistogram::observe(double value) -> void {
+	// Few enough buckets that a linear scan beats a binary search
+	size_t bucket = 0;
+	while ((bucket < mBounds.size()) && (value > mBounds[bucket])) {
+		bucket++;
+	}
+	mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	double sum = mSum.load(std::memory_order_relaxed);
+	while (!mSum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {
+	}
+}
+
+auto MetricHistogram::cumulativeCounts() const -> std::vector<uint64_t> {
+	std::vector<uint64_t> counts(mBounds.size() + 1);
+	uint64_t total = 0;
+	for (size_t i = 0; i <= mBounds.size(); i++) {
+		total += mBuckets[i].load(std::memory_order_relaxed);
+		counts[i] = total;
+	}
+	return counts;
+}
+
+auto MetricsRegistry::find(const std::string &name, Type type, const MetricLabels &labels) -> Entry * {
+	for (auto &entry : mEntries) {
+		if ((entry.name == name) && (entry.type == type) && (entry.labels == labels)) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+auto MetricsRegistry::counter(const std::string &name, const std::string &help, const MetricLabels &labels)
+		-> MetricCounter & {
+	std::lock_guard<std::mutex> lock(mMtx);
+	if (Entry *entry = find(name, Type::kCounter, labels)) {
+		return *entry->counter;
+	}
+	mEntries.push_back(Entry{ name, help, Type::kCounter, labels, nullptr, nullptr, nullptr });
+	mEntries.back().counter.reset(new MetricCounter());
+	return *mEntries.back().counter;
+}
+
+auto MetricsRegistry::gauge(const std::string &name, const std::string &help, const MetricLabels &labels)
+		-> MetricGauge & {
+	std::lock_guard<std::mutex> lock(mMtx);
+	if (Entry *entry = find(name, Type::kGauge, labels)) {
+		return *entry->gauge;
+	}
+	mEntries.push_back(Entry{ name, help, Type::kGauge, labels, nullptr, nullptr, nullptr });
+	mEntries.back().gauge.reset(new MetricGauge());
+	return *mEntries.back().gauge;
+}
+
+auto MetricsRegistry::histogram(const std::string &name, const std::string &help, std::vector<double> bounds,
+		const MetricLabels &labels) -> MetricHistogram & {
+	std::lock_guard<std::mutex> lock(mMtx);
+	if (Entry *entry = find(name, Type::kHistogram, labels)) {
+		return *entry->histogram;
+	}
+	mEntries.push_back(Entry{ name, help, Type::kHistogram, labels, nullptr, nullptr, nullptr });
+	mEntries.back().histogram.reset(new MetricHistogram(std::move(bounds)));
+	return *mEntries.back().histogram;
+}
+
+auto MetricsRegistry::render() const -> std::string {
+	static const char *const kTypeNames[] = { "counter", "gauge", "histogram" };
+
+	std::lock_guard<std::mutex> lock(mMtx);
+	std::string text;
+	std::set<std::string> rendered;
+	for (const auto &first : mEntries) {
+		if (!rendered.insert(first.name).second) {
+			continue;
+		}
+		text += "# HELP " + first.name + " " + escapeHelp(first.help) + "\n";
+		text += "# TYPE " + first.name + " " + kTypeNames[static_cast<int>(first.type)] + "\n";
+
+		for (const auto &entry : mEntries) {
+			if (entry.name != first.name) {
+				continue;
+			}
+			switch (entry.type) {
+				case Type::kCounter:
+					text += entry.name + formatLabels(entry.labels) + " " + std::to_string(entry.counter->value()) + "\n";
+					break;
+				case Type::kGauge:
+					text += entry.name + formatLabels(entry.labels) + " " + formatValue(entry.gauge->value()) + "\n";
+					break;
+				case Type::kHistogram: {
+					const auto &bounds = entry.histogram->bounds();
+					auto counts = entry.histogram->cumulativeCounts();
+					for (size_t i = 0; i < counts.size(); i++) {
+						std::string bound = (i < bounds.size()) ? formatValue(bounds[i]) : "+Inf";
+						text += entry.name + "_bucket" + formatLabels(entry.labels, "le", bound) + " " +
+								std::to_string(counts[i]) + "\n";
+					}
+					text += entry.name + "_sum" + formatLabels(entry.labels) + " " + formatValue(entry.histogram->sum()) +
+							"\n";
+					text += entry.name + "_count" + formatLabels(entry.labels) + " " + std::to_string(counts.back()) +
+							"\n";
+					break;
+				}
+			}
+		}
+	}
+	return text;
+}
+
+auto latencyBuckets() -> std::vector<double> {
+	return { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0 };
+}
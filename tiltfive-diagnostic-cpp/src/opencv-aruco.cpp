@@ -1,21 +1,59 @@
+#include "include/aruco-atlas.hpp"
+#include "include/marker-sheet.hpp"
+#include "include/session-file.hpp"
+
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgcodecs.hpp>
-#include <opencv2/objdetect/aruco_detector.hpp>
-#include <opencv2/objdetect/aruco_dictionary.hpp>
 
 using namespace cv;
 
-static std::string roundNum(float num) {
-	double value = std::round(num * 1000.0) / 1000.0;
-	std::string num_text = std::to_string(value);
+// Play a recorded session straight from its memory mapping. Space pauses, any other key steps
+// while paused, and q quits.
+static int playSession(const std::string &sessionPath) {
+	SessionReader session;
+	if (!session.open(sessionPath)) {
+		return 1;
+	}
+	std::cout << "Session " << sessionPath << ": " << session.frameCount() << " frames of " << session.width()
+			  << "x" << session.height() << std::endl;
+
+	const size_t kPrefetchFrames = 32;
+	session.adviseSequential();
+	cv::namedWindow("Test Window", cv::WINDOW_AUTOSIZE);
 
-	return num_text.substr(0, num_text.find(".") + 4);
+	bool paused = false;
+	for (size_t i = 0; i < session.frameCount();) {
+		if (i % kPrefetchFrames == 0) {
+			session.prefetch(i + kPrefetchFrames, kPrefetchFrames);
+		}
+		cv::imshow("Test Window", session.frame(i));
+		std::cout << "\rFrame " << i << " at " << session.info(i).timestampNanos << " ns" << std::flush;
+
+		int key = cv::waitKey(paused ? 0 : 1);
+		const int SPACE_KEY = 32;
+		const int Q_KEY = 113;
+		if (key == Q_KEY) {
+			break;
+		} else if (key == SPACE_KEY) {
+			paused = !paused;
+		} else {
+			i++;
+		}
+	}
+	std::cout << std::endl;
+	return 0;
 }
 
-static int displayCapturedTiltFiveImage() {
-	std::string image_path = "C:/dev/code/visual-studio/tiltfive-diagnostic-cpp/tiltfive-diagnostic-cpp/saved-frame.png";
+static int displayCapturedTiltFiveImage(const std::string &image_path) {
+	if ((image_path.size() > 4) && (image_path.compare(image_path.size() - 4, 4, ".t5s") == 0)) {
+		return playSession(image_path);
+	}
+
 	std::cout << "Image Path: " << image_path << std::endl;
 	cv::Mat img = cv::imread(image_path, IMREAD_COLOR);
 
@@ -26,13 +64,13 @@ static int displayCapturedTiltFiveImage() {
 
 	cv::namedWindow("Test Window", cv::WINDOW_AUTOSIZE);
 	cv::imshow("Test Window", img);
-	return cv::waitKey(0);
+	cv::waitKey(0);
+	return 0;
 }
 
 bool generateMarker(int markerId) {
-	cv::Mat markerImage;
-	cv::aruco::Dictionary dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
-	cv::aruco::generateImageMarker(dictionary, markerId, 200, markerImage, 1);
+	cv::Mat markerImage(200, 200, CV_8UC1);
+	blitArucoMarker(markerId, markerImage);
 
 	cv::imshow("Marker", markerImage);
 	int keyId = cv::waitKey(0);
@@ -53,7 +91,7 @@ bool generateMarker(int markerId) {
 static int showArucoMarkers() {
 	cv::namedWindow("Marker", cv::WINDOW_AUTOSIZE);
 
-	for (int i = 0; i < 250; i++) {
+	for (int i = 0; i < kArucoDictionarySize; i++) {
 		std::cout << "\rImage id: " << i;
 		bool quitPressed = generateMarker(i);
 
@@ -63,56 +101,122 @@ static int showArucoMarkers() {
 		}
 	}
 
-	std::cout << "\n\Cycled through all images. Quitting.\n";
+	std::cout << "\n\nCycled through all images. Quitting.\n";
 
 	return 0;
 }
 
-static int showArucoGrid() {
-	const int MARKER_SIDE = 220;
-	const int MARGIN = 20;
-	const int ROWS = 6;
-	const int COLS = 5;
-	const int CANVAS_WIDTH = MARKER_SIDE * COLS + 2 * MARGIN;
-	const int CANVAS_HEIGHT = MARKER_SIDE * ROWS + 2 * MARGIN;
-
-	cv::Mat canvas(cv::Size(CANVAS_WIDTH, CANVAS_HEIGHT), CV_64FC1, Scalar(255));
-	cv::Mat markerImage;
-
-	int markerList[] = { 19, 29, 31, 43, 62, 65, 67, 68, 82, 93, 96, 98, 100, 126, 127, 129, 130, 155, 205, 206, 220, 227, 228, 231, 247, 248,
-		0, 1, 2, 3, 4, 5, 6, 7, 8 };
-	int markerListLength = sizeof(markerList) / sizeof(markerList[0]);
-	int markerIterator = 0;
-
-	for (int rows = 0; rows < ROWS; rows++) {
-		for (int cols = 0; cols < COLS; cols++) {
-			if (markerIterator < markerListLength) {
-				cv::aruco::Dictionary dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
-				cv::aruco::generateImageMarker(dictionary, markerList[markerIterator], 200, markerImage, 1);
-				markerImage.copyTo(canvas(cv::Rect(
-						cols * MARKER_SIDE + MARGIN,
-						rows * MARKER_SIDE + MARGIN,
-						markerImage.cols,
-						markerImage.rows)));
-
-				markerIterator++;
-			}
+static void printUsage(const char *argv0) {
+	std::cout << "Usage: " << argv0 << " [options]\n"
+			  << "Renders ArUco DICT_6X6_250 marker sheets without opening any windows.\n\n"
+			  << "  --ids SPEC        Marker ids, e.g. 0-249 or 19,29,31 (default: calibration set)\n"
+			  << "  --rows N          Rows per page (default 6)\n"
+			  << "  --cols N          Columns per page (default 5)\n"
+			  << "  --marker-px N     Marker side in pixels (default 200)\n"
+			  << "  --cell-px N       Marker pitch in pixels (default 220)\n"
+			  << "  --margin-px N     Page margin in pixels (default 20)\n"
+			  << "  --page a4|letter  Fit the grid to a paper size at --dpi\n"
+			  << "  --dpi N           Output resolution (default 300)\n"
+			  << "  --format png|pdf  One PNG per page, or a single PDF (default png)\n"
+			  << "  --out PREFIX      Output file name without extension (default markerPage)\n\n"
+			  << "  --browse          Step through every marker interactively\n"
+			  << "  --view PATH       Display a captured image, or play a .t5s session\n";
+}
+
+int main(int argc, char **argv) {
+	// The calibration set printed for venues
+	std::string idSpec = "19,29,31,43,62,65,67,68,82,93,96,98,100,126,127,129,130,155,205,206,220,227,"
+						 "228,231,247,248,0-8";
+	std::string format = "png";
+	std::string outPrefix = "markerPage";
+	std::string paper;
+	MarkerSheetLayout layout;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool haveValue = (i + 1 < argc);
+
+		if (arg == "--browse") {
+			return showArucoMarkers();
+		} else if ((arg == "--view") && haveValue) {
+			return displayCapturedTiltFiveImage(argv[++i]);
+		} else if ((arg == "--ids") && haveValue) {
+			idSpec = argv[++i];
+		} else if ((arg == "--rows") && haveValue) {
+			layout.rows = std::atoi(argv[++i]);
+		} else if ((arg == "--cols") && haveValue) {
+			layout.cols = std::atoi(argv[++i]);
+		} else if ((arg == "--marker-px") && haveValue) {
+			layout.markerSidePx = std::atoi(argv[++i]);
+		} else if ((arg == "--cell-px") && haveValue) {
+			layout.cellSidePx = std::atoi(argv[++i]);
+		} else if ((arg == "--margin-px") && haveValue) {
+			layout.marginPx = std::atoi(argv[++i]);
+		} else if ((arg == "--page") && haveValue) {
+			paper = argv[++i];
+		} else if ((arg == "--dpi") && haveValue) {
+			layout.dpi = std::atof(argv[++i]);
+		} else if ((arg == "--format") && haveValue) {
+			format = argv[++i];
+		} else if ((arg == "--out") && haveValue) {
+			outPrefix = argv[++i];
+		} else {
+			printUsage(argv[0]);
+			return (arg == "--help") ? 0 : 1;
 		}
 	}
 
-	cv::imshow("Grid", canvas);
-	int keyId = cv::waitKey(0);
+	if (!paper.empty()) {
+		double widthIn = 0;
+		double heightIn = 0;
+		if (paper == "a4") {
+			widthIn = 210.0 / 25.4;
+			heightIn = 297.0 / 25.4;
+		} else if (paper == "letter") {
+			widthIn = 8.5;
+			heightIn = 11.0;
+		} else {
+			std::cerr << "Unknown page size '" << paper << "'" << std::endl;
+			return 1;
+		}
+		layout.fitToPage(cv::Size(static_cast<int>(widthIn * layout.dpi), static_cast<int>(heightIn * layout.dpi)),
+				arucoMarkerCells(layout.borderBits));
+	}
 
-	const std::string fileName = "markerPage.png";
-	cv::imwrite(fileName, canvas);
-}
+	std::string layoutError;
+	if (!layout.validate(layoutError)) {
+		std::cerr << "Invalid layout: " << layoutError << std::endl;
+		return 1;
+	}
+
+	std::vector<int> ids;
+	if (!parseMarkerIds(idSpec, kArucoDictionarySize, ids)) {
+		std::cerr << "Invalid marker ids '" << idSpec << "'" << std::endl;
+		return 1;
+	}
 
-int main() {
-	//displayCapturedTiltFiveImage();
+	std::unique_ptr<MarkerSheetSink> sink;
+	if (format == "png") {
+		sink.reset(new PngSheetSink(outPrefix));
+	} else if (format == "pdf") {
+		sink.reset(new PdfSheetSink(outPrefix + ".pdf", layout.dpi));
+	} else {
+		std::cerr << "Unknown format '" << format << "'" << std::endl;
+		return 1;
+	}
 
-	//showArucoMarkers();
+	MarkerSheetRenderer renderer(layout);
 
-	showArucoGrid();
+	auto start = std::chrono::steady_clock::now();
+	if (!generateMarkerSheets(renderer, ids, *sink)) {
+		std::cerr << "Failed to generate marker sheets" << std::endl;
+		return 1;
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	size_t pages = (ids.size() + layout.markersPerPage() - 1) / layout.markersPerPage();
+	std::cout << "Wrote " << ids.size() << " markers on " << pages << " page(s) in " << elapsed.count()
+			  << "s" << std::endl;
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -1,4 +1,8 @@
+#include "include/batch-detection.hpp"
+
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgcodecs.hpp>
@@ -7,8 +11,7 @@
 
 using namespace cv;
 
-int detectArucoMarker19() {
-	std::string image_path = "C:/dev/code/visual-studio/tiltfive-diagnostic-cpp/tiltfive-diagnostic-cpp/aruco-capture.png";
+int detectArucoMarker19(const std::string &image_path) {
 	std::cout << "Image Path: " << image_path << std::endl;
 	cv::Mat img = cv::imread(image_path, IMREAD_COLOR);
 
@@ -32,8 +35,84 @@ int detectArucoMarker19() {
 	return cv::waitKey(0);
 }
 
-int main() {
-	detectArucoMarker19();
+static int detectBatch(const std::string &input, const std::string &outPath, const BatchDetectionOptions &options) {
+	std::vector<std::string> paths;
+	if (!collectImagePaths(input, paths)) {
+		return 1;
+	}
+	if (paths.empty()) {
+		std::cerr << "No images found in " << input << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<DetectionSink> sink;
+	bool binary = (outPath.size() >= 4) && (outPath.compare(outPath.size() - 4, 4, ".bin") == 0);
+	if (binary) {
+		sink.reset(new BinaryDetectionSink(outPath));
+	} else {
+		sink.reset(new CsvDetectionSink(outPath));
+	}
+
+	std::cout << "Detecting markers in " << paths.size() << " images" << std::endl;
+
+	BatchDetectionStats stats;
+	if (!runBatchDetection(paths, options, *sink, stats)) {
+		std::cerr << "Batch detection failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "Processed " << stats.images << " images (" << stats.failed << " unreadable), found "
+			  << stats.markers << " markers in " << stats.seconds << "s : " << stats.imagesPerSecond()
+			  << " images/sec" << std::endl;
+	std::cout << "Results written to " << outPath << std::endl;
+
+	return (stats.failed == 0) ? 0 : 2;
+}
+
+static void printUsage(const char *argv0) {
+	std::cout << "Usage: " << argv0 << " [options] [IMAGE]\n"
+			  << "Shows the markers detected in IMAGE (default aruco-capture.png).\n\n"
+			  << "  --batch PATH        Detect without a window in a directory of images, a session\n"
+			  << "                      list file (.txt/.lst, one image per line) or a single image\n"
+			  << "  --out FILE          Batch results, CSV unless FILE ends in .bin (default detections.csv)\n"
+			  << "  --decode-threads N  Image decode threads (default 2)\n"
+			  << "  --detect-threads N  Detection threads (default: one per core)\n"
+			  << "  --prefetch N        Decoded images queued ahead of detection (default 16)\n";
+}
+
+int main(int argc, char **argv) {
+	std::string imagePath = "aruco-capture.png";
+	std::string batchInput;
+	std::string outPath = "detections.csv";
+	BatchDetectionOptions options;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool haveValue = (i + 1 < argc);
+
+		if ((arg == "--batch") && haveValue) {
+			batchInput = argv[++i];
+		} else if ((arg == "--out") && haveValue) {
+			outPath = argv[++i];
+		} else if ((arg == "--decode-threads") && haveValue) {
+			options.decodeThreads = std::atoi(argv[++i]);
+		} else if ((arg == "--detect-threads") && haveValue) {
+			options.detectThreads = std::atoi(argv[++i]);
+		} else if ((arg == "--prefetch") && haveValue) {
+			options.prefetch = static_cast<size_t>(std::atoi(argv[++i]));
+		} else if (!arg.empty() && (arg[0] != '-')) {
+			imagePath = arg;
+		} else {
+			printUsage(argv[0]);
+			return (arg == "--help") ? 0 : 1;
+		}
+	}
+
+	if (!batchInput.empty()) {
+		return detectBatch(batchInput, outPath, options);
+	}
+
+	detectArucoMarker19(imagePath);
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,184 @@
+/// \file
+/// \brief Streaming writer for multi-page PDFs of 8-bit grayscale images
+
+#include "include/pdf-writer.hpp"
+
+#include <cstdio>
+
+namespace {
+
+// PDF RunLengthDecode (PackBits): a length byte L of 0-127 is followed by L+1 literal bytes, 129-255
+// by one byte to repeat 257-L times, and 128 marks the end of data.
+void runLengthEncode(const uint8_t *pixels, int width, int height, size_t stride,
+		std::vector<uint8_t> &out) {
+	out.clear();
+
+	std::vector<uint8_t> literal;
+	literal.reserve(128);
+	auto flushLiteral = [&]() {
+		if (!literal.empty()) {
+			out.push_back(static_cast<uint8_t>(literal.size() - 1));
+			out.insert(out.end(), literal.begin(), literal.end());
+			literal.clear();
+		}
+	};
+
+	for (int y = 0; y < height; y++) {
+		const uint8_t *row = pixels + y * stride;
+		int x = 0;
+		while (x < width) {
+			int run = 1;
+			while ((x + run < width) && (run < 128) && (row[x + run] == row[x])) {
+				run++;
+			}
+
+			if (run >= 3) {
+				flushLiteral();
+				out.push_back(static_cast<uint8_t>(257 - run));
+				out.push_back(row[x]);
+			} else {
+				for (int i = 0; i < run; i++) {
+					literal.push_back(row[x + i]);
+					if (literal.size() == 128) {
+						flushLiteral();
+					}
+				}
+			}
+			x += run;
+		}
+	}
+	flushLiteral();
+	out.push_back(128);
+}
+
+} // namespace
+
+PdfWriter::~PdfWriter() {
+	if (mOut.is_open()) {
+		close();
+	}
+}
+
+auto PdfWriter::open(const std::string &path) -> bool {
+	mOut.open(path, std::ios::binary | std::ios::trunc);
+	if (!mOut) {
+		return false;
+	}
+
+	mOffset = 0;
+	mObjectOffsets.assign(kPagesObject + 1, 0);
+	mPageObjects.clear();
+
+	// The binary comment marks the file as binary for transfer tools
+	write("%PDF-1.4\n%\xE2\xE3\xCF\xD3\n");
+
+	beginObject(kCatalogObject);
+	write("<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+
+	return static_cast<bool>(mOut);
+}
+
+auto PdfWriter::addGrayPage(const uint8_t *pixels, int width, int height, size_t stride,
+		double dpi) -> bool {
+	if (!mOut.is_open() || (width <= 0) || (height <= 0) || (dpi <= 0.0)) {
+		return false;
+	}
+
+	char buffer[256];
+	double widthPt = width * 72.0 / dpi;
+	double heightPt = height * 72.0 / dpi;
+
+	int imageObject = allocateObject();
+	int contentObject = allocateObject();
+	int pageObject = allocateObject();
+
+	runLengthEncode(pixels, width, height, stride, mEncodeBuffer);
+	beginObject(imageObject);
+	std::snprintf(buffer, sizeof(buffer),
+			"<< /Type /XObject /Subtype /Image /Width %d /Height %d /ColorSpace /DeviceGray "
+			"/BitsPerComponent 8 /Filter /RunLengthDecode /Length %zu >>\nstream\n",
+			width, height, mEncodeBuffer.size());
+	write(buffer);
+	write(mEncodeBuffer.data(), mEncodeBuffer.size());
+	write("\nendstream\nendobj\n");
+
+	char content[128];
+	int contentLength = std::snprintf(content, sizeof(content), "q %.3f 0 0 %.3f 0 0 cm /Im0 Do Q\n",
+			widthPt, heightPt);
+	beginObject(contentObject);
+	std::snprintf(buffer, sizeof(buffer), "<< /Length %d >>\nstream\n", contentLength);
+	write(buffer);
+	write(content);
+	write("endstream\nendobj\n");
+
+	beginObject(pageObject);
+	std::snprintf(buffer, sizeof(buffer),
+			"<< /Type /Page /Parent 2 0 R /MediaBox [0 0 %.3f %.3f] "
+			"/Resources << /XObject << /Im0 %d 0 R >> >> /Contents %d 0 R >>\nendobj\n",
+			widthPt, heightPt, imageObject, contentObject);
+	write(buffer);
+
+	mPageObjects.push_back(pageObject);
+	return static_cast<bool>(mOut);
+}
+
+auto PdfWriter::close() -> bool {
+	if (!mOut.is_open()) {
+		return false;
+	}
+
+	char buffer[64];
+
+	beginObject(kPagesObject);
+	write("<< /Type /Pages /Kids [");
+	for (int page : mPageObjects) {
+		std::snprintf(buffer, sizeof(buffer), " %d 0 R", page);
+		write(buffer);
+	}
+	std::snprintf(buffer, sizeof(buffer), " ] /Count %zu >>\nendobj\n", mPageObjects.size());
+	write(buffer);
+
+	// Each cross-reference entry must be exactly 20 bytes
+	uint64_t xrefOffset = mOffset;
+	std::snprintf(buffer, sizeof(buffer), "xref\n0 %zu\n", mObjectOffsets.size());
+	write(buffer);
+	write("0000000000 65535 f \n");
+	for (size_t i = 1; i < mObjectOffsets.size(); i++) {
+		std::snprintf(buffer, sizeof(buffer), "%010llu 00000 n \n",
+				static_cast<unsigned long long>(mObjectOffsets[i]));
+		write(buffer);
+	}
+
+	std::snprintf(buffer, sizeof(buffer), "trailer\n<< /Size %zu /Root 1 0 R >>\n",
+			mObjectOffsets.size());
+	write(buffer);
+	std::snprintf(buffer, sizeof(buffer), "startxref\n%llu\n%%%%EOF\n",
+			static_cast<unsigned long long>(xrefOffset));
+	write(buffer);
+
+	bool ok = static_cast<bool>(mOut);
+	mOut.close();
+	return ok;
+}
+
+auto PdfWriter::beginObject(int objectNumber) -> void {
+	mObjectOffsets[objectNumber] = mOffset;
+
+	char buffer[32];
+	std::snprintf(buffer, sizeof(buffer), "%d 0 obj\n", objectNumber);
+	write(buffer);
+}
+
+auto PdfWriter::allocateObject() -> int {
+	mObjectOffsets.push_back(0);
+	return static_cast<int>(mObjectOffsets.size() - 1);
+}
+
+auto PdfWriter::write(const std::string &text) -> void {
+	write(reinterpret_cast<const uint8_t *>(text.data()), text.size());
+}
+
+auto PdfWriter::write(const uint8_t *data, size_t size) -> void {
+	mOut.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+	mOffset += size;
+}
@@ -0,0 +1,109 @@
+/// \file
+/// \brief Online jitter, drift and dropout statistics over a stream of glasses poses
+
+#include "include/pose-analyzer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+auto component(const T5_Vec3 &v, int axis) -> double {
+	return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+}
+
+/// Angle of the rotation taking a to b, in radians
+///
+/// From the relative quaternion with atan2 rather than acos of the dot product, which loses all
+/// precision for the tiny angles between consecutive poses.
+auto angleBetween(const T5_Quat &a, const T5_Quat &b) -> double {
+	// conj(a) * b
+	double w = double(a.w) * b.w + double(a.x) * b.x + double(a.y) * b.y + double(a.z) * b.z;
+	double x = double(a.w) * b.x - double(a.x) * b.w - double(a.y) * b.z + double(a.z) * b.y;
+	double y = double(a.w) * b.y + double(a.x) * b.z - double(a.y) * b.w - double(a.z) * b.x;
+	double z = double(a.w) * b.z - double(a.x) * b.y + double(a.y) * b.x - double(a.z) * b.w;
+	return 2.0 * std::atan2(std::sqrt(x * x + y * y + z * z), std::fabs(w));
+}
+
+} // namespace
+
+auto RunningStats::stddev() const -> double {
+	return std::sqrt(variance());
+}
+
+auto PoseAnalyzer::addPose(const T5_GlassesPose &pose) -> void {
+	if (mStreak > 0) {
+		mStreaks.add(static_cast<double>(mStreak));
+		mStreak = 0;
+	}
+	if (mHavePrevious && (pose.timestampNanos == mPrevious.timestampNanos)) {
+		mRepeats++;
+		return;
+	}
+	mPoses++;
+
+	if (!mHavePrevious) {
+		mFirstRotation = pose.rotToGLS_GBD;
+		mFirstTimestamp = pose.timestampNanos;
+	}
+	double seconds = static_cast<double>(static_cast<int64_t>(pose.timestampNanos - mFirstTimestamp)) * 1e-9;
+
+	for (int axis = 0; axis < 3; axis++) {
+		double value = component(pose.posGLS_GBD, axis);
+		mPosition[axis].add(value);
+		mPositionTrend[axis].add(seconds, value);
+	}
+	mAngleTrend.add(seconds, angleBetween(mFirstRotation, pose.rotToGLS_GBD));
+
+	// Timestamps going backwards mean the stream restarted; don't count the gap as one step
+	if (mHavePrevious && (pose.timestampNanos > mPrevious.timestampNanos)) {
+		mInterval.add(static_cast<double>(pose.timestampNanos - mPrevious.timestampNanos) * 1e-9);
+		for (int axis = 0; axis < 3; axis++) {
+			mPositionStep[axis].add(component(pose.posGLS_GBD, axis) - component(mPrevious.posGLS_GBD, axis));
+		}
+		mAngleStep.add(angleBetween(mPrevious.rotToGLS_GBD, pose.rotToGLS_GBD));
+	}
+
+	mPrevious = pose;
+	mHavePrevious = true;
+}
+
+auto PoseAnalyzer::addDropout() -> void {
+	mDropouts++;
+	mStreak++;
+}
+
+auto PoseAnalyzer::reset() -> void {
+	*this = PoseAnalyzer();
+}
+
+auto PoseAnalyzer::longestDropout() const -> uint64_t {
+	return std::max(static_cast<uint64_t>(mStreaks.max()), mStreak);
+}
+
+auto PoseAnalyzer::report(std::ostream &out) const -> void {
+	constexpr double kDegrees = 180.0 / kPi;
+	char line[256];
+
+	std::snprintf(line, sizeof(line),
+			"Poses: %llu distinct, %llu repeated; interval %.3f ms mean, %.3f ms jitter (%.3f to %.3f ms)\n",
+			static_cast<unsigned long long>(mPoses), static_cast<unsigned long long>(mRepeats),
+			mInterval.mean() * 1e3, mInterval.stddev() * 1e3, mInterval.min() * 1e3, mInterval.max() * 1e3);
+	out << line;
+	std::snprintf(line, sizeof(line),
+			"Position jitter: x %.3f, y %.3f, z %.3f mm; drift x %.3f, y %.3f, z %.3f mm/s\n",
+			mPositionStep[0].stddev() * 1e3, mPositionStep[1].stddev() * 1e3, mPositionStep[2].stddev() * 1e3,
+			positionDrift(0) * 1e3, positionDrift(1) * 1e3, positionDrift(2) * 1e3);
+	out << line;
+	std::snprintf(line, sizeof(line), "Angular jitter: %.4f deg mean step, %.4f deg spread; drift %.4f deg/s\n",
+			mAngleStep.mean() * kDegrees, mAngleStep.stddev() * kDegrees, angularDrift() * kDegrees);
+	out << line;
+	std::snprintf(line, sizeof(line), "Dropouts: %llu samples in %llu streaks, longest %llu samples, mean %.1f samples\n",
+			static_cast<unsigned long long>(mDropouts),
+			static_cast<unsigned long long>(mStreaks.count() + (mStreak > 0 ? 1 : 0)),
+			static_cast<unsigned long long>(longestDropout()), mStreaks.mean());
+	out << line;
+}
@@ -0,0 +1,327 @@
+/// \file
+/// \brief One-Euro and constant-velocity Kalman smoothing of glasses poses, with prediction
+
+#include "include/pose-filter.hpp"
+#include "include/ir-preprocess.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define POSE_FILTER_X86 1
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions marked for it; MSVC always can
+#if defined(POSE_FILTER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define POSE_FILTER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define POSE_FILTER_TARGET_AVX2
+#endif
+
+namespace {
+
+constexpr float kTwoPi = 6.28318530717958647692f;
+
+// Lanes per AVX2 vector; the bank pads every channel to a multiple of this
+constexpr size_t kVectorLanes = 8;
+
+// Variance of the rate before a second measurement has said anything about it, units^2/s^2
+constexpr float kInitialRateVariance = 1.0f;
+
+struct ChannelArrays {
+	const float *measured;
+	const float *previous;
+	float *value;
+	float *rate;
+	float *p00;
+	float *p01;
+	float *p11;
+};
+
+// Scalar kernels; these also finish the tail of each channel for the vector versions. Lanes whose
+// dt isn't positive have no new measurement and are left unchanged.
+
+void oneEuroScalar(const ChannelArrays &c, const float *dt, size_t begin, size_t end, const OneEuroParams &p) {
+	for (size_t i = begin; i < end; i++) {
+		if (!(dt[i] > 0.0f)) {
+			continue;
+		}
+		// Smoothing factor of an exponential filter with the given cutoff: r / (r + 1), r = 2 pi fc dt
+		float rd = kTwoPi * p.derivativeCutoff * dt[i];
+		float rate = c.rate[i] + (rd / (rd + 1.0f)) * ((c.measured[i] - c.previous[i]) / dt[i] - c.rate[i]);
+		float r = kTwoPi * (p.minCutoff + p.beta * std::fabs(rate)) * dt[i];
+		c.value[i] += (r / (r + 1.0f)) * (c.measured[i] - c.value[i]);
+		c.rate[i] = rate;
+	}
+}
+
+void kalmanScalar(const ChannelArrays &c, const float *dt, size_t begin, size_t end, const KalmanParams &p) {
+	for (size_t i = begin; i < end; i++) {
+		float t = dt[i];
+		if (!(t > 0.0f)) {
+			continue;
+		}
+		// Predict with constant velocity; white acceleration noise of density q adds
+		// q [t^3/3, t^2/2; t^2/2, t] to the covariance
+		float value = c.value[i] + c.rate[i] * t;
+		float p11 = c.p11[i] + p.processNoise * t;
+		float p01 = c.p01[i] + t * c.p11[i] + p.processNoise * t * t * 0.5f;
+		float p00 = c.p00[i] + t * (2.0f * c.p01[i] + t * c.p11[i]) + p.processNoise * t * t * t * (1.0f / 3.0f);
+
+		// Update with the measured value
+		float k0 = p00 / (p00 + p.measurementNoise);
+		float k1 = p01 / (p00 + p.measurementNoise);
+		float residual = c.measured[i] - value;
+		c.value[i] = value + k0 * residual;
+		c.rate[i] += k1 * residual;
+		c.p11[i] = p11 - k1 * p01;
+		c.p01[i] = (1.0f - k0) * p01;
+		c.p00[i] = (1.0f - k0) * p00;
+	}
+}
+
+#if defined(POSE_FILTER_X86)
+
+POSE_FILTER_TARGET_AVX2 void oneEuroAvx2(const ChannelArrays &c, const float *dt, size_t begin, size_t end,
+		const OneEuroParams &p) {
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const __m256 derivativeOmega = _mm256_set1_ps(kTwoPi * p.derivativeCutoff);
+	const __m256 minOmega = _mm256_set1_ps(kTwoPi * p.minCutoff);
+	const __m256 betaOmega = _mm256_set1_ps(kTwoPi * p.beta);
+
+	size_t i = begin;
+	for (; i + kVectorLanes <= end; i += kVectorLanes) {
+		__m256 t = _mm256_loadu_ps(dt + i);
+		__m256 active = _mm256_cmp_ps(t, zero, _CMP_GT_OQ);
+		// Inactive lanes divide by one instead of zero; their results are discarded below
+		__m256 safeT = _mm256_blendv_ps(one, t, active);
+		__m256 measured = _mm256_loadu_ps(c.measured + i);
+		__m256 value = _mm256_loadu_ps(c.value + i);
+		__m256 rate = _mm256_loadu_ps(c.rate + i);
+
+		__m256 rd = _mm256_mul_ps(derivativeOmega, safeT);
+		__m256 ad = _mm256_div_ps(rd, _mm256_add_ps(rd, one));
+		__m256 speed = _mm256_div_ps(_mm256_sub_ps(measured, _mm256_loadu_ps(c.previous + i)), safeT);
+		__m256 newRate = _mm256_add_ps(rate, _mm256_mul_ps(ad, _mm256_sub_ps(speed, rate)));
+
+		__m256 omega = _mm256_add_ps(minOmega, _mm256_mul_ps(betaOmega, _mm256_and_ps(newRate, absMask)));
+		__m256 r = _mm256_mul_ps(omega, safeT);
+		__m256 a = _mm256_div_ps(r, _mm256_add_ps(r, one));
+		__m256 newValue = _mm256_add_ps(value, _mm256_mul_ps(a, _mm256_sub_ps(measured, value)));
+
+		_mm256_storeu_ps(c.value + i, _mm256_blendv_ps(value, newValue, active));
+		_mm256_storeu_ps(c.rate + i, _mm256_blendv_ps(rate, newRate, active));
+	}
+	// GCC turns this into a tail jump without clearing the upper halves, which would make the
+	// scalar SSE code pay for AVX state transitions
+	_mm256_zeroupper();
+	oneEuroScalar(c, dt, i, end, p);
+}
+
+POSE_FILTER_TARGET_AVX2 void kalmanAvx2(const ChannelArrays &c, const float *dt, size_t begin, size_t end,
+		const KalmanParams &p) {
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 third = _mm256_set1_ps(1.0f / 3.0f);
+	const __m256 q = _mm256_set1_ps(p.processNoise);
+	const __m256 r = _mm256_set1_ps(p.measurementNoise);
+
+	size_t i = begin;
+	for (; i + kVectorLanes <= end; i += kVectorLanes) {
+		__m256 t = _mm256_loadu_ps(dt + i);
+		__m256 active = _mm256_cmp_ps(t, zero, _CMP_GT_OQ);
+		__m256 value = _mm256_loadu_ps(c.value + i);
+		__m256 rate = _mm256_loadu_ps(c.rate + i);
+		__m256 p00 = _mm256_loadu_ps(c.p00 + i);
+		__m256 p01 = _mm256_loadu_ps(c.p01 + i);
+		__m256 p11 = _mm256_loadu_ps(c.p11 + i);
+
+		__m256 qt = _mm256_mul_ps(q, t);
+		__m256 qt2 = _mm256_mul_ps(qt, t);
+		__m256 predicted = _mm256_add_ps(value, _mm256_mul_ps(rate, t));
+		__m256 np11 = _mm256_add_ps(p11, qt);
+		__m256 np01 = _mm256_add_ps(_mm256_add_ps(p01, _mm256_mul_ps(t, p11)), _mm256_mul_ps(qt2, half));
+		__m256 np00 = _mm256_add_ps(p00, _mm256_mul_ps(t, _mm256_add_ps(_mm256_mul_ps(two, p01), _mm256_mul_ps(t, p11))));
+		np00 = _mm256_add_ps(np00, _mm256_mul_ps(_mm256_mul_ps(qt2, t), third));
+
+		__m256 innovation = _mm256_div_ps(one, _mm256_add_ps(np00, r));
+		__m256 k0 = _mm256_mul_ps(np00, innovation);
+		__m256 k1 = _mm256_mul_ps(np01, innovation);
+		__m256 residual = _mm256_sub_ps(_mm256_loadu_ps(c.measured + i), predicted);
+		__m256 keep = _mm256_sub_ps(one, k0);
+
+		_mm256_storeu_ps(c.value + i, _mm256_blendv_ps(value, _mm256_add_ps(predicted, _mm256_mul_ps(k0, residual)), active));
+		_mm256_storeu_ps(c.rate + i, _mm256_blendv_ps(rate, _mm256_add_ps(rate, _mm256_mul_ps(k1, residual)), active));
+		_mm256_storeu_ps(c.p11 + i, _mm256_blendv_ps(p11, _mm256_sub_ps(np11, _mm256_mul_ps(k1, np01)), active));
+		_mm256_storeu_ps(c.p01 + i, _mm256_blendv_ps(p01, _mm256_mul_ps(keep, np01), active));
+		_mm256_storeu_ps(c.p00 + i, _mm256_blendv_ps(p00, _mm256_mul_ps(keep, np00), active));
+	}
+	// GCC turns this into a tail jump without clearing the upper halves, which would make the
+	// scalar SSE code pay for AVX state transitions
+	_mm256_zeroupper();
+	kalmanScalar(c, dt, i, end, p);
+}
+
+#endif
+
+auto channelOf(const T5_GlassesPose &pose, int channel) -> float {
+	switch (channel) {
+	case 0:
+		return pose.posGLS_GBD.x;
+	case 1:
+		return pose.posGLS_GBD.y;
+	case 2:
+		return pose.posGLS_GBD.z;
+	case 3:
+		return pose.rotToGLS_GBD.w;
+	case 4:
+		return pose.rotToGLS_GBD.x;
+	case 5:
+		return pose.rotToGLS_GBD.y;
+	default:
+		return pose.rotToGLS_GBD.z;
+	}
+}
+
+} // namespace
+
+PoseFilterBank::PoseFilterBank(size_t glassesCount, PoseFilterOptions options)
+	: mCount(glassesCount),
+	  mStride((glassesCount + kVectorLanes - 1) / kVectorLanes * kVectorLanes),
+	  mOptions(options),
+	  mTimestamp(glassesCount, 0),
+	  mGameboard(glassesCount, kT5_GameboardType_None),
+	  mDt(mStride, 0.0f),
+	  mMeasured(kChannels * mStride, 0.0f),
+	  mPrevious(kChannels * mStride, 0.0f),
+	  mValue(kChannels * mStride, 0.0f),
+	  mRate(kChannels * mStride, 0.0f),
+	  mP00(kChannels * mStride, 0.0f),
+	  mP01(kChannels * mStride, 0.0f),
+	  mP11(kChannels * mStride, 0.0f) {}
+
+auto PoseFilterBank::update(size_t glasses, const T5_GlassesPose &pose) -> void {
+	stage(glasses, pose);
+	run(glasses, glasses + 1);
+}
+
+auto PoseFilterBank::updateAll(const T5_GlassesPose *poses) -> void {
+	for (size_t g = 0; g < mCount; g++) {
+		stage(g, poses[g]);
+	}
+	run(0, mStride);
+}
+
+auto PoseFilterBank::stage(size_t glasses, const T5_GlassesPose &pose) -> void {
+	bool first = (mTimestamp[glasses] == 0);
+	if (!first && (pose.timestampNanos <= mTimestamp[glasses])) {
+		mDt[glasses] = 0.0f;
+		return;
+	}
+
+	// Measure the rotation on the filtered one's side of the quaternion double cover
+	float sign = 1.0f;
+	if (!first) {
+		float dot = 0.0f;
+		for (int channel = 3; channel < kChannels; channel++) {
+			dot += channelOf(pose, channel) * mValue[lane(channel, glasses)];
+		}
+		sign = (dot < 0.0f) ? -1.0f : 1.0f;
+	}
+
+	for (int channel = 0; channel < kChannels; channel++) {
+		size_t i = lane(channel, glasses);
+		mPrevious[i] = mMeasured[i];
+		mMeasured[i] = (channel < 3) ? channelOf(pose, channel) : sign * channelOf(pose, channel);
+		if (first) {
+			const KalmanParams &kalman = (channel < 3) ? mOptions.positionKalman : mOptions.rotationKalman;
+			mValue[i] = mMeasured[i];
+			mRate[i] = 0.0f;
+			mP00[i] = kalman.measurementNoise;
+			mP01[i] = 0.0f;
+			mP11[i] = kInitialRateVariance;
+		}
+	}
+
+	mDt[glasses] = first ? 0.0f : static_cast<float>(static_cast<double>(pose.timestampNanos - mTimestamp[glasses]) * 1e-9);
+	mTimestamp[glasses] = pose.timestampNanos;
+	mGameboard[glasses] = pose.gameboardType;
+}
+
+auto PoseFilterBank::run(size_t begin, size_t end) -> void {
+	bool vector = false;
+#if defined(POSE_FILTER_X86)
+	vector = (activeSimdLevel() == SimdLevel::kAvx2) && (end - begin >= kVectorLanes);
+#endif
+
+	for (int channel = 0; channel < kChannels; channel++) {
+		size_t base = lane(channel, 0);
+		ChannelArrays c = { mMeasured.data() + base, mPrevious.data() + base, mValue.data() + base,
+			mRate.data() + base, mP00.data() + base, mP01.data() + base, mP11.data() + base };
+		bool position = channel < 3;
+
+		if (mOptions.type == PoseFilterType::kOneEuro) {
+			const OneEuroParams &params = position ? mOptions.positionOneEuro : mOptions.rotationOneEuro;
+#if defined(POSE_FILTER_X86)
+			if (vector) {
+				oneEuroAvx2(c, mDt.data(), begin, end, params);
+				continue;
+			}
+#endif
+			oneEuroScalar(c, mDt.data(), begin, end, params);
+		} else {
+			const KalmanParams &params = position ? mOptions.positionKalman : mOptions.rotationKalman;
+#if defined(POSE_FILTER_X86)
+			if (vector) {
+				kalmanAvx2(c, mDt.data(), begin, end, params);
+				continue;
+			}
+#endif
+			kalmanScalar(c, mDt.data(), begin, end, params);
+		}
+	}
+	(void)vector;
+}
+
+auto PoseFilterBank::predict(size_t glasses, uint64_t timestampNanos) const -> T5_GlassesPose {
+	T5_GlassesPose pose{};
+	pose.rotToGLS_GBD.w = 1.0f;
+	pose.timestampNanos = timestampNanos;
+	if (mTimestamp[glasses] == 0) {
+		return pose;
+	}
+
+	double horizon = static_cast<double>(static_cast<int64_t>(timestampNanos - mTimestamp[glasses])) * 1e-9;
+	auto h = static_cast<float>(std::clamp(horizon, -mOptions.maxPredictionSeconds, mOptions.maxPredictionSeconds));
+	float channels[kChannels];
+	for (int channel = 0; channel < kChannels; channel++) {
+		size_t i = lane(channel, glasses);
+		channels[channel] = mValue[i] + mRate[i] * h;
+	}
+
+	pose.posGLS_GBD = { channels[0], channels[1], channels[2] };
+	float norm = std::sqrt(channels[3] * channels[3] + channels[4] * channels[4] + channels[5] * channels[5] +
+			channels[6] * channels[6]);
+	if (norm > 0.0f) {
+		pose.rotToGLS_GBD = { channels[3] / norm, channels[4] / norm, channels[5] / norm, channels[6] / norm };
+	}
+	pose.gameboardType = mGameboard[glasses];
+	return pose;
+}
+
+auto PoseFilterBank::predictAll(uint64_t timestampNanos, T5_GlassesPose *out) const -> void {
+	for (size_t g = 0; g < mCount; g++) {
+		out[g] = predict(g, timestampNanos);
+	}
+}
+
+auto PoseFilterBank::reset(size_t glasses) -> void {
+	mTimestamp[glasses] = 0;
+	mDt[glasses] = 0.0f;
+	mGameboard[glasses] = kT5_GameboardType_None;
+}
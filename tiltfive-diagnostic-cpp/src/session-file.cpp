@@ -0,0 +1,325 @@
+/// \file
+/// \brief Recorded camera sessions in a memory-mappable container
+
+#include "include/session-file.hpp"
+#include "include/trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char kSessionMagic[4] = { 'T', '5', 'S', 'S' };
+// Version 1 files have no copy of the frame info in their slots, so can't be recovered
+constexpr uint32_t kFirstVersionWithSlotInfo = 2;
+
+// Advice values shared with the platform-neutral interface
+constexpr int kAdviseSequential = 0;
+constexpr int kAdviseRandom = 1;
+constexpr int kAdviseWillNeed = 2;
+
+auto roundUpToPage(uint64_t bytes) -> uint64_t {
+	return (bytes + kSessionPageSize - 1) / kSessionPageSize * kSessionPageSize;
+}
+
+} // namespace
+
+SessionWriter::~SessionWriter() {
+	if (mOut.is_open()) {
+		finish();
+	}
+}
+
+auto SessionWriter::open(const std::string &path, int width, int height) -> bool {
+	if ((width <= 0) || (height <= 0)) {
+		std::cerr << "Invalid session frame size " << width << "x" << height << std::endl;
+		return false;
+	}
+
+	mPath = path;
+	mOut.open(path, std::ios::binary | std::ios::trunc);
+	if (!mOut) {
+		std::cerr << "Error creating " << path << std::endl;
+		return false;
+	}
+
+	mHeader = SessionHeader();
+	std::memcpy(mHeader.magic, kSessionMagic, sizeof(kSessionMagic));
+	mHeader.version = kSessionVersion;
+	mHeader.width = static_cast<uint32_t>(width);
+	mHeader.height = static_cast<uint32_t>(height);
+	mHeader.slotBytes = roundUpToPage(static_cast<uint64_t>(width) * height + sizeof(SessionFrameInfo));
+	mHeader.slotsOffset = kSessionPageSize;
+	mHeader.flags = SessionHeader::kSorted;
+	mIndex.clear();
+	mPadding.assign(kSessionPageSize, 0);
+
+	// A header without an index offset yet, so a crashed recording can be recovered; the final one
+	// is written once the frame count is known
+	mOut.write(reinterpret_cast<const char *>(&mHeader), sizeof(mHeader));
+	mOut.write(mPadding.data(), static_cast<std::streamsize>(kSessionPageSize - sizeof(mHeader)));
+	mOut.flush();
+	return static_cast<bool>(mOut);
+}
+
+auto SessionWriter::append(const uint8_t *pixels, size_t stride, const SessionFrameInfo &info) -> bool {
+	if (!mOut.is_open()) {
+		return false;
+	}
+
+	size_t rowBytes = mHeader.width;
+	for (uint32_t y = 0; y < mHeader.height; y++) {
+		mOut.write(reinterpret_cast<const char *>(pixels + y * stride), static_cast<std::streamsize>(rowBytes));
+	}
+	size_t padding = static_cast<size_t>(mHeader.slotBytes - rowBytes * mHeader.height - sizeof(info));
+	mOut.write(mPadding.data(), static_cast<std::streamsize>(padding));
+	mOut.write(reinterpret_cast<const char *>(&info), sizeof(info));
+
+	if (!mIndex.empty() && (info.timestampNanos < mIndex.back().timestampNanos)) {
+		mHeader.flags &= ~SessionHeader::kSorted;
+	}
+	mIndex.push_back(info);
+	return static_cast<bool>(mOut);
+}
+
+auto SessionWriter::append(const T5_CamImage &image, uint64_t timestampNanos) -> bool {
+	T5DIAG_TRACE_SPAN("capture", "record frame");
+	if ((image.imageWidth && (image.imageWidth != mHeader.width)) ||
+			(image.imageHeight && (image.imageHeight != mHeader.height))) {
+		std::cerr << "Frame size " << image.imageWidth << "x" << image.imageHeight << " doesn't match session "
+				  << mHeader.width << "x" << mHeader.height << std::endl;
+		return false;
+	}
+
+	SessionFrameInfo info{};
+	info.timestampNanos = timestampNanos;
+	info.posCAM_GBD = image.posCAM_GBD;
+	info.rotToCAM_GBD = image.rotToCAM_GBD;
+	info.illuminationMode = image.illuminationMode;
+	info.cameraIndex = image.cameraIndex;
+	return append(image.pixelData, image.imageStride ? image.imageStride : mHeader.width, info);
+}
+
+auto SessionWriter::finish() -> bool {
+	if (!mOut.is_open()) {
+		return false;
+	}
+
+	// The header goes first: if the index is then cut short, readers still know the frame count
+	mHeader.frameCount = mIndex.size();
+	mHeader.indexOffset = mHeader.slotsOffset + mHeader.frameCount * mHeader.slotBytes;
+	mOut.seekp(0);
+	mOut.write(reinterpret_cast<const char *>(&mHeader), sizeof(mHeader));
+	mOut.seekp(static_cast<std::streamoff>(mHeader.indexOffset));
+	mOut.write(reinterpret_cast<const char *>(mIndex.data()),
+			static_cast<std::streamsize>(mIndex.size() * sizeof(SessionFrameInfo)));
+	mOut.close();
+
+	if (mOut.fail()) {
+		std::cerr << "Error writing " << mPath << std::endl;
+		return false;
+	}
+	return true;
+}
+
+SessionReader::~SessionReader() {
+	close();
+}
+
+auto SessionReader::open(const std::string &path) -> bool {
+	close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		std::cerr << "Error opening " << path << std::endl;
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	HANDLE mapping = (size.QuadPart > 0) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	const void *base = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	mFile = file;
+	mMapping = mapping;
+	mSize = static_cast<size_t>(size.QuadPart);
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cerr << "Error opening " << path << std::endl;
+		return false;
+	}
+	struct stat status {};
+	fstat(fd, &status);
+	void *base = (status.st_size > 0) ? mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	if (base == MAP_FAILED) {
+		base = nullptr;
+	}
+	mFd = fd;
+	mSize = static_cast<size_t>(status.st_size);
+#endif
+
+	mBase = static_cast<const uint8_t *>(base);
+	if (!mBase) {
+		std::cerr << "Error mapping " << path << std::endl;
+		close();
+		return false;
+	}
+
+	// Validate everything frame() and info() rely on before handing out pointers. Counts come from
+	// the file, so they are checked by division, where a product could wrap around.
+	if (mSize >= sizeof(SessionHeader)) {
+		std::memcpy(&mHeader, mBase, sizeof(mHeader));
+	}
+	uint64_t pixelBytes = static_cast<uint64_t>(mHeader.width) * mHeader.height;
+	uint64_t infoBytes = (mHeader.version >= kFirstVersionWithSlotInfo) ? sizeof(SessionFrameInfo) : 0;
+	bool valid = (mSize >= sizeof(SessionHeader)) &&
+			(std::memcmp(mHeader.magic, kSessionMagic, sizeof(kSessionMagic)) == 0) &&
+			(mHeader.version >= 1) && (mHeader.version <= kSessionVersion) && (pixelBytes > 0) &&
+			(mHeader.slotBytes >= pixelBytes + infoBytes) && (mHeader.slotsOffset >= sizeof(SessionHeader)) &&
+			(mHeader.slotsOffset <= mSize);
+	if (!valid) {
+		std::cerr << path << " is not a session file" << std::endl;
+		close();
+		return false;
+	}
+
+	uint64_t slotCount = (mSize - mHeader.slotsOffset) / mHeader.slotBytes;
+	bool complete = (mHeader.indexOffset != 0) && (mHeader.frameCount <= slotCount) &&
+			(mHeader.indexOffset == mHeader.slotsOffset + mHeader.frameCount * mHeader.slotBytes) &&
+			(mHeader.indexOffset % alignof(SessionFrameInfo) == 0) &&
+			(mHeader.frameCount <= (mSize - mHeader.indexOffset) / sizeof(SessionFrameInfo));
+	if (complete) {
+		mIndex = reinterpret_cast<const SessionFrameInfo *>(mBase + mHeader.indexOffset);
+		return true;
+	}
+	if (mHeader.version < kFirstVersionWithSlotInfo) {
+		std::cerr << path << " is not a complete session file" << std::endl;
+		close();
+		return false;
+	}
+
+	// Unfinished: every whole slot is a frame, up to the count of a header written before its index
+	recover((mHeader.indexOffset != 0) ? std::min(mHeader.frameCount, slotCount) : slotCount);
+	std::cerr << path << " was not finished; recovered " << frameCount() << " frames" << std::endl;
+	return true;
+}
+
+auto SessionReader::recover(uint64_t maxFrames) -> void {
+	mRecoveredIndex.resize(static_cast<size_t>(maxFrames));
+	mHeader.flags = SessionHeader::kSorted;
+	for (size_t i = 0; i < mRecoveredIndex.size(); i++) {
+		const uint8_t *slotEnd = mBase + mHeader.slotsOffset + (i + 1) * mHeader.slotBytes;
+		std::memcpy(&mRecoveredIndex[i], slotEnd - sizeof(SessionFrameInfo), sizeof(SessionFrameInfo));
+		if ((i > 0) && (mRecoveredIndex[i].timestampNanos < mRecoveredIndex[i - 1].timestampNanos)) {
+			mHeader.flags &= ~SessionHeader::kSorted;
+		}
+	}
+	mHeader.frameCount = mRecoveredIndex.size();
+	mIndex = mRecoveredIndex.data();
+	mRecovered = true;
+}
+
+auto SessionReader::close() -> void {
+#if defined(_WIN32)
+	if (mBase) {
+		UnmapViewOfFile(mBase);
+	}
+	if (mMapping) {
+		CloseHandle(mMapping);
+	}
+	if (mFile) {
+		CloseHandle(mFile);
+	}
+	mFile = nullptr;
+	mMapping = nullptr;
+#else
+	if (mBase) {
+		munmap(const_cast<uint8_t *>(mBase), mSize);
+	}
+	if (mFd >= 0) {
+		::close(mFd);
+	}
+	mFd = -1;
+#endif
+	mBase = nullptr;
+	mSize = 0;
+	mHeader = SessionHeader();
+	mIndex = nullptr;
+	mRecoveredIndex.clear();
+	mRecovered = false;
+}
+
+auto SessionReader::frame(size_t index) const -> cv::Mat {
+	if (index >= frameCount()) {
+		return cv::Mat();
+	}
+	const uint8_t *pixels = mBase + mHeader.slotsOffset + index * mHeader.slotBytes;
+	return cv::Mat(height(), width(), CV_8UC1, const_cast<uint8_t *>(pixels), static_cast<size_t>(mHeader.width));
+}
+
+auto SessionReader::seek(uint64_t timestampNanos) const -> size_t {
+	const SessionFrameInfo *end = mIndex + frameCount();
+	const SessionFrameInfo *found;
+	if (mHeader.flags & SessionHeader::kSorted) {
+		found = std::lower_bound(mIndex, end, timestampNanos,
+				[](const SessionFrameInfo &info, uint64_t value) { return info.timestampNanos < value; });
+	} else {
+		found = std::find_if(mIndex, end,
+				[&](const SessionFrameInfo &info) { return info.timestampNanos >= timestampNanos; });
+	}
+	return static_cast<size_t>(found - mIndex);
+}
+
+auto SessionReader::adviseSequential() -> void {
+	advise(0, mSize, kAdviseSequential);
+}
+
+auto SessionReader::adviseRandom() -> void {
+	advise(0, mSize, kAdviseRandom);
+}
+
+auto SessionReader::prefetch(size_t first, size_t count) -> void {
+	if (first >= frameCount()) {
+		return;
+	}
+	count = std::min(count, frameCount() - first);
+	advise(static_cast<size_t>(mHeader.slotsOffset + first * mHeader.slotBytes),
+			static_cast<size_t>(count * mHeader.slotBytes), kAdviseWillNeed);
+}
+
+auto SessionReader::advise(size_t offset, size_t length, int advice) -> void {
+	if (!mBase || (length == 0)) {
+		return;
+	}
+#if defined(_WIN32)
+	// PrefetchVirtualMemory needs Windows 8, and there is no equivalent of the other hints
+	if (advice == kAdviseWillNeed) {
+		WIN32_MEMORY_RANGE_ENTRY range{ const_cast<uint8_t *>(mBase) + offset, length };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+#else
+	static const int kAdvice[] = { MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED };
+	// Slots are aligned to 4 KiB, but some ARM systems use larger pages and madvise needs the start
+	// aligned to the real page size
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t aligned = offset / pageSize * pageSize;
+	madvise(const_cast<uint8_t *>(mBase) + aligned, length + (offset - aligned), kAdvice[advice]);
+#endif
+}
@@ -0,0 +1,819 @@
+/// \file
+/// \brief Stand-in for libTiltFiveNative that simulates one pair of glasses without a service
+///
+/// Implements the whole C interface from TiltFiveNative.h, so the tools can be built and profiled
+/// on machines with no glasses or service attached. Built as libTiltFiveNative.so with the same
+/// soname as the real library, so either can be swapped in at run time with LD_LIBRARY_PATH.
+///
+/// The glasses circle slowly above the gameboard. The camera produces 768x600 frames at 60 Hz,
+/// alternating between lit frames showing four ArUco markers and dark frames, and one wand
+/// reports at 100 Hz once its stream is enabled.
+
+#include "include/TiltFiveNative.h"
+#include "include/aruco-atlas.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct T5_ContextImpl {
+	std::string applicationId;
+};
+
+struct T5_GlassesImpl {
+	std::mutex mtx;
+	std::string displayName;
+	T5_ConnectionState state = kT5_ConnectionState_NotExclusivelyConnected;
+	bool graphicsReady = false;
+
+	bool cameraEnabled = false;
+	std::deque<T5_CamImage> emptyBuffers;
+	std::chrono::steady_clock::time_point nextFrame;
+	uint64_t frameCount = 0;
+	uint32_t noise = 0x9E3779B9u;
+
+	bool wandStreamEnabled = false;
+	bool wandConnectSent = false;
+	std::chrono::steady_clock::time_point nextWandReport;
+};
+
+namespace {
+
+constexpr const char *kGlassesId = "StandIn-00000001";
+constexpr const char *kFriendlyName = "Stand-in Glasses";
+constexpr const char *kServiceVersion = "1.4.1-standin";
+constexpr double kIpd = 0.059;
+
+constexpr T5_WandHandle kWandHandle = 1;
+
+constexpr int kCameraWidth = T5_MIN_CAM_IMAGE_BUFFER_WIDTH;
+constexpr int kCameraHeight = T5_MIN_CAM_IMAGE_BUFFER_HEIGHT;
+constexpr auto kCameraPeriod = std::chrono::microseconds(16667);
+constexpr auto kWandPeriod = std::chrono::milliseconds(10);
+
+constexpr uint16_t kFramebufferWidth = 1216;
+constexpr uint16_t kFramebufferHeight = 768;
+constexpr double kFieldOfViewDegrees = 48.0;
+
+constexpr int kMarkerIds[] = { 0, 1, 2, 3 };
+
+const auto kEpoch = std::chrono::steady_clock::now();
+
+auto secondsSinceStart() -> double {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - kEpoch).count();
+}
+
+auto nanosSinceStart() -> uint64_t {
+	return static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - kEpoch).count());
+}
+
+auto copyString(const std::string &value, char *buffer, size_t *bufferSize) -> T5_Result {
+	if (!buffer || !bufferSize) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	size_t needed = value.size() + 1;
+	if (*bufferSize < needed) {
+		*bufferSize = needed;
+		return T5_ERROR_OVERFLOW;
+	}
+	std::memcpy(buffer, value.c_str(), needed);
+	*bufferSize = needed;
+	return T5_SUCCESS;
+}
+
+auto axisAngle(float x, float y, float z, double angle) -> T5_Quat {
+	auto s = static_cast<float>(std::sin(angle / 2));
+	return { static_cast<float>(std::cos(angle / 2)), x * s, y * s, z * s };
+}
+
+auto multiply(const T5_Quat &a, const T5_Quat &b) -> T5_Quat {
+	return {
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+	};
+}
+
+/// Glasses position and orientation at a time: a slow circle above the board, looking down at it
+auto simulatedPose(double t, T5_Vec3 &pos, T5_Quat &rot) -> void {
+	double yaw = 0.4 * t;
+	pos.x = static_cast<float>(0.25 * std::cos(yaw));
+	pos.y = static_cast<float>(0.25 * std::sin(yaw));
+	pos.z = static_cast<float>(0.45 + 0.03 * std::sin(1.3 * t));
+	rot = multiply(axisAngle(1, 0, 0, -0.8 + 0.05 * std::sin(0.9 * t)), axisAngle(0, 0, 1, -yaw));
+}
+
+auto nextNoise(uint32_t &state) -> uint32_t {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+/// Fill a buffer with sensor noise around a level and, for lit frames, a 2x2 grid of markers
+auto renderFrame(T5_GlassesImpl &glasses, T5_CamImage &image, bool lit, double t) -> void {
+	const int stride = kCameraWidth;
+	const int base = lit ? 24 : 8;
+	for (int y = 0; y < kCameraHeight; y++) {
+		uint8_t *row = image.pixelData + y * stride;
+		for (int x = 0; x < kCameraWidth; x += 4) {
+			uint32_t bits = nextNoise(glasses.noise);
+			for (int i = 0; i < 4; i++) {
+				row[x + i] = static_cast<uint8_t>(base + ((bits >> (i * 8)) & 15));
+			}
+		}
+	}
+	if (!lit) {
+		return;
+	}
+
+	// Marker size and grid position drift with the pose so trackers have something to follow
+	const int cells = arucoMarkerCells(1);
+	const int size = static_cast<int>(96 + 24 * std::sin(0.7 * t)) / cells * cells;
+	const int quiet = size / cells;
+	const int spacing = size + 3 * quiet;
+	const int left = static_cast<int>(kCameraWidth / 2 + 80 * std::cos(0.4 * t)) - spacing;
+	const int top = static_cast<int>(kCameraHeight / 2 + 60 * std::sin(0.4 * t)) - spacing;
+
+	for (int m = 0; m < 4; m++) {
+		int x0 = left + (m % 2) * spacing + quiet;
+		int y0 = top + (m / 2) * spacing + quiet;
+		for (int y = -quiet; y < size + quiet; y++) {
+			int py = y0 + y;
+			if ((py < 0) || (py >= kCameraHeight)) {
+				continue;
+			}
+			uint8_t *row = image.pixelData + py * stride;
+			for (int x = -quiet; x < size + quiet; x++) {
+				int px = x0 + x;
+				if ((px < 0) || (px >= kCameraWidth)) {
+					continue;
+				}
+				bool white = (x < 0) || (y < 0) || (x >= size) || (y >= size) ||
+						arucoMarkerCell(kMarkerIds[m], y * cells / size, x * cells / size);
+				row[px] = static_cast<uint8_t>(white ? 200 + (row[px] & 15) : row[px]);
+			}
+		}
+	}
+}
+
+} // namespace
+
+extern "C" {
+
+const char *t5GetResultMessage(T5_Result result) {
+	switch (result) {
+		case T5_SUCCESS:
+			return "Success";
+		case T5_TIMEOUT:
+			return "Timeout";
+		case T5_ERROR_NO_CONTEXT:
+			return "Invalid context";
+		case T5_ERROR_NO_LIBRARY:
+			return "Library unavailable";
+		case T5_ERROR_INTERNAL:
+			return "Internal error";
+		case T5_ERROR_NO_SERVICE:
+			return "Service unavailable";
+		case T5_ERROR_IO_FAILURE:
+			return "I/O failure";
+		case T5_ERROR_REQUEST_ID_UNKNOWN:
+			return "Request ID unknown";
+		case T5_ERROR_INVALID_ARGS:
+			return "Invalid arguments";
+		case T5_ERROR_DEVICE_LOST:
+			return "Device lost";
+		case T5_ERROR_TARGET_NOT_FOUND:
+			return "Target not found";
+		case T5_ERROR_INVALID_STATE:
+			return "Invalid state";
+		case T5_ERROR_SETTING_UNKNOWN:
+			return "Setting unknown";
+		case T5_ERROR_SETTING_WRONG_TYPE:
+			return "Setting has the wrong type";
+		case T5_ERROR_MISC_REMOTE:
+			return "Service error";
+		case T5_ERROR_OVERFLOW:
+			return "Buffer overflow";
+		case T5_ERROR_GRAPHICS_API_UNAVAILABLE:
+			return "Graphics API unavailable";
+		case T5_ERROR_UNSUPPORTED:
+			return "Unsupported";
+		case T5_ERROR_DECODE_ERROR:
+			return "Decode error";
+		case T5_ERROR_INVALID_GFX_CONTEXT:
+			return "Invalid graphics context";
+		case T5_ERROR_GFX_CONTEXT_INIT_FAIL:
+			return "Graphics context initialization failed";
+		case T5_ERROR_TRY_AGAIN:
+			return "Try again";
+		case T5_ERROR_UNAVAILABLE:
+			return "Unavailable";
+		case T5_ERROR_ALREADY_CONNECTED:
+			return "Already connected";
+		case T5_ERROR_NOT_CONNECTED:
+			return "Not connected";
+		case T5_ERROR_STRING_OVERFLOW:
+			return "String overflow";
+		case T5_ERROR_SERVICE_INCOMPATIBLE:
+			return "Service incompatible";
+		case T5_PERMISSION_DENIED:
+			return "Permission denied";
+		case T5_ERROR_INVALID_BUFFER_SIZE:
+			return "Invalid buffer size";
+		case T5_ERROR_INVALID_GEOMETRY:
+			return "Invalid geometry";
+		default:
+			return "Unknown error";
+	}
+}
+
+T5_Result t5CreateContext(T5_Context *context, const T5_ClientInfo *clientInfo, void *platformContext) {
+	(void)platformContext;
+	if (!context || !clientInfo || !clientInfo->applicationId) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	*context = new T5_ContextImpl{ clientInfo->applicationId };
+	return T5_SUCCESS;
+}
+
+void t5DestroyContext(T5_Context *context) {
+	if (context) {
+		delete *context;
+		*context = nullptr;
+	}
+}
+
+T5_Result t5ListGlasses(T5_Context context, char *buffer, size_t *bufferSize) {
+	if (!context) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!buffer || !bufferSize) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	// Each id is null terminated, and an empty string ends the list
+	size_t idLength = std::strlen(kGlassesId) + 1;
+	if (*bufferSize < idLength + 1) {
+		*bufferSize = idLength + 1;
+		return T5_ERROR_OVERFLOW;
+	}
+	std::memcpy(buffer, kGlassesId, idLength);
+	buffer[idLength] = '\0';
+	*bufferSize = idLength + 1;
+	return T5_SUCCESS;
+}
+
+T5_Result t5CreateGlasses(T5_Context context, const char *id, T5_Glasses *glasses) {
+	if (!context) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!id || !glasses) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	if (std::strcmp(id, kGlassesId) != 0) {
+		return T5_ERROR_TARGET_NOT_FOUND;
+	}
+	*glasses = new T5_GlassesImpl();
+	return T5_SUCCESS;
+}
+
+void t5DestroyGlasses(T5_Glasses *glasses) {
+	if (glasses) {
+		delete *glasses;
+		*glasses = nullptr;
+	}
+}
+
+T5_Result t5GetSystemIntegerParam(T5_Context context, T5_ParamSys param, int64_t *value) {
+	if (!context) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!value) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	switch (param) {
+		case kT5_ParamSys_Integer_CPL_AttRequired:
+			*value = 0;
+			return T5_SUCCESS;
+		case kT5_ParamSys_UTF8_Service_Version:
+			return T5_ERROR_SETTING_WRONG_TYPE;
+		default:
+			return T5_ERROR_INVALID_ARGS;
+	}
+}
+
+T5_Result t5GetSystemFloatParam(T5_Context context, T5_ParamSys param, double *value) {
+	if (!context) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!value) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	switch (param) {
+		case kT5_ParamSys_Integer_CPL_AttRequired:
+		case kT5_ParamSys_UTF8_Service_Version:
+			return T5_ERROR_SETTING_WRONG_TYPE;
+		default:
+			return T5_ERROR_INVALID_ARGS;
+	}
+}
+
+T5_Result t5GetSystemUtf8Param(T5_Context context, T5_ParamSys param, char *buffer, size_t *bufferSize) {
+	if (!context) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	switch (param) {
+		case kT5_ParamSys_UTF8_Service_Version:
+			return copyString(kServiceVersion, buffer, bufferSize);
+		case kT5_ParamSys_Integer_CPL_AttRequired:
+			return T5_ERROR_SETTING_WRONG_TYPE;
+		default:
+			return T5_ERROR_INVALID_ARGS;
+	}
+}
+
+T5_Result t5GetChangedSystemParams(T5_Context context, T5_ParamSys *buffer, uint16_t *count) {
+	if (!context) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!buffer || !count) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	// Simulated parameters never change
+	*count = 0;
+	return T5_SUCCESS;
+}
+
+T5_Result t5GetGameboardSize(T5_Context context, T5_GameboardType gameboardType, T5_GameboardSize *gameboardSize) {
+	if (!context) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!gameboardSize) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	// Viewable extents in metres, approximately those reported by the service
+	switch (gameboardType) {
+		case kT5_GameboardType_None:
+			*gameboardSize = { 0, 0, 0, 0, 0 };
+			return T5_SUCCESS;
+		case kT5_GameboardType_LE:
+			*gameboardSize = { 0.35f, 0.35f, 0.35f, 0.35f, 0.0f };
+			return T5_SUCCESS;
+		case kT5_GameboardType_XE:
+			*gameboardSize = { 0.7f, 0.7f, 0.35f, 0.35f, 0.0f };
+			return T5_SUCCESS;
+		case kT5_GameboardType_XE_Raised:
+			*gameboardSize = { 0.7f, 0.7f, 0.35f, 0.35f, 0.5f };
+			return T5_SUCCESS;
+		default:
+			return T5_ERROR_INVALID_ARGS;
+	}
+}
+
+T5_Result t5ReserveGlasses(T5_Glasses glasses, const char *displayName) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!displayName) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (glasses->state == kT5_ConnectionState_ExclusiveConnection) {
+		return T5_ERROR_ALREADY_CONNECTED;
+	}
+	glasses->displayName = displayName;
+	glasses->state = kT5_ConnectionState_ExclusiveReservation;
+	return T5_SUCCESS;
+}
+
+T5_Result t5SetGlassesDisplayName(T5_Glasses glasses, const char *displayName) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!displayName) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (glasses->state == kT5_ConnectionState_NotExclusivelyConnected) {
+		return T5_ERROR_NOT_CONNECTED;
+	}
+	glasses->displayName = displayName;
+	return T5_SUCCESS;
+}
+
+T5_Result t5EnsureGlassesReady(T5_Glasses glasses) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (glasses->state == kT5_ConnectionState_NotExclusivelyConnected) {
+		return T5_ERROR_NOT_CONNECTED;
+	}
+	glasses->state = kT5_ConnectionState_ExclusiveConnection;
+	return T5_SUCCESS;
+}
+
+T5_Result t5ReleaseGlasses(T5_Glasses glasses) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	glasses->state = kT5_ConnectionState_NotExclusivelyConnected;
+	glasses->graphicsReady = false;
+	glasses->cameraEnabled = false;
+	glasses->emptyBuffers.clear();
+	return T5_SUCCESS;
+}
+
+T5_Result t5GetGlassesConnectionState(T5_Glasses glasses, T5_ConnectionState *connectionState) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!connectionState) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	*connectionState = glasses->state;
+	return T5_SUCCESS;
+}
+
+T5_Result t5GetGlassesIdentifier(T5_Glasses glasses, char *buffer, size_t *bufferSize) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	return copyString(kGlassesId, buffer, bufferSize);
+}
+
+T5_Result t5GetGlassesPose(T5_Glasses glasses, T5_GlassesPoseUsage usage, T5_GlassesPose *pose) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!pose || ((usage != kT5_GlassesPoseUsage_GlassesPresentation) &&
+						 (usage != kT5_GlassesPoseUsage_SpectatorPresentation))) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (glasses->state != kT5_ConnectionState_ExclusiveConnection) {
+		return T5_ERROR_NOT_CONNECTED;
+	}
+	pose->timestampNanos = nanosSinceStart();
+	simulatedPose(secondsSinceStart(), pose->posGLS_GBD, pose->rotToGLS_GBD);
+	pose->gameboardType = kT5_GameboardType_LE;
+	return T5_SUCCESS;
+}
+
+T5_Result t5InitGlassesGraphicsContext(T5_Glasses glasses, T5_GraphicsApi graphicsApi, void *graphicsContext) {
+	(void)graphicsContext;
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (glasses->state != kT5_ConnectionState_ExclusiveConnection) {
+		return T5_ERROR_NOT_CONNECTED;
+	}
+	if (glasses->graphicsReady) {
+		return T5_ERROR_INVALID_STATE;
+	}
+	if (graphicsApi != kT5_GraphicsApi_None) {
+		return T5_ERROR_GRAPHICS_API_UNAVAILABLE;
+	}
+	glasses->graphicsReady = true;
+	return T5_SUCCESS;
+}
+
+T5_Result t5ConfigureCameraStreamForGlasses(T5_Glasses glasses, T5_CameraStreamConfig config) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (config.cameraIndex != 0) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (config.enabled && !glasses->cameraEnabled) {
+		glasses->nextFrame = std::chrono::steady_clock::now() + kCameraPeriod;
+	}
+	glasses->cameraEnabled = config.enabled;
+	return T5_SUCCESS;
+}
+
+T5_Result t5GetFilledCamImageBuffer(T5_Glasses glasses, T5_CamImage *image) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!image) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (glasses->state != kT5_ConnectionState_ExclusiveConnection) {
+		return T5_ERROR_NOT_CONNECTED;
+	}
+	auto now = std::chrono::steady_clock::now();
+	if (!glasses->cameraEnabled || glasses->emptyBuffers.empty() || (now < glasses->nextFrame)) {
+		return T5_ERROR_TRY_AGAIN;
+	}
+
+	// Frames the client was too slow to collect are skipped, like the camera would
+	glasses->nextFrame += kCameraPeriod;
+	if (glasses->nextFrame < now) {
+		glasses->nextFrame = now + kCameraPeriod;
+	}
+
+	T5_CamImage filled = glasses->emptyBuffers.front();
+	glasses->emptyBuffers.pop_front();
+
+	double t = secondsSinceStart();
+	bool lit = (glasses->frameCount++ % 2) == 0;
+	filled.imageWidth = kCameraWidth;
+	filled.imageHeight = kCameraHeight;
+	filled.imageStride = kCameraWidth;
+	filled.illuminationMode = lit ? 1 : 2;
+	simulatedPose(t, filled.posCAM_GBD, filled.rotToCAM_GBD);
+	renderFrame(*glasses, filled, lit, t);
+
+	*image = filled;
+	return T5_SUCCESS;
+}
+
+T5_Result t5SubmitEmptyCamImageBuffer(T5_Glasses glasses, T5_CamImage *image) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!image || !image->pixelData) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	if (image->bufferSize < static_cast<uint32_t>(kCameraWidth * kCameraHeight)) {
+		return T5_ERROR_INVALID_BUFFER_SIZE;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (glasses->state != kT5_ConnectionState_ExclusiveConnection) {
+		return T5_ERROR_NOT_CONNECTED;
+	}
+	glasses->emptyBuffers.push_back(*image);
+	return T5_SUCCESS;
+}
+
+T5_Result t5CancelCamImageBuffer(T5_Glasses glasses, uint8_t *buffer) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (glasses->state != kT5_ConnectionState_ExclusiveConnection) {
+		return T5_ERROR_NOT_CONNECTED;
+	}
+	auto &buffers = glasses->emptyBuffers;
+	buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+						  [&](const T5_CamImage &image) { return image.pixelData == buffer; }),
+			buffers.end());
+	return T5_SUCCESS;
+}
+
+T5_Result t5ValidateFrameInfo(T5_Glasses glasses, const T5_FrameInfo *info, char *detail, size_t *detailSize) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!info || !detail || !detailSize) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	std::string problems;
+	if (!info->leftTexHandle || !info->rightTexHandle) {
+		problems += "Missing texture handle\n";
+	}
+	if ((info->texWidth_PIX == 0) || (info->texHeight_PIX == 0)) {
+		problems += "Zero texture size\n";
+	}
+	if ((info->vci.width_VCI <= 0) || (info->vci.height_VCI <= 0)) {
+		problems += "Empty virtual camera image\n";
+	}
+	T5_Result result = copyString(problems, detail, detailSize);
+	if (result != T5_SUCCESS) {
+		return result;
+	}
+	return problems.empty() ? T5_SUCCESS : T5_ERROR_INVALID_ARGS;
+}
+
+T5_Result t5SendFrameToGlasses(T5_Glasses glasses, const T5_FrameInfo *info) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!info) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (glasses->state != kT5_ConnectionState_ExclusiveConnection) {
+		return T5_ERROR_NOT_CONNECTED;
+	}
+	if (!glasses->graphicsReady) {
+		return T5_ERROR_GFX_CONTEXT_INIT_FAIL;
+	}
+	return T5_SUCCESS;
+}
+
+T5_Result t5GetGlassesIntegerParam(T5_Glasses glasses, T5_WandHandle wand, T5_ParamGlasses param, int64_t *value) {
+	(void)wand;
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!value) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	switch (param) {
+		case kT5_ParamGlasses_Float_IPD:
+		case kT5_ParamGlasses_UTF8_FriendlyName:
+			return T5_ERROR_SETTING_WRONG_TYPE;
+		default:
+			return T5_ERROR_INVALID_ARGS;
+	}
+}
+
+T5_Result t5GetGlassesFloatParam(T5_Glasses glasses, T5_WandHandle wand, T5_ParamGlasses param, double *value) {
+	(void)wand;
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!value) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	switch (param) {
+		case kT5_ParamGlasses_Float_IPD:
+			*value = kIpd;
+			return T5_SUCCESS;
+		case kT5_ParamGlasses_UTF8_FriendlyName:
+			return T5_ERROR_SETTING_WRONG_TYPE;
+		default:
+			return T5_ERROR_INVALID_ARGS;
+	}
+}
+
+T5_Result t5GetGlassesUtf8Param(T5_Glasses glasses, T5_WandHandle wand, T5_ParamGlasses param, char *buffer,
+		size_t *bufferSize) {
+	(void)wand;
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	switch (param) {
+		case kT5_ParamGlasses_UTF8_FriendlyName:
+			return copyString(kFriendlyName, buffer, bufferSize);
+		case kT5_ParamGlasses_Float_IPD:
+			return T5_ERROR_SETTING_WRONG_TYPE;
+		default:
+			return T5_ERROR_INVALID_ARGS;
+	}
+}
+
+T5_Result t5GetChangedGlassesParams(T5_Glasses glasses, T5_ParamGlasses *buffer, uint16_t *count) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!buffer || !count) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	*count = 0;
+	return T5_SUCCESS;
+}
+
+T5_Result t5GetProjection(T5_Glasses glasses, T5_CartesianCoordinateHandedness handedness, T5_DepthRange depthRange,
+		T5_MatrixOrder matrixOrder, double nearPlane, double farPlane, double worldScale,
+		T5_ProjectionInfo *projectionInfo) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!projectionInfo || (nearPlane <= 0) || (farPlane <= nearPlane) || (worldScale <= 0)) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+
+	// Standard perspective projection built row-major, then transposed if asked
+	const double aspect = static_cast<double>(kFramebufferWidth) / kFramebufferHeight;
+	const double f = 1.0 / std::tan(kFieldOfViewDegrees * 3.14159265358979323846 / 360.0);
+	const double sign = (handedness == kT5_CartesianCoordinateHandedness_Left) ? 1.0 : -1.0;
+	double m[16] = {};
+	m[0] = f / aspect;
+	m[5] = f;
+	if (depthRange == kT5_DepthRange_ZeroToOne) {
+		m[10] = sign * farPlane / (farPlane - nearPlane);
+		m[11] = -nearPlane * farPlane / (farPlane - nearPlane);
+	} else {
+		m[10] = sign * (farPlane + nearPlane) / (farPlane - nearPlane);
+		m[11] = -2.0 * nearPlane * farPlane / (farPlane - nearPlane);
+	}
+	m[14] = sign;
+
+	for (int row = 0; row < 4; row++) {
+		for (int col = 0; col < 4; col++) {
+			int index = (matrixOrder == kT5_MatrixOrder_ColumnMajor) ? (col * 4 + row) : (row * 4 + col);
+			projectionInfo->matrix[index] = m[row * 4 + col];
+		}
+	}
+	projectionInfo->fieldOfView = kFieldOfViewDegrees;
+	projectionInfo->aspectRatio = aspect;
+	projectionInfo->framebufferWidth = kFramebufferWidth;
+	projectionInfo->framebufferHeight = kFramebufferHeight;
+	return T5_SUCCESS;
+}
+
+T5_Result t5ListWandsForGlasses(T5_Glasses glasses, T5_WandHandle *buffer, uint8_t *count) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!buffer || !count) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	if (*count < 1) {
+		*count = 1;
+		return T5_ERROR_OVERFLOW;
+	}
+	buffer[0] = kWandHandle;
+	*count = 1;
+	return T5_SUCCESS;
+}
+
+T5_Result t5SendImpulse(T5_Glasses glasses, T5_WandHandle wand, float amplitude, uint16_t duration) {
+	(void)duration;
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if ((wand != kWandHandle) || (amplitude < 0.0f) || (amplitude > 1.0f)) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	return T5_SUCCESS;
+}
+
+T5_Result t5ConfigureWandStreamForGlasses(T5_Glasses glasses, const T5_WandStreamConfig *config) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!config) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	if (config->enabled && !glasses->wandStreamEnabled) {
+		glasses->wandConnectSent = false;
+		glasses->nextWandReport = std::chrono::steady_clock::now();
+	}
+	glasses->wandStreamEnabled = config->enabled;
+	return T5_SUCCESS;
+}
+
+T5_Result t5ReadWandStreamForGlasses(T5_Glasses glasses, T5_WandStreamEvent *event, uint32_t timeoutMs) {
+	if (!glasses) {
+		return T5_ERROR_NO_CONTEXT;
+	}
+	if (!event) {
+		return T5_ERROR_INVALID_ARGS;
+	}
+
+	std::chrono::steady_clock::time_point due;
+	{
+		std::lock_guard<std::mutex> lock(glasses->mtx);
+		if (!glasses->wandStreamEnabled) {
+			return T5_ERROR_UNAVAILABLE;
+		}
+		*event = T5_WandStreamEvent();
+		event->wandId = kWandHandle;
+		event->timestampNanos = nanosSinceStart();
+		if (!glasses->wandConnectSent) {
+			glasses->wandConnectSent = true;
+			event->type = kT5_WandStreamEventType_Connect;
+			return T5_SUCCESS;
+		}
+		due = glasses->nextWandReport;
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	if (due > deadline) {
+		std::this_thread::sleep_until(deadline);
+		return T5_TIMEOUT;
+	}
+	std::this_thread::sleep_until(due);
+
+	std::lock_guard<std::mutex> lock(glasses->mtx);
+	glasses->nextWandReport = std::max(due + kWandPeriod, std::chrono::steady_clock::now());
+
+	double t = secondsSinceStart();
+	T5_WandReport &report = event->report;
+	event->type = kT5_WandStreamEventType_Report;
+	event->timestampNanos = nanosSinceStart();
+	report.timestampNanos = event->timestampNanos;
+	report.analogValid = true;
+	report.batteryValid = true;
+	report.buttonsValid = true;
+	report.poseValid = true;
+	report.trigger = static_cast<float>(0.5 + 0.5 * std::sin(t));
+	report.stick = { static_cast<float>(std::cos(0.5 * t)), static_cast<float>(std::sin(0.5 * t)) };
+	report.battery = 200;
+	report.buttons.a = (static_cast<int>(t) % 4) == 0;
+	report.rotToWND_GBD = axisAngle(0, 0, 1, 0.3 * t);
+	report.posGrip_GBD = { 0.1f, static_cast<float>(-0.2 + 0.05 * std::sin(t)), 0.15f };
+	report.posAim_GBD = { report.posGrip_GBD.x, report.posGrip_GBD.y + 0.05f, report.posGrip_GBD.z + 0.02f };
+	report.posFingertips_GBD = { report.posGrip_GBD.x, report.posGrip_GBD.y + 0.03f, report.posGrip_GBD.z };
+	report.hand = kT5_Hand_Right;
+	return T5_SUCCESS;
+}
+
+} // extern "C"
@@ -0,0 +1,286 @@
+/// \file
+/// \brief LD_PRELOAD interposer that profiles every call through the T5 C interface
+///
+/// Defines each function of TiltFiveNative.h, forwards it to the next definition in the lookup
+/// order (the real libTiltFiveNative, or the stand-in) and counts its latency and result code into
+/// the shared-memory segment described in t5-profile.hpp, where t5top reads it live:
+///
+/// ```
+/// LD_PRELOAD=build/libt5profiler.so ./app
+/// ./build/t5top
+/// ```
+///
+/// The segment is removed when the process exits, unless T5PROFILE_KEEP=1 is set so the totals can
+/// still be read afterwards with `t5top PID`. If the segment can't be created, calls are still
+/// forwarded, just not counted.
+
+#include "include/TiltFiveNative.h"
+#include "include/t5-profile.hpp"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+// Every function of the C interface: return type, name, parameters, arguments
+#define T5_PROFILED_FUNCTIONS(X) \
+	X(T5_Result, t5CreateContext, (T5_Context *context, const T5_ClientInfo *clientInfo, void *platformContext), \
+			(context, clientInfo, platformContext)) \
+	X(void, t5DestroyContext, (T5_Context *context), (context)) \
+	X(T5_Result, t5ListGlasses, (T5_Context context, char *buffer, size_t *bufferSize), (context, buffer, bufferSize)) \
+	X(T5_Result, t5CreateGlasses, (T5_Context context, const char *id, T5_Glasses *glasses), (context, id, glasses)) \
+	X(void, t5DestroyGlasses, (T5_Glasses *glasses), (glasses)) \
+	X(T5_Result, t5GetSystemIntegerParam, (T5_Context context, T5_ParamSys param, int64_t *value), \
+			(context, param, value)) \
+	X(T5_Result, t5GetSystemFloatParam, (T5_Context context, T5_ParamSys param, double *value), \
+			(context, param, value)) \
+	X(T5_Result, t5GetSystemUtf8Param, (T5_Context context, T5_ParamSys param, char *buffer, size_t *bufferSize), \
+			(context, param, buffer, bufferSize)) \
+	X(T5_Result, t5GetChangedSystemParams, (T5_Context context, T5_ParamSys *buffer, uint16_t *count), \
+			(context, buffer, count)) \
+	X(T5_Result, t5GetGameboardSize, \
+			(T5_Context context, T5_GameboardType gameboardType, T5_GameboardSize *gameboardSize), \
+			(context, gameboardType, gameboardSize)) \
+	X(T5_Result, t5ReserveGlasses, (T5_Glasses glasses, const char *displayName), (glasses, displayName)) \
+	X(T5_Result, t5SetGlassesDisplayName, (T5_Glasses glasses, const char *displayName), (glasses, displayName)) \
+	X(T5_Result, t5EnsureGlassesReady, (T5_Glasses glasses), (glasses)) \
+	X(T5_Result, t5ReleaseGlasses, (T5_Glasses glasses), (glasses)) \
+	X(T5_Result, t5GetGlassesConnectionState, (T5_Glasses glasses, T5_ConnectionState *connectionState), \
+			(glasses, connectionState)) \
+	X(T5_Result, t5GetGlassesIdentifier, (T5_Glasses glasses, char *buffer, size_t *bufferSize), \
+			(glasses, buffer, bufferSize)) \
+	X(T5_Result, t5GetGlassesPose, (T5_Glasses glasses, T5_GlassesPoseUsage usage, T5_GlassesPose *pose), \
+			(glasses, usage, pose)) \
+	X(T5_Result, t5InitGlassesGraphicsContext, \
+			(T5_Glasses glasses, T5_GraphicsApi graphicsApi, void *graphicsContext), \
+			(glasses, graphicsApi, graphicsContext)) \
+	X(T5_Result, t5ConfigureCameraStreamForGlasses, (T5_Glasses glasses, T5_CameraStreamConfig config), \
+			(glasses, config)) \
+	X(T5_Result, t5GetFilledCamImageBuffer, (T5_Glasses glasses, T5_CamImage *image), (glasses, image)) \
+	X(T5_Result, t5SubmitEmptyCamImageBuffer, (T5_Glasses glasses, T5_CamImage *image), (glasses, image)) \
+	X(T5_Result, t5CancelCamImageBuffer, (T5_Glasses glasses, uint8_t *buffer), (glasses, buffer)) \
+	X(T5_Result, t5SendFrameToGlasses, (T5_Glasses glasses, const T5_FrameInfo *info), (glasses, info)) \
+	X(T5_Result, t5ValidateFrameInfo, \
+			(T5_Glasses glasses, const T5_FrameInfo *info, char *detail, size_t *detailSize), \
+			(glasses, info, detail, detailSize)) \
+	X(T5_Result, t5GetGlassesIntegerParam, \
+			(T5_Glasses glasses, T5_WandHandle wand, T5_ParamGlasses param, int64_t *value), \
+			(glasses, wand, param, value)) \
+	X(T5_Result, t5GetGlassesFloatParam, \
+			(T5_Glasses glasses, T5_WandHandle wand, T5_ParamGlasses param, double *value), \
+			(glasses, wand, param, value)) \
+	X(T5_Result, t5GetGlassesUtf8Param, \
+			(T5_Glasses glasses, T5_WandHandle wand, T5_ParamGlasses param, char *buffer, size_t *bufferSize), \
+			(glasses, wand, param, buffer, bufferSize)) \
+	X(T5_Result, t5GetChangedGlassesParams, (T5_Glasses glasses, T5_ParamGlasses *buffer, uint16_t *count), \
+			(glasses, buffer, count)) \
+	X(T5_Result, t5GetProjection, \
+			(T5_Glasses glasses, T5_CartesianCoordinateHandedness handedness, T5_DepthRange depthRange, \
+					T5_MatrixOrder matrixOrder, double nearPlane, double farPlane, double worldScale, \
+					T5_ProjectionInfo *projectionInfo), \
+			(glasses, handedness, depthRange, matrixOrder, nearPlane, farPlane, worldScale, projectionInfo)) \
+	X(T5_Result, t5ListWandsForGlasses, (T5_Glasses glasses, T5_WandHandle *buffer, uint8_t *count), \
+			(glasses, buffer, count)) \
+	X(T5_Result, t5SendImpulse, (T5_Glasses glasses, T5_WandHandle wand, float amplitude, uint16_t duration), \
+			(glasses, wand, amplitude, duration)) \
+	X(T5_Result, t5ConfigureWandStreamForGlasses, (T5_Glasses glasses, const T5_WandStreamConfig *config), \
+			(glasses, config)) \
+	X(T5_Result, t5ReadWandStreamForGlasses, \
+			(T5_Glasses glasses, T5_WandStreamEvent *event, uint32_t timeoutMs), (glasses, event, timeoutMs)) \
+	X(const char *, t5GetResultMessage, (T5_Result result), (result))
+
+namespace {
+
+enum FunctionIndex : size_t {
+#define T5_PROFILE_INDEX(ret, name, params, args) kIndex_##name,
+	T5_PROFILED_FUNCTIONS(T5_PROFILE_INDEX)
+#undef T5_PROFILE_INDEX
+			kFunctionCount
+};
+
+static_assert(kFunctionCount <= kT5ProfileMaxFunctions, "raise kT5ProfileMaxFunctions");
+
+const char *const kFunctionNames[] = {
+#define T5_PROFILE_NAME(ret, name, params, args) #name,
+	T5_PROFILED_FUNCTIONS(T5_PROFILE_NAME)
+#undef T5_PROFILE_NAME
+};
+
+auto monotonicNanos() -> uint64_t {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<uint64_t>(now.tv_sec) * 1000000000u + static_cast<uint64_t>(now.tv_nsec);
+}
+
+class ProfileSegment {
+public:
+	static auto instance() -> ProfileSegment & {
+		static ProfileSegment segment;
+		return segment;
+	}
+
+	~ProfileSegment() {
+		const char *keep = std::getenv("T5PROFILE_KEEP");
+		if (mShared) {
+			// Lets a kept segment's rates be read against the time the process ran, not until now
+			mShared->exitNanos.store(monotonicNanos(), std::memory_order_relaxed);
+			if (!(keep && (std::strcmp(keep, "1") == 0))) {
+				shm_unlink(mName.c_str());
+			}
+		}
+		// Left mapped: other threads may still be returning through a profiled call
+	}
+
+	ProfileSegment(const ProfileSegment &) = delete;
+	auto operator=(const ProfileSegment &) -> ProfileSegment & = delete;
+
+	/// The calling thread's row, or nullptr if profiling is unavailable
+	auto threadStats() -> T5ProfileStats * {
+		if (!mShared) {
+			return nullptr;
+		}
+		thread_local T5ProfileStats *row = nullptr;
+		if (!row) {
+			uint32_t slot = mShared->threadCount.fetch_add(1, std::memory_order_relaxed);
+			if (slot < kT5ProfileMaxThreads - 1) {
+				mShared->threads[slot].tid.store(static_cast<uint32_t>(syscall(SYS_gettid)), std::memory_order_relaxed);
+			} else {
+				slot = kT5ProfileMaxThreads - 1;
+			}
+			row = mShared->stats[slot];
+		}
+		return row;
+	}
+
+private:
+	ProfileSegment() {
+		uint32_t pid = static_cast<uint32_t>(getpid());
+		mName = t5ProfileShmName(pid);
+
+		int fd = shm_open(mName.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0600);
+		if (fd < 0) {
+			std::perror("t5profiler: shm_open");
+			return;
+		}
+		void *memory = MAP_FAILED;
+		if (ftruncate(fd, sizeof(T5ProfileShared)) == 0) {
+			memory = mmap(nullptr, sizeof(T5ProfileShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		close(fd);
+		if (memory == MAP_FAILED) {
+			std::perror("t5profiler: mapping shared memory");
+			shm_unlink(mName.c_str());
+			return;
+		}
+
+		mShared = static_cast<T5ProfileShared *>(memory);
+		mShared->version = kT5ProfileVersion;
+		mShared->pid = pid;
+		mShared->functionCount = kFunctionCount;
+		mShared->startNanos = monotonicNanos();
+		for (size_t i = 0; i < kFunctionCount; i++) {
+			std::strncpy(mShared->functions[i], kFunctionNames[i], kT5ProfileNameLength - 1);
+		}
+		mShared->magic.store(kT5ProfileMagic, std::memory_order_release);
+	}
+
+	std::string mName;
+	T5ProfileShared *mShared = nullptr;
+};
+
+auto countResult(T5ProfileStats &stats, uint32_t code) -> void {
+	uint32_t key = code + 1;
+	for (auto &slot : stats.results) {
+		uint32_t current = slot.codePlusOne.load(std::memory_order_relaxed);
+		// Only the overflow row is shared between threads, so the claim rarely races
+		if ((current == 0) && slot.codePlusOne.compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+			current = key;
+		}
+		if (current == key) {
+			slot.count.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+	stats.otherResults.fetch_add(1, std::memory_order_relaxed);
+}
+
+auto record(T5ProfileStats &stats, uint64_t nanos) -> void {
+	stats.calls.fetch_add(1, std::memory_order_relaxed);
+	stats.totalNanos.fetch_add(nanos, std::memory_order_relaxed);
+	stats.buckets[t5ProfileBucket(nanos)].fetch_add(1, std::memory_order_relaxed);
+	uint64_t max = stats.maxNanos.load(std::memory_order_relaxed);
+	while ((nanos > max) && !stats.maxNanos.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {
+	}
+}
+
+/// The next definition of a function after this library's own
+template <typename Fn>
+auto resolveNext(const char *name) -> Fn {
+	auto fn = reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+	if (!fn) {
+		std::fprintf(stderr, "t5profiler: %s not found after the interposer; is libTiltFiveNative loaded?\n", name);
+	}
+	return fn;
+}
+
+/// Returned when the real function is missing
+template <typename R>
+auto missingResult() -> R {
+	if constexpr (std::is_same_v<R, T5_Result>) {
+		return T5_ERROR_NO_LIBRARY;
+	} else if constexpr (std::is_same_v<R, const char *>) {
+		return "Library unavailable";
+	} else if constexpr (!std::is_void_v<R>) {
+		return R{};
+	}
+}
+
+template <typename Fn, typename... Args>
+auto profiledCall(size_t index, Fn real, Args... args) -> decltype(real(args...)) {
+	using R = decltype(real(args...));
+	if (!real) {
+		return missingResult<R>();
+	}
+	T5ProfileStats *row = ProfileSegment::instance().threadStats();
+	if (!row) {
+		return real(args...);
+	}
+	T5ProfileStats &stats = row[index];
+
+	uint64_t start = monotonicNanos();
+	if constexpr (std::is_void_v<R>) {
+		real(args...);
+		record(stats, monotonicNanos() - start);
+	} else {
+		R result = real(args...);
+		record(stats, monotonicNanos() - start);
+		if constexpr (std::is_same_v<R, T5_Result>) {
+			countResult(stats, result);
+		}
+		return result;
+	}
+}
+
+} // namespace
+
+extern "C" {
+
+#define T5_PROFILE_DEFINE(ret, name, params, args) \
+	ret name params { \
+		static const auto real = resolveNext<decltype(&name)>(#name); \
+		return profiledCall(kIndex_##name, real, T5_PROFILE_UNPAREN args); \
+	}
+#define T5_PROFILE_UNPAREN(...) __VA_ARGS__
+
+T5_PROFILED_FUNCTIONS(T5_PROFILE_DEFINE)
+
+#undef T5_PROFILE_UNPAREN
+#undef T5_PROFILE_DEFINE
+
+} // extern "C"
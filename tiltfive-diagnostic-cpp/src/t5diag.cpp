@@ -0,0 +1,760 @@
+/// \file
+/// \brief Scriptable diagnostic runs: one executable with a subcommand per scenario
+///
+/// Everything the separate sample programs hardcode (which glasses, how long to run, which camera,
+/// detector settings and where results go) is a flag here, so fleet runs can be repeated from a
+/// script without rebuilding.
+
+#include "include/TiltFiveNative.hpp"
+#include "include/frame-pacer.hpp"
+#include "include/metrics-server.hpp"
+#include "include/metrics.hpp"
+#include "include/pose-analyzer.hpp"
+#include "include/trace.hpp"
+
+#ifdef T5DIAG_WITH_OPENCV
+#include "include/aruco-atlas.hpp"
+#include "include/batch-detection.hpp"
+#include "include/camera-capture.hpp"
+#include "include/detection-eval.hpp"
+#include "include/marker-sheet.hpp"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Live output is redrawn at most this often so the terminal doesn't limit the sampling rate
+constexpr auto kPrintInterval = std::chrono::milliseconds(100);
+
+using Client = std::shared_ptr<tiltfive::Client>;
+using Glasses = std::shared_ptr<tiltfive::Glasses>;
+using Wand = std::shared_ptr<tiltfive::Wand>;
+
+struct DiagOptions {
+	std::string command;
+	std::string glassesId; ///< Empty for the first glasses found
+	std::chrono::milliseconds duration{ 10000 };
+	std::chrono::milliseconds timeout{ 30000 }; ///< Limit on waiting for the service, glasses or a wand
+	std::chrono::milliseconds reportInterval{ 5000 }; ///< Period of the poses tracking quality report
+	double fps = 60.0; ///< Frames per second frames sends at, and pose reads per second for poses
+	std::chrono::microseconds renderTime{ 0 }; ///< Simulated render time per frame for frames
+	uint8_t cameraIndex = 0;
+	std::string detectorConfig = "detector-params.yml";
+	std::string intrinsicsPath = "camera-intrinsics.yml";
+	std::string output; ///< Command specific result file; empty for its default
+	std::string recordPath;
+	std::string framesDirectory = "frames";
+	int framesEveryNth = 0;
+	bool framesOnMarkerLoss = false;
+	bool framesOnError = false;
+	int fullDetectEveryNth = 10;
+	int unknownKeepEvery = 3;
+	bool headless = false;
+	double previewFps = 10.0;
+	bool stdinCommands = true;
+
+	int decodeThreads = 2;
+	int detectThreads = 0;
+	std::string markerIds = "19,29,31,43,62,65,67,68,82,93,96,98,100,126,127,129,130,155,205,206,220,227,"
+							"228,231,247,248,0-8";
+	std::string sheetFormat = "png";
+
+	int metricsPort = -1; ///< Serve metrics on this port if not negative; 0 picks a free port
+	std::string metricsAddress = "127.0.0.1";
+	MetricsRegistry *metrics = nullptr; ///< Set by main
+	std::string tracePath; ///< Record timing spans and write them here as a Chrome trace if set
+
+	std::vector<std::string> inputs;
+};
+
+auto printUsage(const char *argv0) -> void {
+	std::cout << "Usage: " << argv0 << " COMMAND [options]\n\n"
+			  << "Commands:\n"
+			  << "  info     Service version, gameboard sizes and glasses settings\n"
+			  << "  wand     Stream wand reports and report their rate\n"
+			  << "  poses    Connect exclusively and stream glasses poses\n"
+			  << "  frames   Send frames with dummy textures at a fixed rate and report pacing\n"
+#ifdef T5DIAG_WITH_OPENCV
+			  << "  camera   Capture camera frames, detect markers and estimate their poses\n"
+			  << "  detect   Detect markers in INPUT: an image, a directory or a session list\n"
+			  << "  markers  Render printable marker sheets\n"
+#endif
+			  << "\nOptions:\n"
+			  << "  --glasses ID            Use these glasses instead of the first found\n"
+			  << "  --duration SECONDS      How long wand, poses, frames and camera run (default 10)\n"
+			  << "  --timeout SECONDS       Give up waiting for the service, glasses or a wand (default 30)\n"
+			  << "  --report-interval SECONDS  How often poses reports jitter, drift and dropouts (default 5)\n"
+			  << "  --metrics-port PORT     Serve live metrics for Prometheus at http://ADDRESS:PORT/metrics\n"
+			  << "  --metrics-address ADDR  Address the metrics endpoint listens on (default 127.0.0.1)\n"
+			  << "  --trace PATH            Write timing spans of the run to PATH as a Chrome trace, for\n"
+			  << "                          chrome://tracing or ui.perfetto.dev\n"
+			  << "  --fps N                 frames: frames per second to send; poses: pose reads per second,\n"
+			  << "                          each one expected to find a pose (default 60)\n"
+			  << "  --render-ms MS          frames: simulated render time per frame (default 0)\n"
+#ifdef T5DIAG_WITH_OPENCV
+			  << "  --camera-index N        Camera to stream (default 0)\n"
+			  << "  --detector-config PATH  Detector parameters, used if present (default detector-params.yml)\n"
+			  << "  --intrinsics PATH       Camera calibration, used if present (default camera-intrinsics.yml)\n"
+			  << "  --out PATH              Output: marker poses CSV for camera (default marker-poses.csv),\n"
+			  << "                          detections for detect, binary if it ends in .bin (default\n"
+			  << "                          detections.csv), file prefix for markers (default markerPage)\n"
+			  << "  --record PATH           camera: also record every raw frame to a session file\n"
+			  << "  --frames-dir DIR        camera: where sampled raw frames go (default frames)\n"
+			  << "  --frames-every N        camera: write every Nth raw frame (default: none)\n"
+			  << "  --frames-on-loss        camera: write the first frame after markers are lost\n"
+			  << "  --frames-on-error       camera: write frames that failed to record or publish poses\n"
+			  << "  --full-detect-every N   camera: also detect at full resolution every Nth frame\n"
+			  << "                          (default 10, 0 only when markers are lost)\n"
+			  << "  --unknown-frames N      camera: detect on every Nth frame with no illumination mode\n"
+			  << "                          (default 3, 0 drops them)\n"
+			  << "  --headless              camera: don't open the preview window\n"
+			  << "  --preview-fps N         camera: preview redraw rate (default 10)\n"
+			  << "  --no-stdin              camera: don't read q/s commands from stdin\n"
+			  << "  --decode-threads N      detect: image decode threads (default 2)\n"
+			  << "  --detect-threads N      detect: detection threads (default: one per core)\n"
+			  << "  --ids SPEC              markers: ids, e.g. 0-249 or 19,29,31 (default: calibration set)\n"
+			  << "  --format png|pdf        markers: one PNG per page or a single PDF (default png)\n"
+#endif
+			;
+}
+
+auto parseSeconds(const char *text, std::chrono::milliseconds &value) -> bool {
+	char *end = nullptr;
+	double seconds = std::strtod(text, &end);
+	if ((end == text) || (*end != '\0') || (seconds < 0)) {
+		return false;
+	}
+	value = std::chrono::milliseconds(static_cast<long long>(seconds * 1000.0));
+	return true;
+}
+
+auto parseInt(const char *text, int minimum, int maximum, int &value) -> bool {
+	char *end = nullptr;
+	long parsed = std::strtol(text, &end, 10);
+	if ((end == text) || (*end != '\0') || (parsed < minimum) || (parsed > maximum)) {
+		return false;
+	}
+	value = static_cast<int>(parsed);
+	return true;
+}
+
+auto parseOptions(int argc, char **argv, DiagOptions &options) -> bool {
+	if (argc < 2) {
+		return false;
+	}
+	options.command = argv[1];
+
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+		bool ok = true;
+		int number = 0;
+
+		if (arg == "--headless") {
+			options.headless = true;
+			continue;
+		} else if (arg == "--no-stdin") {
+			options.stdinCommands = false;
+			continue;
+		} else if (arg == "--frames-on-loss") {
+			options.framesOnMarkerLoss = true;
+			continue;
+		} else if (arg == "--frames-on-error") {
+			options.framesOnError = true;
+			continue;
+		} else if (!arg.empty() && (arg[0] != '-')) {
+			options.inputs.push_back(arg);
+			continue;
+		} else if (!value) {
+			ok = false;
+		} else if (arg == "--glasses") {
+			options.glassesId = value;
+		} else if (arg == "--duration") {
+			ok = parseSeconds(value, options.duration);
+		} else if (arg == "--timeout") {
+			ok = parseSeconds(value, options.timeout);
+		} else if (arg == "--report-interval") {
+			ok = parseSeconds(value, options.reportInterval) && (options.reportInterval.count() > 0);
+		} else if (arg == "--metrics-port") {
+			ok = parseInt(value, 0, 65535, options.metricsPort);
+		} else if (arg == "--metrics-address") {
+			options.metricsAddress = value;
+		} else if (arg == "--trace") {
+			options.tracePath = value;
+		} else if (arg == "--camera-index") {
+			ok = parseInt(value, 0, 255, number);
+			options.cameraIndex = static_cast<uint8_t>(number);
+		} else if (arg == "--detector-config") {
+			options.detectorConfig = value;
+		} else if (arg == "--intrinsics") {
+			options.intrinsicsPath = value;
+		} else if (arg == "--out") {
+			options.output = value;
+		} else if (arg == "--record") {
+			options.recordPath = value;
+		} else if (arg == "--fps") {
+			char *end = nullptr;
+			options.fps = std::strtod(value, &end);
+			ok = (end != value) && (*end == '\0') && (options.fps > 0);
+		} else if (arg == "--render-ms") {
+			char *end = nullptr;
+			double milliseconds = std::strtod(value, &end);
+			ok = (end != value) && (*end == '\0') && (milliseconds >= 0);
+			options.renderTime = std::chrono::microseconds(static_cast<long long>(milliseconds * 1000.0));
+		} else if (arg == "--preview-fps") {
+			char *end = nullptr;
+			options.previewFps = std::strtod(value, &end);
+			ok = (end != value) && (*end == '\0') && (options.previewFps > 0);
+		} else if (arg == "--frames-dir") {
+			options.framesDirectory = value;
+		} else if (arg == "--frames-every") {
+			ok = parseInt(value, 0, 1000000, options.framesEveryNth);
+		} else if (arg == "--full-detect-every") {
+			ok = parseInt(value, 0, 1000000, options.fullDetectEveryNth);
+		} else if (arg == "--unknown-frames") {
+			ok = parseInt(value, 0, 1000000, options.unknownKeepEvery);
+		} else if (arg == "--decode-threads") {
+			ok = parseInt(value, 1, 256, options.decodeThreads);
+		} else if (arg == "--detect-threads") {
+			ok = parseInt(value, 0, 256, options.detectThreads);
+		} else if (arg == "--ids") {
+			options.markerIds = value;
+		} else if (arg == "--format") {
+			options.sheetFormat = value;
+		} else {
+			ok = false;
+		}
+
+		if (!ok) {
+			std::cerr << "Invalid option " << arg << (value ? std::string(" ") + value : std::string()) << std::endl;
+			return false;
+		}
+		i++;
+	}
+	return true;
+}
+
+auto obtainClient() -> tiltfive::Result<Client> {
+	auto client = tiltfive::obtainClient("com.tiltfive.t5diag", "0.1.0", nullptr);
+	if (!client) {
+		std::cerr << "Failed to create client : " << client << std::endl;
+	}
+	return client;
+}
+
+// Repeat a call while the service is unavailable, up to the timeout. findGlasses() needs no wrapping:
+// its discovery helper already polls through an unavailable service.
+template <typename T, typename Fn>
+auto waitForService(const DiagOptions &options, Fn &&fn) -> tiltfive::Result<T> {
+	auto deadline = std::chrono::steady_clock::now() + options.timeout;
+	auto retryInterval = std::chrono::milliseconds(5);
+	for (;;) {
+		tiltfive::Result<T> result = fn();
+		if (result || (result.error() != tiltfive::Error::kNoService) ||
+				(std::chrono::steady_clock::now() >= deadline)) {
+			return result;
+		}
+		std::this_thread::sleep_for(retryInterval);
+		retryInterval = std::min(retryInterval * 2, std::chrono::milliseconds(100));
+	}
+}
+
+auto findGlasses(Client &client, const DiagOptions &options) -> tiltfive::Result<Glasses> {
+	auto discoveryHelper = client->createGlassesDiscoveryHelper();
+	std::string id = options.glassesId;
+	if (id.empty()) {
+		auto found = discoveryHelper->awaitGlasses(options.timeout);
+		if (!found) {
+			std::cerr << "No glasses found : " << found << std::endl;
+			return found.error();
+		}
+		id = *found;
+	} else {
+		auto found = discoveryHelper->awaitGlasses(id, options.timeout);
+		if (!found) {
+			std::cerr << "Glasses " << id << " not found : " << found << std::endl;
+			return found.error();
+		}
+	}
+
+	auto glasses = tiltfive::obtainGlasses(id, client);
+	if (!glasses) {
+		std::cerr << "Failed to obtain glasses " << id << " : " << glasses << std::endl;
+	}
+	return glasses;
+}
+
+auto connectExclusive(Glasses &glasses, const DiagOptions &options)
+		-> std::unique_ptr<tiltfive::GlassesConnectionHelper> {
+	auto connectionHelper = glasses->createConnectionHelper("t5diag");
+	auto connectionResult = connectionHelper->awaitConnection(options.timeout);
+	if (!connectionResult) {
+		std::cerr << "Error connecting glasses for exclusive use : " << connectionResult << std::endl;
+		return nullptr;
+	}
+	std::cout << "Glasses connected for exclusive use" << std::endl;
+	return connectionHelper;
+}
+
+auto runInfo(const DiagOptions &options) -> int {
+	auto client = obtainClient();
+	if (!client) {
+		return EXIT_FAILURE;
+	}
+
+	auto version = waitForService<std::string>(options, [&] { return (*client)->getServiceVersion(); });
+	if (!version) {
+		std::cerr << "Failed to get service version : " << version << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Service version : " << *version << std::endl;
+
+	auto attention = (*client)->isTiltFiveUiRequestingAttention();
+	if (attention) {
+		std::cout << "Tilt Five UI (Attention Requested) : " << (*attention ? "TRUE" : "FALSE") << std::endl;
+	}
+
+	const std::pair<T5_GameboardType, const char *> gameboards[] = {
+		{ kT5_GameboardType_LE, "LE" },
+		{ kT5_GameboardType_XE, "XE" },
+		{ kT5_GameboardType_XE_Raised, "XE raised" },
+	};
+	for (const auto &gameboard : gameboards) {
+		auto size = (*client)->getGameboardSize(gameboard.first);
+		if (size) {
+			std::cout << gameboard.second << " gameboard size : "
+					  << size->viewableExtentPositiveX + size->viewableExtentNegativeX << "m x "
+					  << size->viewableExtentPositiveY + size->viewableExtentNegativeY << "m x "
+					  << size->viewableExtentPositiveZ << "m" << std::endl;
+		}
+	}
+
+	auto glasses = findGlasses(*client, options);
+	if (!glasses) {
+		return EXIT_FAILURE;
+	}
+	std::cout << "Glasses : " << *glasses << std::endl;
+	auto friendlyName = (*glasses)->getFriendlyName();
+	std::cout << "Friendly name : " << friendlyName << std::endl;
+	auto ipd = (*glasses)->getIpd();
+	std::cout << "IPD : " << ipd << (ipd ? "m" : "") << std::endl;
+	auto projection = (*glasses)->getProjection(kT5_CartesianCoordinateHandedness_Right,
+			kT5_DepthRange_MinusOneToOne, kT5_MatrixOrder_ColumnMajor, 0.1, 100.0, 1.0);
+	if (projection) {
+		std::cout << "Projection : " << projection->fieldOfView << " deg vertical FOV, aspect "
+				  << projection->aspectRatio << ", " << projection->framebufferWidth << "x"
+				  << projection->framebufferHeight << " framebuffer" << std::endl;
+	} else {
+		std::cout << "Projection : " << projection << std::endl;
+	}
+	return EXIT_SUCCESS;
+}
+
+auto runWand(const DiagOptions &options) -> int {
+	auto client = obtainClient();
+	if (!client) {
+		return EXIT_FAILURE;
+	}
+	auto glasses = findGlasses(*client, options);
+	if (!glasses) {
+		return EXIT_FAILURE;
+	}
+
+	auto wandHelper = (*glasses)->getWandStreamHelper();
+	auto deadline = std::chrono::steady_clock::now() + options.timeout;
+	Wand wand;
+	while (!wand) {
+		auto wands = wandHelper->listWands();
+		if (!wands) {
+			std::cerr << "Error listing wands : " << wands << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!wands->empty()) {
+			wand = wands->front();
+		} else if (std::chrono::steady_clock::now() >= deadline) {
+			std::cerr << "No wand connected" << std::endl;
+			return EXIT_FAILURE;
+		} else {
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+	std::cout << "Streaming reports from " << wand << std::endl;
+
+	MetricCounter &reportCounter = options.metrics->counter("t5diag_wand_reports_total", "Distinct wand reports received");
+	MetricGauge &reportRate = options.metrics->gauge("t5diag_wand_report_rate_hz", "Wand reports over the last second");
+
+	// The helper keeps only the latest report, so count distinct timestamps to measure the rate
+	size_t reports = 0;
+	uint64_t lastTimestamp = 0;
+	auto start = std::chrono::steady_clock::now();
+	auto nextPrint = start;
+	auto rateStart = start;
+	size_t rateReports = 0;
+	while (std::chrono::steady_clock::now() - start < options.duration) {
+		auto report = wand->getLatestReport();
+		auto now = std::chrono::steady_clock::now();
+		if (report && (report->timestampNanos != lastTimestamp)) {
+			lastTimestamp = report->timestampNanos;
+			reports++;
+			reportCounter.add();
+			if (now >= nextPrint) {
+				nextPrint += kPrintInterval;
+				std::cout << "\r" << *report << std::flush;
+			}
+		}
+		if (now - rateStart >= std::chrono::seconds(1)) {
+			reportRate.set((reports - rateReports) / std::chrono::duration<double>(now - rateStart).count());
+			rateStart = now;
+			rateReports = reports;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "\n"
+			  << reports << " wand reports in " << elapsed.count() << "s ("
+			  << reports / std::max(elapsed.count(), 1e-9) << " Hz)" << std::endl;
+	return EXIT_SUCCESS;
+}
+
+auto runPoses(const DiagOptions &options) -> int {
+	auto client = obtainClient();
+	if (!client) {
+		return EXIT_FAILURE;
+	}
+	auto glasses = findGlasses(*client, options);
+	if (!glasses) {
+		return EXIT_FAILURE;
+	}
+	auto connectionHelper = connectExclusive(*glasses, options);
+	if (!connectionHelper) {
+		return EXIT_FAILURE;
+	}
+
+	MetricCounter &availableCounter = options.metrics->counter("t5diag_pose_reads_total",
+			"Glasses pose reads by availability", { { "result", "available" } });
+	MetricCounter &unavailableCounter = options.metrics->counter("t5diag_pose_reads_total",
+			"Glasses pose reads by availability", { { "result", "unavailable" } });
+	MetricCounter &poseCounter = options.metrics->counter("t5diag_poses_total", "Distinct glasses poses received");
+	MetricGauge &availability = options.metrics->gauge("t5diag_pose_availability_ratio",
+			"Fraction of glasses pose reads that returned a pose");
+	MetricGauge *positionJitter[3];
+	for (int axis = 0; axis < 3; axis++) {
+		positionJitter[axis] = &options.metrics->gauge("t5diag_pose_position_jitter_meters",
+				"Standard deviation of the position change between poses over the last report interval",
+				{ { "axis", std::string(1, static_cast<char>('x' + axis)) } });
+	}
+	MetricGauge &angularJitter = options.metrics->gauge("t5diag_pose_angular_jitter_radians",
+			"Mean rotation between poses over the last report interval");
+	MetricGauge &intervalJitter = options.metrics->gauge("t5diag_pose_interval_jitter_seconds",
+			"Standard deviation of the time between poses over the last report interval");
+	MetricGauge &longestDropout = options.metrics->gauge("t5diag_pose_longest_dropout_reads",
+			"Longest run of paced pose reads that found no pose over the last report interval");
+
+	// One analyzer per report window and one for the whole run
+	PoseAnalyzer window;
+	PoseAnalyzer total;
+	auto reportWindow = [&]() {
+		std::cout << "\n";
+		window.report(std::cout);
+		for (int axis = 0; axis < 3; axis++) {
+			positionJitter[axis]->set(window.positionJitter(axis).stddev());
+		}
+		angularJitter.set(window.angularJitter().mean());
+		intervalJitter.set(window.interval().stddev());
+		longestDropout.set(static_cast<double>(window.longestDropout()));
+		window.reset();
+	};
+
+	size_t reads = 0;
+	size_t poses = 0;
+	size_t unavailable = 0;
+	uint64_t lastTimestamp = 0;
+	// Reads are paced like an application reading once per frame, so each read is one expected pose
+	// and a dropout counts the periods that had none, not how often the loop could poll
+	auto readPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(1.0 / options.fps));
+	auto start = std::chrono::steady_clock::now();
+	auto nextRead = start;
+	auto nextPrint = start;
+	auto nextReport = start + options.reportInterval;
+	while (std::chrono::steady_clock::now() - start < options.duration) {
+		std::this_thread::sleep_until(nextRead);
+		// After a stall on our side, carry on from now instead of reading back to back to catch up
+		nextRead = std::max(nextRead + readPeriod, std::chrono::steady_clock::now());
+
+		reads++;
+		auto pose = (*glasses)->getLatestGlassesPose(kT5_GlassesPoseUsage_GlassesPresentation);
+		(pose ? availableCounter : unavailableCounter).add();
+		availability.set(static_cast<double>(availableCounter.value()) / reads);
+		if (pose) {
+			window.addPose(*pose);
+			total.addPose(*pose);
+			if (pose->timestampNanos != lastTimestamp) {
+				lastTimestamp = pose->timestampNanos;
+				poses++;
+				poseCounter.add();
+				if (std::chrono::steady_clock::now() >= nextPrint) {
+					nextPrint += kPrintInterval;
+					std::cout << "\r" << *pose << std::flush;
+				}
+			}
+		} else if (pose.error() == tiltfive::Error::kTryAgain) {
+			unavailable++;
+			window.addDropout();
+			total.addDropout();
+		} else {
+			std::cerr << "\nError reading pose : " << pose << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		if (std::chrono::steady_clock::now() >= nextReport) {
+			nextReport += options.reportInterval;
+			reportWindow();
+		}
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "\n"
+			  << poses << " distinct poses from " << reads << " reads in " << elapsed.count() << "s ("
+			  << poses / std::max(elapsed.count(), 1e-9) << " Hz), " << unavailable << " reads unavailable"
+			  << std::endl;
+	std::cout << "\nWhole run:\n";
+	total.report(std::cout);
+	return EXIT_SUCCESS;
+}
+
+auto runFrames(const DiagOptions &options) -> int {
+	auto client = obtainClient();
+	if (!client) {
+		return EXIT_FAILURE;
+	}
+	auto glasses = findGlasses(*client, options);
+	if (!glasses) {
+		return EXIT_FAILURE;
+	}
+	auto connectionHelper = connectExclusive(*glasses, options);
+	if (!connectionHelper) {
+		return EXIT_FAILURE;
+	}
+
+	FramePacerOptions pacerOptions;
+	pacerOptions.duration = options.duration;
+	pacerOptions.fps = options.fps;
+	pacerOptions.renderTime = options.renderTime;
+	pacerOptions.metrics = options.metrics;
+
+	FramePacerStats stats;
+	auto result = runFramePacer(*glasses, pacerOptions, stats);
+	if (!result) {
+		std::cerr << "Error sending frames : " << result << std::endl;
+		return EXIT_FAILURE;
+	}
+	// Like detect with unreadable images: the run finished, but the render path didn't keep up
+	return (stats.missedDeadlines == 0 && stats.sendFailures == 0) ? EXIT_SUCCESS : 2;
+}
+
+#ifdef T5DIAG_WITH_OPENCV
+
+auto runCamera(const DiagOptions &options) -> int {
+	auto client = obtainClient();
+	if (!client) {
+		return EXIT_FAILURE;
+	}
+	auto glasses = findGlasses(*client, options);
+	if (!glasses) {
+		return EXIT_FAILURE;
+	}
+	auto connectionHelper = connectExclusive(*glasses, options);
+	if (!connectionHelper) {
+		return EXIT_FAILURE;
+	}
+
+	CameraCaptureOptions captureOptions;
+	captureOptions.duration = options.duration;
+	captureOptions.cameraIndex = options.cameraIndex;
+	captureOptions.detectorConfig = options.detectorConfig;
+	captureOptions.intrinsicsPath = options.intrinsicsPath;
+	if (!options.output.empty()) {
+		captureOptions.markerPoseOutput = options.output;
+	}
+	captureOptions.framesDirectory = options.framesDirectory;
+	captureOptions.framesEveryNth = options.framesEveryNth;
+	captureOptions.framesOnMarkerLoss = options.framesOnMarkerLoss;
+	captureOptions.framesOnError = options.framesOnError;
+	captureOptions.fullDetectEveryNth = options.fullDetectEveryNth;
+	captureOptions.demux.unknownKeepEvery = options.unknownKeepEvery;
+	captureOptions.sessionPath = options.recordPath;
+	captureOptions.headless = options.headless;
+	captureOptions.previewFps = options.previewFps;
+	captureOptions.stdinCommands = options.stdinCommands;
+	captureOptions.metrics = options.metrics;
+
+	auto result = runCameraCapture(*glasses, captureOptions);
+	if (!result) {
+		std::cerr << "Error capturing camera frames : " << result << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+auto runDetect(const DiagOptions &options) -> int {
+	if (options.inputs.size() != 1) {
+		std::cerr << "detect needs one INPUT" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::vector<std::string> paths;
+	if (!collectImagePaths(options.inputs.front(), paths)) {
+		return EXIT_FAILURE;
+	}
+	if (paths.empty()) {
+		std::cerr << "No images found in " << options.inputs.front() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	BatchDetectionOptions batchOptions;
+	batchOptions.decodeThreads = options.decodeThreads;
+	batchOptions.detectThreads = options.detectThreads;
+	if (std::ifstream(options.detectorConfig)) {
+		if (!loadDetectorParameters(options.detectorConfig, batchOptions.detectorParams)) {
+			std::cerr << "Error reading " << options.detectorConfig << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::cout << "Loaded detector parameters from " << options.detectorConfig << std::endl;
+	}
+
+	std::string outPath = options.output.empty() ? "detections.csv" : options.output;
+	std::unique_ptr<DetectionSink> sink;
+	bool binary = (outPath.size() >= 4) && (outPath.compare(outPath.size() - 4, 4, ".bin") == 0);
+	if (binary) {
+		sink.reset(new BinaryDetectionSink(outPath));
+	} else {
+		sink.reset(new CsvDetectionSink(outPath));
+	}
+
+	BatchDetectionStats stats;
+	if (!runBatchDetection(paths, batchOptions, *sink, stats)) {
+		std::cerr << "Batch detection failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Processed " << stats.images << " images (" << stats.failed << " unreadable), found "
+			  << stats.markers << " markers in " << stats.seconds << "s : " << stats.imagesPerSecond()
+			  << " images/sec" << std::endl;
+	std::cout << "Results written to " << outPath << std::endl;
+	return (stats.failed == 0) ? EXIT_SUCCESS : 2;
+}
+
+auto runMarkers(const DiagOptions &options) -> int {
+	MarkerSheetLayout layout;
+	std::string layoutError;
+	if (!layout.validate(layoutError)) {
+		std::cerr << "Invalid layout: " << layoutError << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<int> ids;
+	if (!parseMarkerIds(options.markerIds, kArucoDictionarySize, ids)) {
+		std::cerr << "Invalid marker ids '" << options.markerIds << "'" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::string outPrefix = options.output.empty() ? "markerPage" : options.output;
+	std::unique_ptr<MarkerSheetSink> sink;
+	if (options.sheetFormat == "png") {
+		sink.reset(new PngSheetSink(outPrefix));
+	} else if (options.sheetFormat == "pdf") {
+		sink.reset(new PdfSheetSink(outPrefix + ".pdf", layout.dpi));
+	} else {
+		std::cerr << "Unknown format '" << options.sheetFormat << "'" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	MarkerSheetRenderer renderer(layout);
+	if (!generateMarkerSheets(renderer, ids, *sink)) {
+		std::cerr << "Failed to generate marker sheets" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Wrote " << ids.size() << " markers" << std::endl;
+	return EXIT_SUCCESS;
+}
+
+#endif
+
+struct Command {
+	const char *name;
+	int (*run)(const DiagOptions &options);
+};
+
+const Command kCommands[] = {
+	{ "info", runInfo },
+	{ "wand", runWand },
+	{ "poses", runPoses },
+	{ "frames", runFrames },
+#ifdef T5DIAG_WITH_OPENCV
+	{ "camera", runCamera },
+	{ "detect", runDetect },
+	{ "markers", runMarkers },
+#endif
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+	DiagOptions options;
+	bool parsed = parseOptions(argc, argv, options);
+	if (parsed && (options.command == "--help" || options.command == "help")) {
+		printUsage(argv[0]);
+		return EXIT_SUCCESS;
+	}
+
+	for (const auto &command : kCommands) {
+		if (parsed && (options.command == command.name)) {
+			MetricsRegistry metrics;
+			options.metrics = &metrics;
+			MetricsServer metricsServer(metrics);
+			if (options.metricsPort >= 0) {
+				if (!metricsServer.start(static_cast<uint16_t>(options.metricsPort), options.metricsAddress)) {
+					return EXIT_FAILURE;
+				}
+				std::cout << "Serving metrics at http://" << options.metricsAddress << ":" << metricsServer.port()
+						  << "/metrics" << std::endl;
+			}
+
+			Tracer &tracer = Tracer::instance();
+			if (!options.tracePath.empty()) {
+				tracer.setThreadName("main");
+				tracer.enable(true);
+			}
+			int status = command.run(options);
+			if (!options.tracePath.empty()) {
+				tracer.enable(false);
+				size_t events = 0;
+				uint64_t dropped = 0;
+				if (!tracer.writeChromeTrace(options.tracePath, events, dropped)) {
+					return EXIT_FAILURE;
+				}
+				std::cout << "Wrote " << events << " spans to " << options.tracePath;
+				if (dropped) {
+					std::cout << " (" << dropped << " dropped with buffers full)";
+				}
+				std::cout << std::endl;
+			}
+			return status;
+		}
+	}
+
+	if (parsed) {
+		std::cerr << "Unknown command '" << options.command << "'" << std::endl;
+	}
+	printUsage(argv[0]);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,461 @@
+/// \file
+/// \brief Live top-style view of the T5 API calls counted by the t5profiler interposer
+///
+/// Attaches to the shared-memory segment of a process started with
+/// `LD_PRELOAD=libt5profiler.so` and redraws, every interval, how often each T5 function was
+/// called, how much wall time its calls took, its latency percentiles and which results it
+/// returned. Without a PID, the newest profiled process still running is picked.
+///
+/// Time inside a call is measured on the wall clock, so it includes time blocked or descheduled in
+/// the call and is summed over threads: the %WALL column can pass 100% and is not CPU usage.
+
+#include "include/errors.h"
+#include "include/t5-profile.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct TopOptions {
+	uint32_t pid = 0; ///< 0 to pick the newest profiled process
+	double interval = 1.0;
+	bool threads = false;
+	bool once = false;
+};
+
+/// Counters of one function, copied out of the segment or summed over threads
+struct FunctionSample {
+	uint64_t calls = 0;
+	uint64_t totalNanos = 0;
+	uint64_t maxNanos = 0;
+	uint64_t buckets[kT5ProfileBuckets] = {};
+	std::map<uint32_t, uint64_t> results;
+	uint64_t otherResults = 0;
+};
+
+struct ThreadSample {
+	uint32_t tid = 0;
+	std::vector<FunctionSample> functions;
+};
+
+struct Snapshot {
+	uint64_t nanos = 0;
+	std::vector<ThreadSample> threads;
+};
+
+auto printUsage(const char *argv0) -> void {
+	std::cerr << "Usage: " << argv0 << " [PID] [--interval SECONDS] [--threads] [--once]\n"
+			  << "\n"
+			  << "Shows the T5 API calls of a process run with LD_PRELOAD=libt5profiler.so. Without a PID,\n"
+			  << "the newest profiled process that is still running is shown.\n"
+			  << "\n"
+			  << "  --interval SECONDS  Refresh period, default 1\n"
+			  << "  --threads           Break every function down by thread\n"
+			  << "  --once              Print the totals since the process started profiling and exit\n";
+}
+
+auto parseOptions(int argc, char **argv, TopOptions &options) -> bool {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		char *end = nullptr;
+		if (arg == "--threads") {
+			options.threads = true;
+		} else if (arg == "--once") {
+			options.once = true;
+		} else if ((arg == "--interval") && (i + 1 < argc)) {
+			options.interval = std::strtod(argv[++i], &end);
+			if ((*end != '\0') || !(options.interval >= 0.05)) {
+				std::cerr << "Invalid option --interval " << argv[i] << std::endl;
+				return false;
+			}
+		} else if (!arg.empty() && (arg[0] != '-') && (options.pid == 0)) {
+			unsigned long pid = std::strtoul(arg.c_str(), &end, 10);
+			if ((*end != '\0') || (pid == 0) || (pid > 0xffffffffu)) {
+				std::cerr << "Invalid PID " << arg << std::endl;
+				return false;
+			}
+			options.pid = static_cast<uint32_t>(pid);
+		} else {
+			std::cerr << "Invalid option " << arg << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+auto processRunning(uint32_t pid) -> bool {
+	return (kill(static_cast<pid_t>(pid), 0) == 0) || (errno == EPERM);
+}
+
+/// Newest segment in /dev/shm whose process is still running, or 0
+auto findNewestProfiledProcess() -> uint32_t {
+	DIR *dir = opendir("/dev/shm");
+	if (!dir) {
+		return 0;
+	}
+	uint32_t newest = 0;
+	time_t newestTime = 0;
+	const std::string prefix = "t5profile-";
+	while (dirent *entry = readdir(dir)) {
+		std::string name = entry->d_name;
+		if (name.compare(0, prefix.size(), prefix) != 0) {
+			continue;
+		}
+		char *end = nullptr;
+		unsigned long pid = std::strtoul(name.c_str() + prefix.size(), &end, 10);
+		struct stat info;
+		if ((*end != '\0') || (pid == 0) || !processRunning(static_cast<uint32_t>(pid)) ||
+				(stat(("/dev/shm/" + name).c_str(), &info) != 0)) {
+			continue;
+		}
+		if ((newest == 0) || (info.st_mtime >= newestTime)) {
+			newest = static_cast<uint32_t>(pid);
+			newestTime = info.st_mtime;
+		}
+	}
+	closedir(dir);
+	return newest;
+}
+
+auto openSegment(uint32_t pid) -> const T5ProfileShared * {
+	std::string name = t5ProfileShmName(pid);
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		std::cerr << "Error opening /dev/shm" << name << ": " << std::strerror(errno) << std::endl;
+		return nullptr;
+	}
+	struct stat info;
+	void *memory = MAP_FAILED;
+	if ((fstat(fd, &info) == 0) && (static_cast<size_t>(info.st_size) >= sizeof(T5ProfileShared))) {
+		memory = mmap(nullptr, sizeof(T5ProfileShared), PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (memory == MAP_FAILED) {
+		std::cerr << "Error mapping /dev/shm" << name << ": not a t5profiler segment" << std::endl;
+		return nullptr;
+	}
+
+	auto shared = static_cast<const T5ProfileShared *>(memory);
+	if ((shared->magic.load(std::memory_order_acquire) != kT5ProfileMagic) ||
+			(shared->version != kT5ProfileVersion) || (shared->functionCount > kT5ProfileMaxFunctions)) {
+		std::cerr << "Error reading /dev/shm" << name << ": unknown layout or version" << std::endl;
+		munmap(memory, sizeof(T5ProfileShared));
+		return nullptr;
+	}
+	return shared;
+}
+
+auto monotonicNanos() -> uint64_t {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<uint64_t>(now.tv_sec) * 1000000000u + static_cast<uint64_t>(now.tv_nsec);
+}
+
+auto takeSnapshot(const T5ProfileShared &shared) -> Snapshot {
+	Snapshot snapshot;
+	// Once the process has exited the clock stops there, so rates don't keep falling afterwards
+	uint64_t exitNanos = shared.exitNanos.load(std::memory_order_relaxed);
+	snapshot.nanos = (exitNanos != 0) ? std::min(exitNanos, monotonicNanos()) : monotonicNanos();
+	size_t rows = std::min<size_t>(shared.threadCount.load(std::memory_order_relaxed), kT5ProfileMaxThreads);
+	for (size_t row = 0; row < rows; row++) {
+		ThreadSample thread;
+		thread.tid = (row < kT5ProfileMaxThreads - 1) ? shared.threads[row].tid.load(std::memory_order_relaxed) : 0;
+		thread.functions.resize(shared.functionCount);
+		for (size_t f = 0; f < shared.functionCount; f++) {
+			const T5ProfileStats &stats = shared.stats[row][f];
+			FunctionSample &sample = thread.functions[f];
+			sample.calls = stats.calls.load(std::memory_order_relaxed);
+			if (sample.calls == 0) {
+				continue;
+			}
+			sample.totalNanos = stats.totalNanos.load(std::memory_order_relaxed);
+			sample.maxNanos = stats.maxNanos.load(std::memory_order_relaxed);
+			for (size_t b = 0; b < kT5ProfileBuckets; b++) {
+				sample.buckets[b] = stats.buckets[b].load(std::memory_order_relaxed);
+			}
+			for (const auto &slot : stats.results) {
+				uint32_t key = slot.codePlusOne.load(std::memory_order_relaxed);
+				if (key != 0) {
+					sample.results[key - 1] = slot.count.load(std::memory_order_relaxed);
+				}
+			}
+			sample.otherResults = stats.otherResults.load(std::memory_order_relaxed);
+		}
+		snapshot.threads.push_back(std::move(thread));
+	}
+	return snapshot;
+}
+
+/// Counts between two samples; the maximum stays the one since profiling started
+auto difference(const FunctionSample &now, const FunctionSample &before) -> FunctionSample {
+	FunctionSample delta;
+	delta.calls = now.calls - before.calls;
+	delta.totalNanos = now.totalNanos - before.totalNanos;
+	delta.maxNanos = now.maxNanos;
+	for (size_t b = 0; b < kT5ProfileBuckets; b++) {
+		delta.buckets[b] = now.buckets[b] - before.buckets[b];
+	}
+	for (const auto &[code, count] : now.results) {
+		auto it = before.results.find(code);
+		uint64_t previous = (it != before.results.end()) ? it->second : 0;
+		if (count > previous) {
+			delta.results[code] = count - previous;
+		}
+	}
+	delta.otherResults = now.otherResults - before.otherResults;
+	return delta;
+}
+
+auto accumulate(FunctionSample &total, const FunctionSample &sample) -> void {
+	total.calls += sample.calls;
+	total.totalNanos += sample.totalNanos;
+	total.maxNanos = std::max(total.maxNanos, sample.maxNanos);
+	for (size_t b = 0; b < kT5ProfileBuckets; b++) {
+		total.buckets[b] += sample.buckets[b];
+	}
+	for (const auto &[code, count] : sample.results) {
+		total.results[code] += count;
+	}
+	total.otherResults += sample.otherResults;
+}
+
+/// Quantile estimated from the log2 buckets, interpolating linearly inside the bucket and capped at
+/// the maximum
+auto quantileNanos(const FunctionSample &sample, double q) -> double {
+	if (sample.calls == 0) {
+		return 0.0;
+	}
+	double target = q * static_cast<double>(sample.calls);
+	double seen = 0.0;
+	for (size_t b = 0; b < kT5ProfileBuckets; b++) {
+		auto count = static_cast<double>(sample.buckets[b]);
+		if ((count > 0) && (seen + count >= target)) {
+			double lower = (b == 0) ? 0.0 : static_cast<double>(uint64_t(1) << b);
+			double upper = static_cast<double>(uint64_t(1) << (b + 1));
+			double estimate = lower + (upper - lower) * ((target - seen) / count);
+			return std::min(estimate, static_cast<double>(sample.maxNanos));
+		}
+		seen += count;
+	}
+	return static_cast<double>(sample.maxNanos);
+}
+
+struct ResultName {
+	uint32_t code;
+	const char *name;
+};
+
+const ResultName kResultNames[] = {
+	{ T5_SUCCESS, "SUCCESS" },
+	{ T5_TIMEOUT, "TIMEOUT" },
+	{ T5_ERROR_NO_CONTEXT, "NO_CONTEXT" },
+	{ T5_ERROR_NO_LIBRARY, "NO_LIBRARY" },
+	{ T5_ERROR_INTERNAL, "INTERNAL" },
+	{ T5_ERROR_NO_SERVICE, "NO_SERVICE" },
+	{ T5_ERROR_IO_FAILURE, "IO_FAILURE" },
+	{ T5_ERROR_REQUEST_ID_UNKNOWN, "REQUEST_ID_UNKNOWN" },
+	{ T5_ERROR_INVALID_ARGS, "INVALID_ARGS" },
+	{ T5_ERROR_DEVICE_LOST, "DEVICE_LOST" },
+	{ T5_ERROR_TARGET_NOT_FOUND, "TARGET_NOT_FOUND" },
+	{ T5_ERROR_INVALID_STATE, "INVALID_STATE" },
+	{ T5_ERROR_SETTING_UNKNOWN, "SETTING_UNKNOWN" },
+	{ T5_ERROR_SETTING_WRONG_TYPE, "SETTING_WRONG_TYPE" },
+	{ T5_ERROR_MISC_REMOTE, "MISC_REMOTE" },
+	{ T5_ERROR_OVERFLOW, "OVERFLOW" },
+	{ T5_ERROR_GRAPHICS_API_UNAVAILABLE, "GRAPHICS_API_UNAVAILABLE" },
+	{ T5_ERROR_UNSUPPORTED, "UNSUPPORTED" },
+	{ T5_ERROR_DECODE_ERROR, "DECODE_ERROR" },
+	{ T5_ERROR_INVALID_GFX_CONTEXT, "INVALID_GFX_CONTEXT" },
+	{ T5_ERROR_GFX_CONTEXT_INIT_FAIL, "GFX_CONTEXT_INIT_FAIL" },
+	{ T5_ERROR_TRY_AGAIN, "TRY_AGAIN" },
+	{ T5_ERROR_UNAVAILABLE, "UNAVAILABLE" },
+	{ T5_ERROR_ALREADY_CONNECTED, "ALREADY_CONNECTED" },
+	{ T5_ERROR_NOT_CONNECTED, "NOT_CONNECTED" },
+	{ T5_ERROR_STRING_OVERFLOW, "STRING_OVERFLOW" },
+	{ T5_ERROR_SERVICE_INCOMPATIBLE, "SERVICE_INCOMPATIBLE" },
+	{ T5_PERMISSION_DENIED, "PERMISSION_DENIED" },
+	{ T5_ERROR_INVALID_BUFFER_SIZE, "INVALID_BUFFER_SIZE" },
+	{ T5_ERROR_INVALID_GEOMETRY, "INVALID_GEOMETRY" },
+};
+
+auto resultName(uint32_t code) -> std::string {
+	for (const auto &entry : kResultNames) {
+		if (entry.code == code) {
+			return entry.name;
+		}
+	}
+	char text[16];
+	std::snprintf(text, sizeof(text), "0x%04x", code);
+	return text;
+}
+
+/// Share of each result, most frequent first, e.g. "SUCCESS 97% TRY_AGAIN 3%"
+auto describeResults(const FunctionSample &sample) -> std::string {
+	uint64_t total = sample.otherResults;
+	std::vector<std::pair<uint64_t, uint32_t>> byCount;
+	for (const auto &[code, count] : sample.results) {
+		byCount.emplace_back(count, code);
+		total += count;
+	}
+	if (total == 0) {
+		return "-";
+	}
+	std::sort(byCount.rbegin(), byCount.rend());
+
+	std::string text;
+	char share[16];
+	for (size_t i = 0; (i < byCount.size()) && (i < 3); i++) {
+		std::snprintf(share, sizeof(share), " %.0f%%", 100.0 * static_cast<double>(byCount[i].first) / total);
+		text += (text.empty() ? "" : " ") + resultName(byCount[i].second) + share;
+	}
+	if (sample.otherResults > 0) {
+		std::snprintf(share, sizeof(share), " %.0f%%", 100.0 * static_cast<double>(sample.otherResults) / total);
+		text += std::string(" other") + share;
+	}
+	return text;
+}
+
+auto threadName(uint32_t pid, uint32_t tid) -> std::string {
+	if (tid == 0) {
+		return "other threads";
+	}
+	std::ifstream comm("/proc/" + std::to_string(pid) + "/task/" + std::to_string(tid) + "/comm");
+	std::string name;
+	std::getline(comm, name);
+	return std::to_string(tid) + (name.empty() ? std::string() : " (" + name + ")");
+}
+
+auto printHeader() -> void {
+	std::printf("%-34s %10s %10s %7s %9s %9s %9s %9s  %s\n", "FUNCTION", "CALLS", "CALLS/S", "%WALL", "AVG us",
+			"P50 us", "P99 us", "MAX us", "RESULTS");
+}
+
+auto printRow(const std::string &name, const FunctionSample &sample, double seconds) -> void {
+	double avg = static_cast<double>(sample.totalNanos) / static_cast<double>(sample.calls);
+	std::printf("%-34s %10llu %10.1f %6.2f%% %9.2f %9.2f %9.2f %9.2f  %s\n", name.c_str(),
+			static_cast<unsigned long long>(sample.calls), static_cast<double>(sample.calls) / seconds,
+			100.0 * static_cast<double>(sample.totalNanos) / (seconds * 1e9), avg / 1000.0,
+			quantileNanos(sample, 0.50) / 1000.0, quantileNanos(sample, 0.99) / 1000.0,
+			static_cast<double>(sample.maxNanos) / 1000.0, describeResults(sample).c_str());
+}
+
+/// Function indices with calls, most time spent first
+auto busiestFirst(const std::vector<FunctionSample> &functions) -> std::vector<size_t> {
+	std::vector<size_t> order;
+	for (size_t f = 0; f < functions.size(); f++) {
+		if (functions[f].calls > 0) {
+			order.push_back(f);
+		}
+	}
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return functions[a].totalNanos > functions[b].totalNanos;
+	});
+	return order;
+}
+
+auto printView(const T5ProfileShared &shared, const Snapshot &now, const Snapshot &before, bool threads) -> void {
+	double seconds = std::max(static_cast<double>(now.nanos - before.nanos) / 1e9, 1e-9);
+
+	std::vector<ThreadSample> deltas;
+	std::vector<FunctionSample> totals(shared.functionCount);
+	for (size_t row = 0; row < now.threads.size(); row++) {
+		ThreadSample delta;
+		delta.tid = now.threads[row].tid;
+		delta.functions.resize(shared.functionCount);
+		for (size_t f = 0; f < shared.functionCount; f++) {
+			const FunctionSample empty;
+			const FunctionSample &previous =
+					(row < before.threads.size()) ? before.threads[row].functions[f] : empty;
+			delta.functions[f] = difference(now.threads[row].functions[f], previous);
+			accumulate(totals[f], delta.functions[f]);
+		}
+		deltas.push_back(std::move(delta));
+	}
+
+	uint64_t calls = 0;
+	uint64_t nanos = 0;
+	for (const auto &total : totals) {
+		calls += total.calls;
+		nanos += total.totalNanos;
+	}
+	std::printf("t5top - pid %u, %.1f s, %zu thread%s calling T5, %.0f calls/s, %.2f%% of wall time in T5 calls\n\n",
+			shared.pid, seconds, now.threads.size(), (now.threads.size() == 1) ? "" : "s",
+			static_cast<double>(calls) / seconds, 100.0 * static_cast<double>(nanos) / (seconds * 1e9));
+	printHeader();
+	for (size_t f : busiestFirst(totals)) {
+		printRow(shared.functions[f], totals[f], seconds);
+	}
+
+	if (threads) {
+		for (const auto &delta : deltas) {
+			auto order = busiestFirst(delta.functions);
+			if (order.empty()) {
+				continue;
+			}
+			std::printf("\nthread %s\n", threadName(shared.pid, delta.tid).c_str());
+			for (size_t f : order) {
+				printRow(std::string("  ") + shared.functions[f], delta.functions[f], seconds);
+			}
+		}
+	}
+	std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	TopOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	uint32_t pid = options.pid ? options.pid : findNewestProfiledProcess();
+	if (pid == 0) {
+		std::cerr << "No running process is being profiled; start one with LD_PRELOAD=libt5profiler.so" << std::endl;
+		return 1;
+	}
+	const T5ProfileShared *shared = openSegment(pid);
+	if (!shared) {
+		return 1;
+	}
+
+	// The first view covers everything since the segment was created
+	Snapshot before;
+	before.nanos = shared->startNanos;
+	if (options.once) {
+		printView(*shared, takeSnapshot(*shared), before, options.threads);
+		return 0;
+	}
+
+	auto interval = std::chrono::duration<double>(options.interval);
+	for (;;) {
+		Snapshot now = takeSnapshot(*shared);
+		std::printf("\x1b[H\x1b[2J");
+		printView(*shared, now, before, options.threads);
+		if (!processRunning(pid)) {
+			std::printf("\nProcess %u exited\n", pid);
+			return 0;
+		}
+		before = std::move(now);
+		std::this_thread::sleep_for(interval);
+	}
+}
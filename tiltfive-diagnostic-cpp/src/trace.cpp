@@ -0,0 +1,93 @@
+/// \file
+/// \brief Scoped timing spans recorded per thread and exported as a Chrome trace
+
+#include "include/trace.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+auto writeJsonString(std::ostream &out, const std::string &text) -> void {
+	out << '"';
+	for (char c : text) {
+		if ((c == '"') || (c == '\\')) {
+			out << '\\' << c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out << escaped;
+		} else {
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+// Chrome trace timestamps are microseconds; keep nanosecond precision as decimals
+auto writeMicros(std::ostream &out, int64_t nanos) -> void {
+	char text[32];
+	std::snprintf(text, sizeof(text), "%lld.%03lld", static_cast<long long>(nanos / 1000),
+			static_cast<long long>(nanos % 1000));
+	out << text;
+}
+
+} // namespace
+
+auto Tracer::writeChromeTrace(const std::string &path, size_t &events, uint64_t &dropped) const -> bool {
+	events = 0;
+	dropped = 0;
+
+	std::ofstream out(path, std::ios::trunc);
+	if (!out) {
+		std::cerr << "Error creating " << path << std::endl;
+		return false;
+	}
+
+	std::vector<TraceBuffer *> buffers;
+	{
+		std::lock_guard<std::mutex> lock(mBuffersMtx);
+		for (const auto &buffer : mBuffers) {
+			buffers.push_back(buffer.get());
+		}
+	}
+
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	for (const TraceBuffer *buffer : buffers) {
+		std::string name = buffer->threadName();
+		if (name.empty()) {
+			name = "thread " + std::to_string(buffer->threadId());
+		}
+		out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+			<< buffer->threadId() << ",\"args\":{\"name\":";
+		writeJsonString(out, name);
+		out << "}}";
+		first = false;
+
+		size_t count = buffer->size();
+		for (size_t i = 0; i < count; i++) {
+			const TraceEvent &event = buffer->at(i);
+			out << ",\n{\"name\":";
+			writeJsonString(out, event.name);
+			out << ",\"cat\":";
+			writeJsonString(out, event.category);
+			out << ",\"ph\":\"X\",\"ts\":";
+			writeMicros(out, event.startNanos);
+			out << ",\"dur\":";
+			writeMicros(out, event.durationNanos);
+			out << ",\"pid\":1,\"tid\":" << buffer->threadId() << "}";
+		}
+		events += count;
+		dropped += buffer->dropped();
+	}
+	out << "\n],\"otherData\":{\"droppedEvents\":" << dropped << "}}\n";
+
+	out.close();
+	if (out.fail()) {
+		std::cerr << "Error writing " << path << std::endl;
+		return false;
+	}
+	return true;
+}